@@ -14,16 +14,15 @@
    - Admin dashboard with audit logs, notifications, and account management
    - File-based data persistence — no external database required
 
-   Compile :
-       gcc bvdu_bank.c -o bvdu_bank
+   Compile (Linux, GNU C dialect - gcc's default or -std=gnu11) :
+       gcc -O2 bvdu_bank.c -o bvdu_bank -pthread
 
    Run :
-       ./bvdu_bank   (Linux/macOS)
-       .\bvdu_bank.exe   (Windows)
+       ./bvdu_bank
 
    Notes :
    - Keep all .txt data files in the same directory as this source file.
-   - Uses ANSI escape codes for colored profit/loss (enable ANSI in Windows terminal).
+   - Uses ANSI escape codes for colored profit/loss.
    - Educational project for demonstration and portfolio use.
 
    © 2025 Adarsh Satyajit Adhikary — BVDU-Bank
@@ -32,18 +31,62 @@
 ============================================================================ */
 
 
+#define _GNU_SOURCE   /* MAP_POPULATE, AT_FDCWD, robust mutexes, open_memstream */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/file.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define BVDU_HAVE_IO_URING 1
+#endif
+#endif
 
 /* ---------------- Configuration ---------------- */
-#define MAX_ACCOUNTS 500
+#ifndef MAX_ACCOUNTS
+#define MAX_ACCOUNTS 500   /* override with -DMAX_ACCOUNTS=... for large books */
+#endif
 #define MAX_HOLDINGS 2000
-#define MAX_PRICES 200
+#define MAX_PRICES 4096
 #define MAX_LINE 512
 #define MINI_STAT_LIMIT 10
+#define LIST_PAGE_DEFAULT 50
+#define OUTBUF_SIZE (256 * 1024)
+#define PRICE_HASH_SIZE 8192         /* power of two, > 2 * MAX_PRICES */
+#define FEED_BUF_SIZE (1 << 20)
+#define FEED_CHECKPOINT_SECS 5
+#define MAX_SUBSCRIBERS 1024
+#define PRICE_BM_WORDS ((MAX_PRICES + 63) / 64)
 
 /* Files */
 static const char *F_ACCOUNTS = "accounts.txt";
@@ -53,6 +96,16 @@ static const char *F_PRICES = "prices.txt";
 static const char *F_FX = "fx_rates.txt";
 static const char *F_ADMIN_AUDIT = "admin_audit.txt";
 static const char *F_NOTIFICATIONS = "notifications.txt";
+static const char *F_TRADES = "trades.dat";
+static const char *F_SETTLEMENT = "settlement.txt";
+static const char *F_FEES = "fees.txt";
+static const char *F_BASKETS = "baskets.txt";
+static const char *F_INTEREST = "interest.txt";
+static const char *F_JOURNAL = "journal.txt";
+static const char *F_PITR_CATALOG = "pitr_catalog.txt";
+static const char *F_HOT_ACCOUNTS = "hot_accounts.txt";
+static const char *F_ACCOUNT_SEQ = "account_seq.txt";
+static const char *F_COLD_STORE = "cold_store.dat";
 
 /* Admin PIN */
 static const int ADMIN_PIN = 0013;
@@ -64,19 +117,30 @@ static const char *ANSI_RESET = "\x1b[0m";
 
 /* ---------------- Data structures ---------------- */
 
+enum { ACC_SAVINGS, ACC_CURRENT, ACC_OTHER, ACC_TYPE_COUNT };
+
+/* An account is split in two parallel tables with the same index:
+   Account holds what scans, lookups and cash movements touch (48 bytes),
+   AccountInfo the identity and display strings that only UI paths read. */
 typedef struct {
     int acc_no;
-    char name[50];
-    char acc_type[20]; /* Savings/Current */
     int pin;
     double balance;    /* cash in INR */
     double loan;
-    int active;        /* 1 active 0 deleted */
-    int frozen;        /* 1 locked after failed attempts */
-    int failed_attempts;
+    double accrued;       /* Savings interest accrued, not yet posted */
+    int64_t last_accrual; /* day number accrual is complete through (0 = not started) */
+    unsigned char active;          /* 1 active 0 deleted */
+    unsigned char frozen;          /* 1 locked after failed attempts */
+    unsigned char failed_attempts;
+    unsigned char type;            /* ACC_* parsed from AccountInfo.acc_type */
+} Account;
+
+typedef struct {
+    char name[50];
+    char acc_type[20]; /* Savings/Current */
     char upi[64];
     char last_login[25];
-} Account;
+} AccountInfo;
 
 typedef struct {
     int acc_no;
@@ -87,14 +151,13 @@ typedef struct {
     char note[80];
 } Transaction;
 
-/* Holding: which account owns which asset */
+/* Holding: which account owns which asset. The asset is interned as its
+   prices[] slot; id, name and market are read from there (24 bytes). */
 typedef struct {
     int acc_no;
-    char asset_id[16];
-    char asset_name[64];
+    int asset;         /* prices[] slot, see intern_asset() */
     double qty;
     double avg_price;  /* in asset's native currency (e.g., USD for US market) */
-    char market[8];    /* "IN","US","EU" */
 } Holding;
 
 /* Price record: asset, price in native currency, volatility, market, last updated */
@@ -109,6 +172,9 @@ typedef struct {
     int close_hour;    /* market close hour (0-23 local) */
 } PriceRec;
 
+enum { MKT_IN, MKT_US, MKT_EU, MKT_COUNT };
+static const char *MARKET_NAMES[MKT_COUNT] = {"IN", "US", "EU"};
+
 /* FX rates: INR per USD and INR per EUR */
 typedef struct {
     double inr_per_usd;
@@ -117,8 +183,14 @@ typedef struct {
 } FXRates;
 
 /* ---------------- In-memory arrays ---------------- */
-static Account accounts[MAX_ACCOUNTS];
+static Account book_accounts[MAX_ACCOUNTS];
+static AccountInfo book_account_info[MAX_ACCOUNTS];
+static Account *accounts = book_accounts;            /* the shared book's tables once attached */
+static AccountInfo *account_info = book_account_info;
 static int acc_count = 0;
+static unsigned book_dirty;       /* DIRTY_* saved while holding the shared book */
+static int acc_index_dirty = 1;   /* listing indexes/bitmaps need rebuild */
+static int upi_set_stale = 1;     /* UPI reservation set needs rebuild */
 
 static Holding holdings[MAX_HOLDINGS];
 static int hold_count = 0;
@@ -128,6 +200,46 @@ static int price_count = 0;
 
 static FXRates fx = {83.5, 88.2, ""};
 
+/* asset_id -> prices[] position (open addressing, -1 = empty) */
+static int price_slot[PRICE_HASH_SIZE];
+/* valuation cache: current price of each asset converted to INR */
+static double price_inr_cache[MAX_PRICES];
+
+/* published quotes: written only by the ticker, read lock-free by subscribers */
+static _Atomic double quote_price[MAX_PRICES];
+static _Atomic uint64_t quote_version[MAX_PRICES];
+static _Atomic uint64_t quote_epoch;   /* bumped on every publication */
+
+/* basket instruments: one entry per (basket, constituent, weight) */
+typedef struct {
+    int basket;        /* prices[] slot of the basket */
+    int constituent;   /* prices[] slot of the underlying asset */
+    double weight;     /* units of constituent per basket unit */
+} BasketEntry;
+
+static unsigned char is_basket[MAX_PRICES];
+static unsigned char is_synthetic[MAX_PRICES];   /* interned for a holding, not listed */
+static double basket_nav_inr[MAX_PRICES];
+static BasketEntry *basket_entries = NULL;        /* sorted by constituent */
+static int basket_entry_count = 0, basket_entry_cap = 0;
+
+/* bank-wide running totals, kept in step with every balance and holding
+   change so dashboards read them without scanning (see "Bank-wide aggregates") */
+static const char *ACC_TYPE_NAMES[ACC_TYPE_COUNT] = {"Savings", "Current", "Other"};
+
+typedef struct {
+    int accounts;                       /* active accounts */
+    double deposits;                    /* cash held by active accounts, INR */
+    double by_type[ACC_TYPE_COUNT];
+    double loans;
+    double aum_inr[MKT_COUNT];          /* holdings at current prices, by market */
+} BankTotals;
+
+static BankTotals totals;
+static double asset_units[MAX_PRICES];  /* units held across all accounts */
+static uint64_t totals_mutations = 0;   /* since the last verification */
+static int basket_link_start[MAX_PRICES + 1];     /* constituent -> first entry */
+
 /* ---------------- Utility functions ---------------- */
 
 static void trim_newline(char *s) {
@@ -143,19 +255,66 @@ static void get_timestamp(char *buf, size_t n) {
     else strncpy(buf, "1970-01-01 00:00:00", n);
 }
 
-/* safe input readers (fgets + parse) */
+/* monotonic seconds, for throughput reporting */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* civil date <-> day number (days since 1970-01-01) */
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int64_t local_day(int64_t ts) {
+    time_t t = (time_t)ts;
+    struct tm *tm = localtime(&t);
+    if (!tm) return ts / 86400;
+    return days_from_civil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+}
+
+static void format_day(int64_t day, char *buf, size_t n) {
+    time_t t = (time_t)(day * 86400 + 43200);
+    struct tm *tm = gmtime(&t);
+    if (tm) strftime(buf, n, "%Y-%m-%d", tm); else snprintf(buf, n, "day%lld", (long long)day);
+}
+
+static void io_flush(void);
+static void book_wait_begin(void);
+static void book_wait_end(void);
+
+/* safe input readers (fgets + parse); pending writes go out and the shared
+   book is let go before we block */
+static char *read_input(char *buf, int n) {
+    io_flush();
+    book_wait_begin();
+    char *r = fgets(buf, n, stdin);
+    book_wait_end();
+    return r;
+}
 static int safe_read_int(void) {
     char buf[128];
-    if (!fgets(buf, sizeof buf, stdin)) return -1;
+    if (!read_input(buf, sizeof buf)) return -1;
     trim_newline(buf);
     return atoi(buf);
 }
 static double safe_read_double(void) {
     char buf[128];
-    if (!fgets(buf, sizeof buf, stdin)) return -1.0;
+    if (!read_input(buf, sizeof buf)) return -1.0;
     trim_newline(buf);
     return atof(buf);
 }
+static int safe_read_line(char *buf, size_t n) {
+    if (!read_input(buf, (int)n)) return 0;
+    trim_newline(buf);
+    return 1;
+}
 
 /* portable stricmp to avoid collision with platform libs */
 static int bvdu_stricmp(const char *a, const char *b) {
@@ -167,6 +326,12 @@ static int bvdu_stricmp(const char *a, const char *b) {
     }
 }
 
+static int acc_type_index(const char *t) {
+    if (bvdu_stricmp(t, "Savings") == 0) return ACC_SAVINGS;
+    if (bvdu_stricmp(t, "Current") == 0) return ACC_CURRENT;
+    return ACC_OTHER;
+}
+
 /* lowercase in-place */
 static void strtolower_inplace(char *s) {
     for (; *s; ++s) *s = (char)tolower((unsigned char)*s);
@@ -186,955 +351,8665 @@ static int atomic_write_text(const char *filename, const char *tmpname, const ch
     return 1;
 }
 
-/* append line to text file */
-static void append_line(const char *filename, const char *line) {
-    FILE *f = fopen(filename, "a");
-    if (!f) return;
-    fputs(line, f);
-    fputs("\n", f);
-    fclose(f);
-}
+/* ---------------- Persistence backend: stdio or io_uring ---------------- */
 
-/* timestamped admin audit append */
-static void audit_log(const char *entry) {
-    char ts[25];
-    get_timestamp(ts, sizeof ts);
-    char buf[512];
-    snprintf(buf, sizeof buf, "%s|%s", ts, entry);
-    append_line(F_ADMIN_AUDIT, buf);
-}
+/* Ledger/journal appends go through io_append() and whole-file rewrites through
+   snapshot_begin()/snapshot_commit(). The default backend is blocking stdio.
+   On Linux, BVDU_IO=uring selects an io_uring backend: appends are staged in
+   registered buffers and submitted as one batch just before the program waits
+   for input; snapshots are rendered in memory and the kernel writes, closes
+   and renames them, so the request path does not wait on the disk. */
 
-/* push notification */
-static void push_notification(int acc_no, const char *msg) {
-    char ts[25];
-    get_timestamp(ts, sizeof ts);
-    char buf[512];
-    snprintf(buf, sizeof buf, "%s|%d|%s", ts, acc_no, msg);
-    append_line(F_NOTIFICATIONS, buf);
-}
+#define IO_SLOTS 32
+#define IO_SLOT_SIZE (64 * 1024)
+#define IO_MAX_FILES 16
+#define IO_RING_ENTRIES 256
 
-/* ---------------- File load/save routines ---------------- */
+static int io_uring_enabled = 0;
 
-static void save_accounts(void) {
-    /* atomic save */
-    const char *tmp = "accounts.tmp";
-    FILE *f = fopen(tmp, "w");
-    if (!f) { perror("save_accounts fopen"); return; }
-    for (int i = 0; i < acc_count; ++i) {
-        Account *a = &accounts[i];
-        /* acc_no|name|acc_type|pin|balance|loan|active|frozen|failed_attempts|upi|last_login */
-        fprintf(f, "%d|%s|%s|%d|%.2f|%.2f|%d|%d|%d|%s|%s\n",
-            a->acc_no, a->name, a->acc_type, a->pin, a->balance, a->loan,
-            a->active, a->frozen, a->failed_attempts, a->upi, a->last_login);
+#ifdef BVDU_HAVE_IO_URING
+
+enum { IO_K_APPEND = 1, IO_K_SNAP_WRITE, IO_K_SNAP_CLOSE, IO_K_SNAP_RENAME };
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned pending;     /* queued, not yet submitted */
+    unsigned inflight;    /* submitted, completion not yet reaped */
+    int has_renameat;
+} IoRing;
+
+typedef struct {
+    char path[64];
+    int fd;
+    int64_t off;          /* next write offset (we never rely on O_APPEND ordering) */
+    int slot;             /* slot being filled, -1 = none */
+    int held;             /* a snapshot is replacing the file: stage, don't submit */
+} IoFile;
+
+typedef struct {
+    int state;            /* 0 free, 1 filling, 2 in flight */
+    int file;
+    size_t len;
+    int64_t off;          /* file offset the write was submitted at */
+} IoSlot;
+
+typedef struct {
+    char final[64];
+    char tmp[72];
+    int fd;
+    int in_flight;
+    int failed;
+    char *buf; size_t len;            /* rewrite in flight */
+    char *next; size_t next_len;      /* newest queued rewrite; older ones are superseded */
+} IoSnap;
+
+static IoRing ring;
+static IoFile io_files[IO_MAX_FILES];
+static int io_file_count = 0;
+static IoSlot io_slots[IO_SLOTS];
+static char *io_arena = NULL;
+static IoSnap io_snaps[IO_MAX_FILES];
+static int io_snap_count = 0;
+
+static int ring_setup(void) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    int fd = (int)syscall(__NR_io_uring_setup, IO_RING_ENTRIES, &p);
+    if (fd < 0) return -1;
+    size_t sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) { if (cq_sz > sq_sz) sq_sz = cq_sz; cq_sz = sq_sz; }
+    char *sq = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) { close(fd); return -1; }
+    char *cq = sq;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) { close(fd); return -1; }
     }
-    fclose(f);
-    remove(F_ACCOUNTS);
-    rename(tmp, F_ACCOUNTS);
+    void *sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) { close(fd); return -1; }
+    ring.fd = fd;
+    ring.sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring.sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring.sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring.cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring.cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring.sqes = sqes;
+    ring.sq_entries = p.sq_entries;
+
+    /* one registered buffer per staging slot */
+    io_arena = malloc((size_t)IO_SLOTS * IO_SLOT_SIZE);
+    if (!io_arena) return -1;
+    struct iovec iov[IO_SLOTS];
+    for (int i = 0; i < IO_SLOTS; ++i) { iov[i].iov_base = io_arena + (size_t)i * IO_SLOT_SIZE; iov[i].iov_len = IO_SLOT_SIZE; }
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, IO_SLOTS) < 0) return -1;
+
+    /* renameat in the ring needs 5.11+; otherwise rename after the close completes */
+    size_t psz = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, psz);
+    if (probe && syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) >= 0)
+        ring.has_renameat = probe->last_op >= IORING_OP_RENAMEAT && (probe->ops[IORING_OP_RENAMEAT].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return 0;
 }
 
-static void load_accounts(void) {
-    FILE *f = fopen(F_ACCOUNTS, "r");
-    if (!f) { acc_count = 0; return; }
-    acc_count = 0;
-    while (!feof(f) && acc_count < MAX_ACCOUNTS) {
-        Account a;
-        char upi[64] = "", last_login[25] = "";
-        int r = fscanf(f, "%d|%49[^|]|%19[^|]|%d|%lf|%lf|%d|%d|%d|%63[^|]|%24[^\n]\n",
-            &a.acc_no, a.name, a.acc_type, &a.pin, &a.balance, &a.loan,
-            &a.active, &a.frozen, &a.failed_attempts, upi, last_login);
-        if (r == 11) {
-            strncpy(a.upi, upi, sizeof a.upi - 1);
-            strncpy(a.last_login, last_login, sizeof a.last_login - 1);
-            accounts[acc_count++] = a;
-        } else break;
+static void ring_submit(void) {
+    while (ring.pending) {
+        int r = (int)syscall(__NR_io_uring_enter, ring.fd, ring.pending, 0, 0, NULL, 0);
+        if (r < 0) { if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue; perror("io_uring_enter"); return; }
+        ring.pending -= (unsigned)r;
+        ring.inflight += (unsigned)r;
     }
-    fclose(f);
 }
 
-static void append_transaction(const Transaction *t) {
-    FILE *f = fopen(F_TRANSACTIONS, "a");
-    if (!f) { perror("append_transaction"); return; }
-    /* acc_no|timestamp|type|amount|balance_after|note */
-    fprintf(f, "%d|%s|%s|%.2f|%.2f|%s\n",
-        t->acc_no, t->timestamp, t->type, t->amount, t->balance_after, t->note);
-    fclose(f);
-}
+static void io_snapshot_start(IoSnap *s);
+static void io_file_reopen(const char *path, int still_held);
 
-/* holdings */
-static void save_holdings(void) {
-    FILE *f = fopen(F_HOLDINGS, "w");
-    if (!f) { perror("save_holdings fopen"); return; }
-    for (int i = 0; i < hold_count; ++i) {
-        Holding *h = &holdings[i];
-        /* acc_no|asset_id|asset_name|qty|avg_price|market */
-        fprintf(f, "%d|%s|%s|%.6f|%.4f|%s\n", h->acc_no, h->asset_id, h->asset_name, h->qty, h->avg_price, h->market);
+static void io_snap_finish(IoSnap *s) {
+    if (s->failed) fprintf(stderr, "io_uring: snapshot of %s failed\n", s->final);
+    free(s->buf);
+    s->buf = NULL;
+    s->in_flight = 0;
+    /* the rename is done: appends staged meanwhile go to the new file */
+    io_file_reopen(s->final, s->next != NULL);
+    if (s->next) {
+        s->buf = s->next; s->len = s->next_len;
+        s->next = NULL;
+        io_snapshot_start(s);
     }
-    fclose(f);
 }
 
-static void load_holdings(void) {
-    FILE *f = fopen(F_HOLDINGS, "r");
-    if (!f) { hold_count = 0; return; }
-    hold_count = 0;
-    while (!feof(f) && hold_count < MAX_HOLDINGS) {
-        Holding h;
-        int r = fscanf(f, "%d|%15[^|]|%63[^|]|%lf|%lf|%7[^\n]\n",
-            &h.acc_no, h.asset_id, h.asset_name, &h.qty, &h.avg_price, h.market);
-        if (r == 6) holdings[hold_count++] = h;
-        else break;
+static void io_handle_cqe(uint64_t ud, int res) {
+    int kind = (int)(ud >> 56);
+    int id = (int)(ud & 0xffffffu);
+    if (kind == IO_K_APPEND) {
+        IoSlot *sl = &io_slots[id];
+        if (res < 0 || (size_t)res < sl->len) {
+            /* short or failed write: finish the rest synchronously where it was aimed */
+            IoFile *f = &io_files[sl->file];
+            size_t done = res > 0 ? (size_t)res : 0;
+            while (done < sl->len) {
+                ssize_t w = pwrite(f->fd, io_arena + (size_t)id * IO_SLOT_SIZE + done, sl->len - done, (off_t)(sl->off + (int64_t)done));
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) { perror("io_uring append"); break; }
+                done += (size_t)w;
+            }
+        }
+        sl->state = 0;
+        sl->len = 0;
+    } else {
+        IoSnap *s = &io_snaps[id];
+        if (kind == IO_K_SNAP_WRITE) {
+            if (res < 0 || (size_t)res != s->len) s->failed = 1;
+        } else if (kind == IO_K_SNAP_CLOSE) {
+            if (res == -ECANCELED) close(s->fd);
+            if (!ring.has_renameat) {
+                if (!s->failed && rename(s->tmp, s->final) != 0) s->failed = 1;
+                io_snap_finish(s);
+            }
+        } else if (kind == IO_K_SNAP_RENAME) {
+            if (res < 0) s->failed = 1;
+            io_snap_finish(s);
+        }
     }
-    fclose(f);
 }
 
-/* prices (atomic) */
-static void save_prices(void) {
-    const char *tmp = "prices.tmp";
-    FILE *f = fopen(tmp, "w");
-    if (!f) { perror("save_prices fopen"); return; }
-    for (int i = 0; i < price_count; ++i) {
-        PriceRec *p = &prices[i];
-        fprintf(f, "%s|%s|%.4f|%.6f|%s|%s|%d|%d\n",
-            p->asset_id, p->asset_name, p->price, p->vol, p->market, p->last_update, p->open_hour, p->close_hour);
+/* reap completions; with wait set, block until at least one arrives */
+static void ring_reap(int wait) {
+    for (;;) {
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        if (head != tail) {
+            while (head != tail) {
+                struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+                uint64_t ud = cqe->user_data;
+                int res = cqe->res;
+                head++;
+                __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+                ring.inflight--;
+                io_handle_cqe(ud, res);
+            }
+            return;
+        }
+        if (!wait || ring.inflight == 0) return;
+        int r = (int)syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (r < 0 && errno != EINTR) { perror("io_uring_enter"); return; }
     }
-    fclose(f);
-    remove(F_PRICES);
-    rename(tmp, F_PRICES);
 }
 
-static void load_prices(void) {
-    FILE *f = fopen(F_PRICES, "r");
-    if (!f) { price_count = 0; return; }
-    price_count = 0;
-    while (!feof(f) && price_count < MAX_PRICES) {
-        PriceRec p;
-        int r = fscanf(f, "%15[^|]|%63[^|]|%lf|%lf|%7[^|]|%24[^|]|%d|%d\n",
-            p.asset_id, p.asset_name, &p.price, &p.vol, p.market, p.last_update, &p.open_hour, &p.close_hour);
-        if (r == 8) prices[price_count++] = p;
-        else break;
+/* reserve n contiguous SQEs (a link chain must not straddle a submit) */
+static void ring_reserve(unsigned n) {
+    for (;;) {
+        unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        unsigned tail = *ring.sq_tail;
+        if (ring.sq_entries - (tail - head) >= n) return;
+        ring_submit();
+        ring_reap(1);
     }
-    fclose(f);
 }
 
-/* fx rates */
-static void save_fx(void) {
-    const char *tmp = "fx.tmp";
-    FILE *f = fopen(tmp, "w");
-    if (!f) { perror("save_fx fopen"); return; }
-    fprintf(f, "%.6f|%.6f|%s\n", fx.inr_per_usd, fx.inr_per_eur, fx.last_update);
-    fclose(f);
-    remove(F_FX);
-    rename(tmp, F_FX);
+static struct io_uring_sqe *ring_push(uint64_t ud, unsigned char flags) {
+    unsigned tail = *ring.sq_tail;
+    unsigned idx = tail & *ring.sq_mask;
+    struct io_uring_sqe *sqe = &ring.sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    sqe->user_data = ud;
+    sqe->flags = flags;
+    ring.sq_array[idx] = idx;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring.pending++;
+    return sqe;
 }
 
-static void load_fx(void) {
-    FILE *f = fopen(F_FX, "r");
-    if (!f) { /* defaults already set */ return; }
-    char last[25] = {0};
-    int r = fscanf(f, "%lf|%lf|%24[^\n]\n", &fx.inr_per_usd, &fx.inr_per_eur, last);
-    if (r == 3) strncpy(fx.last_update, last, sizeof fx.last_update - 1);
-    fclose(f);
+static void io_slot_submit(IoFile *f) {
+    int id = f->slot;
+    IoSlot *sl = &io_slots[id];
+    ring_reserve(1);
+    struct io_uring_sqe *sqe = ring_push(((uint64_t)IO_K_APPEND << 56) | (uint64_t)id, 0);
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = f->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(io_arena + (size_t)id * IO_SLOT_SIZE);
+    sqe->len = (unsigned)sl->len;
+    sqe->off = (uint64_t)f->off;
+    sqe->buf_index = (unsigned short)id;
+    sl->off = f->off;
+    f->off += (int64_t)sl->len;
+    sl->state = 2;
+    f->slot = -1;
 }
 
-/* ---------------- Helper finders ---------------- */
+static void io_submit_staged(void) {
+    for (int i = 0; i < io_file_count; ++i)
+        if (io_files[i].slot >= 0 && !io_files[i].held && io_slots[io_files[i].slot].len) io_slot_submit(&io_files[i]);
+}
 
-static int find_account_index(int acc_no) {
-    for (int i = 0; i < acc_count; ++i) if (accounts[i].acc_no == acc_no) return i;
-    return -1;
+static void io_snapshot_start(IoSnap *s) {
+    s->failed = 0;
+    s->fd = open(s->tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (s->fd < 0) { perror("io_uring snapshot open"); s->in_flight = 1; s->failed = 1; io_snap_finish(s); return; }
+    s->in_flight = 1;
+    int id = (int)(s - io_snaps);
+    /* Appends staged so far (the journal rows of this save among them) go in
+       first, and IO_DRAIN keeps the write -> close -> rename chain from
+       starting until they have completed: the file is never replaced ahead
+       of the journal that covers it. */
+    io_submit_staged();
+    ring_reserve(3);
+    struct io_uring_sqe *w = ring_push(((uint64_t)IO_K_SNAP_WRITE << 56) | (uint64_t)id, IOSQE_IO_LINK | IOSQE_IO_DRAIN);
+    w->opcode = IORING_OP_WRITE;
+    w->fd = s->fd;
+    w->addr = (uint64_t)(uintptr_t)s->buf;
+    w->len = (unsigned)s->len;
+    w->off = 0;
+    struct io_uring_sqe *c = ring_push(((uint64_t)IO_K_SNAP_CLOSE << 56) | (uint64_t)id, ring.has_renameat ? IOSQE_IO_LINK : 0);
+    c->opcode = IORING_OP_CLOSE;
+    c->fd = s->fd;
+    if (ring.has_renameat) {
+        struct io_uring_sqe *r = ring_push(((uint64_t)IO_K_SNAP_RENAME << 56) | (uint64_t)id, 0);
+        r->opcode = IORING_OP_RENAMEAT;
+        r->fd = AT_FDCWD;
+        r->addr = (uint64_t)(uintptr_t)s->tmp;
+        r->len = (unsigned)AT_FDCWD;
+        r->addr2 = (uint64_t)(uintptr_t)s->final;
+    }
 }
 
-static int find_active_account_index(int acc_no) {
-    for (int i = 0; i < acc_count; ++i) if (accounts[i].acc_no == acc_no && accounts[i].active) return i;
-    return -1;
+/* takes ownership of buf (malloc'd) */
+static void io_snapshot_submit(const char *final, char *buf, size_t len) {
+    IoSnap *s = NULL;
+    for (int i = 0; i < io_snap_count; ++i) if (strcmp(io_snaps[i].final, final) == 0) s = &io_snaps[i];
+    if (!s) {
+        if (io_snap_count == IO_MAX_FILES) { fprintf(stderr, "io_uring: too many snapshot targets\n"); free(buf); return; }
+        s = &io_snaps[io_snap_count++];
+        memset(s, 0, sizeof *s);
+        strncpy(s->final, final, sizeof s->final - 1);
+        snprintf(s->tmp, sizeof s->tmp, "%s.iotmp", final);
+    }
+    if (s->in_flight) {
+        free(s->next);
+        s->next = buf; s->next_len = len;
+        return;
+    }
+    s->buf = buf; s->len = len;
+    io_snapshot_start(s);
 }
 
-static int find_account_by_upi(const char *upi) {
-    for (int i = 0; i < acc_count; ++i) if (accounts[i].active && bvdu_stricmp(accounts[i].upi, upi) == 0) return i;
-    return -1;
+static IoSnap *io_snap_in_flight(const char *path) {
+    for (int i = 0; i < io_snap_count; ++i)
+        if (io_snaps[i].in_flight && strcmp(io_snaps[i].final, path) == 0) return &io_snaps[i];
+    return NULL;
 }
 
-static int is_upi_unique(const char *upi) {
-    for (int i = 0; i < acc_count; ++i) if (bvdu_stricmp(accounts[i].upi, upi) == 0) return 0;
-    return 1;
+static IoFile *io_file_find(const char *path) {
+    for (int i = 0; i < io_file_count; ++i) if (strcmp(io_files[i].path, path) == 0) return &io_files[i];
+    return NULL;
 }
 
-static int find_price_index(const char *asset_id) {
-    for (int i = 0; i < price_count; ++i) if (strcmp(prices[i].asset_id, asset_id) == 0) return i;
-    return -1;
+static IoFile *io_file_get(const char *path) {
+    IoFile *f = io_file_find(path);
+    if (f) return f;
+    if (io_file_count == IO_MAX_FILES) return NULL;
+    int fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return NULL;
+    f = &io_files[io_file_count++];
+    memset(f, 0, sizeof *f);
+    strncpy(f->path, path, sizeof f->path - 1);
+    f->fd = fd;
+    f->off = (int64_t)lseek(fd, 0, SEEK_END);
+    f->slot = -1;
+    IoSnap *s = io_snap_in_flight(path);
+    if (s) {
+        /* this fd is the file being replaced; hold appends until the rename */
+        f->held = 1;
+        f->off = (int64_t)(s->next ? s->next_len : s->len);
+    }
+    return f;
 }
 
-static int find_holding_index(int acc_no, const char *asset_id) {
-    for (int i = 0; i < hold_count; ++i)
-        if (holdings[i].acc_no == acc_no && strcmp(holdings[i].asset_id, asset_id) == 0) return i;
-    return -1;
+/* A snapshot is replacing path. Appends already staged go to the old file;
+   later ones are held in their slot, and the descriptor is swapped for the
+   new file when the rename completes (io_file_reopen), so the caller never
+   waits for the snapshot. */
+static void io_file_hold(const char *path, size_t new_size) {
+    IoFile *f = io_file_find(path);
+    if (!f) return;
+    if (f->slot >= 0 && !f->held && io_slots[f->slot].len) io_slot_submit(f);
+    f->held = 1;
+    f->off = (int64_t)new_size;
 }
 
-/* ---------------- Transaction logging ---------------- */
+static void io_file_reopen(const char *path, int still_held) {
+    IoFile *f = io_file_find(path);
+    if (!f) return;
+    int fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) { perror("io_uring reopen"); return; }
+    close(f->fd);   /* its writes were drained ahead of the snapshot */
+    f->fd = fd;
+    f->off = (int64_t)lseek(fd, 0, SEEK_END);
+    f->held = still_held;
+    if (!f->held && f->slot >= 0 && io_slots[f->slot].len) io_slot_submit(f);
+}
 
-static void log_transaction(int acc_no, const char *type, double amount, double balance_after, const char *note) {
-    Transaction t;
-    t.acc_no = acc_no;
-    get_timestamp(t.timestamp, sizeof t.timestamp);
-    strncpy(t.type, type, sizeof t.type - 1); t.type[sizeof t.type - 1] = '\0';
-    t.amount = amount;
-    t.balance_after = balance_after;
-    strncpy(t.note, note, sizeof t.note - 1); t.note[sizeof t.note - 1] = '\0';
-    append_transaction(&t);
+static int io_slot_acquire(int file) {
+    for (;;) {
+        for (int i = 0; i < IO_SLOTS; ++i)
+            if (io_slots[i].state == 0) { io_slots[i].state = 1; io_slots[i].file = file; io_slots[i].len = 0; return i; }
+        /* all slots busy: the only place the request path can wait */
+        ring_submit();
+        ring_reap(1);
+    }
 }
 
-/* ---------------- Utilities: market time & tick ---------------- */
+#endif /* BVDU_HAVE_IO_URING */
 
-static int market_is_open(const PriceRec *p) {
-    time_t t = time(NULL);
-    struct tm *tm = localtime(&t);
-    int hour = tm->tm_hour;
-    /* simple: compare hour in local timezone */
-    if (p->open_hour <= p->close_hour) return (hour >= p->open_hour && hour < p->close_hour);
-    /* wrap-around e.g., open 20 to 4 */
-    return (hour >= p->open_hour || hour < p->close_hour);
+/* Group commit: between io_group_begin() and io_group_end() appends are
+   collected per file in memory and written once at the end, so a burst of
+   requests costs one write per file instead of one per row. */
+#define IO_GROUP_FILES 8
+
+typedef struct {
+    const char *path;
+    int binary;
+    char *buf;
+    size_t len, cap;
+} IoGroupFile;
+
+static IoGroupFile io_group_files[IO_GROUP_FILES];
+static int io_group_count, io_grouping;
+
+static int io_group_add(const char *path, const void *data, size_t len, int binary) {
+    IoGroupFile *g = NULL;
+    for (int i = 0; i < io_group_count && !g; ++i) if (strcmp(io_group_files[i].path, path) == 0) g = &io_group_files[i];
+    if (!g) {
+        if (io_group_count == IO_GROUP_FILES) return -1;
+        g = &io_group_files[io_group_count++];
+        g->path = path; g->binary = binary; g->len = 0;
+    }
+    if (g->len + len > g->cap) {
+        size_t cap = g->cap ? g->cap : 65536;
+        while (cap < g->len + len) cap *= 2;
+        char *nb = realloc(g->buf, cap);
+        if (!nb) return -1;
+        g->buf = nb; g->cap = cap;
+    }
+    memcpy(g->buf + g->len, data, len);
+    g->len += len;
+    return 0;
 }
 
-/* small random double in [-1,1] */
-static double rand_minus1_1(void) {
-    return ((double)rand() / RAND_MAX) * 2.0 - 1.0;
+static int io_append(const char *path, const void *data, size_t len, int binary);
+
+static void io_group_begin(void) { io_grouping = 1; }
+
+/* write out everything collected; buffers are kept for the next group */
+static void io_group_end(void) {
+    io_grouping = 0;
+    for (int i = 0; i < io_group_count; ++i) {
+        IoGroupFile *g = &io_group_files[i];
+        if (g->len && io_append(g->path, g->buf, g->len, g->binary) != 0) perror(g->path);
+    }
+    io_group_count = 0;
 }
 
-/* single market tick: adjust prices for market that is open */
-static void tick_market_once(void) {
-    char ts[25];
-    get_timestamp(ts, sizeof ts);
-    for (int i = 0; i < price_count; ++i) {
-        PriceRec *p = &prices[i];
-        if (market_is_open(p)) {
-            /* percent change ~ N(0, vol) scaled by random */
-            double change_pct = rand_minus1_1() * p->vol;
-            double old = p->price;
-            p->price *= (1.0 + change_pct);
-            if (p->price < 0.0001) p->price = 0.0001;
-            strncpy(p->last_update, ts, sizeof p->last_update - 1);
+/* submit everything staged so far in one batch (no-op for stdio) */
+static void io_flush(void) {
+#ifdef BVDU_HAVE_IO_URING
+    if (!io_uring_enabled) return;
+    io_submit_staged();
+    ring_submit();
+    ring_reap(0);
+#endif
+}
+
+/* wait until every write has reached the files (before reading them back) */
+static void io_drain(void) {
+    if (io_grouping) { io_group_end(); io_group_begin(); }
+#ifdef BVDU_HAVE_IO_URING
+    if (!io_uring_enabled) return;
+    io_flush();
+    for (;;) {
+        int busy = ring.inflight > 0 || ring.pending > 0;
+        for (int i = 0; i < io_snap_count; ++i) busy |= io_snaps[i].in_flight;
+        if (!busy) break;
+        ring_submit();
+        ring_reap(1);
+    }
+#endif
+}
+
+/* returns 1 if io_uring is active afterwards */
+static int io_backend_init(const char *name) {
+    if (!name || strcmp(name, "uring") != 0) return 0;
+#ifdef BVDU_HAVE_IO_URING
+    if (io_uring_enabled) return 1;
+    if (ring_setup() != 0) { fprintf(stderr, "io_uring unavailable, using stdio.\n"); return 0; }
+    io_uring_enabled = 1;
+    atexit(io_drain);
+    return 1;
+#else
+    fprintf(stderr, "io_uring not compiled in, using stdio.\n");
+    return 0;
+#endif
+}
+
+/* append raw bytes to a ledger/journal file */
+static int io_append(const char *path, const void *data, size_t len, int binary) {
+    if (io_grouping && io_group_add(path, data, len, binary) == 0) return 0;
+#ifdef BVDU_HAVE_IO_URING
+    if (io_uring_enabled) {
+        IoFile *f = io_file_get(path);
+        if (!f) return -1;
+        const char *p = data;
+        while (len) {
+            if (f->slot < 0) f->slot = io_slot_acquire((int)(f - io_files));
+            IoSlot *sl = &io_slots[f->slot];
+            size_t n = IO_SLOT_SIZE - sl->len;
+            if (n > len) n = len;
+            memcpy(io_arena + (size_t)f->slot * IO_SLOT_SIZE + sl->len, p, n);
+            sl->len += n; p += n; len -= n;
+            if (sl->len == IO_SLOT_SIZE) {
+                int fi = (int)(f - io_files);
+                while (io_files[fi].held) { ring_submit(); ring_reap(1); }   /* full slot: wait for the rename */
+                f = &io_files[fi];
+                if (f->slot >= 0 && io_slots[f->slot].len == IO_SLOT_SIZE) io_slot_submit(f);
+            }
         }
+        return 0;
     }
-    save_prices();
-    char entry[128]; snprintf(entry, sizeof entry, "MARKET_TICK|ALL_MARKETS");
-    audit_log(entry);
+#endif
+    FILE *f = fopen(path, binary ? "ab" : "a");
+    if (!f) return -1;
+    fwrite(data, 1, len, f);
+    fclose(f);
+    return 0;
 }
 
-/* allow admin to randomize all prices (larger move) */
-static void admin_randomize_all_prices(void) {
-    srand((unsigned)time(NULL));
-    for (int i = 0; i < price_count; ++i) {
-        PriceRec *p = &prices[i];
-        double change_pct = rand_minus1_1() * p->vol * 5.0; /* bigger */
-        p->price *= (1.0 + change_pct);
-        if (p->price < 0.0001) p->price = 0.0001;
-        get_timestamp(p->last_update, sizeof p->last_update);
+/* bytes currently in (or queued for) a file */
+static long io_file_size(const char *path) {
+#ifdef BVDU_HAVE_IO_URING
+    if (io_uring_enabled) {
+        for (int i = 0; i < io_file_count; ++i)
+            if (strcmp(io_files[i].path, path) == 0)
+                return (long)io_files[i].off + (io_files[i].slot >= 0 ? (long)io_slots[io_files[i].slot].len : 0);
     }
-    save_prices();
-    audit_log("ADMIN_RANDOMIZE_PRICES");
+#endif
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : 0;
 }
 
-/* ---------------- Portfolio valuation ---------------- */
+/* whole-file rewrite: write to tmp, then replace the target */
+typedef struct {
+    FILE *f;
+    char *mem;
+    size_t memlen;
+    const char *tmp;
+    const char *final;
+} Snapshot;
 
-/* Convert asset price in native currency to INR using fx rates */
-static double price_in_inr(const PriceRec *p) {
-    if (strcmp(p->market, "IN") == 0) return p->price;
-    if (strcmp(p->market, "US") == 0) return p->price * fx.inr_per_usd;
-    if (strcmp(p->market, "EU") == 0) return p->price * fx.inr_per_eur;
-    return p->price; /* fallback */
+static FILE *snapshot_begin(Snapshot *s, const char *tmp, const char *final, int binary) {
+    s->tmp = tmp;
+    s->final = final;
+    s->mem = NULL;
+    s->memlen = 0;
+#ifdef BVDU_HAVE_IO_URING
+    if (io_uring_enabled) { s->f = open_memstream(&s->mem, &s->memlen); return s->f; }
+#endif
+    s->f = fopen(tmp, binary ? "wb" : "w");
+    return s->f;
 }
 
-/* compute portfolio value (in INR) for account */
-static double compute_portfolio_value_inr(int acc_no) {
-    double tot = 0.0;
-    for (int i = 0; i < hold_count; ++i) {
-        if (holdings[i].acc_no != acc_no) continue;
-        int pidx = find_price_index(holdings[i].asset_id);
-        double cur_price = (pidx >= 0) ? price_in_inr(&prices[pidx]) : holdings[i].avg_price * ((strcmp(holdings[i].market,"US")==0)?fx.inr_per_usd:1.0);
-        tot += holdings[i].qty * cur_price;
+static void snapshot_commit(Snapshot *s) {
+#ifdef BVDU_HAVE_IO_URING
+    if (io_uring_enabled) {
+        fclose(s->f);
+        io_file_hold(s->final, s->memlen);
+        io_snapshot_submit(s->final, s->mem, s->memlen);
+        return;
     }
-    return tot;
+#endif
+    fclose(s->f);
+    remove(s->final);
+    rename(s->tmp, s->final);
 }
 
-/* compute unrealized P/L in INR */
-static double compute_unrealized_pl_inr(int acc_no) {
-    double pl = 0.0;
-    for (int i = 0; i < hold_count; ++i) {
-        if (holdings[i].acc_no != acc_no) continue;
-        int pidx = find_price_index(holdings[i].asset_id);
-        double cur_price_native = (pidx >= 0) ? prices[pidx].price : holdings[i].avg_price;
-        double cur_inr;
-        if (strcmp(holdings[i].market, "IN") == 0) cur_inr = cur_price_native;
-        else if (strcmp(holdings[i].market, "US") == 0) cur_inr = cur_price_native * fx.inr_per_usd;
-        else if (strcmp(holdings[i].market, "EU") == 0) cur_inr = cur_price_native * fx.inr_per_eur;
-        else cur_inr = cur_price_native;
-        double avg_inr = holdings[i].avg_price * (strcmp(holdings[i].market,"US")==0 ? fx.inr_per_usd : (strcmp(holdings[i].market,"EU")==0 ? fx.inr_per_eur : 1.0));
-        pl += holdings[i].qty * (cur_inr - avg_inr);
+/* buffered writer: collects formatted output and hands it to stdio in large chunks
+   (or, with append_path set, to the persistence backend) */
+typedef struct {
+    FILE *out;
+    const char *append_path;
+    size_t len;
+    char buf[OUTBUF_SIZE];
+} OutBuf;
+
+static void ob_flush(OutBuf *ob) {
+    if (ob->append_path) {
+        if (ob->len && io_append(ob->append_path, ob->buf, ob->len, 0) != 0) perror(ob->append_path);
+        ob->len = 0;
+        return;
     }
-    return pl;
+    if (ob->len) { fwrite(ob->buf, 1, ob->len, ob->out); ob->len = 0; }
+    fflush(ob->out);
 }
 
-/* ---------------- New helpers: account number & UPI validation ---------------- */
-
-/* Return next account number: max acc_no + 1 or 1001 if none */
-static int next_account_no(void) {
-    int max = 1000;
-    for (int i = 0; i < acc_count; ++i) if (accounts[i].acc_no > max) max = accounts[i].acc_no;
-    return max + 1;
+static void ob_printf(OutBuf *ob, const char *fmt, ...) {
+    if (OUTBUF_SIZE - ob->len < MAX_LINE) ob_flush(ob);
+    size_t room = OUTBUF_SIZE - ob->len;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(ob->buf + ob->len, room, fmt, ap);
+    va_end(ap);
+    if (n > 0) ob->len += ((size_t)n < room) ? (size_t)n : room - 1;
 }
 
-/* Validate UPI local part: only letters and digits, not empty.
-   Accept these user inputs:
-     - "alice" -> becomes "alice@bvdu"
-     - "alice@bvdu" -> accepted
-   Reject:
-     - anything with additional '@' or domain not 'bvdu'
-     - local part containing non-alnum characters or spaces
-   Returns 1 and writes normalized lowercased upi into out_upi on success, 0 on failure.
-*/
-static int validate_and_normalize_upi(const char *input, char *out_upi, size_t out_len) {
-    if (!input || !out_upi) return 0;
-    char buf[128];
-    strncpy(buf, input, sizeof buf - 1); buf[sizeof buf - 1] = '\0';
-    trim_newline(buf);
-    if (strlen(buf) == 0) return 0;
+/* ---------------- Log-structured KV store (BVDU_KV=<dir>) ---------------- */
 
-    /* If contains '@', split once */
-    char *at = strchr(buf, '@');
-    if (at) {
-        /* if more than one '@' => reject */
-        if (strchr(at+1, '@') != NULL) return 0;
-        *at = '\0';
-        char *local = buf;
-        char *domain = at + 1;
-        strtolower_inplace(local); strtolower_inplace(domain);
-        /* domain must be exactly "bvdu" */
-        if (strcmp(domain, "bvdu") != 0) return 0;
-        /* local must be alnum only */
-        if (strlen(local) == 0) return 0;
-        for (size_t i = 0; i < strlen(local); ++i) {
-            if (!isalnum((unsigned char)local[i])) return 0;
-        }
-        snprintf(out_upi, out_len, "%s@bvdu", local);
-        return 1;
-    } else {
-        /* no '@' -> local part only, ensure alnum */
-        strtolower_inplace(buf);
-        for (size_t i = 0; i < strlen(buf); ++i) {
-            if (!isalnum((unsigned char)buf[i])) return 0;
-        }
-        snprintf(out_upi, out_len, "%s@bvdu", buf);
-        return 1;
-    }
-}
+/* An LSM engine with one tree per column family (accounts, holdings, prices,
+   fx, notifications, audit) and one shared write-ahead log:
+     put/del  -> wal.log append + per-family memtable (hash map)
+     memtables full -> each sorted into an immutable run (tier 0), WAL reset
+     run file = sorted entries, sparse index of every 16th key, bloom filter
+   A background thread merges KV_FANIN runs of one tier into a run of the
+   next tier (size-tiered), so every byte is rewritten about log4(N/memtable)
+   times. Lookups try the memtable, then runs newest first, reading one
+   index block per run whose bloom filter admits the key. MANIFEST lists the
+   live runs and is replaced atomically after every flush and merge.
+   Once the book has been copied in (MANIFEST says "book|1"), accounts and
+   holdings are loaded from the store and a save writes only the rows that
+   changed; accounts.txt and holdings.txt are no longer rewritten. Prices,
+   FX, notifications and the audit log are copied in as they are written.
+   One process opens a store at a time (flock on LOCK). */
 
-/* ---------------- User actions: accounts ---------------- */
+#ifndef KV_MEMTABLE_BYTES
+#define KV_MEMTABLE_BYTES (4u * 1024 * 1024)
+#endif
+#define KV_FANIN 4
+#define KV_INDEX_EVERY 16
+#define KV_BLOOM_BITS_PER_KEY 10
+#define KV_BLOOM_K 7
+#define KV_TOMBSTONE 0xFFFFFFFFu
+#define KV_RUN_MAGIC 0x4e55524bu      /* "KRUN" */
 
-static void create_account_interactive(void) {
-    if (acc_count >= MAX_ACCOUNTS) { printf("Account limit reached.\n"); return; }
-    char buf[256];
-    Account a;
+enum { CF_ACCOUNTS, CF_HOLDINGS, CF_PRICES, CF_FX, CF_NOTIFY, CF_AUDIT, CF_COUNT };
+static const char *CF_NAMES[CF_COUNT] = {"accounts", "holdings", "prices", "fx", "notifications", "audit"};
 
-    /* auto-assign account number */
-    a.acc_no = next_account_no();
+typedef struct {
+    char *key;                        /* key bytes followed by value bytes */
+    uint32_t klen, vlen;              /* vlen KV_TOMBSTONE = deleted */
+} KvEntry;
 
-    printf("Creating account number: %d\n", a.acc_no);
+typedef struct {
+    KvEntry *e;
+    int n, cap;
+    int32_t *slot;                    /* open addressing over e[], -1 = empty */
+    unsigned slotcap;
+} Memtable;
 
-    printf("Enter name (single word preferred): ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf); strncpy(a.name, buf, sizeof a.name - 1); a.name[sizeof a.name - 1] = '\0';
+typedef struct {
+    uint64_t count, index_off, index_len, bloom_off;
+    uint32_t bloom_bits, magic;
+} KvFooter;
 
-    printf("Account type (Savings/Current) [Savings]: ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf);
-    if (strlen(buf) == 0) strncpy(a.acc_type, "Savings", sizeof a.acc_type - 1);
-    else strncpy(a.acc_type, buf, sizeof a.acc_type - 1);
-    a.acc_type[sizeof a.acc_type - 1] = '\0';
+typedef struct {
+    int tier;
+    uint64_t seq;                     /* file name; larger = newer within a tier */
+    int fd;
+    KvFooter ft;
+    char *index;                      /* raw index block: (u32 klen, key, u64 off)* */
+    uint32_t nindex;
+    uint32_t *ipos;                   /* offset of each entry in index */
+    uint8_t *bloom;
+    uint64_t bytes;
+} KvRun;
 
-    printf("Set 4-digit PIN: ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf); a.pin = atoi(buf);
-    if (a.pin < 1000 || a.pin > 9999) { printf("PIN must be 4-digit.\n"); return; }
+typedef struct {
+    Memtable mem;
+    KvRun **runs;                     /* newest first: tier ascending, seq descending */
+    int nruns, capruns;
+} KvFamily;
 
-    printf("Initial deposit amount (INR): ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf); a.balance = atof(buf);
+static struct {
+    int open;
+    char dir[200];
+    FILE *wal;
+    size_t mem_bytes;
+    KvFamily cf[CF_COUNT];
+    uint64_t next_seq;
+    pthread_mutex_t lock;             /* run lists; held by readers for a whole lookup */
+    pthread_cond_t wake;
+    pthread_t compactor;
+    int stop, merging;
+    int holds_book;                   /* accounts and holdings live here, not in the text files */
+    int lockfd;
+    uint64_t user_bytes, wal_bytes, flush_bytes, merge_bytes, merges;
+} kv = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
 
-    /* UPI selection + validation */
-    char candidate[128];
-    printf("Choose UPI local part (letters/numbers only). Leave empty to use '%s': ", a.name);
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf);
-    if (strlen(buf) == 0) {
-        /* use name as local part */
-        char tmp[80]; strncpy(tmp, a.name, sizeof tmp - 1); tmp[sizeof tmp - 1] = '\0';
-        if (!validate_and_normalize_upi(tmp, candidate, sizeof candidate)) {
-            /* fallback: use acc_no as local */
-            snprintf(candidate, sizeof candidate, "%d@bvdu", a.acc_no);
-        }
-    } else {
-        /* user provided something: validate */
-        if (!validate_and_normalize_upi(buf, candidate, sizeof candidate)) {
-            printf("Invalid UPI. Must be letters and/or numbers only, domain must be @bvdu or omitted.\n");
-            return;
-        }
-    }
-    /* ensure uniqueness */
-    if (!is_upi_unique(candidate)) {
-        printf("UPI '%s' already taken. Choose a unique UPI.\n", candidate);
-        return;
-    }
-    strncpy(a.upi, candidate, sizeof a.upi - 1);
-    a.upi[sizeof a.upi - 1] = '\0';
+static uint64_t kv_hash(const void *p, size_t n) {
+    const unsigned char *s = p;
+    uint64_t h = 1469598103934665603ull;          /* FNV-1a */
+    for (size_t i = 0; i < n; ++i) { h ^= s[i]; h *= 1099511628211ull; }
+    return h;
+}
 
-    a.loan = 0.0;
-    a.active = 1;
-    a.frozen = 0;
-    a.failed_attempts = 0;
-    get_timestamp(a.last_login, sizeof a.last_login);
-    accounts[acc_count++] = a;
-    save_accounts();
+static int kv_keycmp(const char *a, uint32_t alen, const char *b, uint32_t blen) {
+    int c = memcmp(a, b, alen < blen ? alen : blen);
+    return c ? c : (alen > blen) - (alen < blen);
+}
 
-    char note[128]; snprintf(note, sizeof note, "Account created (UPI:%s)", a.upi);
-    log_transaction(a.acc_no, "CREATE", a.balance, a.balance, note);
-    char audit[256]; snprintf(audit, sizeof audit, "CREATE_ACCOUNT|%d|%s|%s", a.acc_no, a.name, a.upi);
-    audit_log(audit);
-    push_notification(a.acc_no, "Welcome! Account created.");
-    printf("Account %d created with UPI '%s'.\n", a.acc_no, a.upi);
+static void kv_path(char *buf, size_t n, const char *name) {
+    snprintf(buf, n, "%s/%s", kv.dir, name);
 }
 
-/* Authenticate - returns account index or -1.
-   If PIN wrong increments failed_attempts and freezes after 3. */
-static int authenticate_prompt(void) {
-    char buf[128];
-    printf("Enter account number: ");
-    if (!fgets(buf, sizeof buf, stdin)) return -1;
-    trim_newline(buf); int acc_no = atoi(buf);
-    int idx = find_account_index(acc_no);
-    if (idx == -1) { printf("Account not found.\n"); return -1; }
-    if (!accounts[idx].active) { printf("Account inactive.\n"); return -1; }
-    if (accounts[idx].frozen) { printf("Account frozen. Contact admin.\n"); return -1; }
+static void kv_run_path(char *buf, size_t n, uint64_t seq) {
+    snprintf(buf, n, "%s/%06llu.run", kv.dir, (unsigned long long)seq);
+}
 
-    printf("Enter PIN: ");
-    if (!fgets(buf, sizeof buf, stdin)) return -1;
-    trim_newline(buf); int pin = atoi(buf);
-    if (accounts[idx].pin == pin) {
-        accounts[idx].failed_attempts = 0;
-        get_timestamp(accounts[idx].last_login, sizeof accounts[idx].last_login);
-        save_accounts();
-        return idx;
+/* ---- memtable ---- */
+
+static void mem_grow_slots(Memtable *m) {
+    unsigned cap = m->slotcap ? m->slotcap * 2 : 1024;
+    int32_t *s = malloc(cap * sizeof *s);
+    if (!s) { perror("kv"); exit(1); }
+    for (unsigned i = 0; i < cap; ++i) s[i] = -1;
+    for (int i = 0; i < m->n; ++i) {
+        unsigned h = (unsigned)kv_hash(m->e[i].key, m->e[i].klen) & (cap - 1);
+        while (s[h] >= 0) h = (h + 1) & (cap - 1);
+        s[h] = i;
+    }
+    free(m->slot);
+    m->slot = s;
+    m->slotcap = cap;
+}
+
+static KvEntry *mem_find(Memtable *m, const char *key, uint32_t klen, unsigned *at) {
+    if (!m->slotcap) return NULL;
+    unsigned h = (unsigned)kv_hash(key, klen) & (m->slotcap - 1);
+    for (; m->slot[h] >= 0; h = (h + 1) & (m->slotcap - 1)) {
+        KvEntry *e = &m->e[m->slot[h]];
+        if (e->klen == klen && memcmp(e->key, key, klen) == 0) { if (at) *at = h; return e; }
+    }
+    if (at) *at = h;
+    return NULL;
+}
+
+static void mem_put(Memtable *m, const char *key, uint32_t klen, const char *val, uint32_t vlen) {
+    if ((unsigned)(m->n + 1) * 2 > m->slotcap) mem_grow_slots(m);
+    uint32_t vbytes = vlen == KV_TOMBSTONE ? 0 : vlen;
+    char *buf = malloc((size_t)klen + vbytes + 1);
+    if (!buf) { perror("kv"); exit(1); }
+    memcpy(buf, key, klen);
+    if (vbytes) memcpy(buf + klen, val, vbytes);
+    unsigned at = 0;
+    KvEntry *e = mem_find(m, key, klen, &at);
+    if (e) {
+        kv.mem_bytes -= e->klen + (e->vlen == KV_TOMBSTONE ? 0 : e->vlen);
+        free(e->key);
     } else {
-        accounts[idx].failed_attempts++;
-        if (accounts[idx].failed_attempts >= 3) {
-            accounts[idx].frozen = 1;
-            save_accounts();
-            audit_log("ACCOUNT_FROZEN");
-            printf("Too many failed attempts. Account frozen. Admin must unfreeze.\n");
-        } else {
-            save_accounts();
-            printf("Invalid PIN. Attempts left: %d\n", 3 - accounts[idx].failed_attempts);
+        if (m->n == m->cap) {
+            int nc = m->cap ? m->cap * 2 : 1024;
+            KvEntry *ne = realloc(m->e, (size_t)nc * sizeof *ne);
+            if (!ne) { perror("kv"); exit(1); }
+            m->e = ne;
+            m->cap = nc;
         }
-        return -1;
+        m->slot[at] = m->n;
+        e = &m->e[m->n++];
     }
+    e->key = buf;
+    e->klen = klen;
+    e->vlen = vlen;
+    kv.mem_bytes += klen + vbytes;
 }
 
-/* Deposit and Withdraw (auth inside) */
-static void deposit_money(void) {
-    int idx = authenticate_prompt(); if (idx < 0) return;
-    printf("Enter amount to deposit (INR): ");
-    double amt = safe_read_double();
-    if (amt <= 0) { printf("Invalid amount.\n"); return; }
-    accounts[idx].balance += amt;
-    save_accounts();
-    log_transaction(accounts[idx].acc_no, "DEPOSIT", amt, accounts[idx].balance, "Deposit");
-    push_notification(accounts[idx].acc_no, "Deposit successful.");
-    printf("Deposit complete. New balance: %.2f INR\n", accounts[idx].balance);
-}
-
-static void withdraw_money(void) {
-    int idx = authenticate_prompt(); if (idx < 0) return;
-    printf("Enter amount to withdraw (INR): ");
-    double amt = safe_read_double();
-    if (amt <= 0) { printf("Invalid amount.\n"); return; }
-    if (amt > accounts[idx].balance) { printf("Insufficient funds.\n"); return; }
-    accounts[idx].balance -= amt;
-    save_accounts();
-    log_transaction(accounts[idx].acc_no, "WITHDRAW", -amt, accounts[idx].balance, "Withdraw");
-    push_notification(accounts[idx].acc_no, "Withdrawal processed.");
-    printf("Withdraw successful. New balance: %.2f INR\n", accounts[idx].balance);
+static void mem_clear(Memtable *m) {
+    for (int i = 0; i < m->n; ++i) free(m->e[i].key);
+    m->n = 0;
+    for (unsigned i = 0; i < m->slotcap; ++i) m->slot[i] = -1;
 }
 
-/* Transfer when already logged in (does not re-authenticate) */
-static void transfer_from_loggedin(int from_idx) {
-    if (from_idx < 0 || from_idx >= acc_count) { printf("Internal error.\n"); return; }
-    char buf[128];
-    printf("Enter destination account number: ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf); int to_acc = atoi(buf);
-    int to_idx = find_active_account_index(to_acc);
-    if (to_idx < 0) { printf("Destination not found or not active.\n"); return; }
-    if (accounts[to_idx].frozen) { printf("Destination frozen. Cannot receive funds.\n"); return; }
-    if (to_idx == from_idx) { printf("Cannot transfer to same account.\n"); return; }
-    printf("Enter amount to transfer (INR): ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf); double amt = atof(buf);
-    if (amt <= 0) { printf("Invalid amount.\n"); return; }
-    if (amt > accounts[from_idx].balance) { printf("Insufficient funds.\n"); return; }
-    accounts[from_idx].balance -= amt;
-    accounts[to_idx].balance += amt;
-    save_accounts();
-    char note1[80]; snprintf(note1, sizeof note1, "Transfer to %d", accounts[to_idx].acc_no);
-    char note2[80]; snprintf(note2, sizeof note2, "Transfer from %d", accounts[from_idx].acc_no);
-    log_transaction(accounts[from_idx].acc_no, "TRANSFER_OUT", -amt, accounts[from_idx].balance, note1);
-    log_transaction(accounts[to_idx].acc_no, "TRANSFER_IN", amt, accounts[to_idx].balance, note2);
-    push_notification(accounts[to_idx].acc_no, "You have received a transfer.");
-    printf("Transfer successful. New balance: %.2f INR\n", accounts[from_idx].balance);
+static int cmp_kv_entry(const void *x, const void *y) {
+    const KvEntry *a = x, *b = y;
+    return kv_keycmp(a->key, a->klen, b->key, b->klen);
 }
 
-/* Transfer (auth inside) kept for convenience */
-static void transfer_money(void) {
-    int idx = authenticate_prompt();
-    if (idx < 0) return;
-    transfer_from_loggedin(idx);
-}
+/* ---- run files ---- */
 
-/* UPI transfer (logged-in) - only to registered UPIs */
-static void upi_transfer_from_loggedin(int from_idx) {
-    if (from_idx < 0 || from_idx >= acc_count) { printf("Internal error.\n"); return; }
-    char buf[128];
-    printf("Enter destination UPI (e.g., alice@bvdu): ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf); strtolower_inplace(buf);
-    int to_idx = find_account_by_upi(buf);
-    if (to_idx < 0) { printf("UPI not found. Transfers allowed only to registered BVDU UPIs.\n"); return; }
-    if (!accounts[to_idx].active) { printf("Destination not active.\n"); return; }
-    if (accounts[to_idx].frozen) { printf("Destination frozen.\n"); return; }
-    if (to_idx == from_idx) { printf("Cannot send to own UPI.\n"); return; }
-    printf("Enter amount (INR): ");
-    double amt = safe_read_double();
-    if (amt <= 0) { printf("Invalid.\n"); return; }
-    if (amt > accounts[from_idx].balance) { printf("Insufficient funds.\n"); return; }
-    accounts[from_idx].balance -= amt;
-    accounts[to_idx].balance += amt;
-    save_accounts();
-    char note1[80]; snprintf(note1, sizeof note1, "UPI to %s", accounts[to_idx].upi);
-    char note2[80]; snprintf(note2, sizeof note2, "UPI from %s", accounts[from_idx].upi);
-    log_transaction(accounts[from_idx].acc_no, "UPI_OUT", -amt, accounts[from_idx].balance, note1);
-    log_transaction(accounts[to_idx].acc_no, "UPI_IN", amt, accounts[to_idx].balance, note2);
-    push_notification(accounts[to_idx].acc_no, "You received money via UPI.");
-    printf("UPI transfer completed. New balance: %.2f INR\n", accounts[from_idx].balance);
+typedef struct {
+    FILE *f;
+    uint64_t off, count;
+    char *index; size_t ilen, icap;
+    uint8_t *bloom; uint32_t bloom_bits;
+    const char *lastkey; uint32_t lastklen;
+} KvRunWriter;
+
+static void kvw_index_append(KvRunWriter *w, const void *p, size_t n) {
+    if (w->ilen + n > w->icap) {
+        size_t nc = w->icap ? w->icap * 2 : 4096;
+        while (nc < w->ilen + n) nc *= 2;
+        char *ni = realloc(w->index, nc);
+        if (!ni) { perror("kv"); exit(1); }
+        w->index = ni;
+        w->icap = nc;
+    }
+    memcpy(w->index + w->ilen, p, n);
+    w->ilen += n;
 }
 
-/* UPI transfer (auth inside) convenience */
-static void upi_transfer_interactive(void) {
-    int idx = authenticate_prompt(); if (idx < 0) return;
-    upi_transfer_from_loggedin(idx);
+static int kvw_begin(KvRunWriter *w, const char *path, uint64_t max_keys) {
+    memset(w, 0, sizeof *w);
+    w->f = fopen(path, "wb");
+    if (!w->f) { perror(path); return -1; }
+    w->bloom_bits = (uint32_t)(max_keys * KV_BLOOM_BITS_PER_KEY);
+    if (w->bloom_bits < 64) w->bloom_bits = 64;
+    w->bloom = calloc(w->bloom_bits / 8 + 1, 1);
+    if (!w->bloom) { fclose(w->f); return -1; }
+    return 0;
 }
 
-/* mini-statement */
-static void print_mini_statement_for_account(int acc_no) {
-    FILE *f = fopen(F_TRANSACTIONS, "r");
-    if (!f) { printf("No transactions yet.\n"); return; }
-    char *lines[MINI_STAT_LIMIT];
-    for (int i = 0; i < MINI_STAT_LIMIT; ++i) lines[i] = NULL;
-    char buf[MAX_LINE];
-    while (fgets(buf, sizeof buf, f)) {
-        int txn_acc = 0;
-        if (sscanf(buf, "%d|", &txn_acc) != 1) continue;
-        if (txn_acc != acc_no) continue;
-        if (lines[0]) { free(lines[0]); lines[0] = NULL; }
-        for (int j = 1; j < MINI_STAT_LIMIT; ++j) lines[j-1] = lines[j];
-        lines[MINI_STAT_LIMIT-1] = strdup(buf);
+static void kvw_add(KvRunWriter *w, const char *key, uint32_t klen, const char *val, uint32_t vlen) {
+    if (w->count % KV_INDEX_EVERY == 0) {
+        kvw_index_append(w, &klen, 4);
+        kvw_index_append(w, key, klen);
+        kvw_index_append(w, &w->off, 8);
     }
-    fclose(f);
-    printf("Mini-statement (last %d):\n", MINI_STAT_LIMIT);
-    for (int i = 0; i < MINI_STAT_LIMIT; ++i) {
-        if (lines[i]) { printf("%s", lines[i]); free(lines[i]); }
+    uint64_t h = kv_hash(key, klen), h2 = (h >> 32) | 1;
+    for (int i = 0; i < KV_BLOOM_K; ++i) {
+        uint32_t bit = (uint32_t)((h + (uint64_t)i * h2) % w->bloom_bits);
+        w->bloom[bit >> 3] |= (uint8_t)(1u << (bit & 7));
     }
+    uint32_t vbytes = vlen == KV_TOMBSTONE ? 0 : vlen;
+    fwrite(&klen, 4, 1, w->f);
+    fwrite(&vlen, 4, 1, w->f);
+    fwrite(key, 1, klen, w->f);
+    if (vbytes) fwrite(val, 1, vbytes, w->f);
+    w->off += 8 + klen + vbytes;
+    w->count++;
 }
 
-/* ---------------- Trading: list, buy, sell ---------------- */
+/* returns bytes written, or 0 on failure (the file is removed) */
+static uint64_t kvw_finish(KvRunWriter *w, const char *path) {
+    KvFooter ft;
+    memset(&ft, 0, sizeof ft);
+    ft.count = w->count;
+    ft.index_off = w->off;
+    ft.index_len = w->ilen;
+    ft.bloom_off = w->off + w->ilen;
+    ft.bloom_bits = w->bloom_bits;
+    ft.magic = KV_RUN_MAGIC;
+    fwrite(w->index, 1, w->ilen, w->f);
+    fwrite(w->bloom, 1, w->bloom_bits / 8 + 1, w->f);
+    fwrite(&ft, sizeof ft, 1, w->f);
+    int ok = fflush(w->f) == 0 && fsync(fileno(w->f)) == 0;
+    ok = (fclose(w->f) == 0) && ok;
+    free(w->index);
+    free(w->bloom);
+    if (!ok) { perror(path); remove(path); return 0; }
+    return ft.bloom_off + w->bloom_bits / 8 + 1 + sizeof ft;
+}
 
-static void ensure_default_prices(void) {
-    if (price_count > 0) return;
-    /* create a few default assets across markets */
-    price_count = 0;
-    PriceRec p;
-    get_timestamp(p.last_update, sizeof p.last_update);
+static KvRun *kv_run_open(uint64_t seq, int tier) {
+    char path[256];
+    kv_run_path(path, sizeof path, seq);
+    KvRun *r = calloc(1, sizeof *r);
+    if (!r) return NULL;
+    r->seq = seq;
+    r->tier = tier;
+    r->fd = open(path, O_RDONLY);
+    struct stat st;
+    if (r->fd < 0 || fstat(r->fd, &st) != 0 || st.st_size < (off_t)sizeof r->ft ||
+        pread(r->fd, &r->ft, sizeof r->ft, st.st_size - (off_t)sizeof r->ft) != (ssize_t)sizeof r->ft ||
+        r->ft.magic != KV_RUN_MAGIC) {
+        fprintf(stderr, "kv: %s is missing or damaged\n", path);
+        if (r->fd >= 0) close(r->fd);
+        free(r);
+        return NULL;
+    }
+    r->bytes = (uint64_t)st.st_size;
+    size_t blen = r->ft.bloom_bits / 8 + 1;
+    r->index = malloc(r->ft.index_len + 1);
+    r->bloom = malloc(blen);
+    r->ipos = malloc((r->ft.count / KV_INDEX_EVERY + 1) * sizeof *r->ipos);
+    if (!r->index || !r->bloom || !r->ipos ||
+        pread(r->fd, r->index, r->ft.index_len, (off_t)r->ft.index_off) != (ssize_t)r->ft.index_len ||
+        pread(r->fd, r->bloom, blen, (off_t)r->ft.bloom_off) != (ssize_t)blen) {
+        fprintf(stderr, "kv: cannot load %s\n", path);
+        close(r->fd); free(r->index); free(r->bloom); free(r->ipos); free(r);
+        return NULL;
+    }
+    for (uint64_t p = 0; p + 4 <= r->ft.index_len; ) {
+        uint32_t klen;
+        memcpy(&klen, r->index + p, 4);
+        r->ipos[r->nindex++] = (uint32_t)p;
+        p += 4 + klen + 8;
+    }
+    return r;
+}
 
-    strncpy(p.asset_id, "INFY", sizeof p.asset_id - 1);
-    strncpy(p.asset_name, "Infosys Ltd", sizeof p.asset_name - 1);
-    p.price = 1500.0; p.vol = 0.01; strncpy(p.market, "IN", sizeof p.market - 1);
-    p.open_hour = 9; p.close_hour = 15; prices[price_count++] = p;
+static void kv_run_free(KvRun *r, int unlink_file) {
+    if (!r) return;
+    close(r->fd);
+    if (unlink_file) {
+        char path[256];
+        kv_run_path(path, sizeof path, r->seq);
+        remove(path);
+    }
+    free(r->index); free(r->bloom); free(r->ipos); free(r);
+}
 
-    strncpy(p.asset_id, "TCS", sizeof p.asset_id - 1);
-    strncpy(p.asset_name, "TCS", sizeof p.asset_name - 1);
-    p.price = 3200.0; p.vol = 0.008; strncpy(p.market, "IN", sizeof p.market - 1);
-    p.open_hour = 9; p.close_hour = 15; prices[price_count++] = p;
+/* 1 found (value malloc'd, *vlen KV_TOMBSTONE if deleted), 0 absent */
+static int kv_run_get(KvRun *r, const char *key, uint32_t klen, char **val, uint32_t *vlen) {
+    uint64_t h = kv_hash(key, klen), h2 = (h >> 32) | 1;
+    for (int i = 0; i < KV_BLOOM_K; ++i) {
+        uint32_t bit = (uint32_t)((h + (uint64_t)i * h2) % r->ft.bloom_bits);
+        if (!(r->bloom[bit >> 3] & (1u << (bit & 7)))) return 0;
+    }
+    /* last index key <= key */
+    int lo = 0, hi = (int)r->nindex;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        uint32_t ik;
+        memcpy(&ik, r->index + r->ipos[mid], 4);
+        if (kv_keycmp(r->index + r->ipos[mid] + 4, ik, key, klen) <= 0) lo = mid + 1; else hi = mid;
+    }
+    if (lo == 0) return 0;
+    uint64_t from, to;
+    uint32_t ik;
+    memcpy(&ik, r->index + r->ipos[lo - 1], 4);
+    memcpy(&from, r->index + r->ipos[lo - 1] + 4 + ik, 8);
+    if ((uint32_t)lo < r->nindex) {
+        memcpy(&ik, r->index + r->ipos[lo], 4);
+        memcpy(&to, r->index + r->ipos[lo] + 4 + ik, 8);
+    } else to = r->ft.index_off;
+    char *blk = malloc((size_t)(to - from));
+    if (!blk || pread(r->fd, blk, (size_t)(to - from), (off_t)from) != (ssize_t)(to - from)) { free(blk); return 0; }
+    int found = 0;
+    for (uint64_t p = 0; p + 8 <= to - from; ) {
+        uint32_t kl, vl;
+        memcpy(&kl, blk + p, 4);
+        memcpy(&vl, blk + p + 4, 4);
+        uint32_t vb = vl == KV_TOMBSTONE ? 0 : vl;
+        int c = kv_keycmp(blk + p + 8, kl, key, klen);
+        if (c == 0) {
+            *vlen = vl;
+            *val = malloc(vb + 1);
+            if (*val) { memcpy(*val, blk + p + 8 + kl, vb); (*val)[vb] = '\0'; found = 1; }
+            break;
+        }
+        if (c > 0) break;
+        p += 8 + kl + vb;
+    }
+    free(blk);
+    return found;
+}
 
-    strncpy(p.asset_id, "AAPL", sizeof p.asset_id - 1);
-    strncpy(p.asset_name, "Apple Inc", sizeof p.asset_name - 1);
-    p.price = 190.0; p.vol = 0.02; strncpy(p.market, "US", sizeof p.market - 1);
-    p.open_hour = 9; p.close_hour = 17; prices[price_count++] = p;
+/* sequential reader used by merges */
+typedef struct {
+    FILE *f;
+    uint64_t left;                    /* data bytes not yet read */
+    char *buf; size_t cap;
+    uint32_t klen, vlen;
+    int live;
+} KvCursor;
 
-    strncpy(p.asset_id, "NVDA", sizeof p.asset_id - 1);
-    strncpy(p.asset_name, "NVIDIA Corp", sizeof p.asset_name - 1);
-    p.price = 190.0; p.vol = 0.03; strncpy(p.market, "US", sizeof p.market - 1);
-    p.open_hour = 9; p.close_hour = 17; prices[price_count++] = p;
+static void kvc_next(KvCursor *c) {
+    c->live = 0;
+    if (c->left < 8) return;
+    uint32_t hdr[2];
+    if (fread(hdr, 4, 2, c->f) != 2) return;
+    uint32_t vb = hdr[1] == KV_TOMBSTONE ? 0 : hdr[1];
+    if ((size_t)hdr[0] + vb > c->cap) {
+        size_t nc = (size_t)hdr[0] + vb + 256;
+        char *nb = realloc(c->buf, nc);
+        if (!nb) return;
+        c->buf = nb;
+        c->cap = nc;
+    }
+    if (fread(c->buf, 1, (size_t)hdr[0] + vb, c->f) != (size_t)hdr[0] + vb) return;
+    c->klen = hdr[0];
+    c->vlen = hdr[1];
+    c->left -= 8 + hdr[0] + vb;
+    c->live = 1;
+}
 
-    strncpy(p.asset_id, "BTC", sizeof p.asset_id - 1);
-    strncpy(p.asset_name, "Bitcoin", sizeof p.asset_name - 1);
-    p.price = 35000.0; p.vol = 0.05; strncpy(p.market, "US", sizeof p.market - 1);
-    p.open_hour = 0; p.close_hour = 24; prices[price_count++] = p;
+/* ---- manifest, flush, merge ---- */
 
-    strncpy(p.asset_id, "SIE", sizeof p.asset_id - 1);
-    strncpy(p.asset_name, "Siemens", sizeof p.asset_name - 1);
-    p.price = 120.0; p.vol = 0.018; strncpy(p.market, "EU", sizeof p.market - 1);
-    p.open_hour = 8; p.close_hour = 18; prices[price_count++] = p;
+static void kv_sort_runs(KvFamily *fam) {
+    for (int i = 1; i < fam->nruns; ++i) {
+        KvRun *r = fam->runs[i];
+        int j = i;
+        while (j > 0 && (fam->runs[j - 1]->tier > r->tier ||
+               (fam->runs[j - 1]->tier == r->tier && fam->runs[j - 1]->seq < r->seq))) {
+            fam->runs[j] = fam->runs[j - 1];
+            --j;
+        }
+        fam->runs[j] = r;
+    }
+}
 
-    save_prices();
-    audit_log("INITIALIZED_DEFAULT_PRICES");
+static void kv_add_run(KvFamily *fam, KvRun *r) {
+    if (fam->nruns == fam->capruns) {
+        int nc = fam->capruns ? fam->capruns * 2 : 16;
+        KvRun **nr = realloc(fam->runs, (size_t)nc * sizeof *nr);
+        if (!nr) { perror("kv"); exit(1); }
+        fam->runs = nr;
+        fam->capruns = nc;
+    }
+    fam->runs[fam->nruns++] = r;
+    kv_sort_runs(fam);
 }
 
-/* list prices — if market open do a tick (simulate live) before listing */
-static void list_market_prices(void) {
-    ensure_default_prices();
-    /* do a tick for each market that is open */
-    tick_market_once();
-    printf("AssetID  Market  AssetName                Price (native)\n");
-    for (int i = 0; i < price_count; ++i) {
-        PriceRec *p = &prices[i];
-        printf("%-7s  %-5s  %-22s  %.4f    (last: %s)\n",
-            p->asset_id, p->market, p->asset_name, p->price, p->last_update);
+/* caller holds kv.lock */
+static void kv_write_manifest(void) {
+    char tmp[256], path[256];
+    kv_path(tmp, sizeof tmp, "MANIFEST.tmp");
+    kv_path(path, sizeof path, "MANIFEST");
+    FILE *f = fopen(tmp, "w");
+    if (!f) { perror(tmp); return; }
+    fprintf(f, "next|%llu\n", (unsigned long long)kv.next_seq);
+    if (kv.holds_book) fprintf(f, "book|1\n");
+    for (int c = 0; c < CF_COUNT; ++c)
+        for (int i = 0; i < kv.cf[c].nruns; ++i)
+            fprintf(f, "%s|%d|%llu\n", CF_NAMES[c], kv.cf[c].runs[i]->tier, (unsigned long long)kv.cf[c].runs[i]->seq);
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    if (rename(tmp, path) != 0) perror("kv manifest");
+}
+
+/* every memtable becomes a tier-0 run; then the WAL starts over */
+static void kv_flush_memtables(void) {
+    char path[256];
+    for (int c = 0; c < CF_COUNT; ++c) {
+        Memtable *m = &kv.cf[c].mem;
+        if (!m->n) continue;
+        qsort(m->e, (size_t)m->n, sizeof *m->e, cmp_kv_entry);
+        pthread_mutex_lock(&kv.lock);
+        uint64_t seq = kv.next_seq++;
+        pthread_mutex_unlock(&kv.lock);
+        kv_run_path(path, sizeof path, seq);
+        KvRunWriter w;
+        if (kvw_begin(&w, path, (uint64_t)m->n) != 0) exit(1);
+        for (int i = 0; i < m->n; ++i) kvw_add(&w, m->e[i].key, m->e[i].klen, m->e[i].key + m->e[i].klen, m->e[i].vlen);
+        uint64_t bytes = kvw_finish(&w, path);
+        KvRun *r = bytes ? kv_run_open(seq, 0) : NULL;
+        if (!r) { fprintf(stderr, "kv: flush failed, keeping the WAL\n"); return; }
+        kv.flush_bytes += bytes;
+        pthread_mutex_lock(&kv.lock);
+        kv_add_run(&kv.cf[c], r);
+        kv_write_manifest();
+        pthread_mutex_unlock(&kv.lock);
+        mem_clear(m);
     }
+    kv.mem_bytes = 0;
+    char wal[256];
+    kv_path(wal, sizeof wal, "wal.log");
+    if (kv.wal) fclose(kv.wal);
+    kv.wal = fopen(wal, "wb");
+    pthread_cond_broadcast(&kv.wake);
 }
 
-/* helper: convert price (native) and quantity to INR cost */
-static double cost_in_inr_for_purchase(const PriceRec *p, double qty) {
-    double cost_native = p->price * qty;
-    if (strcmp(p->market, "IN") == 0) return cost_native;
-    if (strcmp(p->market, "US") == 0) return cost_native * fx.inr_per_usd;
-    if (strcmp(p->market, "EU") == 0) return cost_native * fx.inr_per_eur;
-    return cost_native;
+/* a tier with KV_FANIN runs in some family; caller holds kv.lock */
+static int kv_pick_merge(int *cf, int *tier) {
+    for (int c = 0; c < CF_COUNT; ++c) {
+        KvFamily *fam = &kv.cf[c];
+        for (int i = 0; i < fam->nruns; ) {
+            int j = i;
+            while (j < fam->nruns && fam->runs[j]->tier == fam->runs[i]->tier) ++j;
+            if (j - i >= KV_FANIN) { *cf = c; *tier = fam->runs[i]->tier; return 1; }
+            i = j;
+        }
+    }
+    return 0;
 }
 
-/* buy asset while logged in */
-static void buy_asset_loggedin(int acc_idx) {
-    if (acc_idx < 0) return;
-    ensure_default_prices();
-    char buf[128];
-    printf("Enter Asset ID to buy (e.g., AAPL): ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf); /* ensure case-sensitive IDs as stored */
-    int pidx = find_price_index(buf);
-    if (pidx < 0) { printf("Asset not found.\n"); return; }
-    PriceRec *pr = &prices[pidx];
-    if (!market_is_open(pr)) {
-        printf("Market for %s (%s) is currently closed (open %02d:00 to %02d:00).\n", pr->asset_id, pr->market, pr->open_hour, pr->close_hour);
-        return;
+static void kv_merge(int c, int tier) {
+    KvFamily *fam = &kv.cf[c];
+    KvRun *in[64];
+    int n = 0, bottom = 1;
+    uint64_t keys = 0;
+    pthread_mutex_lock(&kv.lock);
+    for (int i = 0; i < fam->nruns; ++i) {
+        if (fam->runs[i]->tier == tier && n < 64) { in[n++] = fam->runs[i]; keys += fam->runs[i]->ft.count; }
+        else if (fam->runs[i]->tier > tier) bottom = 0;   /* older data below: keep tombstones */
     }
-    printf("Current price of %s (%s) = %.4f (native)\n", pr->asset_name, pr->asset_id, pr->price);
-    printf("Enter quantity to buy: ");
-    double qty = safe_read_double();
-    if (qty <= 0) { printf("Invalid quantity.\n"); return; }
-    double cost_inr = cost_in_inr_for_purchase(pr, qty);
-    if (cost_inr > accounts[acc_idx].balance) { printf("Insufficient cash (need %.2f INR).\n", cost_inr); return; }
+    uint64_t seq = kv.next_seq++;
+    pthread_mutex_unlock(&kv.lock);
 
-    /* deduct cash */
-    accounts[acc_idx].balance -= cost_inr;
+    KvCursor cur[64];
+    char path[256];
+    memset(cur, 0, sizeof cur);
+    for (int i = 0; i < n; ++i) {      /* in[] is newest first */
+        kv_run_path(path, sizeof path, in[i]->seq);
+        cur[i].f = fopen(path, "rb");
+        cur[i].left = in[i]->ft.index_off;
+        if (cur[i].f) kvc_next(&cur[i]);
+    }
+    kv_run_path(path, sizeof path, seq);
+    KvRunWriter w;
+    if (kvw_begin(&w, path, keys) != 0) exit(1);
+    for (;;) {
+        int best = -1;
+        for (int i = 0; i < n; ++i)
+            if (cur[i].live && (best < 0 || kv_keycmp(cur[i].buf, cur[i].klen, cur[best].buf, cur[best].klen) < 0)) best = i;
+        if (best < 0) break;
+        if (!(bottom && cur[best].vlen == KV_TOMBSTONE))
+            kvw_add(&w, cur[best].buf, cur[best].klen, cur[best].buf + cur[best].klen, cur[best].vlen);
+        /* older copies of the same key are superseded */
+        for (int i = n - 1; i >= 0; --i)
+            if (i != best && cur[i].live && kv_keycmp(cur[i].buf, cur[i].klen, cur[best].buf, cur[best].klen) == 0) kvc_next(&cur[i]);
+        kvc_next(&cur[best]);
+    }
+    for (int i = 0; i < n; ++i) { if (cur[i].f) fclose(cur[i].f); free(cur[i].buf); }
+    uint64_t bytes = kvw_finish(&w, path);
+    KvRun *out = bytes ? kv_run_open(seq, tier + 1) : NULL;
+    if (!out) return;
 
-    /* update or add holding */
-    int hidx = find_holding_index(accounts[acc_idx].acc_no, pr->asset_id);
-    if (hidx < 0) {
-        if (hold_count >= MAX_HOLDINGS) { printf("Holdings limit reached.\n"); return; }
-        Holding h;
-        h.acc_no = accounts[acc_idx].acc_no;
-        strncpy(h.asset_id, pr->asset_id, sizeof h.asset_id - 1);
-        strncpy(h.asset_name, pr->asset_name, sizeof h.asset_name - 1);
-        h.qty = qty;
-        h.avg_price = pr->price;
-        strncpy(h.market, pr->market, sizeof h.market - 1);
-        holdings[hold_count++] = h;
-    } else {
-        Holding *h = &holdings[hidx];
-        /* avg price in native currency */
-        double total_old = h->avg_price * h->qty;
-        double total_new = pr->price * qty;
-        h->qty += qty;
-        if (h->qty > 0.0) h->avg_price = (total_old + total_new) / h->qty;
+    pthread_mutex_lock(&kv.lock);
+    int k = 0;
+    for (int i = 0; i < fam->nruns; ++i) {
+        int merged = 0;
+        for (int j = 0; j < n; ++j) merged |= fam->runs[i] == in[j];
+        if (!merged) fam->runs[k++] = fam->runs[i];
     }
-    save_accounts(); save_holdings();
-    char note[128]; snprintf(note, sizeof note, "Bought %s x %.4f", pr->asset_id, qty);
-    log_transaction(accounts[acc_idx].acc_no, "BUY", -cost_inr, accounts[acc_idx].balance, note);
-    char audit[128]; snprintf(audit, sizeof audit, "BUY|%d|%s|%.4f|%.2fINR", accounts[acc_idx].acc_no, pr->asset_id, qty, cost_inr);
-    audit_log(audit);
-    push_notification(accounts[acc_idx].acc_no, note);
-    printf("Bought %s x %.4f for %.2f INR. New cash balance: %.2f INR\n", pr->asset_id, qty, cost_inr, accounts[acc_idx].balance);
+    fam->nruns = k;
+    kv_add_run(fam, out);
+    kv_write_manifest();
+    kv.merge_bytes += bytes;
+    kv.merges++;
+    pthread_mutex_unlock(&kv.lock);
+    for (int i = 0; i < n; ++i) kv_run_free(in[i], 1);
 }
 
-/* sell asset while logged in */
-static void sell_asset_loggedin(int acc_idx) {
-    if (acc_idx < 0) return;
-    ensure_default_prices();
-    char buf[128];
-    printf("Enter Asset ID to sell: ");
-    if (!fgets(buf, sizeof buf, stdin)) return;
-    trim_newline(buf);
-    int pidx = find_price_index(buf);
-    if (pidx < 0) { printf("Asset unknown.\n"); return; }
-    int hidx = find_holding_index(accounts[acc_idx].acc_no, buf);
-    if (hidx < 0) { printf("You do not own this asset.\n"); return; }
-    Holding *h = &holdings[hidx];
-    PriceRec *pr = &prices[pidx];
-    printf("You own %.6f units. Current price (native) = %.4f\n", h->qty, pr->price);
-    printf("Quantity to sell: ");
-    double qty = safe_read_double();
-    if (qty <= 0 || qty > h->qty) { printf("Invalid quantity.\n"); return; }
-    double proceeds_inr = cost_in_inr_for_purchase(pr, qty); /* reuse function */
-    /* reduce holdings */
-    h->qty -= qty;
-    if (h->qty <= 0.000001) {
-        for (int i = hidx; i < hold_count - 1; ++i) holdings[i] = holdings[i+1];
-        hold_count--;
+static void *kv_compactor(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&kv.lock);
+    for (;;) {
+        int c, tier;
+        while (!kv.stop && !kv_pick_merge(&c, &tier)) pthread_cond_wait(&kv.wake, &kv.lock);
+        if (kv.stop) break;
+        kv.merging = 1;
+        pthread_mutex_unlock(&kv.lock);
+        kv_merge(c, tier);
+        pthread_mutex_lock(&kv.lock);
+        kv.merging = 0;
+        pthread_cond_broadcast(&kv.wake);
     }
-    accounts[acc_idx].balance += proceeds_inr;
-    save_accounts(); save_holdings();
-    char note[128]; snprintf(note, sizeof note, "Sold %s x %.4f", pr->asset_id, qty);
-    log_transaction(accounts[acc_idx].acc_no, "SELL", proceeds_inr, accounts[acc_idx].balance, note);
-    char audit[128]; snprintf(audit, sizeof audit, "SELL|%d|%s|%.4f|%.2fINR", accounts[acc_idx].acc_no, pr->asset_id, qty, proceeds_inr);
-    audit_log(audit);
-    push_notification(accounts[acc_idx].acc_no, note);
-    printf("Sold %.4f units, credited %.2f INR. New cash: %.2f INR\n", qty, proceeds_inr, accounts[acc_idx].balance);
+    pthread_mutex_unlock(&kv.lock);
+    return NULL;
 }
 
-/* view portfolio with P/L (colored) */
-static void view_portfolio(int acc_idx) {
-    if (acc_idx < 0) return;
-    printf("Holdings for account %d (%s):\n", accounts[acc_idx].acc_no, accounts[acc_idx].name);
-    printf("AssetID  Market  Qty       AvgPrice(native)  CurPrice(native)  Value(INR)   P/L(INR)\n");
-    for (int i = 0; i < hold_count; ++i) {
-        if (holdings[i].acc_no != accounts[acc_idx].acc_no) continue;
-        Holding *h = &holdings[i];
-        int pidx = find_price_index(h->asset_id);
-        double cur_native = (pidx >= 0) ? prices[pidx].price : h->avg_price;
-        double cur_inr;
-        if (strcmp(h->market, "IN") == 0) cur_inr = cur_native;
-        else if (strcmp(h->market, "US") == 0) cur_inr = cur_native * fx.inr_per_usd;
-        else if (strcmp(h->market, "EU") == 0) cur_inr = cur_native * fx.inr_per_eur;
-        else cur_inr = cur_native;
-        double value_inr = h->qty * cur_inr;
-        double avg_inr = h->avg_price * (strcmp(h->market,"US")==0 ? fx.inr_per_usd : (strcmp(h->market,"EU")==0 ? fx.inr_per_eur : 1.0));
-        double pl = h->qty * (cur_inr - avg_inr);
-        const char *color = pl >= 0 ? ANSI_GREEN : ANSI_RED;
-        printf("%-7s  %-6s  %-8.4f  %-16.4f  %-16.4f  %-11.2f  %s%+.2f%s\n",
-            h->asset_id, h->market, h->qty, h->avg_price, cur_native, value_inr, color, pl, ANSI_RESET);
+/* ---- public API ---- */
+
+static void kv_apply(int cf, const char *key, uint32_t klen, const char *val, uint32_t vlen) {
+    uint32_t vbytes = vlen == KV_TOMBSTONE ? 0 : vlen;
+    unsigned char hdr[9];
+    hdr[0] = (unsigned char)cf;
+    memcpy(hdr + 1, &klen, 4);
+    memcpy(hdr + 5, &vlen, 4);
+    uint32_t sum = (uint32_t)kv_hash(key, klen) ^ (uint32_t)(vbytes ? kv_hash(val, vbytes) : 0);
+    if (kv.wal) {
+        fwrite(hdr, 1, sizeof hdr, kv.wal);
+        fwrite(key, 1, klen, kv.wal);
+        if (vbytes) fwrite(val, 1, vbytes, kv.wal);
+        fwrite(&sum, 4, 1, kv.wal);
     }
-    double port = compute_portfolio_value_inr(accounts[acc_idx].acc_no);
-    double pl_total = compute_unrealized_pl_inr(accounts[acc_idx].acc_no);
-    const char *color = pl_total >= 0 ? ANSI_GREEN : ANSI_RED;
-    printf("Portfolio Value: %.2f INR  |  Unrealized P/L: %s%+.2f INR%s\n", port, color, pl_total, ANSI_RESET);
+    kv.wal_bytes += sizeof hdr + klen + vbytes + 4;
+    kv.user_bytes += klen + vbytes;
+    mem_put(&kv.cf[cf].mem, key, klen, val, vlen);
+    if (kv.mem_bytes >= KV_MEMTABLE_BYTES) kv_flush_memtables();
 }
 
+static void kv_put(int cf, const char *key, const char *val, size_t vlen) {
+    if (kv.open) kv_apply(cf, key, (uint32_t)strlen(key), val, (uint32_t)vlen);
+}
+
+static void kv_del(int cf, const char *key) {
+    if (kv.open) kv_apply(cf, key, (uint32_t)strlen(key), NULL, KV_TOMBSTONE);
+}
+
+/* malloc'd, NUL-terminated value or NULL */
+static char *kv_get(int cf, const char *key, size_t *vlen) {
+    if (!kv.open) return NULL;
+    uint32_t klen = (uint32_t)strlen(key), vl = 0;
+    char *val = NULL;
+    KvEntry *e = mem_find(&kv.cf[cf].mem, key, klen, NULL);
+    if (e) {
+        if (e->vlen == KV_TOMBSTONE) return NULL;
+        val = malloc(e->vlen + 1);
+        if (!val) return NULL;
+        memcpy(val, e->key + e->klen, e->vlen);
+        val[e->vlen] = '\0';
+        if (vlen) *vlen = e->vlen;
+        return val;
+    }
+    pthread_mutex_lock(&kv.lock);
+    int found = 0;
+    for (int i = 0; i < kv.cf[cf].nruns && !found; ++i) found = kv_run_get(kv.cf[cf].runs[i], key, klen, &val, &vl);
+    pthread_mutex_unlock(&kv.lock);
+    if (found && vl == KV_TOMBSTONE) { free(val); return NULL; }
+    if (found && vlen) *vlen = vl;
+    return found ? val : NULL;
+}
+
+static int cmp_kv_entry_ptr(const void *x, const void *y) {
+    return cmp_kv_entry(*(const KvEntry *const *)x, *(const KvEntry *const *)y);
+}
+
+/* every live value of a family in key order, the newest version of each key:
+   a merge of the memtable and all runs. fn gets a NUL-terminated copy. */
+static void kv_scan(int cf, void (*fn)(const char *val, uint32_t vlen, void *ctx), void *ctx) {
+    if (!kv.open) return;
+    Memtable *m = &kv.cf[cf].mem;
+    KvEntry **mem = malloc((size_t)(m->n ? m->n : 1) * sizeof *mem);
+    if (!mem) { perror("kv"); exit(1); }
+    for (int i = 0; i < m->n; ++i) mem[i] = &m->e[i];
+    qsort(mem, (size_t)m->n, sizeof *mem, cmp_kv_entry_ptr);
+    /* open the runs under the lock; a merge may unlink them afterwards */
+    pthread_mutex_lock(&kv.lock);
+    KvFamily *fam = &kv.cf[cf];
+    int n = fam->nruns;
+    KvCursor *cur = calloc((size_t)(n ? n : 1), sizeof *cur);
+    if (!cur) { perror("kv"); exit(1); }
+    char path[256];
+    for (int i = 0; i < n; ++i) {      /* newest first */
+        kv_run_path(path, sizeof path, fam->runs[i]->seq);
+        cur[i].f = fopen(path, "rb");
+        cur[i].left = fam->runs[i]->ft.index_off;
+        if (cur[i].f) kvc_next(&cur[i]);
+    }
+    pthread_mutex_unlock(&kv.lock);
+    char *out = NULL;
+    size_t cap = 0;
+    for (int mi = 0;;) {
+        const char *key = NULL;
+        uint32_t klen = 0, vlen = 0;
+        int best = -1;                 /* -1: the memtable, which is newer than any run */
+        if (mi < m->n) { key = mem[mi]->key; klen = mem[mi]->klen; vlen = mem[mi]->vlen; }
+        for (int i = 0; i < n; ++i)
+            if (cur[i].live && (!key || kv_keycmp(cur[i].buf, cur[i].klen, key, klen) < 0)) {
+                best = i; key = cur[i].buf; klen = cur[i].klen; vlen = cur[i].vlen;
+            }
+        if (!key) break;
+        if (vlen != KV_TOMBSTONE) {
+            if (vlen + 1 > cap) {
+                cap = vlen + 256;
+                char *no = realloc(out, cap);
+                if (!no) { perror("kv"); exit(1); }
+                out = no;
+            }
+            memcpy(out, key + klen, vlen);
+            out[vlen] = '\0';
+            fn(out, vlen, ctx);
+        }
+        /* older copies of the same key are superseded */
+        for (int i = 0; i < n; ++i)
+            if (i != best && cur[i].live && kv_keycmp(cur[i].buf, cur[i].klen, key, klen) == 0) kvc_next(&cur[i]);
+        if (best >= 0) kvc_next(&cur[best]); else mi++;
+    }
+    for (int i = 0; i < n; ++i) { if (cur[i].f) fclose(cur[i].f); free(cur[i].buf); }
+    free(cur);
+    free(mem);
+    free(out);
+}
+
+/* end of a save: the WAL is on disk before the caller goes on (runs and
+   MANIFEST are fsynced as they are written) */
+static void kv_sync(void) {
+    if (!kv.open || !kv.wal) return;
+    if (fflush(kv.wal) != 0 || fsync(fileno(kv.wal)) != 0) perror("kv wal");
+}
+
+static int kv_open(const char *dir) {
+    if (kv.open) return 0;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) { perror(dir); return -1; }
+    snprintf(kv.dir, sizeof kv.dir, "%s", dir);
+    char path[256], line[MAX_LINE];
+    kv_path(path, sizeof path, "LOCK");
+    kv.lockfd = open(path, O_RDWR | O_CREAT, 0644);
+    if (kv.lockfd < 0 || flock(kv.lockfd, LOCK_EX | LOCK_NB) != 0) {
+        if (kv.lockfd >= 0) { printf("%s is in use by another process.\n", dir); close(kv.lockfd); }
+        else perror(path);
+        return -1;
+    }
+    kv.next_seq = 1;
+    kv.holds_book = 0;
+    kv_path(path, sizeof path, "MANIFEST");
+    FILE *f = fopen(path, "r");
+    if (f) {
+        while (fgets(line, sizeof line, f)) {
+            char name[32];
+            int tier;
+            unsigned long long seq;
+            if (sscanf(line, "next|%llu", &seq) == 1) { kv.next_seq = seq; continue; }
+            if (strcmp(line, "book|1\n") == 0) { kv.holds_book = 1; continue; }
+            if (sscanf(line, "%31[^|]|%d|%llu", name, &tier, &seq) != 3) continue;
+            for (int c = 0; c < CF_COUNT; ++c) {
+                if (strcmp(name, CF_NAMES[c]) != 0) continue;
+                KvRun *r = kv_run_open(seq, tier);
+                if (r) kv_add_run(&kv.cf[c], r);
+            }
+        }
+        fclose(f);
+    }
+    /* replay the WAL tail; a torn or corrupt record ends it */
+    kv_path(path, sizeof path, "wal.log");
+    f = fopen(path, "rb");
+    size_t replayed = 0;
+    if (f) {
+        unsigned char hdr[9];
+        char *buf = NULL;
+        size_t cap = 0;
+        while (fread(hdr, 1, sizeof hdr, f) == sizeof hdr && hdr[0] < CF_COUNT) {
+            uint32_t klen, vlen, sum;
+            memcpy(&klen, hdr + 1, 4);
+            memcpy(&vlen, hdr + 5, 4);
+            uint32_t vb = vlen == KV_TOMBSTONE ? 0 : vlen;
+            if ((size_t)klen + vb > cap) {
+                cap = (size_t)klen + vb + 256;
+                char *nb = realloc(buf, cap);
+                if (!nb) break;
+                buf = nb;
+            }
+            if (fread(buf, 1, (size_t)klen + vb, f) != (size_t)klen + vb || fread(&sum, 4, 1, f) != 1) break;
+            if (sum != ((uint32_t)kv_hash(buf, klen) ^ (uint32_t)(vb ? kv_hash(buf + klen, vb) : 0))) break;
+            mem_put(&kv.cf[hdr[0]].mem, buf, klen, buf + klen, vlen);
+            replayed++;
+        }
+        free(buf);
+        fclose(f);
+    }
+    kv.open = 1;
+    kv.stop = 0;
+    if (replayed) kv_flush_memtables();   /* also restarts the WAL */
+    else {
+        kv.wal = fopen(path, "wb");
+        if (!kv.wal) { perror(path); kv.open = 0; close(kv.lockfd); return -1; }
+    }
+    if (pthread_create(&kv.compactor, NULL, kv_compactor, NULL) != 0) { kv.open = 0; close(kv.lockfd); return -1; }
+    pthread_mutex_lock(&kv.lock);
+    pthread_cond_signal(&kv.wake);
+    pthread_mutex_unlock(&kv.lock);
+    return 0;
+}
+
+/* wait until no tier holds KV_FANIN runs */
+static void kv_wait_merges(void) {
+    pthread_mutex_lock(&kv.lock);
+    int c, tier;
+    while (kv.merging || kv_pick_merge(&c, &tier)) pthread_cond_wait(&kv.wake, &kv.lock);
+    pthread_mutex_unlock(&kv.lock);
+}
+
+static void kv_close(void) {
+    if (!kv.open) return;
+    kv_flush_memtables();
+    kv_wait_merges();
+    pthread_mutex_lock(&kv.lock);
+    kv.stop = 1;
+    pthread_cond_broadcast(&kv.wake);
+    pthread_mutex_unlock(&kv.lock);
+    pthread_join(kv.compactor, NULL);
+    if (kv.wal) fclose(kv.wal);
+    kv.wal = NULL;
+    for (int c = 0; c < CF_COUNT; ++c) {
+        KvFamily *fam = &kv.cf[c];
+        for (int i = 0; i < fam->nruns; ++i) kv_run_free(fam->runs[i], 0);
+        free(fam->runs);
+        mem_clear(&fam->mem);
+        free(fam->mem.e);
+        free(fam->mem.slot);
+        memset(fam, 0, sizeof *fam);
+    }
+    close(kv.lockfd);
+    kv.open = 0;
+    kv.holds_book = 0;
+}
+
+/* unique, time-ordered key for append-only families */
+static void kv_log_key(char *buf, size_t n) {
+    static unsigned counter;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    snprintf(buf, n, "%010lld.%09ld.%04u", (long long)ts.tv_sec, ts.tv_nsec, counter++ % 10000);
+}
+
+/* append line to text file */
+static void append_line(const char *filename, const char *line) {
+    char buf[MAX_LINE + 2];
+    int n = snprintf(buf, sizeof buf, "%s\n", line);
+    if (n < 0) return;
+    if ((size_t)n >= sizeof buf) { n = (int)sizeof buf - 1; buf[n - 1] = '\n'; }
+    io_append(filename, buf, (size_t)n, 0);
+}
+
+/* timestamped admin audit append */
+static void audit_log(const char *entry) {
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    char buf[512];
+    snprintf(buf, sizeof buf, "%s|%s", ts, entry);
+    append_line(F_ADMIN_AUDIT, buf);
+    if (kv.open) { char key[40]; kv_log_key(key, sizeof key); kv_put(CF_AUDIT, key, buf, strlen(buf)); kv_sync(); }
+}
+
+/* push notification */
+static void push_notification(int acc_no, const char *msg) {
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    char buf[512];
+    snprintf(buf, sizeof buf, "%s|%d|%s", ts, acc_no, msg);
+    append_line(F_NOTIFICATIONS, buf);
+    if (kv.open) { char key[40]; kv_log_key(key, sizeof key); kv_put(CF_NOTIFY, key, buf, strlen(buf)); kv_sync(); }
+}
+
+/* ---------------- Asset lookup & valuation cache ---------------- */
+
+static unsigned hash_asset_id(const char *s, size_t len) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) { h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
+}
+
+static int market_index(const char *m) {
+    for (int i = 0; i < MKT_COUNT; ++i) if (strcmp(m, MARKET_NAMES[i]) == 0) return i;
+    return MKT_IN;
+}
+
+static void rebuild_price_index(void) {
+    for (int i = 0; i < PRICE_HASH_SIZE; ++i) price_slot[i] = -1;
+    for (int i = 0; i < price_count; ++i) {
+        unsigned h = hash_asset_id(prices[i].asset_id, strlen(prices[i].asset_id)) & (PRICE_HASH_SIZE - 1);
+        while (price_slot[h] >= 0) h = (h + 1) & (PRICE_HASH_SIZE - 1);
+        price_slot[h] = i;
+    }
+}
+
+/* lookup by (pointer, length) so feed parsers need not copy the id out */
+static int find_price_index_n(const char *asset_id, size_t len) {
+    unsigned h = hash_asset_id(asset_id, len) & (PRICE_HASH_SIZE - 1);
+    for (int i; (i = price_slot[h]) >= 0; h = (h + 1) & (PRICE_HASH_SIZE - 1)) {
+        if (strncmp(prices[i].asset_id, asset_id, len) == 0 && prices[i].asset_id[len] == '\0') return i;
+    }
+    return -1;
+}
+
+/* INR per unit of a market's currency */
+static double fx_factor(const char *market) {
+    if (strcmp(market, "US") == 0) return fx.inr_per_usd;
+    if (strcmp(market, "EU") == 0) return fx.inr_per_eur;
+    return 1.0;
+}
+
+static void refresh_price_inr(int i) {
+    price_inr_cache[i] = prices[i].price * fx_factor(prices[i].market);
+}
+
+static void refresh_all_price_inr(void) {
+    for (int i = 0; i < price_count; ++i) refresh_price_inr(i);
+    for (int m = 0; m < MKT_COUNT; ++m) totals.aum_inr[m] = 0.0;
+    for (int i = 0; i < price_count; ++i) totals.aum_inr[market_index(prices[i].market)] += asset_units[i] * price_inr_cache[i];
+}
+
+/* Publish a quote: O(1) and independent of how many subscribers exist.
+   Price is stored before the version bump, so a reader that sees the new
+   version always reads a price at least that fresh. */
+static void quote_publish(int i, double price) {
+    atomic_store_explicit(&quote_price[i], price, memory_order_relaxed);
+    atomic_fetch_add_explicit(&quote_version[i], 1, memory_order_release);
+    atomic_fetch_add_explicit(&quote_epoch, 1, memory_order_release);
+}
+
+static void publish_all_quotes(void) {
+    for (int i = 0; i < price_count; ++i) quote_publish(i, prices[i].price);
+}
+
+/* single place where an asset's price changes; keeps the valuation cache in step */
+static void set_asset_price(int i, double price, const char *ts) {
+    PriceRec *p = &prices[i];
+    double old_inr = price_inr_cache[i];
+    p->price = price;
+    strncpy(p->last_update, ts, sizeof p->last_update - 1);
+    p->last_update[sizeof p->last_update - 1] = '\0';
+    refresh_price_inr(i);
+    quote_publish(i, price);
+    /* O(1) per containing basket: NAV moves by weight x price delta */
+    double delta = price_inr_cache[i] - old_inr;
+    if (asset_units[i] != 0.0) totals.aum_inr[market_index(p->market)] += asset_units[i] * delta;
+    for (int e = basket_link_start[i]; e < basket_link_start[i + 1]; ++e) {
+        int b = basket_entries[e].basket;
+        basket_nav_inr[b] += basket_entries[e].weight * delta;
+        set_asset_price(b, basket_nav_inr[b] / fx_factor(prices[b].market), ts);
+    }
+}
+
+/* Holdings name assets by prices[] slot. An id with no price row (dropped
+   from prices.txt) is interned as a closed, zero-volatility listing priced
+   at the holding's cost, so the position keeps valuing as it did before.
+   Such slots are marked synthetic: they are never written to prices.txt or
+   shown in the market list, and their holdings keep the name and market in
+   the row (legacy format) so they intern the same way next time. */
+static int intern_asset(const char *asset_id, const char *name, const char *market, double price) {
+    int i = find_price_index_n(asset_id, strlen(asset_id));
+    if (i >= 0 || price_count >= MAX_PRICES) return i;
+    i = price_count++;
+    PriceRec *p = &prices[i];
+    memset(p, 0, sizeof *p);
+    strncpy(p->asset_id, asset_id, sizeof p->asset_id - 1);
+    strncpy(p->asset_name, name ? name : asset_id, sizeof p->asset_name - 1);
+    strncpy(p->market, market ? market : "IN", sizeof p->market - 1);
+    p->price = price;
+    get_timestamp(p->last_update, sizeof p->last_update);
+    is_synthetic[i] = 1;
+    rebuild_price_index();
+    refresh_price_inr(i);
+    quote_publish(i, price);
+    return i;
+}
+
+/* ---------------- Paged account store (accounts.db): B+tree + buffer pool ---------------- */
+
+/* Paged home for the accounts that have left memory. The file is a run of
+   4 KB pages holding two B+trees: one keyed by acc_no with the full Account +
+   AccountInfo record in its leaves, one mapping lowercase UPI handles to
+   acc_no. Pages are cached in a fixed pool with clock eviction, so memory
+   stays at the pool size however large the file grows, and a lookup costs
+   one page per tree level (3-4 for tens of millions of rows).
+   With BVDU_ACCOUNT_STORE=<file> it holds every archived account (see cold
+   storage): login, rehydration and UPI checks look archived accounts up here
+   instead of in a map and UPI set sized to the whole archive, so only the
+   working set is held in the arrays. cold_store.dat stays the record of
+   what is archived; the store follows it up to meta.cold_end, and
+   --store-import rebuilds it from there. */
+
+#define BT_PAGE 4096
+#define BT_MAGIC 0x42445642u          /* "BVDB" */
+#ifndef BT_POOL_PAGES
+#define BT_POOL_PAGES 4096            /* 16 MB of cached pages */
+#endif
+#define BT_MAX_HEIGHT 16
+#define STORE_UPI_KEY 64
+enum { BT_ACC, BT_UPI, BT_TREES };
+
+typedef struct {
+    Account a;
+    AccountInfo ai;
+    int64_t cold_off;                 /* header of its record in cold_store.dat */
+} StoreRecord;
+
+typedef struct {                      /* page 0 */
+    uint32_t magic;
+    uint32_t record_size;             /* sizeof(StoreRecord) that wrote the file */
+    uint32_t page_count;
+    uint32_t root[BT_TREES];          /* 0 = empty tree */
+    uint32_t height[BT_TREES];
+    uint64_t records;
+    uint64_t cold_end;                /* cold_store.dat bytes applied */
+} BtMeta;
+
+/* node page: header, then keys, then leaf values or inner child page numbers */
+typedef struct {
+    uint16_t leaf;
+    uint16_t n;
+    uint32_t next;                    /* right sibling leaf, 0 = none */
+} BtNode;
+
+typedef struct {
+    int ks, vs;                       /* key and value bytes */
+    int leaf_cap, inner_cap;
+} BtShape;
+
+typedef struct {
+    uint32_t page;                    /* 0 = free (the meta page is never pooled) */
+    int pins;
+    unsigned char ref, dirty;
+} BtFrame;
+
+static struct {
+    int fd;
+    BtMeta meta;
+    BtShape shape[BT_TREES];
+    unsigned char *mem;               /* nframes pages */
+    BtFrame *frames;
+    int nframes, hand;
+    int32_t *where;                   /* page -> frame, -1 = not cached */
+    uint32_t wherecap;
+    uint64_t hits, misses, writebacks;
+} acct_store = { .fd = -1 };
+
+static void bp_write_back(int f) {
+    BtFrame *fr = &acct_store.frames[f];
+    if (!fr->dirty) return;
+    if (pwrite(acct_store.fd, acct_store.mem + (size_t)f * BT_PAGE, BT_PAGE, (off_t)fr->page * BT_PAGE) != BT_PAGE)
+        perror("account store write");
+    fr->dirty = 0;
+    acct_store.writebacks++;
+}
+
+/* pin a page into the pool; fresh pages are zeroed instead of read */
+static BtNode *bp_pin(uint32_t page, int fresh) {
+    if (page >= acct_store.wherecap) {
+        uint32_t nc = acct_store.wherecap ? acct_store.wherecap : 1024;
+        while (nc <= page) nc *= 2;
+        int32_t *w = realloc(acct_store.where, nc * sizeof *w);
+        if (!w) { perror("account store"); exit(1); }
+        for (uint32_t i = acct_store.wherecap; i < nc; ++i) w[i] = -1;
+        acct_store.where = w;
+        acct_store.wherecap = nc;
+    }
+    int f = acct_store.where[page];
+    if (f >= 0) {
+        acct_store.hits++;
+        acct_store.frames[f].pins++;
+        acct_store.frames[f].ref = 1;
+        return (BtNode *)(acct_store.mem + (size_t)f * BT_PAGE);
+    }
+    acct_store.misses++;
+    /* clock: sweep past pinned frames, give referenced ones a second chance */
+    for (int step = 0;; ++step) {
+        f = acct_store.hand;
+        acct_store.hand = (acct_store.hand + 1) % acct_store.nframes;
+        BtFrame *fr = &acct_store.frames[f];
+        if (fr->pins == 0 && !fr->ref) break;
+        fr->ref = 0;
+        if (step > 2 * acct_store.nframes) { fprintf(stderr, "account store: every page is pinned\n"); exit(1); }
+    }
+    BtFrame *fr = &acct_store.frames[f];
+    if (fr->page) { bp_write_back(f); acct_store.where[fr->page] = -1; }
+    unsigned char *p = acct_store.mem + (size_t)f * BT_PAGE;
+    if (fresh || pread(acct_store.fd, p, BT_PAGE, (off_t)page * BT_PAGE) != BT_PAGE) memset(p, 0, BT_PAGE);
+    fr->page = page;
+    fr->pins = 1;
+    fr->ref = 1;
+    fr->dirty = (unsigned char)fresh;
+    acct_store.where[page] = f;
+    return (BtNode *)p;
+}
+
+static void bp_unpin(BtNode *n, int dirty) {
+    BtFrame *fr = &acct_store.frames[((unsigned char *)n - acct_store.mem) / BT_PAGE];
+    fr->pins--;
+    if (dirty) fr->dirty = 1;
+}
+
+static BtNode *bp_new(uint32_t *page, int leaf) {
+    *page = acct_store.meta.page_count++;
+    BtNode *n = bp_pin(*page, 1);
+    n->leaf = (uint16_t)leaf;
+    return n;
+}
+
+static unsigned char *bt_key(int t, BtNode *n, int i) {
+    return (unsigned char *)(n + 1) + (size_t)i * acct_store.shape[t].ks;
+}
+static unsigned char *bt_val(int t, BtNode *n, int i) {
+    const BtShape *sh = &acct_store.shape[t];
+    return (unsigned char *)(n + 1) + (size_t)sh->leaf_cap * sh->ks + (size_t)i * sh->vs;
+}
+static uint32_t *bt_child(int t, BtNode *n) {
+    return (uint32_t *)((unsigned char *)(n + 1) + (size_t)acct_store.shape[t].inner_cap * acct_store.shape[t].ks);
+}
+
+static int bt_cmp(int t, const void *x, const void *y) {
+    if (t == BT_UPI) return memcmp(x, y, STORE_UPI_KEY);
+    int32_t a, b;
+    memcpy(&a, x, 4);
+    memcpy(&b, y, 4);
+    return (a > b) - (a < b);
+}
+
+/* first slot with key >= `key` (leaves), or > `key` (inner: the child to follow) */
+static int bt_search(int t, BtNode *n, const void *key, int upper) {
+    int lo = 0, hi = n->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int c = bt_cmp(t, bt_key(t, n, mid), key);
+        if (c < 0 || (upper && c == 0)) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/* pinned leaf that would hold `key`; records the path when asked */
+static BtNode *bt_descend(int t, const void *key, uint32_t *path, int *slot, int *depth, int *rightmost) {
+    uint32_t page = acct_store.meta.root[t];
+    int d = 0, rm = 1;
+    for (;;) {
+        BtNode *n = bp_pin(page, 0);
+        if (n->leaf) {
+            if (depth) *depth = d;
+            if (rightmost) *rightmost = rm && n->next == 0;
+            return n;
+        }
+        int i = bt_search(t, n, key, 1);
+        rm = rm && i == n->n;
+        if (path && d < BT_MAX_HEIGHT) { path[d] = page; slot[d] = i; }
+        d++;
+        page = bt_child(t, n)[i];
+        bp_unpin(n, 0);
+    }
+}
+
+static int bt_get(int t, const void *key, void *val) {
+    if (!acct_store.meta.root[t]) return 0;
+    BtNode *n = bt_descend(t, key, NULL, NULL, NULL, NULL);
+    int i = bt_search(t, n, key, 0);
+    int found = i < n->n && bt_cmp(t, bt_key(t, n, i), key) == 0;
+    if (found) memcpy(val, bt_val(t, n, i), (size_t)acct_store.shape[t].vs);
+    bp_unpin(n, 0);
+    return found;
+}
+
+/* insert or replace; returns 1 (old value copied out if wanted) on replace.
+   Splits halve a node, except appends at the right edge, which leave the
+   left node full so acc_no-ordered loads pack pages completely. */
+static int bt_put(int t, const void *key, const void *val, void *old) {
+    const BtShape *sh = &acct_store.shape[t];
+    size_t ks = (size_t)sh->ks, vs = (size_t)sh->vs;
+    if (!acct_store.meta.root[t]) {
+        bp_unpin(bp_new(&acct_store.meta.root[t], 1), 1);
+        acct_store.meta.height[t] = 1;
+    }
+    uint32_t path[BT_MAX_HEIGHT];
+    int slot[BT_MAX_HEIGHT], depth, rightmost;
+    BtNode *n = bt_descend(t, key, path, slot, &depth, &rightmost);
+    int i = bt_search(t, n, key, 0);
+    if (i < n->n && bt_cmp(t, bt_key(t, n, i), key) == 0) {
+        if (old) memcpy(old, bt_val(t, n, i), vs);
+        memcpy(bt_val(t, n, i), val, vs);
+        bp_unpin(n, 1);
+        return 1;
+    }
+    if (n->n < sh->leaf_cap) {
+        memmove(bt_key(t, n, i + 1), bt_key(t, n, i), (size_t)(n->n - i) * ks);
+        memmove(bt_val(t, n, i + 1), bt_val(t, n, i), (size_t)(n->n - i) * vs);
+        memcpy(bt_key(t, n, i), key, ks);
+        memcpy(bt_val(t, n, i), val, vs);
+        n->n++;
+        bp_unpin(n, 1);
+        return 0;
+    }
+
+    /* leaf split over the n+1 entries, new one at position i */
+    int total = n->n + 1;
+    int left = (rightmost && i == n->n) ? n->n : total / 2;
+    uint32_t rpage;
+    BtNode *r = bp_new(&rpage, 1);
+    for (int j = left; j < total; ++j) {
+        int from = j < i ? j : j - 1;
+        memcpy(bt_key(t, r, j - left), j == i ? key : bt_key(t, n, from), ks);
+        memcpy(bt_val(t, r, j - left), j == i ? val : bt_val(t, n, from), vs);
+    }
+    r->n = (uint16_t)(total - left);
+    if (i < left) {
+        n->n = (uint16_t)(left - 1);
+        memmove(bt_key(t, n, i + 1), bt_key(t, n, i), (size_t)(n->n - i) * ks);
+        memmove(bt_val(t, n, i + 1), bt_val(t, n, i), (size_t)(n->n - i) * vs);
+        memcpy(bt_key(t, n, i), key, ks);
+        memcpy(bt_val(t, n, i), val, vs);
+    }
+    n->n = (uint16_t)left;
+    r->next = n->next;
+    n->next = rpage;
+    unsigned char sep[STORE_UPI_KEY];
+    memcpy(sep, bt_key(t, r, 0), ks);
+    bp_unpin(r, 1);
+    bp_unpin(n, 1);
+
+    /* push (sep, rpage) up; inner splits promote their middle key */
+    static unsigned char tk[BT_PAGE + STORE_UPI_KEY];
+    static uint32_t tc[BT_PAGE / 4 + 2];
+    uint32_t child = rpage;
+    while (depth > 0) {
+        --depth;
+        int at = slot[depth];
+        BtNode *p = bp_pin(path[depth], 0);
+        uint32_t *pc = bt_child(t, p);
+        if (p->n < sh->inner_cap) {
+            memmove(bt_key(t, p, at + 1), bt_key(t, p, at), (size_t)(p->n - at) * ks);
+            memmove(pc + at + 2, pc + at + 1, (size_t)(p->n - at) * sizeof *pc);
+            memcpy(bt_key(t, p, at), sep, ks);
+            pc[at + 1] = child;
+            p->n++;
+            bp_unpin(p, 1);
+            return 0;
+        }
+        total = p->n + 1;
+        memcpy(tk, bt_key(t, p, 0), (size_t)at * ks);
+        memcpy(tk + (size_t)at * ks, sep, ks);
+        memcpy(tk + (size_t)(at + 1) * ks, bt_key(t, p, at), (size_t)(p->n - at) * ks);
+        memcpy(tc, pc, (size_t)(at + 1) * sizeof *pc);
+        tc[at + 1] = child;
+        memcpy(tc + at + 2, pc + at + 1, (size_t)(p->n - at) * sizeof *pc);
+        int mid = (rightmost && at == p->n) ? p->n : total / 2;
+        uint32_t qpage;
+        BtNode *q = bp_new(&qpage, 0);
+        p->n = (uint16_t)mid;
+        memcpy(bt_key(t, p, 0), tk, (size_t)mid * ks);
+        memcpy(pc, tc, (size_t)(mid + 1) * sizeof *pc);
+        q->n = (uint16_t)(total - mid - 1);
+        memcpy(bt_key(t, q, 0), tk + (size_t)(mid + 1) * ks, (size_t)q->n * ks);
+        memcpy(bt_child(t, q), tc + mid + 1, (size_t)(q->n + 1) * sizeof *pc);
+        memcpy(sep, tk + (size_t)mid * ks, ks);
+        child = qpage;
+        bp_unpin(q, 1);
+        bp_unpin(p, 1);
+    }
+    if (acct_store.meta.height[t] >= BT_MAX_HEIGHT) { fprintf(stderr, "account store: tree too deep\n"); exit(1); }
+    uint32_t rootpage;
+    BtNode *root = bp_new(&rootpage, 0);
+    root->n = 1;
+    memcpy(bt_key(t, root, 0), sep, ks);
+    bt_child(t, root)[0] = acct_store.meta.root[t];
+    bt_child(t, root)[1] = child;
+    bp_unpin(root, 1);
+    acct_store.meta.root[t] = rootpage;
+    acct_store.meta.height[t]++;
+    return 0;
+}
+
+/* drop a key from its leaf; leaves are not merged, which suits an index
+   that only loses a key when a UPI handle changes */
+static void bt_delete(int t, const void *key) {
+    if (!acct_store.meta.root[t]) return;
+    const BtShape *sh = &acct_store.shape[t];
+    BtNode *n = bt_descend(t, key, NULL, NULL, NULL, NULL);
+    int i = bt_search(t, n, key, 0);
+    int found = i < n->n && bt_cmp(t, bt_key(t, n, i), key) == 0;
+    if (found) {
+        memmove(bt_key(t, n, i), bt_key(t, n, i + 1), (size_t)(n->n - i - 1) * sh->ks);
+        memmove(bt_val(t, n, i), bt_val(t, n, i + 1), (size_t)(n->n - i - 1) * sh->vs);
+        n->n--;
+    }
+    bp_unpin(n, found);
+}
+
+static void store_upi_key(const char *upi, unsigned char *key) {
+    memset(key, 0, STORE_UPI_KEY);
+    for (int i = 0; i < STORE_UPI_KEY - 1 && upi[i]; ++i) key[i] = (unsigned char)tolower((unsigned char)upi[i]);
+}
+
+static int acctstore_open(const char *path, int frames) {
+    if (acct_store.fd >= 0) { printf("Account store already open.\n"); return -1; }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) { perror(path); return -1; }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) { printf("%s is in use by another process.\n", path); close(fd); return -1; }
+    BtMeta m;
+    memset(&m, 0, sizeof m);
+    ssize_t got = pread(fd, &m, sizeof m, 0);
+    if (got == 0) {
+        m.magic = BT_MAGIC;
+        m.record_size = (uint32_t)sizeof(StoreRecord);
+        m.page_count = 1;
+    } else if (got != (ssize_t)sizeof m || m.magic != BT_MAGIC || m.record_size != sizeof(StoreRecord)) {
+        printf("%s is not an account store for this build; rebuild it with --store-import.\n", path);
+        close(fd);
+        return -1;
+    }
+    acct_store.mem = malloc((size_t)frames * BT_PAGE);
+    acct_store.frames = calloc((size_t)frames, sizeof *acct_store.frames);
+    if (!acct_store.mem || !acct_store.frames) {
+        free(acct_store.mem); free(acct_store.frames);
+        close(fd);
+        return -1;
+    }
+    int body = BT_PAGE - (int)sizeof(BtNode);
+    acct_store.shape[BT_ACC] = (BtShape){4, (int)sizeof(StoreRecord), body / (4 + (int)sizeof(StoreRecord)), (body - 4) / (4 + 4)};
+    acct_store.shape[BT_UPI] = (BtShape){STORE_UPI_KEY, 4, body / (STORE_UPI_KEY + 4), (body - 4) / (STORE_UPI_KEY + 4)};
+    acct_store.fd = fd;
+    acct_store.meta = m;
+    acct_store.nframes = frames;
+    acct_store.hand = 0;
+    acct_store.hits = acct_store.misses = acct_store.writebacks = 0;
+    return 0;
+}
+
+/* write dirty pages and the meta page; the pool stays warm */
+static void acctstore_flush(void) {
+    if (acct_store.fd < 0) return;
+    for (int f = 0; f < acct_store.nframes; ++f) bp_write_back(f);
+    if (pwrite(acct_store.fd, &acct_store.meta, sizeof acct_store.meta, 0) != (ssize_t)sizeof acct_store.meta)
+        perror("account store meta");
+}
+
+static void acctstore_close(void) {
+    if (acct_store.fd < 0) return;
+    acctstore_flush();
+    fsync(acct_store.fd);
+    close(acct_store.fd);
+    free(acct_store.mem);
+    free(acct_store.frames);
+    free(acct_store.where);
+    acct_store.mem = NULL;
+    acct_store.frames = NULL;
+    acct_store.where = NULL;
+    acct_store.wherecap = 0;
+    acct_store.fd = -1;
+}
+
+/* upsert by acc_no and keep the UPI index in step */
+static void acctstore_put(const Account *a, const AccountInfo *ai, long cold_off) {
+    StoreRecord rec, old;
+    memset(&rec, 0, sizeof rec);
+    rec.a = *a;
+    rec.ai = *ai;
+    rec.cold_off = cold_off;
+    int32_t k = a->acc_no;
+    int replaced = bt_put(BT_ACC, &k, &rec, &old);
+    if (!replaced) acct_store.meta.records++;
+    if (replaced && bvdu_stricmp(old.ai.upi, ai->upi) == 0) return;
+    unsigned char uk[STORE_UPI_KEY];
+    if (replaced && old.ai.upi[0]) { store_upi_key(old.ai.upi, uk); bt_delete(BT_UPI, uk); }
+    if (ai->upi[0]) { store_upi_key(ai->upi, uk); bt_put(BT_UPI, uk, &k, NULL); }
+}
+
+/* remove an account and its UPI key */
+static void acctstore_del(int acc_no) {
+    StoreRecord rec;
+    int32_t k = acc_no;
+    if (!bt_get(BT_ACC, &k, &rec)) return;
+    bt_delete(BT_ACC, &k);
+    acct_store.meta.records--;
+    if (rec.ai.upi[0]) {
+        unsigned char uk[STORE_UPI_KEY];
+        store_upi_key(rec.ai.upi, uk);
+        bt_delete(BT_UPI, uk);
+    }
+}
+
+/* any of a, ai and cold_off may be NULL */
+static int acctstore_get(int acc_no, Account *a, AccountInfo *ai, long *cold_off) {
+    StoreRecord rec;
+    int32_t k = acc_no;
+    if (!bt_get(BT_ACC, &k, &rec)) return 0;
+    if (a) *a = rec.a;
+    if (ai) *ai = rec.ai;
+    if (cold_off) *cold_off = (long)rec.cold_off;
+    return 1;
+}
+
+/* acc_no owning a UPI handle (any case), or -1 */
+static int acctstore_find_upi(const char *upi) {
+    unsigned char uk[STORE_UPI_KEY];
+    int32_t acc;
+    store_upi_key(upi, uk);
+    return bt_get(BT_UPI, uk, &acc) ? acc : -1;
+}
+
+/* ---------------- File load/save routines ---------------- */
+
+/* Change journal (journal.txt): every save appends the rows that changed since
+   the previous save, as full row images stamped with the save time:
+     epoch|A|<accounts.txt row>        account state
+     epoch|H|acc_no|n                  account's holdings replaced by the next n rows
+     epoch|h|<holdings.txt row>
+   A snapshot plus the journal after its offset rebuilds any later moment. */
+
+typedef struct {
+    int acc_no;           /* 0 = empty slot */
+    uint64_t row_hash;    /* account row as last saved */
+    uint64_t hold_hash;   /* holdings rows as last saved */
+    uint64_t hold_cur;    /* accumulators for the save in progress */
+    int hold_n;
+    int hold_dirty;
+} JournalShadow;
+
+#define JOURNAL_SLOTS_MIN 1024
+
+static JournalShadow *jshadow = NULL;
+static unsigned jshadow_cap = 0, jshadow_used = 0;
+static OutBuf journal_out;
+
+static uint64_t row_hash(const char *s, size_t len, uint64_t h) {
+    for (size_t i = 0; i < len; ++i) { h ^= (unsigned char)s[i]; h *= 1099511628211ull; }
+    return h;
+}
+#define ROW_HASH_INIT 14695981039346656037ull
+
+static JournalShadow *jshadow_get(int acc_no) {
+    if (jshadow_used * 2 >= jshadow_cap) {
+        unsigned cap = jshadow_cap ? jshadow_cap * 2 : JOURNAL_SLOTS_MIN;
+        JournalShadow *t = calloc(cap, sizeof *t);
+        if (!t) return NULL;
+        for (unsigned i = 0; i < jshadow_cap; ++i) {
+            if (!jshadow[i].acc_no) continue;
+            unsigned h = (unsigned)jshadow[i].acc_no * 2654435761u & (cap - 1);
+            while (t[h].acc_no) h = (h + 1) & (cap - 1);
+            t[h] = jshadow[i];
+        }
+        free(jshadow);
+        jshadow = t;
+        jshadow_cap = cap;
+    }
+    unsigned h = (unsigned)acc_no * 2654435761u & (jshadow_cap - 1);
+    while (jshadow[h].acc_no && jshadow[h].acc_no != acc_no) h = (h + 1) & (jshadow_cap - 1);
+    if (!jshadow[h].acc_no) {
+        jshadow[h].acc_no = acc_no;
+        jshadow[h].hold_hash = ROW_HASH_INIT;
+        jshadow_used++;
+    }
+    return &jshadow[h];
+}
+
+static int format_account_row(char *buf, size_t n, const Account *a, const AccountInfo *ai) {
+    /* acc_no|name|acc_type|pin|balance|loan|active|frozen|failed_attempts|upi|last_login|accrued|last_accrual */
+    char day[24] = "-";
+    if (a->last_accrual > 0) format_day(a->last_accrual, day, sizeof day);
+    int r = snprintf(buf, n, "%d|%s|%s|%d|%.2f|%.2f|%d|%d|%d|%s|%s|%.6f|%s\n",
+        a->acc_no, ai->name, ai->acc_type, a->pin, a->balance, a->loan,
+        a->active, a->frozen, a->failed_attempts, ai->upi, ai->last_login, a->accrued, day);
+    return (r < 0 || (size_t)r >= n) ? (int)strlen(buf) : r;
+}
+
+/* fixed-point with trailing zeros dropped: 10.500000 -> 10.5, 190.0000 -> 190 */
+static char *format_trimmed(char *buf, size_t n, double v, int decimals) {
+    snprintf(buf, n, "%.*f", decimals, v);
+    char *dot = strchr(buf, '.');
+    if (dot) {
+        char *e = dot + strlen(dot) - 1;
+        while (e > dot && *e == '0') *e-- = '\0';
+        if (e == dot) *e = '\0';
+    }
+    if (strcmp(buf, "-0") == 0) strcpy(buf, "0");
+    return buf;
+}
+
+/* acc_no|asset_id|qty|avg_price, whose name and market live in prices.txt;
+   for an unlisted asset (name set) acc_no|asset_id|asset_name|qty|avg_price|market */
+static int format_holding_line(char *buf, size_t n, const Holding *h, const char *asset_id, const char *name, const char *market) {
+    char q[48], ap[48];
+    format_trimmed(q, sizeof q, h->qty, 6);
+    format_trimmed(ap, sizeof ap, h->avg_price, 4);
+    int r = name ? snprintf(buf, n, "%d|%s|%s|%s|%s|%s\n", h->acc_no, asset_id, name, q, ap, market)
+                 : snprintf(buf, n, "%d|%s|%s|%s\n", h->acc_no, asset_id, q, ap);
+    return (r < 0 || (size_t)r >= n) ? (int)strlen(buf) : r;
+}
+
+static int format_holding_row(char *buf, size_t n, const Holding *h) {
+    const PriceRec *p = &prices[h->asset];
+    return format_holding_line(buf, n, h, p->asset_id, is_synthetic[h->asset] ? p->asset_name : NULL, p->market);
+}
+
+/* split a row without interning; *legacy is set for the six-field form */
+static int scan_holding_row(const char *s, Holding *h, char id[16], char name[64], char market[8], int *legacy) {
+    memset(h, 0, sizeof *h);
+    *legacy = sscanf(s, "%d|%15[^|]|%63[^|]|%lf|%lf|%7[^\r\n]",
+        &h->acc_no, id, name, &h->qty, &h->avg_price, market) == 6;
+    return *legacy || sscanf(s, "%d|%15[^|]|%lf|%lf", &h->acc_no, id, &h->qty, &h->avg_price) == 4;
+}
+
+/* acc_no|asset_id|qty|avg_price, or the older acc_no|asset_id|asset_name|qty|avg_price|market */
+static int parse_holding_row(const char *s, Holding *h) {
+    char id[16], name[64], market[8];
+    int legacy;
+    if (!scan_holding_row(s, h, id, name, market, &legacy)) return 0;
+    h->asset = intern_asset(id, legacy ? name : NULL, legacy ? market : NULL, h->avg_price);
+    return h->asset >= 0;
+}
+
+/* record the account row being saved; journal it if it changed (emit = 0 on load).
+   Returns 1 when the row differs from the last one recorded. */
+static int journal_account_row(int acc_no, const char *row, int len, long long epoch, int emit) {
+    JournalShadow *js = jshadow_get(acc_no);
+    if (!js) return 1;
+    uint64_t h = row_hash(row, (size_t)len, ROW_HASH_INIT);
+    if (js->row_hash == h) return 0;
+    js->row_hash = h;
+    if (emit) ob_printf(&journal_out, "%lld|A|%s", epoch, row);
+    return 1;
+}
+
+/* holdings diff is per account: pass 1 hashes each account's rows, pass 2
+   journals the full holding set of every account whose hash moved */
+static void journal_holdings(long long epoch, int emit) {
+    char row[MAX_LINE];
+    for (unsigned i = 0; i < jshadow_cap; ++i) { jshadow[i].hold_cur = ROW_HASH_INIT; jshadow[i].hold_n = 0; }
+    for (int i = 0; i < hold_count; ++i) {
+        JournalShadow *js = jshadow_get(holdings[i].acc_no);
+        if (!js) return;
+        int n = format_holding_row(row, sizeof row, &holdings[i]);
+        js->hold_cur = row_hash(row, (size_t)n, js->hold_cur);
+        js->hold_n++;
+    }
+    int any = 0;
+    for (unsigned i = 0; i < jshadow_cap; ++i) {
+        JournalShadow *js = &jshadow[i];
+        js->hold_dirty = js->acc_no && js->hold_cur != js->hold_hash;
+        if (!js->hold_dirty) continue;
+        js->hold_hash = js->hold_cur;
+        any = 1;
+        if (emit) ob_printf(&journal_out, "%lld|H|%d|%d\n", epoch, js->acc_no, js->hold_n);
+    }
+    if (!any || !emit) return;
+    for (int i = 0; i < hold_count; ++i) {
+        if (!jshadow_get(holdings[i].acc_no)->hold_dirty) continue;
+        format_holding_row(row, sizeof row, &holdings[i]);
+        ob_printf(&journal_out, "%lld|h|%s", epoch, row);
+    }
+}
+
+static void journal_flush(void) {
+    journal_out.append_path = F_JOURNAL;
+    ob_flush(&journal_out);
+}
+
+/* KV store (BVDU_KV): accounts keyed by acc_no, holdings as one value per
+   account holding its rows, prices by asset id, fx under "fx" */
+static void kv_put_account(int i) {
+    char key[16], row[MAX_LINE];
+    int len = format_account_row(row, sizeof row, &accounts[i], &account_info[i]);
+    snprintf(key, sizeof key, "%d", accounts[i].acc_no);
+    kv_put(CF_ACCOUNTS, key, row, len > 0 && row[len - 1] == '\n' ? (size_t)len - 1 : (size_t)len);
+}
+
+/* all = 0: only accounts journal_holdings() just found changed */
+static void kv_put_holdings(int all) {
+    if (!kv.open) return;
+    char key[16], row[MAX_LINE];
+    OutBuf *val = malloc(sizeof *val);
+    if (!val) return;
+    for (unsigned s = 0; s < jshadow_cap; ++s) {
+        JournalShadow *js = &jshadow[s];
+        if (!js->acc_no || !(all || js->hold_dirty)) continue;
+        val->len = 0;
+        for (int i = 0; i < hold_count; ++i) {
+            if (holdings[i].acc_no != js->acc_no) continue;
+            int n = format_holding_row(row, sizeof row, &holdings[i]);
+            if (val->len + (size_t)n > OUTBUF_SIZE) break;
+            memcpy(val->buf + val->len, row, (size_t)n);
+            val->len += (size_t)n;
+        }
+        snprintf(key, sizeof key, "%d", js->acc_no);
+        if (val->len) kv_put(CF_HOLDINGS, key, val->buf, val->len);
+        else kv_del(CF_HOLDINGS, key);
+    }
+    free(val);
+    kv_sync();
+}
+
+static void hot_fold_all(void);
+static void account_index_touch(int i);
+
+/* While a request group is open (commit_begin() .. commit_end()), the
+   whole-file saves below only mark what changed; commit_end() saves each
+   dirty file once for the whole group. */
+#define DIRTY_ACCOUNTS 1
+#define DIRTY_HOLDINGS 2
+/* the rest only tell other front ends sharing the book what to reload */
+#define DIRTY_TRADES 4
+#define DIRTY_PRICES 8
+#define DIRTY_IDEM 16
+#define DIRTY_SETTLEMENT 32
+#define DIRTY_HOT 64
+#define DIRTY_INTEREST 128
+static int persist_deferred;
+static unsigned persist_dirty;
+
+static void save_accounts(void) {
+    if (persist_deferred) { persist_dirty |= DIRTY_ACCOUNTS; return; }
+    book_dirty |= DIRTY_ACCOUNTS;
+    hot_fold_all(); /* striped credits are part of the balance on disk */
+    /* atomic save; with the book in the KV store only the changed rows are written */
+    static int changed[MAX_ACCOUNTS];
+    int nchanged = 0;
+    Snapshot snap;
+    FILE *f = NULL;
+    if (!kv.holds_book && !(f = snapshot_begin(&snap, "accounts.tmp", F_ACCOUNTS, 0))) { perror("save_accounts fopen"); return; }
+    long long now = (long long)time(NULL);
+    char row[MAX_LINE];
+    for (int i = 0; i < acc_count; ++i) {
+        int n = format_account_row(row, sizeof row, &accounts[i], &account_info[i]);
+        if (f) fputs(row, f);
+        if (journal_account_row(accounts[i].acc_no, row, n, now, 1)) {
+            account_index_touch(i);
+            changed[nchanged++] = i;
+        }
+    }
+    journal_flush(); /* journal first: a crash between the two loses nothing */
+    if (f) snapshot_commit(&snap);
+    else {
+        for (int k = 0; k < nchanged; ++k) kv_put_account(changed[k]);
+        kv_sync();
+    }
+}
+
+/* accepts rows written before interest accrual (11 fields) and after (13) */
+static int parse_account_row(const char *s, Account *a, AccountInfo *ai) {
+    memset(a, 0, sizeof *a);
+    memset(ai, 0, sizeof *ai);
+    char day[16] = "";
+    int active = 0, frozen = 0, failed = 0;
+    int r = sscanf(s, "%d|%49[^|]|%19[^|]|%d|%lf|%lf|%d|%d|%d|%63[^|]|%24[^|\n]|%lf|%15[^\n]",
+        &a->acc_no, ai->name, ai->acc_type, &a->pin, &a->balance, &a->loan,
+        &active, &frozen, &failed, ai->upi, ai->last_login, &a->accrued, day);
+    a->active = (unsigned char)active;
+    a->frozen = (unsigned char)frozen;
+    a->failed_attempts = (unsigned char)failed;
+    a->type = (unsigned char)acc_type_index(ai->acc_type);
+    int y, m, d;
+    if (r == 13 && sscanf(day, "%d-%d-%d", &y, &m, &d) == 3) a->last_accrual = days_from_civil(y, m, d);
+    return r == 11 || r == 13;
+}
+
+/* append one stored row to the book; 0 if it does not parse or the book is full */
+static int load_account_row(const char *line) {
+    Account a;
+    AccountInfo ai;
+    char row[MAX_LINE];
+    if (acc_count >= MAX_ACCOUNTS || !parse_account_row(line, &a, &ai)) return 0;
+    if (a.last_accrual <= 0) a.last_accrual = local_day((int64_t)time(NULL)); /* pre-accrual rows start today */
+    account_info[acc_count] = ai;
+    accounts[acc_count++] = a;
+    journal_account_row(a.acc_no, row, format_account_row(row, sizeof row, &a, &ai), 0, 0);
+    return 1;
+}
+
+static void kv_load_account(const char *val, uint32_t vlen, void *ctx) {
+    (void)vlen; (void)ctx;
+    if (!load_account_row(val) && acc_count < MAX_ACCOUNTS) fprintf(stderr, "kv: skipping account row '%.40s'\n", val);
+}
+
+static void load_accounts(void) {
+    upi_set_stale = 1;
+    acc_count = 0;
+    acc_index_dirty = 1;
+    if (kv.holds_book) { kv_scan(CF_ACCOUNTS, kv_load_account, NULL); return; }
+    FILE *f = fopen(F_ACCOUNTS, "r");
+    if (!f) return;
+    char line[MAX_LINE];
+    while (fgets(line, sizeof line, f) && load_account_row(line)) {}
+    fclose(f);
+}
+
+/* acc_no|timestamp|type|amount|balance_after|note, newline-terminated;
+   returns the length written (truncated to fit) */
+static int format_transaction(char *line, size_t cap, const Transaction *t) {
+    int n = snprintf(line, cap, "%d|%s|%s|%.2f|%.2f|%s\n",
+        t->acc_no, t->timestamp, t->type, t->amount, t->balance_after, t->note);
+    if (n < 0 || (size_t)n >= cap) n = (int)strlen(line);
+    return n;
+}
+
+static void append_transaction(const Transaction *t) {
+    char line[MAX_LINE];
+    int n = format_transaction(line, sizeof line, t);
+    if (io_append(F_TRANSACTIONS, line, (size_t)n, 0) != 0) perror("append_transaction");
+}
+
+/* holdings */
+static void save_holdings(void) {
+    if (persist_deferred) { persist_dirty |= DIRTY_HOLDINGS; return; }
+    book_dirty |= DIRTY_HOLDINGS;
+    Snapshot snap;
+    FILE *f = NULL;
+    if (!kv.holds_book && !(f = snapshot_begin(&snap, "holdings.tmp", F_HOLDINGS, 0))) { perror("save_holdings fopen"); return; }
+    char row[MAX_LINE];
+    for (int i = 0; f && i < hold_count; ++i) {
+        format_holding_row(row, sizeof row, &holdings[i]);
+        fputs(row, f);
+    }
+    journal_holdings((long long)time(NULL), 1);
+    journal_flush();
+    if (f) snapshot_commit(&snap);
+    else kv_put_holdings(0);   /* the accounts whose holdings changed */
+}
+
+static void commit_begin(void) {
+    persist_deferred = 1;
+    io_group_begin();
+}
+
+/* state first (journal, then snapshots), then the ledger rows of the group,
+   the same order a single request writes them in */
+static void commit_end(void) {
+    persist_deferred = 0;
+    io_grouping = 0;
+    if (persist_dirty & DIRTY_ACCOUNTS) save_accounts();
+    if (persist_dirty & DIRTY_HOLDINGS) save_holdings();
+    persist_dirty = 0;
+    io_group_end();
+}
+
+/* one CF_HOLDINGS value: all rows of one account */
+static void kv_load_holdings(const char *val, uint32_t vlen, void *ctx) {
+    (void)vlen; (void)ctx;
+    for (const char *line = val; *line && hold_count < MAX_HOLDINGS; ) {
+        Holding h;
+        if (parse_holding_row(line, &h)) holdings[hold_count++] = h;
+        else fprintf(stderr, "kv: skipping holding row '%.40s'\n", line);
+        const char *nl = strchr(line, '\n');
+        line = nl ? nl + 1 : line + strlen(line);
+    }
+}
+
+static void load_holdings(void) {
+    hold_count = 0;
+    if (kv.holds_book) {
+        kv_scan(CF_HOLDINGS, kv_load_holdings, NULL);
+        journal_holdings(0, 0);
+        return;
+    }
+    FILE *f = fopen(F_HOLDINGS, "r");
+    if (!f) return;
+    char line[MAX_LINE];
+    while (hold_count < MAX_HOLDINGS && fgets(line, sizeof line, f)) {
+        Holding h;
+        if (parse_holding_row(line, &h)) holdings[hold_count++] = h;
+        else break;
+    }
+    fclose(f);
+    journal_holdings(0, 0);
+}
+
+/* prices (atomic) */
+static void save_prices(void) {
+    Snapshot snap;
+    FILE *f = snapshot_begin(&snap, "prices.tmp", F_PRICES, 0);
+    if (!f) { perror("save_prices fopen"); return; }
+    char row[MAX_LINE];
+    for (int i = 0; i < price_count; ++i) {
+        if (is_synthetic[i]) continue;
+        PriceRec *p = &prices[i];
+        int n = snprintf(row, sizeof row, "%s|%s|%.4f|%.6f|%s|%s|%d|%d\n",
+            p->asset_id, p->asset_name, p->price, p->vol, p->market, p->last_update, p->open_hour, p->close_hour);
+        fputs(row, f);
+        if (n > 0 && (size_t)n < sizeof row) kv_put(CF_PRICES, p->asset_id, row, (size_t)n - 1);
+    }
+    snapshot_commit(&snap);
+    kv_sync();
+    book_dirty |= DIRTY_PRICES;
+}
+
+static void load_prices(void) {
+    FILE *f = fopen(F_PRICES, "r");
+    memset(is_synthetic, 0, sizeof is_synthetic);
+    if (!f) { price_count = 0; rebuild_price_index(); return; }
+    price_count = 0;
+    while (!feof(f) && price_count < MAX_PRICES) {
+        PriceRec p;
+        int r = fscanf(f, "%15[^|]|%63[^|]|%lf|%lf|%7[^|]|%24[^|]|%d|%d\n",
+            p.asset_id, p.asset_name, &p.price, &p.vol, p.market, p.last_update, &p.open_hour, &p.close_hour);
+        if (r == 8) prices[price_count++] = p;
+        else break;
+    }
+    fclose(f);
+    rebuild_price_index();
+    refresh_all_price_inr();
+    publish_all_quotes();
+}
+
+/* another front end saved prices.txt: take its quotes without moving any
+   slot, since holdings, trades and baskets here point at them */
+static void refresh_prices(void) {
+    FILE *f = fopen(F_PRICES, "r");
+    if (!f) return;
+    int added = 0;
+    while (!feof(f)) {
+        PriceRec p;
+        int r = fscanf(f, "%15[^|]|%63[^|]|%lf|%lf|%7[^|]|%24[^|]|%d|%d\n",
+            p.asset_id, p.asset_name, &p.price, &p.vol, p.market, p.last_update, &p.open_hour, &p.close_hour);
+        if (r != 8) break;
+        int i = find_price_index_n(p.asset_id, strlen(p.asset_id));
+        if (i < 0) {
+            if (price_count >= MAX_PRICES) continue;
+            i = price_count++;
+            added = 1;
+        }
+        prices[i] = p;
+        is_synthetic[i] = 0;
+    }
+    fclose(f);
+    if (added) rebuild_price_index();
+    refresh_all_price_inr();
+    publish_all_quotes();
+}
+
+/* fx rates */
+static void save_fx(void) {
+    Snapshot snap;
+    FILE *f = snapshot_begin(&snap, "fx.tmp", F_FX, 0);
+    if (!f) { perror("save_fx fopen"); return; }
+    char row[MAX_LINE];
+    int n = snprintf(row, sizeof row, "%.6f|%.6f|%s", fx.inr_per_usd, fx.inr_per_eur, fx.last_update);
+    fprintf(f, "%s\n", row);
+    snapshot_commit(&snap);
+    if (n > 0) { kv_put(CF_FX, "fx", row, strlen(row)); kv_sync(); }
+    book_dirty |= DIRTY_PRICES;
+}
+
+static void load_fx(void) {
+    FILE *f = fopen(F_FX, "r");
+    if (!f) { /* defaults already set */ return; }
+    char last[25] = {0};
+    int r = fscanf(f, "%lf|%lf|%24[^\n]\n", &fx.inr_per_usd, &fx.inr_per_eur, last);
+    if (r == 3) strncpy(fx.last_update, last, sizeof fx.last_update - 1);
+    fclose(f);
+    refresh_all_price_inr();
+}
+
+/* BVDU_KV=<dir>: open the store before anything is loaded, since once it
+   holds the book accounts and holdings come from there. A store that cannot
+   be opened is fatal: the text files may be behind it. */
+static void kv_attach(const char *dir) {
+    if (!dir || !*dir) return;
+    if (kv_open(dir) != 0) { printf("Cannot open the KV store %s.\n", dir); exit(1); }
+    atexit(kv_close);
+}
+
+/* after the loads: on a new store copy the book in, once; from then on the
+   text files are not rewritten */
+static void kv_adopt_book(void) {
+    if (!kv.open) return;
+    if (!kv.holds_book) {
+        for (int i = 0; i < acc_count; ++i) kv_put_account(i);
+        kv_put_holdings(1);
+        kv_flush_memtables();
+        kv.holds_book = 1;
+        pthread_mutex_lock(&kv.lock);
+        kv_write_manifest();
+        pthread_mutex_unlock(&kv.lock);
+    }
+    save_prices();
+    save_fx();
+}
+
+/* --kv-get <dir> <family> <key> */
+static int kv_lookup(const char *dir, const char *family, const char *key) {
+    int cf = -1;
+    for (int c = 0; c < CF_COUNT; ++c) if (strcmp(family, CF_NAMES[c]) == 0) cf = c;
+    if (cf < 0) {
+        printf("Unknown family '%s'. Families:", family);
+        for (int c = 0; c < CF_COUNT; ++c) printf(" %s", CF_NAMES[c]);
+        printf("\n");
+        return 1;
+    }
+    kv_close();   /* the store BVDU_KV opened, if any */
+    if (kv_open(dir) != 0) return 1;
+    size_t n = 0;
+    char *v = kv_get(cf, key, &n);
+    if (v) { fwrite(v, 1, n, stdout); if (n && v[n - 1] != '\n') putchar('\n'); }
+    else printf("No key '%s' in %s.\n", key, family);
+    int runs = kv.cf[cf].nruns, found = v != NULL;
+    free(v);
+    kv_close();
+    printf("(%s: %d run(s))\n", family, runs);
+    return !found;
+}
+
+/* ---------------- Helper finders ---------------- */
+
+static int find_account_index(int acc_no) {
+    for (int i = 0; i < acc_count; ++i) if (accounts[i].acc_no == acc_no) return i;
+    return -1;
+}
+
+static int find_active_account_index(int acc_no) {
+    for (int i = 0; i < acc_count; ++i) if (accounts[i].acc_no == acc_no && accounts[i].active) return i;
+    return -1;
+}
+
+static int find_account_by_upi(const char *upi) {
+    for (int i = 0; i < acc_count; ++i) if (accounts[i].active && bvdu_stricmp(account_info[i].upi, upi) == 0) return i;
+    return -1;
+}
+
+static int find_price_index(const char *asset_id) {
+    return find_price_index_n(asset_id, strlen(asset_id));
+}
+
+static int find_holding_index(int acc_no, int asset) {
+    for (int i = 0; i < hold_count; ++i)
+        if (holdings[i].acc_no == acc_no && holdings[i].asset == asset) return i;
+    return -1;
+}
+
+/* ---------------- Daily interest accrual (lazy) ---------------- */
+
+/* Savings interest accrues daily on the balance but is only computed when an
+   account's cash moves or at month-end posting: each account carries the day
+   it is accrued through, and catching up is one multiply for any number of
+   days, because the balance was constant over them. */
+
+static double savings_rate_pct = 0.0;   /* annual, simple daily accrual on a 365-day year */
+static int interest_posted_month = 0;   /* year * 12 + month - 1 of the last posting, 0 = never */
+
+static int64_t today_day(void) {
+    return local_day((int64_t)time(NULL));
+}
+
+static int earns_interest(const Account *a) {
+    return a->active && a->type == ACC_SAVINGS;
+}
+
+/* interest earned between the account's last accrual and `day` */
+static double interest_pending(const Account *a, int64_t day) {
+    if (!earns_interest(a) || a->last_accrual <= 0 || day <= a->last_accrual || a->balance <= 0.0) return 0.0;
+    return a->balance * (savings_rate_pct / 100.0 / 365.0) * (double)(day - a->last_accrual);
+}
+
+static void accrue_interest(Account *a, int64_t day) {
+    if (a->last_accrual <= 0) { a->last_accrual = day; return; }
+    if (day <= a->last_accrual) return;
+    a->accrued += interest_pending(a, day);
+    a->last_accrual = day;
+}
+
+/* ---------------- Bank-wide aggregates ---------------- */
+
+/* Running totals are adjusted at each mutation (account_credit, holding_units_changed,
+   set_asset_price) and checked against a full scan every TOTALS_VERIFY_EVERY
+   mutations and whenever an admin views them. */
+
+#define TOTALS_VERIFY_EVERY 1024
+
+/* add (sign 1) or remove (sign -1) one account's contribution */
+static void totals_account(const Account *a, double sign) {
+    if (!a->active) return;
+    totals.accounts += (int)sign;
+    totals.deposits += sign * a->balance;
+    totals.by_type[a->type] += sign * a->balance;
+    totals.loans += sign * a->loan;
+}
+
+static void totals_scan(BankTotals *t, double *units) {
+    memset(t, 0, sizeof *t);
+    for (int i = 0; i < acc_count; ++i) {
+        const Account *a = &accounts[i];
+        if (!a->active) continue;
+        t->accounts++;
+        t->deposits += a->balance;
+        t->by_type[a->type] += a->balance;
+        t->loans += a->loan;
+    }
+    for (int i = 0; i < price_count; ++i) units[i] = 0.0;
+    for (int i = 0; i < hold_count; ++i) units[holdings[i].asset] += holdings[i].qty;
+    for (int i = 0; i < price_count; ++i) t->aum_inr[market_index(prices[i].market)] += units[i] * price_inr_cache[i];
+}
+
+static void totals_rebuild(void) {
+    totals_scan(&totals, asset_units);
+    totals_mutations = 0;
+}
+
+static int totals_differ(double incr, double full) {
+    return fabs(incr - full) > 0.005 + 1e-9 * fabs(full);
+}
+
+/* full recompute; drift is logged and the scanned values adopted. Returns fields that drifted. */
+static int totals_verify(void) {
+    static double units[MAX_PRICES];
+    BankTotals full;
+    totals_scan(&full, units);
+    const char *names[3 + ACC_TYPE_COUNT + MKT_COUNT];
+    double incr[3 + ACC_TYPE_COUNT + MKT_COUNT], want[3 + ACC_TYPE_COUNT + MKT_COUNT];
+    int n = 0;
+    names[n] = "accounts"; incr[n] = totals.accounts; want[n++] = full.accounts;
+    names[n] = "deposits"; incr[n] = totals.deposits; want[n++] = full.deposits;
+    names[n] = "loans"; incr[n] = totals.loans; want[n++] = full.loans;
+    for (int k = 0; k < ACC_TYPE_COUNT; ++k) { names[n] = ACC_TYPE_NAMES[k]; incr[n] = totals.by_type[k]; want[n++] = full.by_type[k]; }
+    for (int m = 0; m < MKT_COUNT; ++m) { names[n] = MARKET_NAMES[m]; incr[n] = totals.aum_inr[m]; want[n++] = full.aum_inr[m]; }
+    int drift = 0;
+    for (int k = 0; k < n; ++k) {
+        if (!totals_differ(incr[k], want[k])) continue;
+        char entry[128];
+        snprintf(entry, sizeof entry, "TOTALS_DRIFT|%s|%.4f|%.4f", names[k], incr[k], want[k]);
+        audit_log(entry);
+        drift++;
+    }
+    totals = full;
+    memcpy(asset_units, units, (size_t)price_count * sizeof *units);
+    totals_mutations = 0;
+    return drift;
+}
+
+static void totals_mutated(void) {
+    if (++totals_mutations >= TOTALS_VERIFY_EVERY) totals_verify();
+}
+
+static void account_apply_cash(int idx, double delta) {
+    Account *a = &accounts[idx];
+    a->balance += delta;
+    if (a->active) {
+        totals.deposits += delta;
+        totals.by_type[a->type] += delta;
+    }
+    totals_mutated();
+}
+
+/* every cash movement on an account goes through here; interest is brought
+   up to date first so the old balance earns until today */
+static void account_credit(int idx, double delta) {
+    accrue_interest(&accounts[idx], today_day());
+    account_apply_cash(idx, delta);
+}
+
+/* ---------------- Hot accounts: striped credits (hot_accounts.txt) ---------------- */
+
+/* A merchant UPI that many payers hit at once turns its one balance field into
+   a lock every credit queues on. Accounts listed in hot_accounts.txt (one
+   acc_no per line) take incoming credits on HOT_STRIPES per-thread counters
+   instead, each on its own cache line, so crediters never touch the same
+   memory. The counters are folded into the balance by the owning thread on
+   save and before the balance is read for a debit. Debits check only the
+   folded balance, so unfolded credits can delay a debit but never overdraw. */
+
+#define HOT_STRIPES 16
+#define MAX_HOT_ACCOUNTS 32
+
+typedef struct { _Alignas(64) _Atomic int64_t paise; } HotStripe;
+
+typedef struct {
+    int idx;                      /* accounts[] slot */
+    int acc_no;                   /* finds the slot again if the shared book moved it */
+    HotStripe stripe[HOT_STRIPES];
+} HotAccount;
+
+static HotAccount hot_accounts[MAX_HOT_ACCOUNTS];
+static int hot_count;
+static signed char hot_slot[MAX_ACCOUNTS]; /* accounts[] slot -> hot_accounts[] slot + 1, 0 = not hot */
+
+/* lock-free credit, safe from any thread; each thread keeps to one stripe */
+static void hot_credit(HotAccount *h, double amount) {
+    static _Atomic unsigned next_stripe;
+    static _Thread_local int mine = -1;
+    if (mine < 0) mine = (int)(atomic_fetch_add_explicit(&next_stripe, 1, memory_order_relaxed) % HOT_STRIPES);
+    int64_t paise = (int64_t)(amount * 100.0 + (amount < 0 ? -0.5 : 0.5));
+    atomic_fetch_add_explicit(&h->stripe[mine].paise, paise, memory_order_relaxed);
+}
+
+/* empty the stripes; the caller owns the paise returned */
+static int64_t hot_drain_stripes(HotAccount *h) {
+    int64_t sum = 0;
+    for (int k = 0; k < HOT_STRIPES; ++k) sum += atomic_exchange_explicit(&h->stripe[k].paise, 0, memory_order_acquire);
+    return sum;
+}
+
+static int64_t hot_drain(int idx) {
+    return hot_slot[idx] ? hot_drain_stripes(&hot_accounts[hot_slot[idx] - 1]) : 0;
+}
+
+/* drain the stripes into the balance (owner thread only) */
+static void hot_fold(int idx) {
+    int64_t sum = hot_drain(idx);
+    if (sum) account_credit(idx, (double)sum / 100.0);
+}
+
+static void hot_fold_all(void) {
+    for (int i = 0; i < hot_count; ++i) hot_fold(hot_accounts[i].idx);
+}
+
+/* incoming money: striped for hot accounts, straight to the balance otherwise */
+static void account_receive(int idx, double amount) {
+    if (hot_slot[idx]) hot_credit(&hot_accounts[hot_slot[idx] - 1], amount);
+    else account_credit(idx, amount);
+}
+
+/* balance a debit may spend: fold what has arrived so far, then read */
+static double account_available(int idx) {
+    hot_fold(idx);
+    return accounts[idx].balance;
+}
+
+static int set_hot_account(int idx, int hot) {
+    if (!hot == !hot_slot[idx]) return 0;
+    if (hot) {
+        if (hot_count >= MAX_HOT_ACCOUNTS) return -1;
+        memset(&hot_accounts[hot_count], 0, sizeof hot_accounts[hot_count]);
+        hot_accounts[hot_count].idx = idx;
+        hot_accounts[hot_count].acc_no = accounts[idx].acc_no;
+        hot_slot[idx] = (signed char)++hot_count;
+        return 0;
+    }
+    hot_fold(idx);
+    int s = hot_slot[idx] - 1;
+    hot_slot[idx] = 0;
+    if (s != --hot_count) { /* stripes are drained, so moving the last one down is safe */
+        hot_accounts[s].idx = hot_accounts[hot_count].idx;
+        hot_accounts[s].acc_no = hot_accounts[hot_count].acc_no;
+        hot_slot[hot_accounts[s].idx] = (signed char)(s + 1);
+    }
+    return 0;
+}
+
+static void save_hot_accounts(void) {
+    FILE *f = fopen(F_HOT_ACCOUNTS, "w");
+    if (!f) { perror("save_hot_accounts fopen"); return; }
+    for (int i = 0; i < hot_count; ++i) fprintf(f, "%d\n", hot_accounts[i].acc_no);
+    fclose(f);
+    book_dirty |= DIRTY_HOT;
+}
+
+static void load_hot_accounts(void) {
+    FILE *f = fopen(F_HOT_ACCOUNTS, "r");
+    if (!f) return;
+    char line[64];
+    while (fgets(line, sizeof line, f)) {
+        int idx = find_account_index(atoi(line));
+        if (idx >= 0 && set_hot_account(idx, 1) < 0) break;
+    }
+    fclose(f);
+}
+
+/* the shared book changed under this process: its slots may have moved and
+   hot_accounts.txt may list a different set. Credits this process striped
+   are folded by account number, then the set is read again. */
+static void hot_reload(void) {
+    int n = hot_count, acc_no[MAX_HOT_ACCOUNTS];
+    int64_t pending[MAX_HOT_ACCOUNTS];
+    for (int i = 0; i < n; ++i) {
+        acc_no[i] = hot_accounts[i].acc_no;
+        pending[i] = hot_drain_stripes(&hot_accounts[i]);
+    }
+    memset(hot_slot, 0, sizeof hot_slot);
+    hot_count = 0;
+    for (int i = 0; i < n; ++i) {
+        int idx = pending[i] ? find_account_index(acc_no[i]) : -1;
+        if (idx >= 0) account_credit(idx, (double)pending[i] / 100.0);
+    }
+    load_hot_accounts();
+}
+
+/* ---------------- Idempotency keys (journal.txt K records) ---------------- */
+
+/* A client that retries a payment after a timeout sends the same key again.
+   The first completed request stores its result under (acc_no, key); a
+   repeat within IDEM_TTL gets that result back without touching any balance.
+   Only requests that changed state are remembered: a refused request did
+   nothing, so running it again is already safe. The entry goes into the
+   change journal in the same flush as the account rows it produced,
+     epoch|K|acc_no|key|result
+   so after a crash either both the payment and its key survive or neither. */
+
+#define IDEM_SLOTS 4096          /* initial size; open addressing, kept at most half full */
+#define IDEM_TTL (24 * 3600)
+#define IDEM_KEY_MAX 40
+#define IDEM_RESULT_MAX 192
+
+typedef struct {
+    char key[IDEM_KEY_MAX];      /* "" = empty slot */
+    int acc_no;
+    long long at;                /* epoch the request completed */
+    char result[IDEM_RESULT_MAX];
+} IdemEntry;
+
+static IdemEntry *idem;
+static unsigned idem_mask;       /* slots - 1 */
+static int idem_used;
+
+static unsigned idem_hash(int acc_no, const char *key) {
+    return (unsigned)row_hash(key, strlen(key), ROW_HASH_INIT ^ (uint64_t)(unsigned)acc_no) & idem_mask;
+}
+
+/* keys are 1-39 printable characters without '|' */
+static int idem_key_valid(const char *key) {
+    size_t n = strlen(key);
+    if (n == 0 || n >= IDEM_KEY_MAX) return 0;
+    for (size_t i = 0; i < n; ++i) if (key[i] == '|' || key[i] <= ' ' || key[i] > '~') return 0;
+    return 1;
+}
+
+static IdemEntry *idem_find(int acc_no, const char *key) {
+    if (!idem) return NULL;
+    long long now = (long long)time(NULL);
+    for (unsigned h = idem_hash(acc_no, key); idem[h].key[0]; h = (h + 1) & idem_mask)
+        if (idem[h].acc_no == acc_no && strcmp(idem[h].key, key) == 0) return now - idem[h].at < IDEM_TTL ? &idem[h] : NULL;
+    return NULL;
+}
+
+/* rehash into `slots` slots without entries older than `cutoff` */
+static void idem_rebuild(unsigned slots, long long cutoff) {
+    IdemEntry *old = idem;
+    unsigned old_slots = idem ? idem_mask + 1 : 0;
+    IdemEntry *fresh = calloc(slots, sizeof *fresh);
+    if (!fresh) { perror("idem_rebuild"); exit(1); }
+    idem = fresh;
+    idem_mask = slots - 1;
+    idem_used = 0;
+    for (unsigned i = 0; i < old_slots; ++i) {
+        if (!old[i].key[0] || old[i].at < cutoff) continue;
+        unsigned h = idem_hash(old[i].acc_no, old[i].key);
+        while (idem[h].key[0]) h = (h + 1) & idem_mask;
+        idem[h] = old[i];
+        idem_used++;
+    }
+    free(old);
+}
+
+/* Expired keys are dropped on the way; live keys are never evicted - a
+   table full of live keys doubles instead. */
+static void idem_insert(int acc_no, const char *key, long long at, const char *result) {
+    if (!idem) idem_rebuild(IDEM_SLOTS, 0);
+    if ((unsigned)idem_used >= (idem_mask + 1) / 2) {
+        long long now = (long long)time(NULL);
+        unsigned slots = idem_mask + 1;
+        int live = 0;
+        for (unsigned i = 0; i < slots; ++i) live += idem[i].key[0] && idem[i].at >= now - IDEM_TTL;
+        while ((unsigned)live >= slots / 4) slots *= 2;   /* leave room to fill before the next rehash */
+        idem_rebuild(slots, now - IDEM_TTL);
+    }
+    unsigned h = idem_hash(acc_no, key);
+    while (idem[h].key[0] && !(idem[h].acc_no == acc_no && strcmp(idem[h].key, key) == 0)) h = (h + 1) & idem_mask;
+    if (!idem[h].key[0]) idem_used++;
+    IdemEntry *e = &idem[h];
+    snprintf(e->key, sizeof e->key, "%s", key);
+    e->acc_no = acc_no;
+    e->at = at;
+    snprintf(e->result, sizeof e->result, "%s", result);
+}
+
+/* remember a completed request; the caller's next save_accounts() flushes it */
+static void idem_remember(int acc_no, const char *key, const char *result) {
+    if (!key) return;
+    long long now = (long long)time(NULL);
+    idem_insert(acc_no, key, now, result);
+    char flat[IDEM_RESULT_MAX];
+    snprintf(flat, sizeof flat, "%s", result);
+    for (char *c = flat; *c; ++c) if (*c == '\n') *c = '\t';   /* one journal line per record */
+    ob_printf(&journal_out, "%lld|K|%d|%s|%s\n", now, acc_no, key, flat);
+    book_dirty |= DIRTY_IDEM;
+}
+
+/* a repeat: hand back the stored result. Returns 1 if key was seen. */
+static int idem_replay(int acc_no, const char *key, char *out, size_t outlen) {
+    if (!key) return 0;
+    const IdemEntry *e = idem_find(acc_no, key);
+    if (!e) return 0;
+    snprintf(out, outlen, "%s", e->result);
+    return 1;
+}
+
+static long idem_journal_end;     /* journal bytes already scanned for K records */
+
+/* insert the live K records from journal offset off to its last whole line */
+static void idem_scan(long off) {
+    long long since = (long long)time(NULL) - IDEM_TTL;
+    char line[MAX_LINE];
+    FILE *f = fopen(F_JOURNAL, "r");
+    if (!f) return;
+    fseek(f, off, SEEK_SET);
+    idem_journal_end = off;
+    while (fgets(line, sizeof line, f)) {
+        if (!strchr(line, '\n') && feof(f)) break;   /* still being written: the next scan takes it */
+        idem_journal_end = ftell(f);
+        char *p = strchr(line, '|');
+        if (!p || p[1] != 'K' || p[2] != '|' || atoll(line) < since) continue;
+        trim_newline(line);
+        int acc_no = atoi(p + 3);
+        char *key = strchr(p + 3, '|');
+        char *res = key ? strchr(++key, '|') : NULL;
+        if (!res) continue;
+        *res++ = '\0';
+        for (char *c = res; *c; ++c) if (*c == '\t') *c = '\n';
+        idem_insert(acc_no, key, atoll(line), res);
+    }
+    fclose(f);
+}
+
+/* rebuild the table from K records no older than IDEM_TTL, starting at the
+   newest recovery checkpoint taken before that window opened */
+static void load_idempotency(void) {
+    long long since = (long long)time(NULL) - IDEM_TTL, e;
+    long off = 0, o;
+    char line[MAX_LINE];
+    FILE *f = fopen(F_PITR_CATALOG, "r");
+    if (f) {
+        while (fgets(line, sizeof line, f))
+            if (sscanf(line, "%lld|%ld", &e, &o) == 2 && e <= since && o > off) off = o;
+        fclose(f);
+    }
+    idem_scan(off);
+}
+
+/* a holding of prices[p] grew (dq > 0) or shrank by dq units */
+static void holding_units_changed(int p, double dq) {
+    asset_units[p] += dq;
+    totals.aum_inr[market_index(prices[p].market)] += dq * price_inr_cache[p];
+    totals_mutated();
+}
+
+static void print_bank_totals(void) {
+    double aum = 0.0;
+    for (int m = 0; m < MKT_COUNT; ++m) aum += totals.aum_inr[m];
+    printf("Active accounts: %d\n", totals.accounts);
+    printf("Total deposits:  %.2f INR (Savings %.2f, Current %.2f, Other %.2f)\n",
+        totals.deposits, totals.by_type[ACC_SAVINGS], totals.by_type[ACC_CURRENT], totals.by_type[ACC_OTHER]);
+    printf("Loan book:       %.2f INR\n", totals.loans);
+    printf("AUM:             %.2f INR (IN %.2f, US %.2f, EU %.2f)\n",
+        aum, totals.aum_inr[MKT_IN], totals.aum_inr[MKT_US], totals.aum_inr[MKT_EU]);
+}
+
+/* Prometheus text format, for ./bvdu_bank --metrics */
+static void write_metrics(FILE *out) {
+    fprintf(out, "# TYPE bvdu_accounts_active gauge\nbvdu_accounts_active %d\n", totals.accounts);
+    fprintf(out, "# TYPE bvdu_deposits_inr gauge\n");
+    for (int k = 0; k < ACC_TYPE_COUNT; ++k)
+        fprintf(out, "bvdu_deposits_inr{type=\"%s\"} %.2f\n", ACC_TYPE_NAMES[k], totals.by_type[k]);
+    fprintf(out, "# TYPE bvdu_loans_inr gauge\nbvdu_loans_inr %.2f\n", totals.loans);
+    fprintf(out, "# TYPE bvdu_aum_inr gauge\n");
+    for (int m = 0; m < MKT_COUNT; ++m)
+        fprintf(out, "bvdu_aum_inr{market=\"%s\"} %.2f\n", MARKET_NAMES[m], totals.aum_inr[m]);
+}
+
+/* ---------------- Basket / index instruments (baskets.txt) ---------------- */
+
+/* baskets.txt: basket_id|name|market|open_hour|close_hour|ASSET:weight,ASSET:weight,...
+   A basket lives in prices[] like any asset (so it trades through the normal
+   buy/sell path); its price is the weighted sum of its constituents, converted
+   from INR into the basket's market currency. */
+
+static int cmp_basket_entry(const void *x, const void *y) {
+    const BasketEntry *a = x, *b = y;
+    return a->constituent - b->constituent;
+}
+
+/* full recompute of every NAV from the constituent valuation cache */
+static void recompute_all_basket_navs(void) {
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    for (int i = 0; i < price_count; ++i) if (is_basket[i]) basket_nav_inr[i] = 0.0;
+    for (int e = 0; e < basket_entry_count; ++e)
+        basket_nav_inr[basket_entries[e].basket] += basket_entries[e].weight * price_inr_cache[basket_entries[e].constituent];
+    for (int i = 0; i < price_count; ++i)
+        if (is_basket[i]) set_asset_price(i, basket_nav_inr[i] / fx_factor(prices[i].market), ts);
+}
+
+/* group entries by constituent so a tick finds its baskets in one slice */
+static void rebuild_basket_links(void) {
+    qsort(basket_entries, (size_t)basket_entry_count, sizeof *basket_entries, cmp_basket_entry);
+    memset(basket_link_start, 0, sizeof basket_link_start);
+    for (int e = 0; e < basket_entry_count; ++e) basket_link_start[basket_entries[e].constituent + 1]++;
+    for (int i = 0; i < MAX_PRICES; ++i) basket_link_start[i + 1] += basket_link_start[i];
+}
+
+/* register a basket over existing assets; returns its prices[] slot or -1 */
+static int add_basket(const char *id, const char *name, const char *market, int open_hour, int close_hour, char *spec) {
+    int b = find_price_index(id);
+    if (b < 0) {
+        if (price_count >= MAX_PRICES) return -1;
+        b = price_count++;
+        PriceRec *p = &prices[b];
+        memset(p, 0, sizeof *p);
+        strncpy(p->asset_id, id, sizeof p->asset_id - 1);
+        p->vol = 0.0;
+        rebuild_price_index();
+    }
+    PriceRec *p = &prices[b];
+    strncpy(p->asset_name, name, sizeof p->asset_name - 1);
+    strncpy(p->market, market, sizeof p->market - 1);
+    p->open_hour = open_hour;
+    p->close_hour = close_hour;
+    is_basket[b] = 1;
+    for (char *tok = strtok(spec, ","); tok; tok = strtok(NULL, ",")) {
+        char *colon = strchr(tok, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        int c = find_price_index(tok);
+        if (c < 0 || is_basket[c]) { printf("Warning: basket %s: skipping constituent '%s'.\n", id, tok); continue; }
+        if (basket_entry_count == basket_entry_cap) {
+            int ncap = basket_entry_cap ? basket_entry_cap * 2 : 256;
+            BasketEntry *ne = realloc(basket_entries, (size_t)ncap * sizeof *ne);
+            if (!ne) { perror("add_basket"); exit(1); }
+            basket_entries = ne; basket_entry_cap = ncap;
+        }
+        BasketEntry *e = &basket_entries[basket_entry_count++];
+        e->basket = b;
+        e->constituent = c;
+        e->weight = atof(colon + 1);
+    }
+    return b;
+}
+
+static void load_baskets(void) {
+    FILE *f = fopen(F_BASKETS, "r");
+    if (!f) return;
+    char line[MAX_LINE * 4];
+    while (fgets(line, sizeof line, f)) {
+        trim_newline(line);
+        if (!line[0] || line[0] == '#') continue;
+        char id[16], name[64], market[8];
+        int oh, ch, off = 0;
+        if (sscanf(line, "%15[^|]|%63[^|]|%7[^|]|%d|%d|%n", id, name, market, &oh, &ch, &off) != 5 || off == 0) {
+            printf("Warning: ignoring basket line '%s'.\n", line);
+            continue;
+        }
+        if (add_basket(id, name, market, oh, ch, line + off) < 0) printf("Warning: price table full, basket %s skipped.\n", id);
+    }
+    fclose(f);
+    rebuild_basket_links();
+    refresh_all_price_inr();
+    recompute_all_basket_navs();
+}
+
+/* ---------------- Transaction logging ---------------- */
+
+static void log_transaction(int acc_no, const char *type, double amount, double balance_after, const char *note) {
+    Transaction t;
+    t.acc_no = acc_no;
+    get_timestamp(t.timestamp, sizeof t.timestamp);
+    strncpy(t.type, type, sizeof t.type - 1); t.type[sizeof t.type - 1] = '\0';
+    t.amount = amount;
+    t.balance_after = balance_after;
+    strncpy(t.note, note, sizeof t.note - 1); t.note[sizeof t.note - 1] = '\0';
+    append_transaction(&t);
+}
+
+/* ---------------- Monthly interest posting (interest.txt) ---------------- */
+
+/* interest.txt: annual_rate_pct|YYYY-MM of the last posting */
+static void save_interest(void) {
+    FILE *f = fopen(F_INTEREST, "w");
+    if (!f) { perror("save_interest fopen"); return; }
+    fprintf(f, "%.4f|%04d-%02d\n", savings_rate_pct, interest_posted_month / 12, interest_posted_month % 12 + 1);
+    fclose(f);
+    book_dirty |= DIRTY_INTEREST;
+}
+
+static void load_interest(void) {
+    FILE *f = fopen(F_INTEREST, "r");
+    if (!f) return;
+    int y = 0, m = 0;
+    if (fscanf(f, "%lf|%d-%d", &savings_rate_pct, &y, &m) == 3 && y > 0 && m >= 1 && m <= 12)
+        interest_posted_month = y * 12 + m - 1;
+    fclose(f);
+}
+
+/* On the first run in a new month, accrue every account to the 1st and move
+   whole paise of accrued interest into the balance; the remainder stays
+   accrued. Returns the number of accounts credited. */
+static int post_monthly_interest(void) {
+    time_t now = time(NULL);
+    struct tm *tm = localtime(&now);
+    if (!tm) return 0;
+    int month = (tm->tm_year + 1900) * 12 + tm->tm_mon;
+    if (month <= interest_posted_month) return 0;
+    int first_run = interest_posted_month == 0;
+    interest_posted_month = month;
+    save_interest();
+    if (first_run) return 0;
+
+    int64_t boundary = days_from_civil(tm->tm_year + 1900, tm->tm_mon + 1, 1);
+    int posted = 0;
+    double total = 0.0;
+    for (int i = 0; i < acc_count; ++i) {
+        Account *a = &accounts[i];
+        accrue_interest(a, boundary);
+        double amt = floor(a->accrued * 100.0 + 1e-6) / 100.0; /* whole paise, robust to 29.9999... */
+        if (amt < 0.01) continue;
+        a->accrued -= amt;
+        account_apply_cash(i, amt); /* credited as of the 1st: accrual from here uses the new balance */
+        char note[80];
+        snprintf(note, sizeof note, "Interest %.2f%% p.a. to %04d-%02d-01", savings_rate_pct, month / 12, month % 12 + 1);
+        log_transaction(a->acc_no, "INTEREST", amt, a->balance, note);
+        posted++;
+        total += amt;
+    }
+    save_accounts();
+    char audit[96];
+    snprintf(audit, sizeof audit, "INTEREST_POSTED|%04d-%02d|%d|%.2f", month / 12, month % 12 + 1, posted, total);
+    audit_log(audit);
+    return posted;
+}
+
+/* a rate change first accrues everyone at the old rate */
+static void set_savings_rate(double rate) {
+    int64_t day = today_day();
+    for (int i = 0; i < acc_count; ++i) accrue_interest(&accounts[i], day);
+    savings_rate_pct = rate;
+    save_accounts();
+    save_interest();
+}
+
+/* ---------------- Trade journal (trades.dat) ---------------- */
+
+/* Fixed-size binary trade records behind a small header. Every trade is kept
+   in memory and chained newest-first per account and per asset, so a
+   blotter query touches only that account's (or asset's) trades. */
+
+#define TRADE_MAGIC "BVDUTRD1"
+#define TRADE_VERSION 2           /* v2 appended fees_inr */
+#define TRADE_V1_REC_SIZE 72
+
+typedef struct {
+    char magic[8];
+    int32_t version;
+    int32_t rec_size;
+} TradeFileHeader;
+
+typedef struct {
+    int64_t trade_id;
+    int64_t ts;           /* epoch seconds */
+    int32_t acc_no;
+    int32_t side;         /* 'B' buy, 'S' sell */
+    char asset_id[16];
+    double qty;
+    double price;         /* native currency per unit */
+    double fx_rate;       /* INR per unit of native currency */
+    double amount_inr;    /* qty * price * fx_rate */
+    double fees_inr;      /* brokerage + levies + FX spread charged */
+} TradeRec;
+
+static TradeRec *trades = NULL;
+static int trade_count = 0, trade_cap = 0;
+static int *trade_prev_acc = NULL;    /* previous trade of the same account, -1 = none */
+static int *trade_prev_asset = NULL;  /* previous trade of the same asset, -1 = none */
+static int trade_asset_head[MAX_PRICES];
+
+/* acc_no -> newest trade index (open addressing) */
+static int *trade_acc_key = NULL, *trade_acc_head = NULL;
+static int *trade_acc_month = NULL;        /* yyyymm of trade_acc_volume */
+static double *trade_acc_volume = NULL;    /* traded value this month, INR (fee tiers) */
+static unsigned trade_acc_mask = 0, trade_acc_used = 0;
+
+static int month_of(int64_t ts) {
+    time_t t = (time_t)ts;
+    struct tm *tm = localtime(&t);
+    return tm ? (tm->tm_year + 1900) * 100 + tm->tm_mon + 1 : 0;
+}
+
+/* move the acc_no table to size slots; history keeps every acc_no ever
+   traded (archived and closed ones too), so it grows past MAX_ACCOUNTS */
+static void trade_acc_rehash(unsigned size) {
+    int *key = malloc(size * sizeof *key), *head = malloc(size * sizeof *head);
+    int *month = calloc(size, sizeof *month);
+    double *volume = calloc(size, sizeof *volume);
+    if (!key || !head || !month || !volume) { perror("trade_acc_rehash"); exit(1); }
+    for (unsigned i = 0; i < size; ++i) { key[i] = 0; head[i] = -1; }
+    for (unsigned i = 0; trade_acc_key && i <= trade_acc_mask; ++i) {
+        if (!trade_acc_key[i]) continue;
+        unsigned h = ((unsigned)trade_acc_key[i] * 2654435761u) & (size - 1);
+        while (key[h]) h = (h + 1) & (size - 1);
+        key[h] = trade_acc_key[i]; head[h] = trade_acc_head[i];
+        month[h] = trade_acc_month[i]; volume[h] = trade_acc_volume[i];
+    }
+    free(trade_acc_key); free(trade_acc_head); free(trade_acc_month); free(trade_acc_volume);
+    trade_acc_key = key; trade_acc_head = head; trade_acc_month = month; trade_acc_volume = volume;
+    trade_acc_mask = size - 1;
+}
+
+/* (re)start an empty history; the shared book reloads it this way */
+static void trade_index_init(void) {
+    free(trade_acc_key); free(trade_acc_head); free(trade_acc_month); free(trade_acc_volume);
+    trade_acc_key = NULL;
+    trade_count = 0;
+    trade_acc_used = 0;
+    unsigned size = 1024;
+    while (size < 2u * MAX_ACCOUNTS) size <<= 1;
+    trade_acc_rehash(size);
+    for (int i = 0; i < MAX_PRICES; ++i) trade_asset_head[i] = -1;
+}
+
+/* kept at most half full, so probes stay short and always end */
+static int *trade_acc_slot(int acc_no) {
+    if (trade_acc_used * 2 >= trade_acc_mask + 1) trade_acc_rehash((trade_acc_mask + 1) * 2);
+    unsigned h = ((unsigned)acc_no * 2654435761u) & trade_acc_mask;
+    while (trade_acc_key[h] != 0 && trade_acc_key[h] != acc_no) h = (h + 1) & trade_acc_mask;
+    if (!trade_acc_key[h]) { trade_acc_key[h] = acc_no; trade_acc_used++; }
+    return &trade_acc_head[h];
+}
+
+static int trade_acc_find(int acc_no) {
+    unsigned h = ((unsigned)acc_no * 2654435761u) & trade_acc_mask;
+    while (trade_acc_key[h] != 0) {
+        if (trade_acc_key[h] == acc_no) return (int)h;
+        h = (h + 1) & trade_acc_mask;
+    }
+    return -1;
+}
+
+static int trade_newest_for_account(int acc_no) {
+    int h = trade_acc_find(acc_no);
+    return h >= 0 ? trade_acc_head[h] : -1;
+}
+
+/* value the account has traded so far in the current month (INR) */
+static double account_month_volume(int acc_no) {
+    int h = trade_acc_find(acc_no);
+    if (h < 0 || trade_acc_month[h] != month_of((int64_t)time(NULL))) return 0.0;
+    return trade_acc_volume[h];
+}
+
+/* add to memory and link into both indexes */
+static void trade_index_add(const TradeRec *t) {
+    if (trade_count == trade_cap) {
+        int ncap = trade_cap ? trade_cap * 2 : 1024;
+        TradeRec *nt = realloc(trades, (size_t)ncap * sizeof *nt);
+        int *na = realloc(trade_prev_acc, (size_t)ncap * sizeof *na);
+        int *ns = realloc(trade_prev_asset, (size_t)ncap * sizeof *ns);
+        if (!nt || !na || !ns) { perror("trade_index_add"); exit(1); }
+        trades = nt; trade_prev_acc = na; trade_prev_asset = ns; trade_cap = ncap;
+    }
+    int k = trade_count++;
+    trades[k] = *t;
+    int *head = trade_acc_slot(t->acc_no);
+    trade_prev_acc[k] = *head;
+    *head = k;
+    size_t h = (size_t)(head - trade_acc_head);
+    int month = month_of(t->ts);
+    if (trade_acc_month[h] != month) { trade_acc_month[h] = month; trade_acc_volume[h] = 0.0; }
+    trade_acc_volume[h] += t->amount_inr;
+    int pidx = find_price_index(t->asset_id);
+    if (pidx >= 0) {
+        trade_prev_asset[k] = trade_asset_head[pidx];
+        trade_asset_head[pidx] = k;
+    } else trade_prev_asset[k] = -1;
+}
+
+static void fill_trade_header(TradeFileHeader *hdr) {
+    memset(hdr, 0, sizeof *hdr);
+    memcpy(hdr->magic, TRADE_MAGIC, 8);
+    hdr->version = TRADE_VERSION;
+    hdr->rec_size = (int32_t)sizeof(TradeRec);
+}
+
+static void write_trade_header(FILE *f) {
+    TradeFileHeader hdr;
+    fill_trade_header(&hdr);
+    fwrite(&hdr, sizeof hdr, 1, f);
+}
+
+/* rewrite trades.dat in the current record format */
+static void save_trades(void) {
+    Snapshot snap;
+    FILE *f = snapshot_begin(&snap, "trades.tmp", F_TRADES, 1);
+    if (!f) { perror("save_trades fopen"); return; }
+    write_trade_header(f);
+    fwrite(trades, sizeof *trades, (size_t)trade_count, f);
+    snapshot_commit(&snap);
+    book_dirty |= DIRTY_TRADES;
+}
+
+static void load_trades(void) {
+    trade_index_init();
+    FILE *f = fopen(F_TRADES, "rb");
+    if (!f) return;
+    TradeFileHeader hdr;
+    int ok = fread(&hdr, sizeof hdr, 1, f) == 1 && memcmp(hdr.magic, TRADE_MAGIC, 8) == 0;
+    int v1 = ok && hdr.version == 1 && hdr.rec_size == TRADE_V1_REC_SIZE;
+    if (!ok || (!v1 && (hdr.version != TRADE_VERSION || hdr.rec_size != (int32_t)sizeof(TradeRec)))) {
+        printf("Warning: %s has an unknown format; trade history not loaded.\n", F_TRADES);
+        fclose(f);
+        return;
+    }
+    TradeRec t;
+    memset(&t, 0, sizeof t);
+    while (fread(&t, (size_t)hdr.rec_size, 1, f) == 1) trade_index_add(&t);
+    fclose(f);
+    if (v1) save_trades(); /* upgrade in place so appends stay uniform */
+}
+
+/* append one trade to trades.dat (header written on first use) and index it */
+static void unsettled_add(const TradeRec *t, double sign);
+
+static void record_trade(int acc_no, char side, const PriceRec *p, double qty, double amount_inr, double fees_inr) {
+    TradeRec t;
+    memset(&t, 0, sizeof t);
+    t.trade_id = trade_count ? trades[trade_count - 1].trade_id + 1 : 1;
+    t.ts = (int64_t)time(NULL);
+    t.acc_no = acc_no;
+    t.side = side;
+    strncpy(t.asset_id, p->asset_id, sizeof t.asset_id - 1);
+    t.qty = qty;
+    t.price = p->price;
+    t.fx_rate = fx_factor(p->market);
+    t.amount_inr = amount_inr;
+    t.fees_inr = fees_inr;
+    if (io_file_size(F_TRADES) == 0) {
+        TradeFileHeader hdr;
+        fill_trade_header(&hdr);
+        io_append(F_TRADES, &hdr, sizeof hdr, 1);
+    }
+    if (io_append(F_TRADES, &t, sizeof t, 1) != 0) { perror("record_trade"); return; }
+    book_dirty |= DIRTY_TRADES;
+    trade_index_add(&t);
+    unsettled_add(&t, 1.0);
+}
+
+static void print_trade_row(OutBuf *ob, const TradeRec *t) {
+    char ts[25];
+    time_t tt = (time_t)t->ts;
+    struct tm *tm = localtime(&tt);
+    if (tm) strftime(ts, sizeof ts, "%Y-%m-%d %H:%M:%S", tm); else strcpy(ts, "?");
+    ob_printf(ob, "%-6lld %s  %-5d  %-4s  %-7s  %-12.4f  %-12.4f  %-9.4f  %-11.2f  %.2f\n",
+        (long long)t->trade_id, ts, t->acc_no, t->side == 'B' ? "BUY" : "SELL",
+        t->asset_id, t->qty, t->price, t->fx_rate, t->amount_inr, t->fees_inr);
+}
+
+static OutBuf blotter_out;
+
+/* newest-first walk of one index chain; by_asset selects the chain */
+static void print_blotter(FILE *out, int head, int by_asset, int limit) {
+    blotter_out.out = out;
+    ob_printf(&blotter_out, "TradeId Timestamp            AccNo  Side  AssetID  Qty           Price(native) FX         Amount(INR)  Fees(INR)\n");
+    int n = 0;
+    for (int k = head; k >= 0 && n < limit; k = by_asset ? trade_prev_asset[k] : trade_prev_acc[k], ++n)
+        print_trade_row(&blotter_out, &trades[k]);
+    if (n == 0) ob_printf(&blotter_out, "No trades.\n");
+    ob_flush(&blotter_out);
+}
+
+static void account_blotter(FILE *out, int acc_no, int limit) {
+    print_blotter(out, trade_newest_for_account(acc_no), 0, limit);
+}
+
+static void asset_blotter(const char *asset_id, int limit) {
+    int pidx = find_price_index(asset_id);
+    if (pidx < 0) { printf("Asset not found.\n"); return; }
+    print_blotter(stdout, trade_asset_head[pidx], 1, limit);
+}
+
+/* analytics feed: flat CSV of the whole journal */
+static int export_trades_csv(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "trade_id,ts,acc_no,side,asset_id,qty,price,fx_rate,amount_inr,fees_inr\n");
+    for (int k = 0; k < trade_count; ++k) {
+        const TradeRec *t = &trades[k];
+        fprintf(f, "%lld,%lld,%d,%c,%s,%.6f,%.4f,%.6f,%.2f,%.2f\n", (long long)t->trade_id, (long long)t->ts,
+            t->acc_no, (char)t->side, t->asset_id, t->qty, t->price, t->fx_rate, t->amount_inr, t->fees_inr);
+    }
+    fclose(f);
+    return trade_count;
+}
+
+/* ---------------- Fee & tax engine (fees.txt) ---------------- */
+
+/* fees.txt rules (wildcard '*' allowed for market/class/side):
+     BROKERAGE|market|class|side|from_month_volume_inr|bps|min_inr|max_inr
+     LEVY|name|market|class|side|bps          (on trade value, e.g. STT, stamp)
+     FEE_TAX|percent                          (GST-style, on brokerage)
+     FX_SPREAD|market|bps                     (on trade value for non-INR markets)
+     CLASS|asset_id|EQUITY/CRYPTO/FX/INDEX
+   At startup the rules are compiled into one flat cell per market x class x
+   side, so pricing a trade is a table lookup plus a few multiplies. */
+
+#define FEE_TIERS 4
+enum { CLS_EQUITY, CLS_CRYPTO, CLS_FX, CLS_INDEX, CLS_COUNT };
+enum { SIDE_BUY, SIDE_SELL, SIDE_COUNT };
+
+static const char *CLASS_NAMES[CLS_COUNT] = {"EQUITY", "CRYPTO", "FX", "INDEX"};
+
+typedef struct {
+    double tier_from[FEE_TIERS];   /* ascending; unused tiers are HUGE_VAL */
+    double bps[FEE_TIERS];
+    double min_fee[FEE_TIERS];
+    double max_fee[FEE_TIERS];
+    double levy_bps;               /* all notional levies for this side */
+    double spread_bps;             /* FX spread */
+} FeeCell;
+
+typedef struct {
+    double brokerage;
+    double taxes;       /* levies + tax on brokerage */
+    double fx_spread;
+    double total;
+} FeeQuote;
+
+static FeeCell fee_table[MKT_COUNT][CLS_COUNT][SIDE_COUNT];
+static double fee_tax_rate = 0.0;               /* fraction of brokerage */
+static unsigned char price_class[MAX_PRICES];   /* CLS_* per prices[] slot */
+static int price_market[MAX_PRICES];            /* MKT_* per prices[] slot */
+
+typedef struct { char asset_id[16]; int cls; } ClassRule;
+static ClassRule class_rules[MAX_PRICES];
+static int class_rule_count = 0;
+
+/* expands "*" to every index; returns [lo, hi) */
+static int fee_dim_range(const char *tok, const char *const *names, int count, int *lo, int *hi) {
+    if (strcmp(tok, "*") == 0) { *lo = 0; *hi = count; return 1; }
+    for (int i = 0; i < count; ++i)
+        if (bvdu_stricmp(tok, names[i]) == 0) { *lo = i; *hi = i + 1; return 1; }
+    return 0;
+}
+
+static void fee_table_reset(void) {
+    for (int m = 0; m < MKT_COUNT; ++m)
+        for (int c = 0; c < CLS_COUNT; ++c)
+            for (int s = 0; s < SIDE_COUNT; ++s) {
+                FeeCell *cell = &fee_table[m][c][s];
+                memset(cell, 0, sizeof *cell);
+                for (int t = 0; t < FEE_TIERS; ++t) { cell->tier_from[t] = HUGE_VAL; cell->max_fee[t] = HUGE_VAL; }
+            }
+    fee_tax_rate = 0.0;
+    class_rule_count = 0;
+}
+
+/* insert a tier keeping tier_from ascending; same floor replaces */
+static void fee_cell_add_tier(FeeCell *cell, double from, double bps, double mn, double mx) {
+    int t = 0;
+    while (t < FEE_TIERS && cell->tier_from[t] < from) t++;
+    if (t == FEE_TIERS) return;
+    if (cell->tier_from[t] != from) {
+        for (int j = FEE_TIERS - 1; j > t; --j) {
+            cell->tier_from[j] = cell->tier_from[j-1]; cell->bps[j] = cell->bps[j-1];
+            cell->min_fee[j] = cell->min_fee[j-1]; cell->max_fee[j] = cell->max_fee[j-1];
+        }
+    }
+    cell->tier_from[t] = from; cell->bps[t] = bps; cell->min_fee[t] = mn; cell->max_fee[t] = mx;
+}
+
+static const char *SIDE_NAMES[SIDE_COUNT] = {"B", "S"};
+
+static void load_fees(void) {
+    fee_table_reset();
+    FILE *f = fopen(F_FEES, "r");
+    if (f) {
+        char line[MAX_LINE];
+        while (fgets(line, sizeof line, f)) {
+            trim_newline(line);
+            if (!line[0] || line[0] == '#') continue;
+            char a[24] = "", b[24] = "", c[24] = "", d[24] = "";
+            double x = 0, y = 0, z = 0, w = 0;
+            int m0, m1, c0, c1, s0, s1;
+            if (sscanf(line, "BROKERAGE|%23[^|]|%23[^|]|%23[^|]|%lf|%lf|%lf|%lf", a, b, c, &x, &y, &z, &w) == 7
+                && fee_dim_range(a, MARKET_NAMES, MKT_COUNT, &m0, &m1)
+                && fee_dim_range(b, CLASS_NAMES, CLS_COUNT, &c0, &c1)
+                && fee_dim_range(c, SIDE_NAMES, SIDE_COUNT, &s0, &s1)) {
+                for (int m = m0; m < m1; ++m) for (int k = c0; k < c1; ++k) for (int s = s0; s < s1; ++s)
+                    fee_cell_add_tier(&fee_table[m][k][s], x, y, z, w);
+            } else if (sscanf(line, "LEVY|%23[^|]|%23[^|]|%23[^|]|%23[^|]|%lf", d, a, b, c, &x) == 5
+                && fee_dim_range(a, MARKET_NAMES, MKT_COUNT, &m0, &m1)
+                && fee_dim_range(b, CLASS_NAMES, CLS_COUNT, &c0, &c1)
+                && fee_dim_range(c, SIDE_NAMES, SIDE_COUNT, &s0, &s1)) {
+                for (int m = m0; m < m1; ++m) for (int k = c0; k < c1; ++k) for (int s = s0; s < s1; ++s)
+                    fee_table[m][k][s].levy_bps += x;
+            } else if (sscanf(line, "FEE_TAX|%lf", &x) == 1) {
+                fee_tax_rate = x / 100.0;
+            } else if (sscanf(line, "FX_SPREAD|%23[^|]|%lf", a, &x) == 2
+                && fee_dim_range(a, MARKET_NAMES, MKT_COUNT, &m0, &m1)) {
+                for (int m = m0; m < m1; ++m) for (int k = 0; k < CLS_COUNT; ++k) for (int s = 0; s < SIDE_COUNT; ++s)
+                    fee_table[m][k][s].spread_bps = x;
+            } else if (sscanf(line, "CLASS|%15[^|]|%23s", a, b) == 2
+                && fee_dim_range(b, CLASS_NAMES, CLS_COUNT, &c0, &c1) && c1 - c0 == 1
+                && class_rule_count < MAX_PRICES) {
+                strncpy(class_rules[class_rule_count].asset_id, a, 15);
+                class_rules[class_rule_count++].cls = c0;
+            } else {
+                printf("Warning: ignoring fee rule '%s'.\n", line);
+            }
+        }
+        fclose(f);
+    }
+}
+
+/* per-asset class/market columns; redo whenever prices[] is reloaded */
+static void compile_asset_fee_keys(void) {
+    for (int i = 0; i < price_count; ++i) {
+        price_market[i] = market_index(prices[i].market);
+        price_class[i] = is_basket[i] ? CLS_INDEX : CLS_EQUITY;
+        for (int r = 0; r < class_rule_count; ++r)
+            if (strcmp(class_rules[r].asset_id, prices[i].asset_id) == 0) price_class[i] = (unsigned char)class_rules[r].cls;
+    }
+}
+
+/* O(1): pick the cell, count crossed tier floors, clamp */
+static FeeQuote compute_fees(int pidx, char side, double value_inr, double month_volume) {
+    const FeeCell *cell = &fee_table[price_market[pidx]][price_class[pidx]][side == 'S'];
+    int t = (month_volume >= cell->tier_from[1]) + (month_volume >= cell->tier_from[2]) + (month_volume >= cell->tier_from[3]);
+    double brk = value_inr * cell->bps[t] * 1e-4;
+    brk = brk < cell->min_fee[t] ? cell->min_fee[t] : brk;
+    brk = brk > cell->max_fee[t] ? cell->max_fee[t] : brk;
+    brk = value_inr > 0.0 ? brk : 0.0;
+    FeeQuote q;
+    q.brokerage = brk;
+    q.taxes = brk * fee_tax_rate + value_inr * cell->levy_bps * 1e-4;
+    q.fx_spread = value_inr * cell->spread_bps * 1e-4;
+    q.total = q.brokerage + q.taxes + q.fx_spread;
+    return q;
+}
+
+/* Batch fee kernel over struct-of-arrays input: no calls and no data-dependent
+   branches in the loop, so the compiler can vectorize it. */
+static void fee_kernel(int n, const double *restrict value, const double *restrict bps,
+                       const double *restrict mn, const double *restrict mx,
+                       const double *restrict levy_bps, const double *restrict spread_bps,
+                       double *restrict out) {
+    for (int i = 0; i < n; ++i) {
+        double brk = value[i] * bps[i] * 1e-4;
+        brk = brk < mn[i] ? mn[i] : brk;
+        brk = brk > mx[i] ? mx[i] : brk;
+        out[i] = brk * (1.0 + fee_tax_rate) + value[i] * (levy_bps[i] + spread_bps[i]) * 1e-4;
+    }
+}
+
+/* Re-price every journalled trade under the current schedule (what-if).
+   Tier selection replays each account's month-to-date volume in trade order. */
+static int reprice_trade_fees(double *old_total, double *new_total) {
+    *old_total = *new_total = 0.0;
+    int n = trade_count;
+    if (n == 0) return 0;
+    double *cols = malloc((size_t)n * 7 * sizeof *cols);
+    int *vol_month = calloc(trade_acc_mask + 1, sizeof *vol_month);
+    double *vol = calloc(trade_acc_mask + 1, sizeof *vol);
+    if (!cols || !vol_month || !vol) { free(cols); free(vol_month); free(vol); return -1; }
+    double *value = cols, *bps = cols + n, *mn = cols + 2*(size_t)n, *mx = cols + 3*(size_t)n;
+    double *levy = cols + 4*(size_t)n, *spread = cols + 5*(size_t)n, *out = cols + 6*(size_t)n;
+    for (int k = 0; k < n; ++k) {
+        const TradeRec *t = &trades[k];
+        int pidx = find_price_index(t->asset_id);
+        int h = trade_acc_find(t->acc_no);
+        int month = month_of(t->ts);
+        if (vol_month[h] != month) { vol_month[h] = month; vol[h] = 0.0; }
+        const FeeCell *cell = pidx >= 0 ? &fee_table[price_market[pidx]][price_class[pidx]][t->side == 'S']
+                                        : &fee_table[MKT_IN][CLS_EQUITY][t->side == 'S'];
+        int tier = (vol[h] >= cell->tier_from[1]) + (vol[h] >= cell->tier_from[2]) + (vol[h] >= cell->tier_from[3]);
+        value[k] = t->amount_inr; bps[k] = cell->bps[tier]; mn[k] = cell->min_fee[tier]; mx[k] = cell->max_fee[tier];
+        levy[k] = cell->levy_bps; spread[k] = cell->spread_bps;
+        vol[h] += t->amount_inr;
+        *old_total += t->fees_inr;
+    }
+    fee_kernel(n, value, bps, mn, mx, levy, spread, out);
+    for (int k = 0; k < n; ++k) *new_total += out[k];
+    free(cols); free(vol_month); free(vol);
+    return n;
+}
+
+/* ---------------- T+N settlement ---------------- */
+
+/* With settle_days > 0, trades still move cash and holdings immediately
+   (trade-date position, so cash cannot be spent twice) but write no ledger
+   rows. A settlement run later nets each account's due trades per asset per
+   trade day into one SETTLE_CASH and one SETTLE_SEC row.
+   The part of each account's cash and of each position that has not settled
+   yet is kept apart (UnsettledPos), so settlement-date figures are
+   balance - unsettled cash and holding - unsettled units. */
+
+#define SETTLE_MAX_THREADS 8
+
+static int settle_days = 0;                 /* 0 = instant settlement */
+static int64_t settled_through_id = 0;      /* trades up to this id are settled */
+
+typedef struct {
+    int acc_no;
+    int k;          /* index into trades[] */
+    int64_t day;    /* local trade date, days since 1970-01-01 */
+} SettleKey;
+
+typedef struct {
+    int acc_no;
+    char asset_id[16];
+    int64_t day;
+    double net_qty;     /* + bought, - sold */
+    double net_cash;    /* + credited, - debited (INR) */
+    int n_trades;
+} SettleMove;
+
+typedef struct {
+    SettleKey *keys;
+    int n;
+    SettleMove *out;
+    int nout;
+} SettleShard;
+
+/* (acc_no, asset) -> effect of the trades not settled yet; asset -1 holds the
+   account's whole unsettled cash. Open addressing, acc_no 0 = empty. */
+typedef struct {
+    int acc_no;
+    int asset;          /* prices[] slot, -1 = account total */
+    int n_trades;
+    double cash;        /* + to be credited, - to be debited (INR, net of fees) */
+    double qty;         /* + bought, - sold */
+} UnsettledPos;
+
+static UnsettledPos *unsettled_tab = NULL;
+static unsigned unsettled_mask = 0, unsettled_used = 0;
+
+static unsigned unsettled_hash(int acc_no, int asset) {
+    return ((unsigned)acc_no * 2654435761u) ^ ((unsigned)(asset + 1) * 40503u);
+}
+
+static UnsettledPos *unsettled_find(int acc_no, int asset, int create) {
+    if (!unsettled_tab) {
+        if (!create) return NULL;
+        unsettled_mask = 1023;
+        unsettled_tab = calloc(unsettled_mask + 1, sizeof *unsettled_tab);
+        if (!unsettled_tab) { perror("unsettled_find"); exit(1); }
+    }
+    unsigned h = unsettled_hash(acc_no, asset) & unsettled_mask;
+    while (unsettled_tab[h].acc_no != 0) {
+        if (unsettled_tab[h].acc_no == acc_no && unsettled_tab[h].asset == asset) return &unsettled_tab[h];
+        h = (h + 1) & unsettled_mask;
+    }
+    if (!create) return NULL;
+    if (2 * (unsettled_used + 1) > unsettled_mask + 1) {
+        /* grow: rehash into twice the slots */
+        UnsettledPos *old = unsettled_tab;
+        unsigned old_size = unsettled_mask + 1;
+        unsettled_mask = 2 * old_size - 1;
+        unsettled_tab = calloc(unsettled_mask + 1, sizeof *unsettled_tab);
+        if (!unsettled_tab) { perror("unsettled_find"); exit(1); }
+        for (unsigned i = 0; i < old_size; ++i) {
+            if (old[i].acc_no == 0) continue;
+            unsigned g = unsettled_hash(old[i].acc_no, old[i].asset) & unsettled_mask;
+            while (unsettled_tab[g].acc_no != 0) g = (g + 1) & unsettled_mask;
+            unsettled_tab[g] = old[i];
+        }
+        free(old);
+        return unsettled_find(acc_no, asset, 1);
+    }
+    unsettled_used++;
+    UnsettledPos *u = &unsettled_tab[h];
+    u->acc_no = acc_no;
+    u->asset = asset;
+    return u;
+}
+
+/* move cash/units in (sign +1, trade booked) or out (sign -1, settled) of one entry */
+static void unsettled_move(UnsettledPos *u, int n_trades, double cash, double qty) {
+    u->n_trades += n_trades;
+    u->cash += cash;
+    u->qty += qty;
+    if (u->n_trades <= 0) { u->n_trades = 0; u->cash = 0.0; u->qty = 0.0; } /* no rounding residue */
+}
+
+static void unsettled_add(const TradeRec *t, double sign) {
+    int n = sign > 0 ? 1 : -1;
+    double qty = (t->side == 'B' ? t->qty : -t->qty) * sign;
+    double cash = ((t->side == 'B' ? -t->amount_inr : t->amount_inr) - t->fees_inr) * sign;
+    unsettled_move(unsettled_find(t->acc_no, -1, 1), n, cash, 0.0);
+    int pidx = find_price_index(t->asset_id);
+    if (pidx >= 0) unsettled_move(unsettled_find(t->acc_no, pidx, 1), n, cash, qty);
+}
+
+/* recompute from the journal: everything after settled_through_id is pending */
+static void rebuild_unsettled(void) {
+    if (unsettled_tab) memset(unsettled_tab, 0, (size_t)(unsettled_mask + 1) * sizeof *unsettled_tab);
+    unsettled_used = 0;
+    for (int k = 0; k < trade_count; ++k)
+        if (trades[k].trade_id > settled_through_id) unsettled_add(&trades[k], 1.0);
+}
+
+/* units of one holding not settled yet */
+static double unsettled_qty(int acc_no, int asset) {
+    UnsettledPos *u = unsettled_find(acc_no, asset, 0);
+    return u ? u->qty : 0.0;
+}
+
+static void save_settlement(void) {
+    FILE *f = fopen(F_SETTLEMENT, "w");
+    if (!f) { perror("save_settlement fopen"); return; }
+    /* settle_days|settled_through_id */
+    fprintf(f, "%d|%lld\n", settle_days, (long long)settled_through_id);
+    fclose(f);
+    book_dirty |= DIRTY_SETTLEMENT;
+}
+
+static void load_settlement(void) {
+    FILE *f = fopen(F_SETTLEMENT, "r");
+    if (!f) return;
+    long long through = 0;
+    if (fscanf(f, "%d|%lld", &settle_days, &through) == 2) settled_through_id = through;
+    fclose(f);
+    rebuild_unsettled();
+}
+
+static int cmp_settle_key(const void *x, const void *y) {
+    const SettleKey *a = x, *b = y;
+    if (a->acc_no != b->acc_no) return (a->acc_no > b->acc_no) - (a->acc_no < b->acc_no);
+    int c = strcmp(trades[a->k].asset_id, trades[b->k].asset_id);
+    if (c) return c;
+    if (a->day != b->day) return (a->day > b->day) - (a->day < b->day);
+    return a->k - b->k;
+}
+
+/* each shard owns a disjoint set of accounts, so shards net independently */
+static void *settle_worker(void *arg) {
+    SettleShard *sh = arg;
+    qsort(sh->keys, (size_t)sh->n, sizeof *sh->keys, cmp_settle_key);
+    sh->nout = 0;
+    for (int i = 0; i < sh->n; ++i) {
+        const TradeRec *t = &trades[sh->keys[i].k];
+        SettleMove *m = sh->nout ? &sh->out[sh->nout - 1] : NULL;
+        if (!m || m->acc_no != t->acc_no || m->day != sh->keys[i].day || strcmp(m->asset_id, t->asset_id) != 0) {
+            m = &sh->out[sh->nout++];
+            memset(m, 0, sizeof *m);
+            m->acc_no = t->acc_no;
+            m->day = sh->keys[i].day;
+            memcpy(m->asset_id, t->asset_id, sizeof m->asset_id);
+        }
+        double sign = t->side == 'B' ? 1.0 : -1.0;
+        m->net_qty += sign * t->qty;
+        m->net_cash -= sign * t->amount_inr + t->fees_inr;
+        m->n_trades++;
+    }
+    return NULL;
+}
+
+static int settle_thread_count(void) {
+    long n = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1) n = 1;
+    if (n > SETTLE_MAX_THREADS) n = SETTLE_MAX_THREADS;
+    return (int)n;
+}
+
+/* Settle every trade whose trade date + settle_days has been reached.
+   Returns the number of trades settled, or -1 on allocation failure. */
+static int run_settlement(int *moves_out) {
+    *moves_out = 0;
+    int first = 0;
+    while (first < trade_count && trades[first].trade_id <= settled_through_id) first++;
+    int64_t today = local_day((int64_t)time(NULL));
+    int last = first; /* trade ids grow with time, so due trades are a prefix */
+    while (last < trade_count && local_day(trades[last].ts) + settle_days <= today) last++;
+    int n = last - first;
+    if (n == 0) return 0;
+
+    int nthreads = settle_thread_count();
+    SettleShard shards[SETTLE_MAX_THREADS];
+    memset(shards, 0, sizeof shards);
+    SettleKey *keys = malloc((size_t)n * sizeof *keys);
+    SettleMove *moves = malloc((size_t)n * sizeof *moves);
+    if (!keys || !moves) { free(keys); free(moves); return -1; }
+
+    /* count, then place each trade into its account's shard */
+    int counts[SETTLE_MAX_THREADS] = {0};
+    for (int k = first; k < last; ++k) counts[(unsigned)trades[k].acc_no % (unsigned)nthreads]++;
+    int off = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        shards[t].keys = keys + off;
+        shards[t].out = moves + off;
+        off += counts[t];
+    }
+    for (int k = first; k < last; ++k) {
+        SettleShard *sh = &shards[(unsigned)trades[k].acc_no % (unsigned)nthreads];
+        SettleKey *key = &sh->keys[sh->n++];
+        key->acc_no = trades[k].acc_no;
+        key->k = k;
+        key->day = local_day(trades[k].ts);
+    }
+
+    pthread_t tids[SETTLE_MAX_THREADS];
+    int started[SETTLE_MAX_THREADS] = {0};
+    for (int t = 1; t < nthreads; ++t)
+        started[t] = pthread_create(&tids[t], NULL, settle_worker, &shards[t]) == 0;
+    settle_worker(&shards[0]);
+    for (int t = 1; t < nthreads; ++t) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else settle_worker(&shards[t]);
+    }
+
+    /* all ledger rows for the run go out in one buffered append */
+    static OutBuf ledger_out;
+    ledger_out.append_path = F_TRANSACTIONS;
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    for (int t = 0; t < nthreads; ++t) {
+        for (int i = 0; i < shards[t].nout; ++i) {
+            SettleMove *m = &shards[t].out[i];
+            int idx = find_account_index(m->acc_no);
+            int pidx = find_price_index(m->asset_id);
+            /* the move leaves the unsettled figures; what remains settled is the row's balance */
+            UnsettledPos *cash = unsettled_find(m->acc_no, -1, 1);
+            unsettled_move(cash, -m->n_trades, -m->net_cash, 0.0);
+            double units = 0.0;
+            if (pidx >= 0) {
+                UnsettledPos *pos = unsettled_find(m->acc_no, pidx, 1);
+                unsettled_move(pos, -m->n_trades, -m->net_cash, -m->net_qty);
+                int hidx = find_holding_index(m->acc_no, pidx);
+                units = (hidx >= 0 ? holdings[hidx].qty : 0.0) - pos->qty;
+            }
+            double bal = (idx >= 0 ? accounts[idx].balance : 0.0) - cash->cash;
+            char day[16];
+            format_day(m->day, day, sizeof day);
+            /* acc_no|timestamp|type|amount|balance_after|note; balance_after is the
+               settled cash (SETTLE_CASH) or settled units of the asset (SETTLE_SEC) */
+            ob_printf(&ledger_out, "%d|%s|SETTLE_CASH|%.2f|%.2f|T+%d %s %s net of %d trade(s)\n",
+                m->acc_no, ts, m->net_cash, bal, settle_days, m->asset_id, day, m->n_trades);
+            ob_printf(&ledger_out, "%d|%s|SETTLE_SEC|%.6f|%.6f|T+%d %s %s units\n",
+                m->acc_no, ts, m->net_qty, units, settle_days, m->asset_id, day);
+            (*moves_out)++;
+        }
+    }
+    ob_flush(&ledger_out);
+    free(keys);
+    free(moves);
+
+    settled_through_id = trades[last - 1].trade_id;
+    save_settlement();
+    char entry[128];
+    snprintf(entry, sizeof entry, "SETTLEMENT_RUN|T+%d|trades=%d|movements=%d", settle_days, n, *moves_out);
+    audit_log(entry);
+    return n;
+}
+
+/* in instant mode the trade's ledger row is its settlement */
+static void mark_trade_settled(void) {
+    if (trade_count == 0 || settled_through_id != (trade_count > 1 ? trades[trade_count - 2].trade_id : 0)) return;
+    settled_through_id = trades[trade_count - 1].trade_id;
+    unsettled_add(&trades[trade_count - 1], -1.0);
+    save_settlement();
+}
+
+/* net cash effect and count of an account's not-yet-settled trades */
+static int unsettled_for_account(int acc_no, double *net_cash) {
+    UnsettledPos *u = unsettled_find(acc_no, -1, 0);
+    *net_cash = u ? u->cash : 0.0;
+    return u ? u->n_trades : 0;
+}
+
+/* ---------------- Point-in-time recovery (journal.txt + pitr_catalog.txt) ---------------- */
+
+/* A recovery checkpoint copies accounts and holdings to pitr_<epoch>.accounts
+   and pitr_<epoch>.holdings and records "epoch|journal_offset" in the catalog.
+   Recovery loads the newest checkpoint at or before T and replays the journal
+   from its offset up to the first record stamped after T. Journal records are
+   full row images keyed by account, so accounts replay independently in
+   parallel shards; both legs of a transfer are written by the same save and
+   carry the same stamp, so a cut never splits them. */
+
+static int pitr_checkpoint(void) {
+    long long now = (long long)time(NULL);
+    char apath[64], hpath[64], row[MAX_LINE];
+    snprintf(apath, sizeof apath, "pitr_%lld.accounts", now);
+    snprintf(hpath, sizeof hpath, "pitr_%lld.holdings", now);
+    /* bring the journal up to date so the offset matches the copied state */
+    save_accounts();
+    save_holdings();
+    io_drain();
+    long off = io_file_size(F_JOURNAL);
+    FILE *f = fopen(apath, "w");
+    if (!f) { perror(apath); return -1; }
+    for (int i = 0; i < acc_count; ++i) { format_account_row(row, sizeof row, &accounts[i], &account_info[i]); fputs(row, f); }
+    fclose(f);
+    f = fopen(hpath, "w");
+    if (!f) { perror(hpath); return -1; }
+    for (int i = 0; i < hold_count; ++i) { format_holding_row(row, sizeof row, &holdings[i]); fputs(row, f); }
+    fclose(f);
+    snprintf(row, sizeof row, "%lld|%ld", now, off);
+    append_line(F_PITR_CATALOG, row);
+    snprintf(row, sizeof row, "PITR_CHECKPOINT|%lld|%ld", now, off);
+    audit_log(row);
+    return 0;
+}
+
+/* journaling needs a base image to replay onto */
+static void pitr_ensure_checkpoint(void) {
+    FILE *f = fopen(F_PITR_CATALOG, "r");
+    if (f) { fclose(f); return; }
+    pitr_checkpoint();
+}
+
+typedef struct {
+    int acc_no;           /* 0 = empty */
+    int has_account;
+    Account acc;
+    AccountInfo info;
+    int hold_head, hold_tail;
+} PitrAcc;
+
+typedef struct {
+    Account acc;
+    AccountInfo info;
+} PitrRow;
+
+#define PITR_GROW(arr, n, cap) do { \
+    if ((n) == (cap)) { int nc_ = (cap) ? (cap) * 2 : 256; void *p_ = realloc((arr), (size_t)nc_ * sizeof *(arr)); \
+        if (!p_) { perror("pitr"); exit(1); } (arr) = p_; (cap) = nc_; } } while (0)
+
+typedef struct {
+    Holding h;            /* h.asset indexes PitrAssets, not prices[] */
+    int next;
+} PitrHolding;
+
+/* Recovery names assets in its own table, so replaying old holdings never
+   adds listings to the live prices[]. Filled by the main thread before the
+   workers start; they only look ids up. */
+typedef struct {
+    char id[16];
+    char name[64];        /* "" unless a legacy row named it */
+    char market[8];
+} PitrAsset;
+
+typedef struct {
+    PitrAsset *a; int n, cap;
+    int *slot; unsigned mask;     /* open addressing over a[], -1 = empty */
+} PitrAssets;
+
+static int pitr_asset_find(const PitrAssets *t, const char *id) {
+    if (!t->slot) return -1;
+    unsigned h = (unsigned)row_hash(id, strlen(id), ROW_HASH_INIT) & t->mask;
+    for (; t->slot[h] >= 0; h = (h + 1) & t->mask)
+        if (strcmp(t->a[t->slot[h]].id, id) == 0) return t->slot[h];
+    return -1;
+}
+
+static int pitr_asset_add(PitrAssets *t, const char *id, const char *name, const char *market) {
+    int k = pitr_asset_find(t, id);
+    if (k >= 0) {
+        if (name && !t->a[k].name[0]) { snprintf(t->a[k].name, sizeof t->a[k].name, "%s", name); snprintf(t->a[k].market, sizeof t->a[k].market, "%s", market); }
+        return k;
+    }
+    PITR_GROW(t->a, t->n, t->cap);
+    k = t->n++;
+    memset(&t->a[k], 0, sizeof t->a[k]);
+    snprintf(t->a[k].id, sizeof t->a[k].id, "%s", id);
+    if (name) { snprintf(t->a[k].name, sizeof t->a[k].name, "%s", name); snprintf(t->a[k].market, sizeof t->a[k].market, "%s", market); }
+    if (2u * (unsigned)t->n > t->mask) {
+        unsigned size = t->mask ? 2 * (t->mask + 1) : 64;
+        free(t->slot);
+        t->slot = malloc(size * sizeof *t->slot);
+        if (!t->slot) { perror("pitr"); exit(1); }
+        t->mask = size - 1;
+        for (unsigned i = 0; i < size; ++i) t->slot[i] = -1;
+        for (int j = 0; j < t->n; ++j) {
+            unsigned h = (unsigned)row_hash(t->a[j].id, strlen(t->a[j].id), ROW_HASH_INIT) & t->mask;
+            while (t->slot[h] >= 0) h = (h + 1) & t->mask;
+            t->slot[h] = j;
+        }
+    } else {
+        unsigned h = (unsigned)row_hash(id, strlen(id), ROW_HASH_INIT) & t->mask;
+        while (t->slot[h] >= 0) h = (h + 1) & t->mask;
+        t->slot[h] = k;
+    }
+    return k;
+}
+
+/* holding row -> Holding naming a PitrAssets entry; add = 0 in the workers */
+static int pitr_parse_holding(PitrAssets *t, const char *s, Holding *h, int add) {
+    char id[16], name[64], market[8];
+    int legacy;
+    if (!scan_holding_row(s, h, id, name, market, &legacy)) return 0;
+    h->asset = add ? pitr_asset_add(t, id, legacy ? name : NULL, market) : pitr_asset_find(t, id);
+    return h->asset >= 0;
+}
+
+/* listed assets keep the short row; anything else carries its name and market */
+static int pitr_format_holding(const PitrAssets *t, char *buf, size_t n, const Holding *h) {
+    const PitrAsset *a = &t->a[h->asset];
+    int live = find_price_index_n(a->id, strlen(a->id));
+    if (live >= 0 && !is_synthetic[live]) return format_holding_line(buf, n, h, a->id, NULL, NULL);
+    if (live >= 0 && !a->name[0]) return format_holding_line(buf, n, h, a->id, prices[live].asset_name, prices[live].market);
+    return format_holding_line(buf, n, h, a->id, a->name[0] ? a->name : a->id, a->name[0] ? a->market : "IN");
+}
+
+typedef struct {
+    char **recs;          /* journal lines for this shard, in journal order */
+    int nrecs, caprecs;
+    PitrRow *base_acc; int nbase_acc, capbase_acc;
+    Holding *base_hold; int nbase_hold, capbase_hold;
+    PitrAcc *map; unsigned mapcap;
+    PitrHolding *hold; int nhold, caphold;
+    PitrAssets *assets;
+    int bad;
+} PitrShard;
+
+static PitrAcc *pitr_map_get(PitrShard *sh, int acc_no) {
+    unsigned h = (unsigned)acc_no * 2654435761u & (sh->mapcap - 1);
+    while (sh->map[h].acc_no && sh->map[h].acc_no != acc_no) h = (h + 1) & (sh->mapcap - 1);
+    PitrAcc *pa = &sh->map[h];
+    if (!pa->acc_no) { pa->acc_no = acc_no; pa->hold_head = pa->hold_tail = -1; }
+    return pa;
+}
+
+static void pitr_add_holding(PitrShard *sh, PitrAcc *pa, const Holding *h) {
+    PITR_GROW(sh->hold, sh->nhold, sh->caphold);
+    int k = sh->nhold++;
+    sh->hold[k].h = *h;
+    sh->hold[k].next = -1;
+    if (pa->hold_tail >= 0) sh->hold[pa->hold_tail].next = k; else pa->hold_head = k;
+    pa->hold_tail = k;
+}
+
+static void *pitr_worker(void *arg) {
+    PitrShard *sh = arg;
+    unsigned need = 2u * (unsigned)(sh->nbase_acc + sh->nbase_hold + sh->nrecs + 1), cap = 64;
+    while (cap < need) cap <<= 1;
+    sh->map = calloc(cap, sizeof *sh->map);
+    if (!sh->map) { sh->bad = -1; return NULL; }
+    sh->mapcap = cap;
+    for (int i = 0; i < sh->nbase_acc; ++i) {
+        PitrAcc *pa = pitr_map_get(sh, sh->base_acc[i].acc.acc_no);
+        pa->acc = sh->base_acc[i].acc;
+        pa->info = sh->base_acc[i].info;
+        pa->has_account = 1;
+    }
+    for (int i = 0; i < sh->nbase_hold; ++i)
+        pitr_add_holding(sh, pitr_map_get(sh, sh->base_hold[i].acc_no), &sh->base_hold[i]);
+    for (int i = 0; i < sh->nrecs; ++i) {
+        const char *r = strchr(sh->recs[i], '|') + 1;   /* skip epoch */
+        if (r[0] == 'A') {
+            Account a;
+            AccountInfo ai;
+            if (!parse_account_row(r + 2, &a, &ai)) { sh->bad++; continue; }
+            PitrAcc *pa = pitr_map_get(sh, a.acc_no);
+            pa->acc = a;
+            pa->info = ai;
+            pa->has_account = 1;
+        } else if (r[0] == 'H') {
+            PitrAcc *pa = pitr_map_get(sh, atoi(r + 2));
+            pa->hold_head = pa->hold_tail = -1;
+        } else if (r[0] == 'h') {
+            Holding h;
+            if (!pitr_parse_holding(sh->assets, r + 2, &h, 0)) { sh->bad++; continue; }
+            pitr_add_holding(sh, pitr_map_get(sh, h.acc_no), &h);
+        } else sh->bad++;
+    }
+    return NULL;
+}
+
+static int cmp_pitr_acc(const void *a, const void *b) {
+    int x = (*(PitrAcc * const *)a)->acc_no, y = (*(PitrAcc * const *)b)->acc_no;
+    return (x > y) - (x < y);
+}
+
+/* journal record -> owning account (A rows and h rows lead with acc_no);
+   K records are idempotency keys, not state, and are skipped */
+static int pitr_record_acc(const char *line) {
+    const char *p = strchr(line, '|');
+    if (!p || !p[1] || p[2] != '|' || p[1] == 'K') return -1;
+    return atoi(p + 3);
+}
+
+/* Rebuild accounts/holdings as of local time `when` into recovered_*.txt.
+   Returns the number of journal records replayed, or -1. */
+static long pitr_recover(const char *when) {
+    struct tm tm;
+    memset(&tm, 0, sizeof tm);
+    if (sscanf(when, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 3) {
+        printf("Time must be YYYY-MM-DD[ HH:MM:SS].\n");
+        return -1;
+    }
+    tm.tm_year -= 1900; tm.tm_mon -= 1; tm.tm_isdst = -1;
+    long long target = (long long)mktime(&tm);
+    if (!strchr(when, ':')) target += 86399; /* a bare date means end of that day */
+
+    /* newest checkpoint at or before the target */
+    FILE *f = fopen(F_PITR_CATALOG, "r");
+    if (!f) { printf("No recovery checkpoints (%s).\n", F_PITR_CATALOG); return -1; }
+    long long snap = -1, e;
+    long snap_off = 0, o;
+    char line[MAX_LINE];
+    while (fgets(line, sizeof line, f))
+        if (sscanf(line, "%lld|%ld", &e, &o) == 2 && e <= target && e >= snap) { snap = e; snap_off = o; }
+    fclose(f);
+    if (snap < 0) { printf("No checkpoint at or before %s.\n", when); return -1; }
+
+    double t0 = now_seconds();
+    int nthreads = settle_thread_count();
+    PitrShard shards[SETTLE_MAX_THREADS];
+    memset(shards, 0, sizeof shards);
+    PitrAssets assets;
+    memset(&assets, 0, sizeof assets);
+    for (int t = 0; t < nthreads; ++t) shards[t].assets = &assets;
+
+    char path[64];
+    snprintf(path, sizeof path, "pitr_%lld.accounts", snap);
+    f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+    while (fgets(line, sizeof line, f)) {
+        PitrRow row;
+        if (!parse_account_row(line, &row.acc, &row.info)) continue;
+        PitrShard *sh = &shards[(unsigned)row.acc.acc_no % (unsigned)nthreads];
+        PITR_GROW(sh->base_acc, sh->nbase_acc, sh->capbase_acc);
+        sh->base_acc[sh->nbase_acc++] = row;
+    }
+    fclose(f);
+    snprintf(path, sizeof path, "pitr_%lld.holdings", snap);
+    f = fopen(path, "r");
+    if (f) {
+        while (fgets(line, sizeof line, f)) {
+            Holding h;
+            if (!pitr_parse_holding(&assets, line, &h, 1)) continue;
+            PitrShard *sh = &shards[(unsigned)h.acc_no % (unsigned)nthreads];
+            PITR_GROW(sh->base_hold, sh->nbase_hold, sh->capbase_hold);
+            sh->base_hold[sh->nbase_hold++] = h;
+        }
+        fclose(f);
+    }
+
+    /* journal tail from the checkpoint offset, cut at the first record after T */
+    io_drain();
+    char *jbuf = NULL;
+    long jlen = 0;
+    f = fopen(F_JOURNAL, "rb");
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        long end = ftell(f);
+        if (end > snap_off) {
+            jbuf = malloc((size_t)(end - snap_off) + 1);
+            if (!jbuf) { fclose(f); return -1; }
+            fseek(f, snap_off, SEEK_SET);
+            jlen = (long)fread(jbuf, 1, (size_t)(end - snap_off), f);
+            jbuf[jlen] = '\0';
+        }
+        fclose(f);
+    }
+    long replayed = 0;
+    for (char *p = jbuf, *nl; p && p < jbuf + jlen; p = nl + 1) {
+        nl = strchr(p, '\n');
+        if (!nl) break;   /* torn final record */
+        *nl = '\0';
+        if (atoll(p) > target) break;
+        int acc = pitr_record_acc(p);
+        if (acc <= 0) continue;
+        const char *r = strchr(p, '|') + 1;
+        if (r[0] == 'h') {
+            /* name unseen assets here so the workers only read the table */
+            Holding h;
+            pitr_parse_holding(&assets, r + 2, &h, 1);
+        }
+        PitrShard *sh = &shards[(unsigned)acc % (unsigned)nthreads];
+        PITR_GROW(sh->recs, sh->nrecs, sh->caprecs);
+        sh->recs[sh->nrecs++] = p;
+        replayed++;
+    }
+
+    pthread_t tids[SETTLE_MAX_THREADS];
+    int started[SETTLE_MAX_THREADS] = {0};
+    for (int t = 1; t < nthreads; ++t)
+        started[t] = pthread_create(&tids[t], NULL, pitr_worker, &shards[t]) == 0;
+    pitr_worker(&shards[0]);
+    for (int t = 1; t < nthreads; ++t) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else pitr_worker(&shards[t]);
+    }
+
+    /* merge shards in account order */
+    int total = 0, bad = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        if (shards[t].bad < 0) { free(jbuf); return -1; }
+        bad += shards[t].bad;
+        for (unsigned i = 0; i < shards[t].mapcap; ++i) total += shards[t].map[i].acc_no != 0;
+    }
+    PitrAcc **order = malloc((size_t)(total ? total : 1) * sizeof *order);
+    if (!order) { free(jbuf); return -1; }
+    int k = 0;
+    for (int t = 0; t < nthreads; ++t)
+        for (unsigned i = 0; i < shards[t].mapcap; ++i)
+            if (shards[t].map[i].acc_no) order[k++] = &shards[t].map[i];
+    qsort(order, (size_t)total, sizeof *order, cmp_pitr_acc);
+
+    FILE *fa = fopen("recovered_accounts.txt", "w");
+    FILE *fh = fopen("recovered_holdings.txt", "w");
+    int nacc = 0, nhold = 0;
+    if (fa && fh) {
+        for (int i = 0; i < total; ++i) {
+            PitrAcc *pa = order[i];
+            PitrShard *sh = &shards[(unsigned)pa->acc_no % (unsigned)nthreads];
+            if (pa->has_account) { format_account_row(line, sizeof line, &pa->acc, &pa->info); fputs(line, fa); nacc++; }
+            for (int j = pa->hold_head; j >= 0; j = sh->hold[j].next) {
+                pitr_format_holding(&assets, line, sizeof line, &sh->hold[j].h);
+                fputs(line, fh);
+                nhold++;
+            }
+        }
+    } else perror("recovered_*.txt");
+    if (fa) fclose(fa);
+    if (fh) fclose(fh);
+
+    char ts[32];
+    time_t st = (time_t)snap;
+    struct tm *stm = localtime(&st);
+    if (stm) strftime(ts, sizeof ts, "%Y-%m-%d %H:%M:%S", stm); else strcpy(ts, "?");
+    printf("Checkpoint %s + %ld journal record(s) on %d thread(s) in %.3fs%s\n",
+        ts, replayed, nthreads, now_seconds() - t0, bad ? " (some records unreadable)" : "");
+    printf("Wrote %d account(s) to recovered_accounts.txt and %d holding(s) to recovered_holdings.txt.\n", nacc, nhold);
+    printf("Review them, then replace accounts.txt and holdings.txt to restore.\n");
+    if (kv.holds_book) printf("The book is in the KV store %s: restore onto a new store directory so the files are copied in.\n", kv.dir);
+
+    free(order);
+    for (int t = 0; t < nthreads; ++t) {
+        free(shards[t].recs); free(shards[t].base_acc); free(shards[t].base_hold);
+        free(shards[t].map); free(shards[t].hold);
+    }
+    free(assets.a); free(assets.slot);
+    free(jbuf);
+    return (fa && fh) ? replayed : -1;
+}
+
+/* ---------------- Utilities: market time & tick ---------------- */
+
+static int market_is_open(const PriceRec *p) {
+    time_t t = time(NULL);
+    struct tm *tm = localtime(&t);
+    int hour = tm->tm_hour;
+    /* simple: compare hour in local timezone */
+    if (p->open_hour <= p->close_hour) return (hour >= p->open_hour && hour < p->close_hour);
+    /* wrap-around e.g., open 20 to 4 */
+    return (hour >= p->open_hour || hour < p->close_hour);
+}
+
+/* small random double in [-1,1] */
+static double rand_minus1_1(void) {
+    return ((double)rand() / RAND_MAX) * 2.0 - 1.0;
+}
+
+/* single market tick: adjust prices for market that is open */
+static void tick_market_once(void) {
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    for (int i = 0; i < price_count; ++i) {
+        PriceRec *p = &prices[i];
+        if (!is_basket[i] && market_is_open(p)) {
+            /* percent change ~ N(0, vol) scaled by random */
+            double change_pct = rand_minus1_1() * p->vol;
+            double np = p->price * (1.0 + change_pct);
+            set_asset_price(i, np < 0.0001 ? 0.0001 : np, ts);
+        }
+    }
+    save_prices();
+    char entry[128]; snprintf(entry, sizeof entry, "MARKET_TICK|ALL_MARKETS");
+    audit_log(entry);
+}
+
+/* allow admin to randomize all prices (larger move) */
+static void admin_randomize_all_prices(void) {
+    srand((unsigned)time(NULL));
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    for (int i = 0; i < price_count; ++i) {
+        PriceRec *p = &prices[i];
+        if (is_basket[i]) continue; /* derived from constituents */
+        double change_pct = rand_minus1_1() * p->vol * 5.0; /* bigger */
+        double np = p->price * (1.0 + change_pct);
+        set_asset_price(i, np < 0.0001 ? 0.0001 : np, ts);
+    }
+    save_prices();
+    audit_log("ADMIN_RANDOMIZE_PRICES");
+}
+
+/* ---------------- Portfolio valuation ---------------- */
+
+/* Convert asset price in native currency to INR (served from the valuation cache) */
+static double price_in_inr(const PriceRec *p) {
+    return price_inr_cache[p - prices];
+}
+
+/* compute portfolio value (in INR) for account */
+static double compute_portfolio_value_inr(int acc_no) {
+    double tot = 0.0;
+    for (int i = 0; i < hold_count; ++i) {
+        if (holdings[i].acc_no != acc_no) continue;
+        tot += holdings[i].qty * price_in_inr(&prices[holdings[i].asset]);
+    }
+    return tot;
+}
+
+/* compute unrealized P/L in INR */
+static double compute_unrealized_pl_inr(int acc_no) {
+    double pl = 0.0;
+    for (int i = 0; i < hold_count; ++i) {
+        if (holdings[i].acc_no != acc_no) continue;
+        const PriceRec *p = &prices[holdings[i].asset];
+        double avg_inr = holdings[i].avg_price * fx_factor(p->market);
+        pl += holdings[i].qty * (price_in_inr(p) - avg_inr);
+    }
+    return pl;
+}
+
+/* ---------------- Price feed ingestion ---------------- */
+
+/* Consumes "asset|price|ts" lines from a file, FIFO or unix socket ("unix:/path").
+   Updates are conflated per asset within each read batch, so only the latest
+   quote of an asset is applied; prices.txt is rewritten only at checkpoints. */
+
+typedef struct {
+    double price;
+    char ts[25];
+} PendingQuote;
+
+static PendingQuote feed_pending[MAX_PRICES];
+static unsigned char feed_dirty[MAX_PRICES];
+static int feed_dirty_list[MAX_PRICES];
+static int feed_dirty_count = 0;
+
+typedef struct {
+    long lines;
+    long applied;     /* quotes applied after conflation */
+    long rejected;    /* unknown asset or malformed line */
+    int checkpoints;
+} FeedStats;
+
+static int feed_open(const char *src) {
+    if (strncmp(src, "unix:", 5) == 0) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof sa);
+        sa.sun_family = AF_UNIX;
+        strncpy(sa.sun_path, src + 5, sizeof sa.sun_path - 1);
+        if (connect(fd, (struct sockaddr *)&sa, sizeof sa) != 0) { close(fd); return -1; }
+        return fd;
+    }
+    return open(src, O_RDONLY);
+}
+
+/* feed timestamps may be epoch seconds or already formatted */
+static void feed_format_ts(const char *raw, char *out, size_t n) {
+    const char *c = raw;
+    while (*c >= '0' && *c <= '9') c++;
+    if (*c == '\0' && c != raw) {
+        time_t t = (time_t)strtoll(raw, NULL, 10);
+        struct tm *tm = localtime(&t);
+        if (tm) { strftime(out, n, "%Y-%m-%d %H:%M:%S", tm); return; }
+    }
+    strncpy(out, raw, n - 1);
+    out[n - 1] = '\0';
+}
+
+static void feed_parse_line(const char *line, size_t len, FeedStats *st) {
+    st->lines++;
+    const char *bar1 = memchr(line, '|', len);
+    if (!bar1) { st->rejected++; return; }
+    int idx = find_price_index_n(line, (size_t)(bar1 - line));
+    if (idx < 0 || is_basket[idx]) { st->rejected++; return; }
+    /* the line is not NUL-terminated: parse the price from a bounded copy */
+    const char *field = bar1 + 1, *stop = line + len;
+    const char *bar2 = memchr(field, '|', (size_t)(stop - field));
+    size_t fl = (size_t)((bar2 ? bar2 : stop) - field);
+    char num[32], *end;
+    if (fl == 0 || fl >= sizeof num) { st->rejected++; return; }
+    memcpy(num, field, fl);
+    num[fl] = '\0';
+    double px = strtod(num, &end);
+    if (end != num + fl || !isfinite(px) || !(px > 0.0)) { st->rejected++; return; }
+    PendingQuote *q = &feed_pending[idx];
+    q->price = px;
+    q->ts[0] = '\0';
+    if (bar2) {
+        size_t tl = len - (size_t)(bar2 + 1 - line);
+        if (tl > sizeof q->ts - 1) tl = sizeof q->ts - 1;
+        memcpy(q->ts, bar2 + 1, tl);
+        q->ts[tl] = '\0';
+    }
+    if (!feed_dirty[idx]) { feed_dirty[idx] = 1; feed_dirty_list[feed_dirty_count++] = idx; }
+}
+
+/* apply the conflated batch: one price change per touched asset */
+static void feed_apply_batch(FeedStats *st) {
+    char now[25] = "";
+    for (int k = 0; k < feed_dirty_count; ++k) {
+        int idx = feed_dirty_list[k];
+        PendingQuote *q = &feed_pending[idx];
+        char ts[25];
+        if (q->ts[0]) feed_format_ts(q->ts, ts, sizeof ts);
+        else {
+            if (!now[0]) get_timestamp(now, sizeof now);
+            strcpy(ts, now);
+        }
+        set_asset_price(idx, q->price, ts);
+        feed_dirty[idx] = 0;
+    }
+    st->applied += feed_dirty_count;
+    feed_dirty_count = 0;
+}
+
+static void feed_checkpoint(FeedStats *st) {
+    recompute_all_basket_navs(); /* drop accumulated rounding from incremental NAVs */
+    save_prices();
+    st->checkpoints++;
+    char entry[160];
+    snprintf(entry, sizeof entry, "PRICE_FEED_CHECKPOINT|lines=%ld|applied=%ld|rejected=%ld",
+        st->lines, st->applied, st->rejected);
+    audit_log(entry);
+}
+
+/* returns 0 on success, -1 if the source could not be opened */
+static int ingest_price_feed(const char *src, FeedStats *st) {
+    memset(st, 0, sizeof *st);
+    int fd = feed_open(src);
+    if (fd < 0) return -1;
+    char *buf = malloc(FEED_BUF_SIZE);
+    if (!buf) { close(fd); return -1; }
+    size_t carry = 0;
+    time_t last_cp = time(NULL);
+    for (;;) {
+        ssize_t r = read(fd, buf + carry, FEED_BUF_SIZE - carry);
+        if (r <= 0) break;
+        size_t avail = carry + (size_t)r;
+        size_t start = 0;
+        for (;;) {
+            char *nl = memchr(buf + start, '\n', avail - start);
+            if (!nl) break;
+            size_t len = (size_t)(nl - (buf + start));
+            if (len && buf[start + len - 1] == '\r') len--;
+            if (len) feed_parse_line(buf + start, len, st);
+            start = (size_t)(nl - buf) + 1;
+        }
+        carry = avail - start;
+        if (carry == FEED_BUF_SIZE) carry = 0; /* over-long garbage line: drop it */
+        else if (carry) memmove(buf, buf + start, carry);
+        feed_apply_batch(st);
+        if (time(NULL) - last_cp >= FEED_CHECKPOINT_SECS) { feed_checkpoint(st); last_cp = time(NULL); }
+    }
+    if (carry) feed_parse_line(buf, carry, st);
+    feed_apply_batch(st);
+    feed_checkpoint(st);
+    free(buf);
+    close(fd);
+    return 0;
+}
+
+static void run_price_feed(const char *src) {
+    FeedStats st;
+    double t0 = now_seconds();
+    if (ingest_price_feed(src, &st) != 0) { printf("Cannot open price feed '%s'.\n", src); return; }
+    double secs = now_seconds() - t0;
+    printf("Feed done: %ld lines, %ld applied after conflation, %ld rejected, %d checkpoint(s)",
+        st.lines, st.applied, st.rejected, st.checkpoints);
+    if (secs > 0) printf(", %.0f lines/sec", st.lines / secs);
+    printf("\n");
+}
+
+/* ---------------- New helpers: UPI validation ---------------- */
+
+/* Validate UPI local part: only letters and digits, not empty.
+   Accept these user inputs:
+     - "alice" -> becomes "alice@bvdu"
+     - "alice@bvdu" -> accepted
+   Reject:
+     - anything with additional '@' or domain not 'bvdu'
+     - local part containing non-alnum characters or spaces
+   Returns 1 and writes normalized lowercased upi into out_upi on success, 0 on failure.
+*/
+static int validate_and_normalize_upi(const char *input, char *out_upi, size_t out_len) {
+    if (!input || !out_upi) return 0;
+    char buf[128];
+    strncpy(buf, input, sizeof buf - 1); buf[sizeof buf - 1] = '\0';
+    trim_newline(buf);
+    if (strlen(buf) == 0) return 0;
+
+    /* If contains '@', split once */
+    char *at = strchr(buf, '@');
+    if (at) {
+        /* if more than one '@' => reject */
+        if (strchr(at+1, '@') != NULL) return 0;
+        *at = '\0';
+        char *local = buf;
+        char *domain = at + 1;
+        strtolower_inplace(local); strtolower_inplace(domain);
+        /* domain must be exactly "bvdu" */
+        if (strcmp(domain, "bvdu") != 0) return 0;
+        /* local must be alnum only */
+        if (strlen(local) == 0) return 0;
+        for (size_t i = 0; i < strlen(local); ++i) {
+            if (!isalnum((unsigned char)local[i])) return 0;
+        }
+        snprintf(out_upi, out_len, "%s@bvdu", local);
+        return 1;
+    } else {
+        /* no '@' -> local part only, ensure alnum */
+        strtolower_inplace(buf);
+        for (size_t i = 0; i < strlen(buf); ++i) {
+            if (!isalnum((unsigned char)buf[i])) return 0;
+        }
+        snprintf(out_upi, out_len, "%s@bvdu", buf);
+        return 1;
+    }
+}
+
+/* ---------------- Account numbers and UPI reservations ---------------- */
+
+/* New account numbers come from a persisted high-water mark
+   (account_seq.txt). A thread takes numbers from a block it has reserved and
+   touches the shared mark only to reserve the next block: one atomic add and
+   a rewrite of the file. A reserved number is never handed out again, even
+   after a crash. A worker hands back the unused tail of its block when it
+   finishes, if nobody has reserved past it.
+   UPI ids are claimed in a lock-free open-addressing set. Checking and
+   reserving an id is one probe sequence rather than a scan of the book, and
+   two threads claiming the same id cannot both succeed. */
+
+#define ACCT_NO_BLOCK 64
+
+typedef struct {
+    _Atomic uint64_t tag;         /* 0 empty, otherwise the id's hash | 1 */
+    _Atomic int ready;            /* upi[] is written */
+    char upi[sizeof ((AccountInfo *)0)->upi];
+} UpiSlot;
+
+static _Atomic int acct_hwm;                /* first number not yet reserved, 0 = not loaded */
+static pthread_mutex_t acct_hwm_lock = PTHREAD_MUTEX_INITIALIZER;  /* orders rewrites of the file */
+static _Thread_local int acct_block_next, acct_block_end;
+static UpiSlot *upi_set;
+static size_t upi_set_mask;
+
+/* single-threaded: load the mark, never below max acc_no + 1 */
+static void acct_seq_ensure(void) {
+    if (atomic_load(&acct_hwm)) return;
+    int hwm = 1001;
+    FILE *f = fopen(F_ACCOUNT_SEQ, "r");
+    if (f) { if (fscanf(f, "%d", &hwm) != 1) hwm = 1001; fclose(f); }
+    for (int i = 0; i < acc_count; ++i) if (accounts[i].acc_no >= hwm) hwm = accounts[i].acc_no + 1;
+    atomic_store(&acct_hwm, hwm);
+}
+
+static void acct_seq_persist(void) {
+    pthread_mutex_lock(&acct_hwm_lock);
+    char text[32];
+    snprintf(text, sizeof text, "%d\n", atomic_load(&acct_hwm)); /* the newest mark, never an older one */
+    if (!atomic_write_text(F_ACCOUNT_SEQ, "account_seq.tmp", text)) perror(F_ACCOUNT_SEQ);
+    pthread_mutex_unlock(&acct_hwm_lock);
+}
+
+/* next number for this thread; block = numbers to reserve when it runs out */
+static int acct_no_take(int block) {
+    if (acct_block_next == acct_block_end) {
+        acct_block_next = atomic_fetch_add(&acct_hwm, block);
+        acct_block_end = acct_block_next + block;
+        acct_seq_persist();   /* durable before any of them is used */
+    }
+    return acct_block_next++;
+}
+
+/* what acct_no_take() would return next on this thread */
+static int acct_no_peek(void) {
+    return acct_block_next != acct_block_end ? acct_block_next : atomic_load(&acct_hwm);
+}
+
+/* give the number just taken back to this thread's block */
+static void acct_no_unget(int acc_no) {
+    if (acc_no == acct_block_next - 1) acct_block_next--;
+}
+
+/* hand the unused tail of this thread's block back, if it is still the top */
+static void acct_no_release(void) {
+    int end = acct_block_end;
+    if (acct_block_next != end && atomic_compare_exchange_strong(&acct_hwm, &end, acct_block_next)) acct_seq_persist();
+    acct_block_next = acct_block_end = 0;
+}
+
+/* single-threaded: (re)build the set from the book with room for cap ids */
+static void upi_set_init(size_t cap) {
+    size_t n = 1024;
+    while (n < 2 * cap) n *= 2;
+    free(upi_set);
+    upi_set = calloc(n, sizeof *upi_set);
+    if (!upi_set) { perror("upi_set_init"); exit(1); }
+    upi_set_mask = n - 1;
+    upi_set_stale = 0;
+}
+
+static int upi_reserve(const char *upi);
+static int cold_archived_count(void);
+static void cold_reserve_upis(void);
+static int cold_upi_taken(const char *upi);
+
+static void upi_set_ensure(void) {
+    if (!upi_set_stale && upi_set) return;
+    /* archived ids go in the set too, unless the account store answers for them */
+    upi_set_init(MAX_ACCOUNTS + (acct_store.fd >= 0 ? 0 : (size_t)cold_archived_count()));
+    for (int i = 0; i < acc_count; ++i) if (account_info[i].upi[0]) upi_reserve(account_info[i].upi);
+    cold_reserve_upis();
+}
+
+/* claim a (lowercase) UPI id; 1 if it was free, 0 if it is taken */
+static int upi_reserve(const char *upi) {
+    size_t len = strlen(upi);
+    if (len >= sizeof upi_set->upi) return 0;
+    uint64_t tag = kv_hash(upi, len) | 1;
+    for (size_t i = tag & upi_set_mask, probes = 0; probes <= upi_set_mask; i = (i + 1) & upi_set_mask, ++probes) {
+        UpiSlot *s = &upi_set[i];
+        uint64_t cur = atomic_load_explicit(&s->tag, memory_order_acquire);
+        if (cur == 0) {
+            if (atomic_compare_exchange_strong(&s->tag, &cur, tag)) {
+                memcpy(s->upi, upi, len + 1);
+                atomic_store_explicit(&s->ready, 1, memory_order_release);
+                return 1;
+            }
+            /* lost the slot to another claim: look at what it holds */
+        }
+        if (cur != tag) continue;
+        while (!atomic_load_explicit(&s->ready, memory_order_acquire)) sched_yield();
+        if (strcmp(s->upi, upi) == 0) return 0;
+    }
+    return 0;   /* full: refuse rather than risk a duplicate */
+}
+
+/* Fill a new account from its fields, reserving its UPI id and number
+   (block as for acct_no_take()). Returns 0, or -1 with the reason in err and
+   nothing reserved. Thread-safe once acct_seq_ensure() and upi_set_ensure()
+   have run. */
+static int account_build(Account *a, AccountInfo *ai, const char *name, const char *type, int pin,
+                         double deposit, const char *upi_in, int block, char *err, size_t errlen) {
+    memset(a, 0, sizeof *a);
+    memset(ai, 0, sizeof *ai);
+    if (pin < 1000 || pin > 9999) { snprintf(err, errlen, "PIN must be 4-digit."); return -1; }
+    if (!isfinite(deposit) || deposit < 0.0) { snprintf(err, errlen, "Invalid initial deposit."); return -1; }
+    snprintf(ai->name, sizeof ai->name, "%s", name);
+    snprintf(ai->acc_type, sizeof ai->acc_type, "%s", type && type[0] ? type : "Savings");
+    char candidate[128];
+    int acc_no = 0;
+    if (upi_in && upi_in[0]) {
+        if (!validate_and_normalize_upi(upi_in, candidate, sizeof candidate)) {
+            snprintf(err, errlen, "Invalid UPI. Must be letters and/or numbers only, domain must be @bvdu or omitted.");
+            return -1;
+        }
+    } else if (!validate_and_normalize_upi(ai->name, candidate, sizeof candidate)) {
+        acc_no = acct_no_take(block);   /* fallback: use acc_no as local part */
+        snprintf(candidate, sizeof candidate, "%d@bvdu", acc_no);
+    }
+    size_t len = strlen(candidate);
+    if (len >= sizeof ai->upi || cold_upi_taken(candidate) || !upi_reserve(candidate)) {
+        if (acc_no) acct_no_unget(acc_no);
+        if (len >= sizeof ai->upi) snprintf(err, errlen, "UPI too long.");
+        else snprintf(err, errlen, "UPI '%.63s' already taken. Choose a unique UPI.", candidate);
+        return -1;
+    }
+    memcpy(ai->upi, candidate, len + 1);
+    a->acc_no = acc_no ? acc_no : acct_no_take(block);
+    a->pin = pin;
+    a->balance = deposit;
+    a->active = 1;
+    a->type = (unsigned char)acc_type_index(ai->acc_type);
+    a->last_accrual = today_day();
+    get_timestamp(ai->last_login, sizeof ai->last_login);
+    return 0;
+}
+
+/* append a built account to the book (not saved) */
+static void account_add(const Account *a, const AccountInfo *ai) {
+    account_info[acc_count] = *ai;
+    accounts[acc_count++] = *a;
+    totals_account(a, 1.0);
+    acc_index_dirty = 1;
+}
+
+/* ---------------- Shared book (BVDU_SHARED=1) ---------------- */
+
+/* Front ends started in the same directory with BVDU_SHARED=1 (a teller
+   console, an admin console, a server) share one copy of the account table
+   in a file under /dev/shm instead of each loading its own, so no save can
+   overwrite another process's update. The book is guarded by one
+   process-shared mutex: a process holds it while it works and lets go only
+   while it waits for input (a prompt, the server's poll), so every request
+   sees and leaves a consistent book. Whoever saves bumps a version; the next
+   holder that sees a new version rebuilds what it derives locally (indexes,
+   totals, UPI set, account number mark). The other tables stay in their
+   files and carry a version each (one per DIRTY_* bit): holdings, trades,
+   prices and FX, idempotency keys, settlement, the hot account set and the
+   interest rate are reloaded by the next holder once another process has
+   saved them, so trade ids and replayed keys are the same everywhere.
+   The mutex is robust: if a holder dies mid-change, the next one reloads the
+   book from accounts.txt, which holds its last save. Slots only move when
+   accounts are archived, which therefore needs the book to itself. */
+
+#define BOOK_MAGIC 0x4b4f4f42u    /* "BOOK" */
+#define BOOK_PROCS 64
+#define BOOK_TABLES 8             /* one version per DIRTY_* bit */
+
+typedef struct {
+    uint32_t magic, max_accounts, account_size, info_size;
+    pthread_mutex_t lock;
+    uint64_t version[BOOK_TABLES];     /* [k] bumped when a holder saved table 1 << k */
+    int acc_count;
+    _Atomic int32_t pid[BOOK_PROCS];   /* attached front ends, 0 = free */
+    Account accounts[MAX_ACCOUNTS];
+    AccountInfo account_info[MAX_ACCOUNTS];
+} SharedBook;
+
+static SharedBook *book;          /* NULL: this process has the book to itself */
+static int book_held;
+static uint64_t book_seen[BOOK_TABLES];
+
+static int book_pid_alive(int32_t pid) {
+    return pid > 0 && !(kill(pid, 0) != 0 && errno == ESRCH);
+}
+
+/* front ends attached besides this one */
+static int book_others(void) {
+    int n = 0;
+    for (int i = 0; book && i < BOOK_PROCS; ++i) {
+        int32_t pid = atomic_load(&book->pid[i]);
+        n += pid != (int32_t)getpid() && book_pid_alive(pid);
+    }
+    return n;
+}
+
+/* DIRTY_* bits of the tables another process saved since this one looked */
+static unsigned book_changed(void) {
+    unsigned changed = 0;
+    for (int k = 0; k < BOOK_TABLES; ++k)
+        if (book->version[k] != book_seen[k]) changed |= 1u << k;
+    return changed;
+}
+
+/* another process saved: reload its tables and rebuild what this one derives */
+static void book_refresh(unsigned changed) {
+    acc_count = book->acc_count;
+    acc_index_dirty = 1;
+    upi_set_stale = 1;
+    atomic_store(&acct_hwm, 0);   /* numbers it reserved are in account_seq.txt */
+    if (changed & DIRTY_PRICES) { load_fx(); refresh_prices(); }
+    if (changed & DIRTY_HOLDINGS) load_holdings();
+    if (changed & (DIRTY_ACCOUNTS | DIRTY_HOT)) hot_reload();
+    if (changed & DIRTY_TRADES) load_trades();
+    if (changed & DIRTY_SETTLEMENT) load_settlement();   /* rebuilds the unsettled positions */
+    else if (changed & DIRTY_TRADES) rebuild_unsettled();
+    if (changed & DIRTY_IDEM) idem_scan(idem_journal_end);
+    if (changed & DIRTY_INTEREST) load_interest();
+    totals_rebuild();
+    memcpy(book_seen, book->version, sizeof book_seen);
+}
+
+static void book_wait_end(void) {
+    if (!book || book_held) return;
+    int r = pthread_mutex_lock(&book->lock);
+#ifdef __linux__
+    if (r == EOWNERDEAD) {
+        /* the holder died, maybe halfway through a change */
+        load_accounts();
+        book->acc_count = acc_count;
+        for (int k = 0; k < BOOK_TABLES; ++k) book->version[k]++;
+        pthread_mutex_consistent(&book->lock);
+        audit_log("SHARED_BOOK_RELOADED");
+    }
+#else
+    (void)r;
+#endif
+    book_held = 1;
+    unsigned changed = book_changed();
+    if (changed) book_refresh(changed);
+}
+
+static void book_wait_begin(void) {
+    if (!book || !book_held) return;
+    if (book_dirty) io_drain();   /* holdings.txt and the ledger complete for the next holder */
+    book->acc_count = acc_count;
+    for (int k = 0; k < BOOK_TABLES; ++k)
+        if (book_dirty & (1u << k)) book->version[k]++;
+    memcpy(book_seen, book->version, sizeof book_seen);
+    book_dirty = 0;
+    book_held = 0;
+    pthread_mutex_unlock(&book->lock);
+}
+
+/* leave the shared book, keeping a private copy of it */
+static void book_detach(void) {
+    if (!book) return;
+    book_wait_end();
+    memcpy(book_accounts, book->accounts, (size_t)acc_count * sizeof *accounts);
+    memcpy(book_account_info, book->account_info, (size_t)acc_count * sizeof *account_info);
+    accounts = book_accounts;
+    account_info = book_account_info;
+    for (int i = 0; i < BOOK_PROCS; ++i) {
+        int32_t me = (int32_t)getpid();
+        atomic_compare_exchange_strong(&book->pid[i], &me, 0);
+    }
+    SharedBook *b = book;
+    book_wait_begin();
+    book = NULL;
+    munmap(b, sizeof *b);
+}
+
+/* BVDU_SHARED=1 (segment named after this directory) or =<name>. The first
+   front end to attach publishes the book it loaded; later ones adopt the
+   live one. Returns 0, or -1 with this process on its own book. */
+static int book_attach(const char *spec) {
+    if (!spec || !*spec || strcmp(spec, "0") == 0) return 0;
+    if (kv.open) { printf("The KV store keeps the book in this process; not sharing it.\n"); return -1; }
+    char path[256];
+    struct stat st;
+    if (strcmp(spec, "1") == 0 && stat(".", &st) == 0)
+        snprintf(path, sizeof path, "/dev/shm/bvdu_book_%llx_%llx", (unsigned long long)st.st_dev, (unsigned long long)st.st_ino);
+    else snprintf(path, sizeof path, "/dev/shm/%s", spec[0] == '/' ? spec + 1 : spec);
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) { perror(path); return -1; }
+    /* attaching is serialised on the file, so two first front ends cannot both publish */
+    if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) { perror(path); close(fd); return -1; }
+    if (st.st_size != 0 && st.st_size != (off_t)sizeof(SharedBook)) {
+        printf("%s belongs to a differently built bank; not sharing the book.\n", path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0 && ftruncate(fd, sizeof(SharedBook)) != 0) { perror(path); close(fd); return -1; }
+    SharedBook *b = mmap(NULL, sizeof *b, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (b == MAP_FAILED) { perror(path); close(fd); return -1; }
+    int live = 0;
+    if (b->magic == BOOK_MAGIC && b->max_accounts == MAX_ACCOUNTS && b->account_size == sizeof(Account) && b->info_size == sizeof(AccountInfo))
+        for (int i = 0; i < BOOK_PROCS; ++i) {
+            if (book_pid_alive(atomic_load(&b->pid[i]))) live++;
+            else atomic_store(&b->pid[i], 0);
+        }
+    if (!live) {
+        /* first one in (or the last user is gone): publish the book loaded from the files */
+        b->magic = 0;
+        pthread_mutexattr_t ma;
+        pthread_mutexattr_init(&ma);
+        pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+        pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+#endif
+        pthread_mutex_init(&b->lock, &ma);
+        pthread_mutexattr_destroy(&ma);
+        b->max_accounts = MAX_ACCOUNTS;
+        b->account_size = sizeof(Account);
+        b->info_size = sizeof(AccountInfo);
+        for (int k = 0; k < BOOK_TABLES; ++k) b->version[k] = 1;
+        b->acc_count = acc_count;
+        memcpy(b->accounts, accounts, (size_t)acc_count * sizeof *accounts);
+        memcpy(b->account_info, account_info, (size_t)acc_count * sizeof *account_info);
+        for (int i = 0; i < BOOK_PROCS; ++i) atomic_store(&b->pid[i], 0);
+        b->magic = BOOK_MAGIC;
+    }
+    int slot = -1;
+    for (int i = 0; i < BOOK_PROCS && slot < 0; ++i) {
+        int32_t free_pid = 0;
+        if (atomic_compare_exchange_strong(&b->pid[i], &free_pid, (int32_t)getpid())) slot = i;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (slot < 0) {
+        printf("%d front ends already share %s; not sharing the book.\n", BOOK_PROCS, path);
+        munmap(b, sizeof *b);
+        return -1;
+    }
+    book = b;
+    accounts = b->accounts;
+    account_info = b->account_info;
+    /* accounts are taken from the live book; the rest is loaded from the files after this */
+    memcpy(book_seen, b->version, sizeof book_seen);
+    book_seen[0] = 0;
+    book_wait_end();
+    atexit(book_detach);
+    return 0;
+}
+
+/* ---------------- Cold storage: archive and rehydrate (cold_store.dat) ---------------- */
+
+/* Inactive accounts, and accounts nobody has logged into for years, leave the
+   working set: the account row, its holdings and its ledger rows are
+   compressed into one record appended to cold_store.dat and dropped from
+   accounts.txt, holdings.txt and transactions.txt, so every save_accounts()
+   checkpoint and every scan of the book covers only accounts in use. A
+   record is expanded on demand - when the customer logs in, or by the admin -
+   and the account comes back with its history. The store is append-only: a
+   newer record for an acc_no supersedes older ones, and a record without a
+   payload marks the account rehydrated. An archived account keeps its
+   number and its UPI id. The index of archived accounts is cold_map, or
+   with BVDU_ACCOUNT_STORE the paged account store, which keeps it off the heap. */
+
+#define COLD_MAGIC 0x53435642u    /* "BVCS" */
+#define COLD_HASH_BITS 12
+#define COLD_MIN_MATCH 4
+
+typedef struct {
+    uint32_t magic;
+    int32_t acc_no;
+    uint32_t raw_len;             /* 0: rehydrated, no payload */
+    uint32_t comp_len;
+    int64_t archived_at;
+    uint64_t check;               /* row_hash() of the raw payload */
+    char upi[sizeof ((AccountInfo *)0)->upi];
+} ColdHeader;
+
+typedef struct {
+    int acc_no;                   /* 0 = empty slot */
+    int live;                     /* archived, not rehydrated since */
+    long off;                     /* header of the newest record */
+    char upi[sizeof ((AccountInfo *)0)->upi];
+} ColdEntry;
+
+static ColdEntry *cold_map;
+static unsigned cold_cap, cold_used;
+static int cold_loaded, cold_live;
+
+static ColdEntry *cold_entry(int acc_no, int create) {
+    if (create && cold_used * 2 >= cold_cap) {
+        unsigned cap = cold_cap ? cold_cap * 2 : 256;
+        ColdEntry *t = calloc(cap, sizeof *t);
+        if (!t) { perror("cold_entry"); exit(1); }
+        for (unsigned i = 0; i < cold_cap; ++i) {
+            if (!cold_map[i].acc_no) continue;
+            unsigned h = (unsigned)cold_map[i].acc_no * 2654435761u & (cap - 1);
+            while (t[h].acc_no) h = (h + 1) & (cap - 1);
+            t[h] = cold_map[i];
+        }
+        free(cold_map);
+        cold_map = t;
+        cold_cap = cap;
+    }
+    if (!cold_cap) return NULL;
+    unsigned h = (unsigned)acc_no * 2654435761u & (cold_cap - 1);
+    while (cold_map[h].acc_no && cold_map[h].acc_no != acc_no) h = (h + 1) & (cold_cap - 1);
+    if (!cold_map[h].acc_no) {
+        if (!create) return NULL;
+        cold_map[h].acc_no = acc_no;
+        cold_used++;
+    }
+    return &cold_map[h];
+}
+
+static void cold_note(const ColdHeader *h, long off) {
+    ColdEntry *e = cold_entry(h->acc_no, 1);
+    int live = h->raw_len != 0;
+    cold_live += live - e->live;
+    e->live = live;
+    e->off = off;
+    memcpy(e->upi, h->upi, sizeof e->upi);
+    e->upi[sizeof e->upi - 1] = '\0';
+}
+
+static void cold_store_sync(void);
+
+/* index the store from its headers; a torn record left by an interrupted
+   archive run is cut off so the next append starts on a boundary. With the
+   account store attached it is the index, brought up to date instead. */
+static void cold_index_ensure(void) {
+    if (acct_store.fd >= 0) cold_store_sync();
+    if (acct_store.fd >= 0 || cold_loaded) return;
+    cold_loaded = 1;
+    FILE *f = fopen(F_COLD_STORE, "rb");
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f), off = 0;
+    ColdHeader h;
+    while (fseek(f, off, SEEK_SET) == 0 && fread(&h, sizeof h, 1, f) == 1 && h.magic == COLD_MAGIC
+           && (long)h.comp_len <= size - off - (long)sizeof h) {
+        cold_note(&h, off);
+        off += (long)sizeof h + (long)h.comp_len;
+    }
+    fclose(f);
+    if (off < size && truncate(F_COLD_STORE, off) != 0) perror(F_COLD_STORE);
+}
+
+static int cold_archived_count(void) {
+    cold_index_ensure();
+    return cold_live;
+}
+
+/* archived ids stay taken: upi_set_ensure() claims them with the book's,
+   unless the account store's UPI tree holds them (cold_upi_taken()) */
+static void cold_reserve_upis(void) {
+    if (acct_store.fd >= 0) return;
+    for (unsigned i = 0; i < cold_cap; ++i)
+        if (cold_map[i].live && cold_map[i].upi[0]) upi_reserve(cold_map[i].upi);
+}
+
+static int cold_is_archived(int acc_no) {
+    cold_index_ensure();
+    if (acct_store.fd >= 0) return acctstore_get(acc_no, NULL, NULL, NULL);
+    ColdEntry *e = cold_entry(acc_no, 0);
+    return e && e->live;
+}
+
+/* an archived account holds the id; with the store that is a UPI tree
+   lookup, locked because onboarding checks ids on several threads */
+static int cold_upi_taken(const char *upi) {
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    if (acct_store.fd < 0) return 0;   /* the UPI set holds them */
+    pthread_mutex_lock(&lock);
+    int taken = acctstore_find_upi(upi) >= 0;
+    pthread_mutex_unlock(&lock);
+    return taken;
+}
+
+/* Byte-oriented LZ77 in the manner of LZ4: each sequence is a varint literal
+   count, the literals, a varint match length (0 ends the block) and a
+   two-byte distance back into the output. Ledger rows repeat the acc_no,
+   the date and the notes, which is what the 4-byte hash finds. Output is at
+   most n + n / 16 + 16 bytes. */
+static size_t cold_put_varint(unsigned char *p, size_t v) {
+    size_t n = 0;
+    for (; v >= 0x80; v >>= 7) p[n++] = (unsigned char)(v | 0x80);
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+static int cold_get_varint(const unsigned char **p, const unsigned char *end, size_t *v) {
+    *v = 0;
+    for (int shift = 0; *p < end && shift < 63; shift += 7) {
+        unsigned char b = *(*p)++;
+        *v |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return 0;
+    }
+    return -1;
+}
+
+static size_t cold_pack(const unsigned char *in, size_t n, unsigned char *out) {
+    uint32_t table[1 << COLD_HASH_BITS] = {0};   /* position + 1 of the last sequence with each hash */
+    size_t ip = 0, lit = 0, op = 0;
+    while (ip + COLD_MIN_MATCH <= n) {
+        uint32_t seq;
+        memcpy(&seq, in + ip, sizeof seq);
+        uint32_t h = (seq * 2654435761u) >> (32 - COLD_HASH_BITS);
+        size_t cand = table[h];
+        table[h] = (uint32_t)ip + 1;
+        if (!cand || ip - (cand - 1) > 0xFFFF || memcmp(in + cand - 1, in + ip, COLD_MIN_MATCH) != 0) { ip++; continue; }
+        size_t ref = cand - 1, len = COLD_MIN_MATCH;
+        while (ip + len < n && in[ref + len] == in[ip + len]) len++;
+        op += cold_put_varint(out + op, ip - lit);
+        memcpy(out + op, in + lit, ip - lit);
+        op += ip - lit;
+        op += cold_put_varint(out + op, len);
+        out[op++] = (unsigned char)((ip - ref) & 0xFF);
+        out[op++] = (unsigned char)((ip - ref) >> 8);
+        ip += len;
+        lit = ip;
+    }
+    op += cold_put_varint(out + op, n - lit);
+    memcpy(out + op, in + lit, n - lit);
+    op += n - lit;
+    out[op++] = 0;
+    return op;
+}
+
+/* 0, or -1 if the block is damaged or does not expand to exactly n bytes */
+static int cold_unpack(const unsigned char *in, size_t len, unsigned char *out, size_t n) {
+    const unsigned char *end = in + len;
+    size_t op = 0, v;
+    for (;;) {
+        if (cold_get_varint(&in, end, &v) != 0 || v > (size_t)(end - in) || v > n - op) return -1;
+        memcpy(out + op, in, v);
+        in += v;
+        op += v;
+        if (cold_get_varint(&in, end, &v) != 0) return -1;
+        if (v == 0) return op == n ? 0 : -1;
+        if (end - in < 2) return -1;
+        size_t dist = in[0] | (size_t)in[1] << 8;
+        in += 2;
+        if (dist == 0 || dist > op || v > n - op) return -1;
+        for (size_t k = 0; k < v; ++k, ++op) out[op] = out[op - dist];   /* may overlap */
+    }
+}
+
+/* Apply cold_store.dat past meta.cold_end to the account store: an archive
+   record stores its account row and offset, a rehydration record deletes
+   it. A torn tail is cut off as in cold_index_ensure(). */
+static void cold_store_sync(void) {
+    FILE *f = fopen(F_COLD_STORE, "rb");
+    long size = 0, off = (long)acct_store.meta.cold_end;
+    if (f) { fseek(f, 0, SEEK_END); size = ftell(f); }
+    if (off == size) { if (f) fclose(f); return; }
+    if (off > size) {
+        printf("The account store is ahead of %s; rebuild it with --store-import.\n", F_COLD_STORE);
+        if (f) fclose(f);
+        acctstore_close();   /* the in-memory index takes over */
+        return;
+    }
+    ColdHeader h;
+    unsigned char *comp = NULL;
+    char *raw = NULL;
+    while (fseek(f, off, SEEK_SET) == 0 && fread(&h, sizeof h, 1, f) == 1 && h.magic == COLD_MAGIC
+           && (long)h.comp_len <= size - off - (long)sizeof h) {
+        if (!h.raw_len) acctstore_del(h.acc_no);
+        else {
+            Account a;
+            AccountInfo ai;
+            unsigned char *nc = realloc(comp, h.comp_len ? h.comp_len : 1);
+            char *nr = nc ? realloc(raw, (size_t)h.raw_len + 1) : NULL;
+            if (nc) comp = nc;
+            if (nr) raw = nr;
+            int ok = nc && nr && fread(comp, 1, h.comp_len, f) == h.comp_len
+                     && cold_unpack(comp, h.comp_len, (unsigned char *)raw, h.raw_len) == 0
+                     && (raw[h.raw_len] = '\0', raw[0] == 'A') && parse_account_row(raw + 2, &a, &ai);
+            if (!ok) {   /* keep it findable; rehydration reports the damage */
+                memset(&a, 0, sizeof a);
+                memset(&ai, 0, sizeof ai);
+                snprintf(ai.upi, sizeof ai.upi, "%s", h.upi);
+            }
+            a.acc_no = h.acc_no;
+            acctstore_put(&a, &ai, off);
+        }
+        off += (long)sizeof h + (long)h.comp_len;
+    }
+    fclose(f);
+    free(comp);
+    free(raw);
+    if (off < size && truncate(F_COLD_STORE, off) != 0) perror(F_COLD_STORE);
+    acct_store.meta.cold_end = (uint64_t)off;
+    acctstore_flush();
+}
+
+typedef struct {
+    char *p;
+    size_t len, cap;
+} ColdBuf;
+
+static void cold_buf_add(ColdBuf *b, char tag, const char *row, size_t n) {
+    if (b->len + n + 2 > b->cap) {
+        size_t cap = b->cap ? b->cap : 1024;
+        while (cap < b->len + n + 2) cap *= 2;
+        char *np = realloc(b->p, cap);
+        if (!np) { perror("cold_buf_add"); exit(1); }
+        b->p = np;
+        b->cap = cap;
+    }
+    b->p[b->len++] = tag;
+    b->p[b->len++] = '|';
+    memcpy(b->p + b->len, row, n);
+    b->len += n;
+}
+
+/* append one record; 0 or -1 */
+static int cold_write(FILE *f, long off, int acc_no, const char *upi, const ColdBuf *raw, size_t *stored) {
+    ColdHeader h;
+    memset(&h, 0, sizeof h);
+    h.magic = COLD_MAGIC;
+    h.acc_no = acc_no;
+    h.archived_at = (int64_t)time(NULL);
+    snprintf(h.upi, sizeof h.upi, "%s", upi);
+    unsigned char *comp = NULL;
+    if (raw && raw->len) {
+        comp = malloc(raw->len + raw->len / 16 + 16);
+        if (!comp) return -1;
+        h.raw_len = (uint32_t)raw->len;
+        h.comp_len = (uint32_t)cold_pack((const unsigned char *)raw->p, raw->len, comp);
+        h.check = row_hash(raw->p, raw->len, ROW_HASH_INIT);
+    }
+    int ok = fwrite(&h, sizeof h, 1, f) == 1 && (!h.comp_len || fwrite(comp, h.comp_len, 1, f) == 1);
+    free(comp);
+    if (!ok) return -1;
+    if (acct_store.fd < 0) cold_note(&h, off);   /* the store takes it in cold_store_sync() once sealed */
+    if (stored) *stored = sizeof h + h.comp_len;
+    return 0;
+}
+
+/* make the appended records durable; if that or a write (failed) went wrong,
+   cut them off again */
+static int cold_seal(FILE *f, long start, int failed) {
+    int ok = !failed && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    fclose(f);
+    if (!ok) {
+        perror(F_COLD_STORE);
+        if (truncate(F_COLD_STORE, start) != 0) perror(F_COLD_STORE);
+        cold_loaded = 0;   /* re-index from what is on disk */
+        cold_live = 0; cold_used = 0;
+        if (cold_map) memset(cold_map, 0, cold_cap * sizeof *cold_map);
+    }
+    cold_index_ensure();   /* the account store takes the new records */
+    return ok ? 0 : -1;
+}
+
+static FILE *cold_open_append(long *off) {
+    FILE *f = fopen(F_COLD_STORE, "ab");
+    if (!f) { perror(F_COLD_STORE); return NULL; }
+    fseek(f, 0, SEEK_END);
+    *off = ftell(f);
+    return f;
+}
+
+typedef struct { int acc_no, k; } ColdPick;
+
+static int cmp_cold_pick(const void *a, const void *b) {
+    int x = ((const ColdPick *)a)->acc_no, y = ((const ColdPick *)b)->acc_no;
+    return (x > y) - (x < y);
+}
+
+static int cold_pick_find(const ColdPick *picks, int n, int acc_no) {
+    ColdPick key = {acc_no, 0};
+    const ColdPick *p = bsearch(&key, picks, (size_t)n, sizeof *picks, cmp_cold_pick);
+    return p ? p->k : -1;
+}
+
+/* inactive, or last login before the cutoff day (years <= 0: inactive only) */
+static int cold_dormant(int i, int64_t cutoff) {
+    if (!accounts[i].active) return 1;
+    int y, m, d;
+    if (cutoff <= 0 || sscanf(account_info[i].last_login, "%d-%d-%d", &y, &m, &d) != 3) return 0;
+    return days_from_civil(y, m, d) < cutoff;
+}
+
+/* --archive [years] / admin: move dormant accounts to cold storage. Hot
+   accounts, open loans and unsettled trades keep an account in the book. */
+static int archive_dormant(int years) {
+    if (book_others()) { printf("Other front ends share the book; archive once they are closed.\n"); return 1; }
+    cold_index_ensure();
+    hot_fold_all();
+    io_drain();
+    double t0 = now_seconds();
+    int64_t cutoff = years > 0 ? today_day() - (int64_t)years * 365 - years / 4 : 0;
+    char *pick = calloc((size_t)(acc_count ? acc_count : 1), 1);
+    ColdPick *picks = malloc((size_t)(acc_count ? acc_count : 1) * sizeof *picks);
+    if (!pick || !picks) { perror("archive_dormant"); exit(1); }
+    int n = 0, kept_hot = 0, kept_loan = 0, kept_trades = 0;
+    for (int i = 0; i < acc_count; ++i) {
+        if (!cold_dormant(i, cutoff)) continue;
+        double cash;
+        if (hot_slot[i]) { kept_hot++; continue; }
+        if (accounts[i].loan > 0.005) { kept_loan++; continue; }
+        if (unsettled_for_account(accounts[i].acc_no, &cash) > 0) { kept_trades++; continue; }
+        pick[i] = 1;
+        picks[n].acc_no = accounts[i].acc_no;
+        picks[n].k = n;
+        n++;
+    }
+    if (!n) {
+        printf("No accounts to archive (kept: %d hot, %d with loans, %d with unsettled trades).\n", kept_hot, kept_loan, kept_trades);
+        free(pick); free(picks);
+        return 0;
+    }
+
+    /* payloads: account row, holdings, then ledger rows in file order */
+    ColdBuf *raw = calloc((size_t)n, sizeof *raw);
+    if (!raw) { perror("archive_dormant"); exit(1); }
+    char row[MAX_LINE];
+    for (int i = 0, k = 0; i < acc_count; ++i) {
+        if (!pick[i]) continue;
+        cold_buf_add(&raw[k++], 'A', row, (size_t)format_account_row(row, sizeof row, &accounts[i], &account_info[i]));
+    }
+    qsort(picks, (size_t)n, sizeof *picks, cmp_cold_pick);
+    int nhold = 0;
+    for (int i = 0; i < hold_count; ++i) {
+        int k = cold_pick_find(picks, n, holdings[i].acc_no);
+        if (k < 0) continue;
+        cold_buf_add(&raw[k], 'H', row, (size_t)format_holding_row(row, sizeof row, &holdings[i]));
+        nhold++;
+    }
+    Snapshot ledger;
+    FILE *lf = snapshot_begin(&ledger, "transactions.tmp", F_TRANSACTIONS, 0);
+    if (!lf) { perror("archive_dormant"); exit(1); }
+    FILE *in = fopen(F_TRANSACTIONS, "r");
+    long nrows = 0;
+    if (in) {
+        while (fgets(row, sizeof row, in)) {
+            int k = cold_pick_find(picks, n, atoi(row));
+            if (k < 0) { fputs(row, lf); continue; }
+            cold_buf_add(&raw[k], 'T', row, strlen(row));
+            nrows++;
+        }
+        fclose(in);
+    }
+
+    /* the records are durable before anything leaves the hot files */
+    long start;
+    size_t raw_bytes = 0, stored = 0, one;
+    FILE *cf = cold_open_append(&start);
+    int failed = !cf;
+    for (int i = 0, k = 0; i < acc_count && !failed; ++i) {
+        if (!pick[i]) continue;
+        failed = cold_write(cf, start + (long)stored, accounts[i].acc_no, account_info[i].upi, &raw[k], &one) != 0;
+        raw_bytes += raw[k++].len;
+        stored += one;
+    }
+    if (cf && cold_seal(cf, start, failed) != 0) failed = 1;
+    for (int k = 0; k < n; ++k) free(raw[k].p);
+    free(raw);
+    if (failed) {
+        fclose(ledger.f);
+        remove(ledger.tmp);
+        free(ledger.mem);
+        free(pick); free(picks);
+        printf("Archive failed; nothing was moved.\n");
+        return 1;
+    }
+
+    int h = 0;
+    for (int i = 0; i < hold_count; ++i) {
+        if (cold_pick_find(picks, n, holdings[i].acc_no) >= 0) { holding_units_changed(holdings[i].asset, -holdings[i].qty); continue; }
+        holdings[h++] = holdings[i];
+    }
+    hold_count = h;
+    int j = 0;
+    for (int i = 0; i < acc_count; ++i) {
+        if (pick[i]) {
+            char key[16];
+            totals_account(&accounts[i], -1.0);
+            snprintf(key, sizeof key, "%d", accounts[i].acc_no);
+            kv_del(CF_ACCOUNTS, key);
+            JournalShadow *js = jshadow_get(accounts[i].acc_no);
+            if (js) js->row_hash = 0;   /* a rehydrated row is journalled again */
+            continue;
+        }
+        if (i != j) {
+            accounts[j] = accounts[i];
+            account_info[j] = account_info[i];
+            hot_slot[j] = hot_slot[i];
+            hot_slot[i] = 0;
+            if (hot_slot[j]) hot_accounts[hot_slot[j] - 1].idx = j;
+        }
+        j++;
+    }
+    acc_count = j;
+    acc_index_dirty = 1;
+    save_accounts();
+    save_holdings();
+    snapshot_commit(&ledger);
+    pitr_checkpoint();   /* recovery must not replay archived rows back in */
+    free(pick); free(picks);
+
+    char audit[160];
+    snprintf(audit, sizeof audit, "ARCHIVE|accounts=%d|holdings=%d|ledger_rows=%ld|bytes=%zu->%zu", n, nhold, nrows, raw_bytes, stored);
+    audit_log(audit);
+    printf("Archived %d account(s), %d holding(s), %ld ledger row(s) in %.3f s: %zu bytes stored as %zu in %s.\n",
+        n, nhold, nrows, now_seconds() - t0, raw_bytes, stored, F_COLD_STORE);
+    printf("Kept in the book: %d hot, %d with loans, %d with unsettled trades. %d account(s) remain.\n",
+        kept_hot, kept_loan, kept_trades, acc_count);
+    return 0;
+}
+
+/* "acc_no|timestamp|..." -> timestamp (sorts as text), "" when malformed */
+static const char *ledger_row_time(const char *row) {
+    const char *bar = strchr(row, '|');
+    return bar ? bar + 1 : "";
+}
+
+/* Put an archive payload's T rows back into transactions.txt where they
+   belong in time. Both sides are already in time order, so this is one
+   merge pass through a snapshot of the ledger; an archived row goes after
+   the live rows with the same stamp. Returns the number of rows restored. */
+static long cold_merge_ledger(const char *raw) {
+    char row[MAX_LINE];
+    long nrows = 0;
+    io_drain();   /* queued appends belong to the ledger being copied */
+    Snapshot ledger;
+    FILE *lf = snapshot_begin(&ledger, "transactions.tmp", F_TRANSACTIONS, 0);
+    if (!lf) { perror("cold_rehydrate"); exit(1); }
+    FILE *in = fopen(F_TRANSACTIONS, "r");
+    const char *t = raw;
+    for (;;) {
+        int have_live = in && fgets(row, sizeof row, in);
+        while (*t) {
+            const char *end = strchr(t, '\n');
+            end = end ? end + 1 : t + strlen(t);
+            if (t[0] == 'T') {
+                if (have_live && strncmp(ledger_row_time(t + 2), ledger_row_time(row), 19) >= 0) break;
+                fwrite(t + 2, 1, (size_t)(end - t - 2), lf);
+                nrows++;
+            }
+            t = end;
+        }
+        if (!have_live) break;
+        fputs(row, lf);
+    }
+    if (in) fclose(in);
+    snapshot_commit(&ledger);
+    return nrows;
+}
+
+/* Bring an archived account back with its holdings and ledger rows. 0, or -1
+   with the reason in err. */
+static int cold_rehydrate(int acc_no, char *err, size_t errlen) {
+    cold_index_ensure();
+    ColdEntry *e = acct_store.fd >= 0 ? NULL : cold_entry(acc_no, 0);
+    long off = 0;
+    if (acct_store.fd >= 0 ? !acctstore_get(acc_no, NULL, NULL, &off) : !e || !e->live) {
+        snprintf(err, errlen, "Account %d is not archived.", acc_no);
+        return -1;
+    }
+    if (e) off = e->off;
+    if (find_account_index(acc_no) >= 0) { snprintf(err, errlen, "Account %d is already in the book.", acc_no); return -1; }
+    if (acc_count >= MAX_ACCOUNTS) { snprintf(err, errlen, "Account limit reached."); return -1; }
+    FILE *f = fopen(F_COLD_STORE, "rb");
+    if (!f) { snprintf(err, errlen, "Cannot read %s.", F_COLD_STORE); return -1; }
+    ColdHeader h;
+    unsigned char *comp = NULL;
+    char *raw = NULL;
+    int ok = fseek(f, off, SEEK_SET) == 0 && fread(&h, sizeof h, 1, f) == 1 && h.magic == COLD_MAGIC && h.acc_no == acc_no
+             && (comp = malloc(h.comp_len ? h.comp_len : 1)) && (raw = malloc((size_t)h.raw_len + 1))
+             && fread(comp, 1, h.comp_len, f) == h.comp_len
+             && cold_unpack(comp, h.comp_len, (unsigned char *)raw, h.raw_len) == 0
+             && row_hash(raw, h.raw_len, ROW_HASH_INIT) == h.check;
+    fclose(f);
+    free(comp);
+    if (!ok) { free(raw); snprintf(err, errlen, "Archive record for %d is damaged.", acc_no); return -1; }
+    raw[h.raw_len] = '\0';
+
+    /* parse everything before changing the book */
+    Account a;
+    AccountInfo ai;
+    int have_acc = 0, nh = 0;
+    Holding *hs = malloc((size_t)(MAX_HOLDINGS - hold_count + 1) * sizeof *hs);
+    if (!hs) { free(raw); snprintf(err, errlen, "Out of memory."); return -1; }
+    long nrows = 0;
+    for (char *line = raw, *next; *line; line = next) {
+        next = strchr(line, '\n');
+        next = next ? next + 1 : line + strlen(line);
+        if (line[0] == 'A') have_acc = parse_account_row(line + 2, &a, &ai);
+        else if (line[0] == 'H') {
+            if (hold_count + nh >= MAX_HOLDINGS) { ok = 0; break; }
+            if (parse_holding_row(line + 2, &hs[nh])) nh++;
+        }
+    }
+    if (!have_acc || !ok) {
+        free(hs); free(raw);
+        snprintf(err, errlen, have_acc ? "Holding limit reached." : "Archive record for %d has no account row.", acc_no);
+        return -1;
+    }
+    account_add(&a, &ai);
+    if (acct_store.fd >= 0) upi_set_stale = 1;   /* its id was in the store's UPI tree, not the set */
+    for (int i = 0; i < nh; ++i) {
+        holdings[hold_count++] = hs[i];
+        holding_units_changed(hs[i].asset, hs[i].qty);
+    }
+    save_accounts();
+    save_holdings();
+    nrows = cold_merge_ledger(raw);
+    free(hs); free(raw);
+
+    /* the tombstone goes last: until it is down the account is in both places,
+       never in neither */
+    long start;
+    FILE *cf = cold_open_append(&start);
+    if (cf) cold_seal(cf, start, cold_write(cf, start, acc_no, ai.upi, NULL, NULL) != 0);
+    char audit[96];
+    snprintf(audit, sizeof audit, "REHYDRATE|%d|holdings=%d|ledger_rows=%ld", acc_no, nh, nrows);
+    audit_log(audit);
+    return 0;
+}
+
+/* BVDU_ACCOUNT_STORE=<file>: archived accounts live in a paged store */
+static void acctstore_attach(const char *path) {
+    if (!path || !*path || acctstore_open(path, BT_POOL_PAGES) != 0) return;
+    cold_store_sync();
+    if (acct_store.fd >= 0) atexit(acctstore_close);
+}
+
+/* --store-import <file>: (re)build a store from cold_store.dat */
+static int acctstore_import(const char *path) {
+    remove(path);
+    double t0 = now_seconds();
+    if (acctstore_open(path, BT_POOL_PAGES) != 0) return 1;
+    cold_store_sync();
+    unsigned long long n = acct_store.meta.records;
+    unsigned pages = acct_store.meta.page_count;
+    acctstore_close();
+    printf("Imported %llu archived account(s) into %s (%u pages) in %.3fs.\n", n, path, pages, now_seconds() - t0);
+    return 0;
+}
+
+/* --store-get <file> <acc_no|upi> */
+static int acctstore_lookup(const char *path, const char *what) {
+    if (acctstore_open(path, BT_POOL_PAGES) != 0) return 1;
+    int acc_no = strspn(what, "0123456789") == strlen(what) ? atoi(what) : acctstore_find_upi(what);
+    Account a;
+    AccountInfo ai;
+    long off = 0;
+    int found = acc_no > 0 && acctstore_get(acc_no, &a, &ai, &off);
+    if (found) {
+        char row[MAX_LINE];
+        format_account_row(row, sizeof row, &a, &ai);
+        fputs(row, stdout);
+        printf("(archived, record at offset %ld of %s)\n", off, F_COLD_STORE);
+    } else printf("No archived account '%s' in %s.\n", what, path);
+    printf("(%llu account(s), %llu page read(s))\n", (unsigned long long)acct_store.meta.records, (unsigned long long)acct_store.misses);
+    acctstore_close();
+    return !found;
+}
+
+/* --rehydrate <acc_no> */
+static int run_rehydrate(int acc_no) {
+    char msg[96];
+    double t0 = now_seconds();
+    if (cold_rehydrate(acc_no, msg, sizeof msg) != 0) { printf("%s\n", msg); return 1; }
+    printf("Account %d restored from %s in %.3f s.\n", acc_no, F_COLD_STORE, now_seconds() - t0);
+    return 0;
+}
+
+/* ---------------- User actions: accounts ---------------- */
+
+static void create_account_interactive(void) {
+    if (acc_count >= MAX_ACCOUNTS) { printf("Account limit reached.\n"); return; }
+    char buf[256], name[50], type[20], upi[128];
+    acct_seq_ensure();
+    upi_set_ensure();
+
+    /* auto-assign account number */
+    printf("Creating account number: %d\n", acct_no_peek());
+
+    printf("Enter name (single word preferred): ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    snprintf(name, sizeof name, "%.*s", (int)sizeof name - 1, buf);
+
+    printf("Account type (Savings/Current) [Savings]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    snprintf(type, sizeof type, "%.*s", (int)sizeof type - 1, buf);
+
+    printf("Set 4-digit PIN: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    int pin = atoi(buf);
+    if (pin < 1000 || pin > 9999) { printf("PIN must be 4-digit.\n"); return; }
+
+    printf("Initial deposit amount (INR): ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    double deposit = atof(buf);
+
+    /* UPI selection: validated and reserved by account_build() */
+    printf("Choose UPI local part (letters/numbers only). Leave empty to use '%s': ", name);
+    if (!safe_read_line(buf, sizeof buf)) return;
+    snprintf(upi, sizeof upi, "%.*s", (int)sizeof upi - 1, buf);
+
+    Account a;
+    AccountInfo ai;
+    char err[128];
+    if (account_build(&a, &ai, name, type, pin, deposit, upi, 1, err, sizeof err) != 0) { printf("%s\n", err); return; }
+    account_add(&a, &ai);
+    save_accounts();
+
+    char note[128]; snprintf(note, sizeof note, "Account created (UPI:%s)", ai.upi);
+    log_transaction(a.acc_no, "CREATE", a.balance, a.balance, note);
+    char audit[256]; snprintf(audit, sizeof audit, "CREATE_ACCOUNT|%d|%s|%s", a.acc_no, ai.name, ai.upi);
+    audit_log(audit);
+    push_notification(a.acc_no, "Welcome! Account created.");
+    printf("Account %d created with UPI '%s'.\n", a.acc_no, ai.upi);
+}
+
+/* --onboard <file> [threads]: bulk account creation, one
+   "name|type|pin|deposit|upi" per line (type and upi may be empty). Lines are
+   split into contiguous shards built in parallel; the book is then saved once. */
+#define ONBOARD_MAX_THREADS 64
+
+typedef struct {
+    char **lines;
+    int first, n;
+    Account *acc;
+    AccountInfo *info;
+    int made;
+    char (*err)[128];             /* per line, "" when created */
+} OnboardShard;
+
+static _Atomic int onboard_room;
+
+static void *onboard_worker(void *arg) {
+    OnboardShard *sh = arg;
+    sh->made = 0;
+    for (int i = 0; i < sh->n; ++i) {
+        char *f[5] = {0}, *p = sh->lines[sh->first + i];
+        char *err = sh->err[sh->first + i];
+        int nf = 0;
+        for (f[nf++] = p; nf < 5 && (p = strchr(p, '|')); f[nf++] = ++p) *p = '\0';
+        if (nf < 4) { snprintf(err, 128, "expected name|type|pin|deposit|upi"); continue; }
+        if (atomic_fetch_sub(&onboard_room, 1) <= 0) {
+            atomic_fetch_add(&onboard_room, 1);
+            snprintf(err, 128, "account limit reached");
+            continue;
+        }
+        if (account_build(&sh->acc[sh->made], &sh->info[sh->made], f[0], f[1], atoi(f[2]), atof(f[3]),
+                          nf == 5 ? f[4] : "", ACCT_NO_BLOCK, err, 128) != 0) {
+            atomic_fetch_add(&onboard_room, 1);
+            continue;
+        }
+        err[0] = '\0';
+        sh->made++;
+    }
+    acct_no_release();
+    return NULL;
+}
+
+/* build at most room accounts from n lines on nthreads threads; shards[]
+   receive them */
+static int onboard_build(char **lines, int n, int nthreads, int room, OnboardShard *shards, char (*err)[128]) {
+    acct_seq_ensure();
+    upi_set_ensure();
+    atomic_store(&onboard_room, room);
+    pthread_t tids[ONBOARD_MAX_THREADS];
+    int started[ONBOARD_MAX_THREADS] = {0};
+    for (int t = 0; t < nthreads; ++t) {
+        OnboardShard *sh = &shards[t];
+        sh->lines = lines; sh->err = err;
+        sh->first = (int)((long)n * t / nthreads);
+        sh->n = (int)((long)n * (t + 1) / nthreads) - sh->first;
+        sh->acc = malloc((size_t)(sh->n ? sh->n : 1) * sizeof *sh->acc);
+        sh->info = malloc((size_t)(sh->n ? sh->n : 1) * sizeof *sh->info);
+        if (!sh->acc || !sh->info) { perror("onboard_build"); exit(1); }
+    }
+    for (int t = 1; t < nthreads; ++t)
+        started[t] = pthread_create(&tids[t], NULL, onboard_worker, &shards[t]) == 0;
+    onboard_worker(&shards[0]);
+    int made = shards[0].made;
+    for (int t = 1; t < nthreads; ++t) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else onboard_worker(&shards[t]);
+        made += shards[t].made;
+    }
+    return made;
+}
+
+static int run_onboard(const char *path, int nthreads) {
+    FILE *f = fopen(path, "r");
+    if (!f) { printf("Cannot read %s.\n", path); return 1; }
+    int n = 0, cap = 0;
+    char **lines = NULL, line[MAX_LINE];
+    int *line_no = NULL, no = 0;
+    while (fgets(line, sizeof line, f)) {
+        no++;
+        trim_newline(line);
+        if (!line[0] || line[0] == '#') continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 256;
+            char **nl = realloc(lines, (size_t)cap * sizeof *nl);
+            int *nn = realloc(line_no, (size_t)cap * sizeof *nn);
+            if (!nl || !nn) { perror("run_onboard"); exit(1); }
+            lines = nl; line_no = nn;
+        }
+        line_no[n] = no;
+        lines[n++] = strdup(line);
+    }
+    fclose(f);
+    if (nthreads < 1) nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > ONBOARD_MAX_THREADS) nthreads = ONBOARD_MAX_THREADS;
+    if (nthreads > n) nthreads = n;
+    if (nthreads < 1) nthreads = 1;
+    OnboardShard shards[ONBOARD_MAX_THREADS];
+    char (*err)[128] = calloc((size_t)(n ? n : 1), sizeof *err);
+    if (!err) { perror("run_onboard"); exit(1); }
+    double t0 = now_seconds();
+    int made = onboard_build(lines, n, nthreads, MAX_ACCOUNTS - acc_count, shards, err);
+    double secs = now_seconds() - t0;
+
+    static OutBuf ledger_out;
+    ledger_out.append_path = F_TRANSACTIONS;
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    for (int t = 0; t < nthreads; ++t) {
+        for (int i = 0; i < shards[t].made; ++i) {
+            account_add(&shards[t].acc[i], &shards[t].info[i]);
+            /* acc_no|timestamp|type|amount|balance_after|note */
+            ob_printf(&ledger_out, "%d|%s|CREATE|%.2f|%.2f|Account created (UPI:%s)\n", shards[t].acc[i].acc_no, ts,
+                shards[t].acc[i].balance, shards[t].acc[i].balance, shards[t].info[i].upi);
+        }
+        free(shards[t].acc); free(shards[t].info);
+    }
+    if (made) { save_accounts(); ob_flush(&ledger_out); }
+    for (int i = 0; i < n; ++i) {
+        if (err[i][0]) printf("Line %d skipped: %s\n", line_no[i], err[i]);
+        free(lines[i]);
+    }
+    free(lines); free(line_no); free(err);
+    char audit[160];
+    snprintf(audit, sizeof audit, "ONBOARD|%s|created=%d|skipped=%d", path, made, n - made);
+    audit_log(audit);
+    printf("Created %d account(s) on %d thread(s) in %.3f s; %d line(s) skipped.\n", made, nthreads, secs, n - made);
+    return 0;
+}
+
+/* Authenticate - returns account index or -1.
+   If PIN wrong increments failed_attempts and freezes after 3. */
+/* account usable for login? -1 with the reason in out otherwise */
+static int login_account(int acc_no, char *out, size_t outlen) {
+    int idx = find_account_index(acc_no);
+    if (idx == -1 && cold_is_archived(acc_no)) {   /* dormant: bring it back on first login */
+        if (cold_rehydrate(acc_no, out, outlen) != 0) return -1;
+        idx = find_account_index(acc_no);
+    }
+    if (idx == -1) { snprintf(out, outlen, "Account not found."); return -1; }
+    if (!accounts[idx].active) { snprintf(out, outlen, "Account inactive."); return -1; }
+    if (accounts[idx].frozen) { snprintf(out, outlen, "Account frozen. Contact admin."); return -1; }
+    return idx;
+}
+
+/* PIN check with the three-strikes freeze; returns idx or -1 (reason in out) */
+static int login_check_pin(int idx, int pin, char *out, size_t outlen) {
+    if (accounts[idx].pin == pin) {
+        accounts[idx].failed_attempts = 0;
+        get_timestamp(account_info[idx].last_login, sizeof account_info[idx].last_login);
+        save_accounts();
+        out[0] = '\0';
+        return idx;
+    }
+    accounts[idx].failed_attempts++;
+    if (accounts[idx].failed_attempts >= 3) {
+        accounts[idx].frozen = 1;
+        save_accounts();
+        audit_log("ACCOUNT_FROZEN");
+        snprintf(out, outlen, "Too many failed attempts. Account frozen. Admin must unfreeze.");
+    } else {
+        save_accounts();
+        snprintf(out, outlen, "Invalid PIN. Attempts left: %d", 3 - accounts[idx].failed_attempts);
+    }
+    return -1;
+}
+
+static int authenticate_prompt(void) {
+    char buf[128], msg[96];
+    printf("Enter account number: ");
+    if (!safe_read_line(buf, sizeof buf)) return -1;
+    int acc_no = atoi(buf);
+    int idx = login_account(acc_no, msg, sizeof msg);
+    if (idx < 0) { printf("%s\n", msg); return -1; }
+
+    printf("Enter PIN: ");
+    if (!safe_read_line(buf, sizeof buf)) return -1;
+    int pin = atoi(buf);
+    idx = login_check_pin(idx, pin, msg, sizeof msg);
+    if (idx < 0) printf("%s\n", msg);
+    return idx;
+}
+
+/* cash in (amt > 0) or out (amt < 0); same result contract as transfer_funds() */
+static int cash_movement(int idx, double amt, const char *key, char *out, size_t outlen) {
+    if (idem_replay(accounts[idx].acc_no, key, out, outlen)) return 0;
+    if (!isfinite(amt) || !(amt >= 0.01 || amt <= -0.01)) { snprintf(out, outlen, "Invalid amount."); return -1; }
+    if (-amt > account_available(idx)) { snprintf(out, outlen, "Insufficient funds."); return -1; }
+    account_credit(idx, amt);
+    snprintf(out, outlen, amt > 0 ? "Deposit complete. New balance: %.2f INR" : "Withdraw successful. New balance: %.2f INR", accounts[idx].balance);
+    idem_remember(accounts[idx].acc_no, key, out);
+    save_accounts();
+    log_transaction(accounts[idx].acc_no, amt > 0 ? "DEPOSIT" : "WITHDRAW", amt, accounts[idx].balance, amt > 0 ? "Deposit" : "Withdraw");
+    push_notification(accounts[idx].acc_no, amt > 0 ? "Deposit successful." : "Withdrawal processed.");
+    return 0;
+}
+
+/* Move amt between two accounts (upi selects UPI wording and checks). The
+   client-facing result goes to out; returns 0 when money moved, -1 when the
+   request was refused. A repeated idempotency key returns the first result. */
+static int transfer_funds(int from_idx, int to_idx, double amt, int upi, const char *key, char *out, size_t outlen) {
+    if (idem_replay(accounts[from_idx].acc_no, key, out, outlen)) return 0;
+    if (!accounts[to_idx].active) { snprintf(out, outlen, upi ? "Destination not active." : "Destination not found or not active."); return -1; }
+    if (accounts[to_idx].frozen) { snprintf(out, outlen, upi ? "Destination frozen." : "Destination frozen. Cannot receive funds."); return -1; }
+    if (to_idx == from_idx) { snprintf(out, outlen, upi ? "Cannot send to own UPI." : "Cannot transfer to same account."); return -1; }
+    if (!isfinite(amt) || !(amt >= 0.01)) { snprintf(out, outlen, upi ? "Invalid." : "Invalid amount."); return -1; }
+    if (amt > account_available(from_idx)) { snprintf(out, outlen, "Insufficient funds."); return -1; }
+    account_credit(from_idx, -amt);
+    account_receive(to_idx, amt);
+    snprintf(out, outlen, upi ? "UPI transfer completed. New balance: %.2f INR" : "Transfer successful. New balance: %.2f INR", accounts[from_idx].balance);
+    idem_remember(accounts[from_idx].acc_no, key, out);
+    save_accounts();
+    char note1[80], note2[80];
+    if (upi) {
+        snprintf(note1, sizeof note1, "UPI to %s", account_info[to_idx].upi);
+        snprintf(note2, sizeof note2, "UPI from %s", account_info[from_idx].upi);
+    } else {
+        snprintf(note1, sizeof note1, "Transfer to %d", accounts[to_idx].acc_no);
+        snprintf(note2, sizeof note2, "Transfer from %d", accounts[from_idx].acc_no);
+    }
+    log_transaction(accounts[from_idx].acc_no, upi ? "UPI_OUT" : "TRANSFER_OUT", -amt, accounts[from_idx].balance, note1);
+    log_transaction(accounts[to_idx].acc_no, upi ? "UPI_IN" : "TRANSFER_IN", amt, accounts[to_idx].balance, note2);
+    push_notification(accounts[to_idx].acc_no, upi ? "You received money via UPI." : "You have received a transfer.");
+    return 0;
+}
+
+/* ---------------- Batch payments (one to many, many to one) ---------------- */
+
+/* A batch is a list of legs that nets to zero: one debit fanning out to many
+   credits (bulk disbursement) or many debits into one credit (split bill).
+   Every leg is validated before any balance moves, the legs are applied in
+   memory together, one save_accounts() snapshot commits them all, and the
+   ledger rows go to transactions.txt in a single buffered append. */
+
+#define MAX_BATCH_LEGS 256
+
+typedef struct {
+    int idx;        /* accounts[] slot */
+    double amount;  /* INR; negative debits the account, positive credits it */
+} PayLeg;
+
+/* returns 0, or -1 with the reason in err; nothing is changed either way
+   (apart from folding hot-account stripes, which keeps balances equal) */
+static int batch_validate(const PayLeg *legs, int n, char *err, size_t errlen) {
+    if (n < 2 || n > MAX_BATCH_LEGS) { snprintf(err, errlen, "a batch needs 2 to %d legs", MAX_BATCH_LEGS); return -1; }
+    double net = 0.0;
+    for (int i = 0; i < n; ++i) {
+        if (legs[i].idx < 0 || legs[i].idx >= acc_count) { snprintf(err, errlen, "leg %d: unknown account", i + 1); return -1; }
+        const Account *a = &accounts[legs[i].idx];
+        if (!a->active || a->frozen) { snprintf(err, errlen, "account %d is not active or is frozen", a->acc_no); return -1; }
+        if (!(legs[i].amount >= 0.01 || legs[i].amount <= -0.01)) { snprintf(err, errlen, "leg %d: invalid amount", i + 1); return -1; }
+        net += legs[i].amount;
+    }
+    if (net > 0.005 || net < -0.005) { snprintf(err, errlen, "legs do not balance (net %+.2f INR)", net); return -1; }
+    /* an account may be debited by several legs: check its total once */
+    for (int i = 0; i < n; ++i) {
+        if (legs[i].amount > 0) continue;
+        int seen = 0;
+        for (int j = 0; j < i && !seen; ++j) seen = legs[j].idx == legs[i].idx && legs[j].amount < 0;
+        if (seen) continue;
+        double out = 0.0;
+        for (int j = i; j < n; ++j) if (legs[j].idx == legs[i].idx && legs[j].amount < 0) out -= legs[j].amount;
+        if (out > account_available(legs[i].idx) + 0.005) {
+            snprintf(err, errlen, "insufficient funds in %d (needs %.2f INR)", accounts[legs[i].idx].acc_no, out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* apply a validated batch; notes[i] is the ledger note of leg i */
+static void batch_apply(const PayLeg *legs, int n, const char *type_out, const char *type_in, char (*notes)[80]) {
+    for (int i = 0; i < n; ++i) {
+        if (legs[i].amount < 0) account_credit(legs[i].idx, legs[i].amount);
+        else account_receive(legs[i].idx, legs[i].amount);
+    }
+    save_accounts();
+    Transaction t;
+    get_timestamp(t.timestamp, sizeof t.timestamp);
+    char *buf = malloc((size_t)n * MAX_LINE);
+    size_t len = 0;
+    for (int i = 0; i < n; ++i) {
+        t.acc_no = accounts[legs[i].idx].acc_no;
+        snprintf(t.type, sizeof t.type, "%s", legs[i].amount < 0 ? type_out : type_in);
+        t.amount = legs[i].amount;
+        t.balance_after = accounts[legs[i].idx].balance;
+        snprintf(t.note, sizeof t.note, "%s", notes[i]);
+        if (buf) len += (size_t)format_transaction(buf + len, MAX_LINE, &t);
+        else append_transaction(&t); /* no memory for the buffer: one row at a time */
+    }
+    if (buf && io_append(F_TRANSACTIONS, buf, len, 0) != 0) perror("batch_apply");
+    free(buf);
+    for (int i = 0; i < n; ++i)
+        if (legs[i].amount > 0) push_notification(accounts[legs[i].idx].acc_no, "You have received a batch payment.");
+}
+
+/* --pay-batch <file> [key]: operator batch, "acc_no|amount" per line
+   (negative = debit), e.g. a split bill collected from several accounts into
+   one. With a key, a retried run reports the first run's result instead of
+   paying twice. */
+static int run_pay_batch(const char *path, const char *key) {
+    static PayLeg legs[MAX_BATCH_LEGS];
+    static char notes[MAX_BATCH_LEGS][80];
+    char result[IDEM_RESULT_MAX];
+    if (key && !idem_key_valid(key)) { printf("Invalid idempotency key.\n"); return 1; }
+    if (idem_replay(0, key, result, sizeof result)) { printf("%s (repeat of key %s)\n", result, key); return 0; }
+    FILE *f = fopen(path, "r");
+    if (!f) { printf("Cannot read %s.\n", path); return 1; }
+    int n = 0;
+    char line[MAX_LINE];
+    while (fgets(line, sizeof line, f)) {
+        trim_newline(line);
+        if (!line[0] || line[0] == '#') continue;
+        int acc; double amt;
+        if (n == MAX_BATCH_LEGS || sscanf(line, "%d|%lf", &acc, &amt) != 2) { printf("Bad batch line: %s\n", line); fclose(f); return 1; }
+        legs[n].idx = find_account_index(acc);
+        legs[n].amount = amt;
+        if (legs[n].idx < 0) { printf("Unknown account %d.\n", acc); fclose(f); return 1; }
+        ++n;
+    }
+    fclose(f);
+    int payers = 0, payees = 0;
+    for (int i = 0; i < n; ++i) { if (legs[i].amount < 0) ++payers; else ++payees; }
+    for (int i = 0; i < n; ++i) {
+        if (legs[i].amount < 0) snprintf(notes[i], sizeof notes[i], "Batch to %d payee(s)", payees);
+        else snprintf(notes[i], sizeof notes[i], "Batch from %d payer(s)", payers);
+    }
+    char err[128];
+    if (batch_validate(legs, n, err, sizeof err) != 0) { printf("Batch rejected: %s. Nothing was paid.\n", err); return 1; }
+    snprintf(result, sizeof result, "Applied %d leg(s) from %s.", n, path);
+    idem_remember(0, key, result); /* committed by batch_apply's save */
+    batch_apply(legs, n, "BATCH_OUT", "BATCH_IN", notes);
+    char audit[96]; snprintf(audit, sizeof audit, "PAY_BATCH|%s|%d legs", path, n); audit_log(audit);
+    printf("%s\n", result);
+    return 0;
+}
+
+/* mini-statement */
+/* the account's last MINI_STAT_LIMIT ledger rows, oldest first (NULL-padded
+   at the front, caller frees); -1 when there is no ledger yet */
+static int last_transactions(int acc_no, char *lines[MINI_STAT_LIMIT]) {
+    io_drain();
+    FILE *f = fopen(F_TRANSACTIONS, "r");
+    if (!f) return -1;
+    for (int i = 0; i < MINI_STAT_LIMIT; ++i) lines[i] = NULL;
+    char buf[MAX_LINE];
+    while (fgets(buf, sizeof buf, f)) {
+        int txn_acc = 0;
+        if (sscanf(buf, "%d|", &txn_acc) != 1) continue;
+        if (txn_acc != acc_no) continue;
+        if (lines[0]) { free(lines[0]); lines[0] = NULL; }
+        for (int j = 1; j < MINI_STAT_LIMIT; ++j) lines[j-1] = lines[j];
+        lines[MINI_STAT_LIMIT-1] = strdup(buf);
+    }
+    fclose(f);
+    return 0;
+}
+
+static void print_mini_statement_for_account(FILE *out, int acc_no) {
+    char *lines[MINI_STAT_LIMIT];
+    if (last_transactions(acc_no, lines) != 0) { fprintf(out, "No transactions yet.\n"); return; }
+    fprintf(out, "Mini-statement (last %d):\n", MINI_STAT_LIMIT);
+    for (int i = 0; i < MINI_STAT_LIMIT; ++i) {
+        if (lines[i]) { fprintf(out, "%s", lines[i]); free(lines[i]); }
+    }
+}
+
+/* ---------------- Trading: list, buy, sell ---------------- */
+
+static void ensure_default_prices(void) {
+    if (price_count > 0) return;
+    /* create a few default assets across markets */
+    price_count = 0;
+    PriceRec p;
+    get_timestamp(p.last_update, sizeof p.last_update);
+
+    strncpy(p.asset_id, "INFY", sizeof p.asset_id - 1);
+    strncpy(p.asset_name, "Infosys Ltd", sizeof p.asset_name - 1);
+    p.price = 1500.0; p.vol = 0.01; strncpy(p.market, "IN", sizeof p.market - 1);
+    p.open_hour = 9; p.close_hour = 15; prices[price_count++] = p;
+
+    strncpy(p.asset_id, "TCS", sizeof p.asset_id - 1);
+    strncpy(p.asset_name, "TCS", sizeof p.asset_name - 1);
+    p.price = 3200.0; p.vol = 0.008; strncpy(p.market, "IN", sizeof p.market - 1);
+    p.open_hour = 9; p.close_hour = 15; prices[price_count++] = p;
+
+    strncpy(p.asset_id, "AAPL", sizeof p.asset_id - 1);
+    strncpy(p.asset_name, "Apple Inc", sizeof p.asset_name - 1);
+    p.price = 190.0; p.vol = 0.02; strncpy(p.market, "US", sizeof p.market - 1);
+    p.open_hour = 9; p.close_hour = 17; prices[price_count++] = p;
+
+    strncpy(p.asset_id, "NVDA", sizeof p.asset_id - 1);
+    strncpy(p.asset_name, "NVIDIA Corp", sizeof p.asset_name - 1);
+    p.price = 190.0; p.vol = 0.03; strncpy(p.market, "US", sizeof p.market - 1);
+    p.open_hour = 9; p.close_hour = 17; prices[price_count++] = p;
+
+    strncpy(p.asset_id, "BTC", sizeof p.asset_id - 1);
+    strncpy(p.asset_name, "Bitcoin", sizeof p.asset_name - 1);
+    p.price = 35000.0; p.vol = 0.05; strncpy(p.market, "US", sizeof p.market - 1);
+    p.open_hour = 0; p.close_hour = 24; prices[price_count++] = p;
+
+    strncpy(p.asset_id, "SIE", sizeof p.asset_id - 1);
+    strncpy(p.asset_name, "Siemens", sizeof p.asset_name - 1);
+    p.price = 120.0; p.vol = 0.018; strncpy(p.market, "EU", sizeof p.market - 1);
+    p.open_hour = 8; p.close_hour = 18; prices[price_count++] = p;
+
+    rebuild_price_index();
+    refresh_all_price_inr();
+    publish_all_quotes();
+    save_prices();
+    audit_log("INITIALIZED_DEFAULT_PRICES");
+}
+
+/* list prices — if market open do a tick (simulate live) before listing */
+static void list_market_prices(FILE *out) {
+    ensure_default_prices();
+    /* do a tick for each market that is open */
+    tick_market_once();
+    fprintf(out, "AssetID  Market  AssetName                Price (native)\n");
+    for (int i = 0; i < price_count; ++i) {
+        if (is_synthetic[i]) continue;
+        PriceRec *p = &prices[i];
+        fprintf(out, "%-7s  %-5s  %-22s  %.4f    (last: %s)\n",
+            p->asset_id, p->market, p->asset_name, p->price, p->last_update);
+    }
+}
+
+/* helper: convert price (native) and quantity to INR cost */
+static double cost_in_inr_for_purchase(const PriceRec *p, double qty) {
+    double cost_native = p->price * qty;
+    if (strcmp(p->market, "IN") == 0) return cost_native;
+    if (strcmp(p->market, "US") == 0) return cost_native * fx.inr_per_usd;
+    if (strcmp(p->market, "EU") == 0) return cost_native * fx.inr_per_eur;
+    return cost_native;
+}
+
+/* Buy qty of prices[pidx] for cash. Result text goes to out; returns 0 when
+   the trade happened, -1 when refused. A repeated key returns the first result. */
+static int trade_buy(int acc_idx, int pidx, double qty, const char *key, char *out, size_t outlen) {
+    if (idem_replay(accounts[acc_idx].acc_no, key, out, outlen)) return 0;
+    PriceRec *pr = &prices[pidx];
+    if (!market_is_open(pr)) {
+        snprintf(out, outlen, "Market for %s (%s) is currently closed (open %02d:00 to %02d:00).", pr->asset_id, pr->market, pr->open_hour, pr->close_hour);
+        return -1;
+    }
+    if (!(qty >= 0.000001)) { snprintf(out, outlen, "Invalid quantity."); return -1; }
+    double cost_inr = cost_in_inr_for_purchase(pr, qty);
+    if (!(cost_inr >= 0.01)) { snprintf(out, outlen, "Invalid quantity."); return -1; }
+    FeeQuote fee = compute_fees(pidx, 'B', cost_inr, account_month_volume(accounts[acc_idx].acc_no));
+    if (cost_inr + fee.total > account_available(acc_idx)) { snprintf(out, outlen, "Insufficient cash (need %.2f INR incl. %.2f fees).", cost_inr + fee.total, fee.total); return -1; }
+    int hidx = find_holding_index(accounts[acc_idx].acc_no, pidx);
+    if (hidx < 0 && hold_count >= MAX_HOLDINGS) { snprintf(out, outlen, "Holdings limit reached."); return -1; }
+
+    /* deduct cash */
+    account_credit(acc_idx, -(cost_inr + fee.total));
+
+    /* update or add holding */
+    if (hidx < 0) {
+        Holding h;
+        h.acc_no = accounts[acc_idx].acc_no;
+        h.asset = pidx;
+        h.qty = qty;
+        h.avg_price = pr->price;
+        holdings[hold_count++] = h;
+        holding_units_changed(pidx, qty);
+    } else {
+        Holding *h = &holdings[hidx];
+        /* avg price in native currency */
+        double total_old = h->avg_price * h->qty;
+        double total_new = pr->price * qty;
+        h->qty += qty;
+        holding_units_changed(pidx, qty);
+        if (h->qty > 0.0) h->avg_price = (total_old + total_new) / h->qty;
+    }
+    snprintf(out, outlen, "Bought %s x %.4f for %.2f INR. New cash balance: %.2f INR\nFees: brokerage %.2f, taxes %.2f, FX spread %.2f (total %.2f INR)",
+        pr->asset_id, qty, cost_inr, accounts[acc_idx].balance, fee.brokerage, fee.taxes, fee.fx_spread, fee.total);
+    idem_remember(accounts[acc_idx].acc_no, key, out);
+    save_accounts(); save_holdings();
+    char note[128]; snprintf(note, sizeof note, "Bought %s x %.4f", pr->asset_id, qty);
+    record_trade(accounts[acc_idx].acc_no, 'B', pr, qty, cost_inr, fee.total);
+    if (settle_days == 0) { log_transaction(accounts[acc_idx].acc_no, "BUY", -(cost_inr + fee.total), accounts[acc_idx].balance, note); mark_trade_settled(); }
+    char audit[128]; snprintf(audit, sizeof audit, "BUY|%d|%s|%.4f|%.2fINR", accounts[acc_idx].acc_no, pr->asset_id, qty, cost_inr);
+    audit_log(audit);
+    push_notification(accounts[acc_idx].acc_no, note);
+    return 0;
+}
+
+/* Sell qty of prices[pidx] for cash; same contract as trade_buy() */
+static int trade_sell(int acc_idx, int pidx, double qty, const char *key, char *out, size_t outlen) {
+    if (idem_replay(accounts[acc_idx].acc_no, key, out, outlen)) return 0;
+    int hidx = find_holding_index(accounts[acc_idx].acc_no, pidx);
+    if (hidx < 0) { snprintf(out, outlen, "You do not own this asset."); return -1; }
+    Holding *h = &holdings[hidx];
+    PriceRec *pr = &prices[pidx];
+    if (!(qty >= 0.000001) || qty > h->qty) { snprintf(out, outlen, "Invalid quantity."); return -1; }
+    double proceeds_inr = cost_in_inr_for_purchase(pr, qty); /* reuse function */
+    if (!(proceeds_inr >= 0.01)) { snprintf(out, outlen, "Invalid quantity."); return -1; }
+    FeeQuote fee = compute_fees(pidx, 'S', proceeds_inr, account_month_volume(accounts[acc_idx].acc_no));
+    if (fee.total > proceeds_inr + account_available(acc_idx)) { snprintf(out, outlen, "Proceeds and cash do not cover fees of %.2f INR.", fee.total); return -1; }
+    /* reduce holdings */
+    h->qty -= qty;
+    holding_units_changed(pidx, -qty);
+    if (h->qty <= 0.000001) {
+        holding_units_changed(pidx, -h->qty); /* drop the dust too */
+        for (int i = hidx; i < hold_count - 1; ++i) holdings[i] = holdings[i+1];
+        hold_count--;
+    }
+    account_credit(acc_idx, proceeds_inr - fee.total);
+    snprintf(out, outlen, "Sold %.4f units, credited %.2f INR. New cash: %.2f INR\nFees: brokerage %.2f, taxes %.2f, FX spread %.2f (total %.2f INR)",
+        qty, proceeds_inr - fee.total, accounts[acc_idx].balance, fee.brokerage, fee.taxes, fee.fx_spread, fee.total);
+    idem_remember(accounts[acc_idx].acc_no, key, out);
+    save_accounts(); save_holdings();
+    char note[128]; snprintf(note, sizeof note, "Sold %s x %.4f", pr->asset_id, qty);
+    record_trade(accounts[acc_idx].acc_no, 'S', pr, qty, proceeds_inr, fee.total);
+    if (settle_days == 0) { log_transaction(accounts[acc_idx].acc_no, "SELL", proceeds_inr - fee.total, accounts[acc_idx].balance, note); mark_trade_settled(); }
+    char audit[128]; snprintf(audit, sizeof audit, "SELL|%d|%s|%.4f|%.2fINR", accounts[acc_idx].acc_no, pr->asset_id, qty, proceeds_inr);
+    audit_log(audit);
+    push_notification(accounts[acc_idx].acc_no, note);
+    return 0;
+}
+
+/* view portfolio with P/L (colored) */
+static void view_portfolio(FILE *out, int acc_idx) {
+    if (acc_idx < 0) return;
+    fprintf(out, "Holdings for account %d (%s):\n", accounts[acc_idx].acc_no, account_info[acc_idx].name);
+    fprintf(out, "AssetID  Market  Qty       AvgPrice(native)  CurPrice(native)  Value(INR)   P/L(INR)\n");
+    for (int i = 0; i < hold_count; ++i) {
+        if (holdings[i].acc_no != accounts[acc_idx].acc_no) continue;
+        Holding *h = &holdings[i];
+        const PriceRec *p = &prices[h->asset];
+        double cur_inr = price_in_inr(p);
+        double value_inr = h->qty * cur_inr;
+        double avg_inr = h->avg_price * fx_factor(p->market);
+        double pl = h->qty * (cur_inr - avg_inr);
+        const char *color = pl >= 0 ? ANSI_GREEN : ANSI_RED;
+        fprintf(out, "%-7s  %-6s  %-8.4f  %-16.4f  %-16.4f  %-11.2f  %s%+.2f%s\n",
+            p->asset_id, p->market, h->qty, h->avg_price, p->price, value_inr, color, pl, ANSI_RESET);
+    }
+    double port = compute_portfolio_value_inr(accounts[acc_idx].acc_no);
+    double pl_total = compute_unrealized_pl_inr(accounts[acc_idx].acc_no);
+    const char *color = pl_total >= 0 ? ANSI_GREEN : ANSI_RED;
+    fprintf(out, "Portfolio Value: %.2f INR  |  Unrealized P/L: %s%+.2f INR%s\n", port, color, pl_total, ANSI_RESET);
+    double unsettled_cash;
+    int unsettled = unsettled_for_account(accounts[acc_idx].acc_no, &unsettled_cash);
+    if (unsettled > 0) {
+        fprintf(out, "Trade-date cash: %.2f INR  |  Settlement-date cash: %.2f INR  (%d unsettled trade(s), T+%d)\n",
+            accounts[acc_idx].balance, accounts[acc_idx].balance - unsettled_cash, unsettled, settle_days);
+        for (int i = 0; i < hold_count; ++i) {
+            if (holdings[i].acc_no != accounts[acc_idx].acc_no) continue;
+            double pending = unsettled_qty(holdings[i].acc_no, holdings[i].asset);
+            if (pending != 0.0)
+                fprintf(out, "  %-7s trade-date %.4f  |  settled %.4f units\n",
+                    prices[holdings[i].asset].asset_id, holdings[i].qty, holdings[i].qty - pending);
+        }
+    }
+}
+
+/* ---------------- Quote subscriptions ---------------- */
+
+/* A subscriber's conflation buffer is just the last quote version it has seen
+   per asset: however many ticks happen between polls, a slow reader gets one
+   row per changed asset carrying the latest price, never a backlog. */
+typedef struct {
+    int in_use;
+    int acc_no;
+    uint64_t assets[PRICE_BM_WORDS];   /* subscribed asset bitmap */
+    uint64_t seen_version[MAX_PRICES];
+    double seen_price[MAX_PRICES];
+    uint64_t seen_epoch;
+} Subscriber;
+
+static Subscriber subscribers[MAX_SUBSCRIBERS];
+
+static Subscriber *subscriber_for_account(int acc_no, int create) {
+    Subscriber *free_slot = NULL;
+    for (int i = 0; i < MAX_SUBSCRIBERS; ++i) {
+        if (subscribers[i].in_use && subscribers[i].acc_no == acc_no) return &subscribers[i];
+        if (!subscribers[i].in_use && !free_slot) free_slot = &subscribers[i];
+    }
+    if (!create || !free_slot) return NULL;
+    memset(free_slot, 0, sizeof *free_slot);
+    free_slot->in_use = 1;
+    free_slot->acc_no = acc_no;
+    return free_slot;
+}
+
+static void subscribe_asset(Subscriber *s, int pidx) {
+    s->assets[pidx >> 6] |= (uint64_t)1 << (pidx & 63);
+    /* deliver the current quote on the next poll */
+    s->seen_version[pidx] = atomic_load_explicit(&quote_version[pidx], memory_order_acquire) - 1;
+    s->seen_price[pidx] = prices[pidx].price;
+    s->seen_epoch = UINT64_MAX; /* force a scan on the next poll */
+}
+
+static void unsubscribe_asset(Subscriber *s, int pidx) {
+    s->assets[pidx >> 6] &= ~((uint64_t)1 << (pidx & 63));
+}
+
+/* Emit every subscribed asset whose quote changed since the last poll.
+   Returns the number of quotes delivered. */
+static int subscriber_poll(Subscriber *s, OutBuf *ob) {
+    uint64_t epoch = atomic_load_explicit(&quote_epoch, memory_order_acquire);
+    if (epoch == s->seen_epoch) return 0;
+    int n = 0;
+    for (int w = 0; w < PRICE_BM_WORDS; ++w) {
+        for (uint64_t bits = s->assets[w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            if (i >= price_count) break;
+            uint64_t v = atomic_load_explicit(&quote_version[i], memory_order_acquire);
+            if (v == s->seen_version[i]) continue;
+            double px = atomic_load_explicit(&quote_price[i], memory_order_relaxed);
+            if (ob) {
+                double chg = s->seen_price[i] > 0 ? (px - s->seen_price[i]) / s->seen_price[i] * 100.0 : 0.0;
+                const char *color = chg >= 0 ? ANSI_GREEN : ANSI_RED;
+                ob_printf(ob, "%-7s  %-5s  %.4f  %s%+.2f%%%s\n",
+                    prices[i].asset_id, prices[i].market, px, color, chg, ANSI_RESET);
+            }
+            s->seen_version[i] = v;
+            s->seen_price[i] = px;
+            n++;
+        }
+    }
+    s->seen_epoch = epoch;
+    return n;
+}
+
+static OutBuf watch_out;
+
 /* ---------------- New UI: Account Details ---------------- */
-static void show_account_details(int idx) {
-    if (idx < 0 || idx >= acc_count) { printf("Invalid account.\n"); return; }
+static void show_account_details(FILE *out, int idx) {
+    if (idx < 0 || idx >= acc_count) { fprintf(out, "Invalid account.\n"); return; }
     Account *a = &accounts[idx];
-    printf("\n--- Account Details ---\n");
-    printf("Account Number : %d\n", a->acc_no);
-    printf("Name           : %s\n", a->name);
-    printf("Account Type   : %s\n", a->acc_type);
-    printf("UPI            : %s\n", a->upi);
-    printf("Cash Balance   : %.2f INR\n", a->balance);
-    printf("Loan Outstanding: %.2f INR\n", a->loan);
-    printf("Status         : %s\n", a->active ? "Active" : "Inactive");
-    printf("Frozen         : %s\n", a->frozen ? "Yes" : "No");
-    printf("Last Login     : %s\n", a->last_login);
-    printf("------------------------\n");
+    AccountInfo *ai = &account_info[idx];
+    fprintf(out, "\n--- Account Details ---\n");
+    fprintf(out, "Account Number : %d\n", a->acc_no);
+    fprintf(out, "Name           : %s\n", ai->name);
+    fprintf(out, "Account Type   : %s\n", ai->acc_type);
+    fprintf(out, "UPI            : %s\n", ai->upi);
+    fprintf(out, "Cash Balance   : %.2f INR\n", a->balance);
+    if (earns_interest(a))
+        fprintf(out, "Interest Accrued: %.2f INR (%.2f%% p.a., posted monthly)\n", a->accrued + interest_pending(a, today_day()), savings_rate_pct);
+    fprintf(out, "Loan Outstanding: %.2f INR\n", a->loan);
+    fprintf(out, "Status         : %s\n", a->active ? "Active" : "Inactive");
+    fprintf(out, "Frozen         : %s\n", a->frozen ? "Yes" : "No");
+    fprintf(out, "Last Login     : %s\n", ai->last_login);
+    fprintf(out, "------------------------\n");
+}
+
+/* ---------------- Admin account listing: bitmaps, indexes, pagination ---------------- */
+
+#define ACC_BM_WORDS ((MAX_ACCOUNTS + 63) / 64)
+
+enum { SORT_ACC_NO = 1, SORT_NAME, SORT_BALANCE, SORT_UPI };
+
+typedef struct {
+    int type;             /* 0 any, 1 Savings, 2 Current */
+    int frozen;           /* -1 any, 0 not frozen, 1 frozen */
+    int inactive;         /* -1 any, 0 active only, 1 inactive only */
+    int has_min, has_max;
+    double min_bal, max_bal;
+    char upi_prefix[64];  /* lowercase, empty = any */
+    int sort_key;         /* SORT_* */
+    int page_size;
+} AccountQuery;
+
+/* one bit per accounts[] slot; rebuilt lazily after save_accounts/load_accounts */
+static uint64_t bm_all[ACC_BM_WORDS];
+static uint64_t bm_active[ACC_BM_WORDS];
+static uint64_t bm_frozen[ACC_BM_WORDS];
+static uint64_t bm_savings[ACC_BM_WORDS];
+static uint64_t bm_current[ACC_BM_WORDS];
+static uint64_t bm_scratch[ACC_BM_WORDS];
+
+/* accounts[] positions ordered by each sort key (acc_no breaks ties) */
+static int idx_by_acc_no[MAX_ACCOUNTS];
+static int idx_by_name[MAX_ACCOUNTS];
+static int idx_by_balance[MAX_ACCOUNTS];
+static int idx_by_upi[MAX_ACCOUNTS];
+/* inverse: where each accounts[] slot sits in the index (acc_no never moves) */
+static int pos_by_name[MAX_ACCOUNTS];
+static int pos_by_balance[MAX_ACCOUNTS];
+static int pos_by_upi[MAX_ACCOUNTS];
+
+/* slots whose row changed since the indexes were last brought up to date;
+   save_accounts() records them instead of forcing a full rebuild */
+#define ACC_TOUCH_MAX 4096
+static int acc_touched[ACC_TOUCH_MAX];
+static int acc_touched_count;
+static uint64_t bm_touched[ACC_BM_WORDS];
+
+typedef int (*AccountCmp)(const Account *, const AccountInfo *, const Account *, const AccountInfo *);
+
+static int cmp_acc_no(const Account *a, const AccountInfo *ai, const Account *b, const AccountInfo *bi) {
+    (void)ai; (void)bi;
+    return (a->acc_no > b->acc_no) - (a->acc_no < b->acc_no);
+}
+static int cmp_name(const Account *a, const AccountInfo *ai, const Account *b, const AccountInfo *bi) {
+    int c = bvdu_stricmp(ai->name, bi->name);
+    return c ? c : cmp_acc_no(a, ai, b, bi);
+}
+static int cmp_balance(const Account *a, const AccountInfo *ai, const Account *b, const AccountInfo *bi) {
+    int c = (a->balance > b->balance) - (a->balance < b->balance);
+    return c ? c : cmp_acc_no(a, ai, b, bi);
+}
+static int cmp_upi(const Account *a, const AccountInfo *ai, const Account *b, const AccountInfo *bi) {
+    int c = strcmp(ai->upi, bi->upi);
+    return c ? c : cmp_acc_no(a, ai, b, bi);
+}
+
+static AccountCmp qsort_account_cmp; /* qsort has no context argument */
+static int qsort_idx_cmp(const void *x, const void *y) {
+    int i = *(const int *)x, j = *(const int *)y;
+    return qsort_account_cmp(&accounts[i], &account_info[i], &accounts[j], &account_info[j]);
+}
+
+static void sort_account_index(int *idx, int *pos, AccountCmp cmp) {
+    for (int i = 0; i < acc_count; ++i) idx[i] = i;
+    qsort_account_cmp = cmp;
+    qsort(idx, (size_t)acc_count, sizeof idx[0], qsort_idx_cmp);
+    if (pos) for (int p = 0; p < acc_count; ++p) pos[idx[p]] = p;
+}
+
+/* move slot i to its place in a sorted index after its key changed;
+   costs one compare per position it moves */
+static void reseat_account_index(int *idx, int *pos, AccountCmp cmp, int i) {
+    int p = pos[i];
+    while (p > 0 && cmp(&accounts[idx[p - 1]], &account_info[idx[p - 1]], &accounts[i], &account_info[i]) > 0) {
+        idx[p] = idx[p - 1]; pos[idx[p]] = p; p--;
+    }
+    while (p + 1 < acc_count && cmp(&accounts[idx[p + 1]], &account_info[idx[p + 1]], &accounts[i], &account_info[i]) < 0) {
+        idx[p] = idx[p + 1]; pos[idx[p]] = p; p++;
+    }
+    idx[p] = i; pos[i] = p;
+}
+
+static void bm_set(uint64_t *bm, int i) { bm[i >> 6] |= (uint64_t)1 << (i & 63); }
+static int bm_test(const uint64_t *bm, int i) { return (int)((bm[i >> 6] >> (i & 63)) & 1); }
+static int bm_words(void) { return (acc_count + 63) / 64; }
+
+static int bm_popcount(const uint64_t *bm) {
+    int n = 0;
+    for (int w = 0; w < bm_words(); ++w) {
+        uint64_t x = bm[w];
+        while (x) { x &= x - 1; n++; }
+    }
+    return n;
+}
+
+static void bm_put(uint64_t *bm, int i, int on) {
+    uint64_t bit = (uint64_t)1 << (i & 63);
+    if (on) bm[i >> 6] |= bit; else bm[i >> 6] &= ~bit;
+}
+
+static void account_index_bits(int i) {
+    const Account *a = &accounts[i];
+    bm_set(bm_all, i);
+    bm_put(bm_active, i, a->active);
+    bm_put(bm_frozen, i, a->frozen);
+    bm_put(bm_savings, i, a->type == ACC_SAVINGS);
+    bm_put(bm_current, i, a->type == ACC_CURRENT);
+}
+
+/* a saved row changed: queue the slot for repair (a full rebuild once too many pile up) */
+static void account_index_touch(int i) {
+    if (acc_index_dirty || bm_test(bm_touched, i)) return;
+    if (acc_touched_count == ACC_TOUCH_MAX) { acc_index_dirty = 1; return; }
+    bm_set(bm_touched, i);
+    acc_touched[acc_touched_count++] = i;
+}
+
+static void clear_account_touches(void) {
+    for (int k = 0; k < acc_touched_count; ++k) bm_put(bm_touched, acc_touched[k], 0);
+    acc_touched_count = 0;
+}
+
+/* Adds, removals and reloads (acc_index_dirty) re-sort everything; rows that
+   only changed in place are reseated one by one. */
+static void rebuild_account_indexes(void) {
+    if (!acc_index_dirty) {
+        for (int k = 0; k < acc_touched_count; ++k) {
+            int i = acc_touched[k];
+            account_index_bits(i);
+            reseat_account_index(idx_by_name, pos_by_name, cmp_name, i);
+            reseat_account_index(idx_by_balance, pos_by_balance, cmp_balance, i);
+            reseat_account_index(idx_by_upi, pos_by_upi, cmp_upi, i);
+        }
+        clear_account_touches();
+        return;
+    }
+    size_t bytes = sizeof(uint64_t) * (size_t)bm_words();
+    memset(bm_all, 0, bytes); memset(bm_active, 0, bytes); memset(bm_frozen, 0, bytes);
+    memset(bm_savings, 0, bytes); memset(bm_current, 0, bytes);
+    for (int i = 0; i < acc_count; ++i) account_index_bits(i);
+    sort_account_index(idx_by_acc_no, NULL, cmp_acc_no);
+    sort_account_index(idx_by_name, pos_by_name, cmp_name);
+    sort_account_index(idx_by_balance, pos_by_balance, cmp_balance);
+    sort_account_index(idx_by_upi, pos_by_upi, cmp_upi);
+    clear_account_touches();
+    acc_index_dirty = 0;
+}
+
+/* first position in idx_by_balance whose balance is >= v (strict: > v) */
+static int balance_bound(double v, int strict) {
+    int lo = 0, hi = acc_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        double b = accounts[idx_by_balance[mid]].balance;
+        if (strict ? (b <= v) : (b < v)) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/* first position in idx_by_upi whose first plen chars compare >= prefix (strict: >) */
+static int upi_prefix_bound(const char *prefix, size_t plen, int strict) {
+    int lo = 0, hi = acc_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = strncmp(account_info[idx_by_upi[mid]].upi, prefix, plen);
+        if (strict ? (c <= 0) : (c < 0)) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static void bm_and_range(uint64_t *out, const int *idx, int from, int to) {
+    memset(bm_scratch, 0, sizeof(uint64_t) * (size_t)bm_words());
+    for (int i = from; i < to; ++i) bm_set(bm_scratch, idx[i]);
+    for (int w = 0; w < bm_words(); ++w) out[w] &= bm_scratch[w];
+}
+
+/* evaluate the filters of q into a match bitmap over accounts[] */
+static void account_query_bitmap(const AccountQuery *q, uint64_t *out) {
+    rebuild_account_indexes();
+    int nw = bm_words();
+    for (int w = 0; w < nw; ++w) {
+        uint64_t m = bm_all[w];
+        if (q->type == 1) m &= bm_savings[w];
+        else if (q->type == 2) m &= bm_current[w];
+        if (q->frozen == 1) m &= bm_frozen[w];
+        else if (q->frozen == 0) m &= ~bm_frozen[w];
+        if (q->inactive == 1) m &= ~bm_active[w];
+        else if (q->inactive == 0) m &= bm_active[w];
+        out[w] = m;
+    }
+    if (q->has_min || q->has_max) {
+        int from = q->has_min ? balance_bound(q->min_bal, 0) : 0;
+        int to = q->has_max ? balance_bound(q->max_bal, 1) : acc_count;
+        bm_and_range(out, idx_by_balance, from, to);
+    }
+    if (q->upi_prefix[0]) {
+        size_t plen = strlen(q->upi_prefix);
+        bm_and_range(out, idx_by_upi, upi_prefix_bound(q->upi_prefix, plen, 0), upi_prefix_bound(q->upi_prefix, plen, 1));
+    }
+}
+
+static const int *account_sort_index(int sort_key, AccountCmp *cmp) {
+    switch (sort_key) {
+        case SORT_NAME: *cmp = cmp_name; return idx_by_name;
+        case SORT_BALANCE: *cmp = cmp_balance; return idx_by_balance;
+        case SORT_UPI: *cmp = cmp_upi; return idx_by_upi;
+        default: *cmp = cmp_acc_no; return idx_by_acc_no;
+    }
+}
+
+/* Write one page of matches in sort order, starting after *cursor when has_cursor is set.
+   The cursor is the last row emitted, so pages stay stable when accounts are added.
+   Returns rows written; *more is set if further matches exist. */
+static int account_query_page(const AccountQuery *q, const uint64_t *match, Account *cursor,
+                              AccountInfo *cursor_info, int *has_cursor, int *more, OutBuf *ob) {
+    AccountCmp cmp;
+    const int *idx = account_sort_index(q->sort_key, &cmp);
+    int pos = 0;
+    if (*has_cursor) {
+        int lo = 0, hi = acc_count;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (cmp(&accounts[idx[mid]], &account_info[idx[mid]], cursor, cursor_info) <= 0) lo = mid + 1; else hi = mid;
+        }
+        pos = lo;
+    }
+    int rows = 0;
+    *more = 0;
+    for (; pos < acc_count; ++pos) {
+        int i = idx[pos];
+        if (!bm_test(match, i)) continue;
+        if (rows == q->page_size) { *more = 1; break; }
+        Account *a = &accounts[i];
+        AccountInfo *ai = &account_info[i];
+        ob_printf(ob, "%d | %s | %s | %.2f | %.2f | %d | %d | %s\n",
+            a->acc_no, ai->name, ai->acc_type, a->balance, a->loan, a->active, a->frozen, ai->upi);
+        *cursor = *a;
+        *cursor_info = *ai;
+        *has_cursor = 1;
+        rows++;
+    }
+    return rows;
+}
+
+static OutBuf list_out;
+
+static void admin_list_accounts(void) {
+    AccountQuery q;
+    memset(&q, 0, sizeof q);
+    char buf[128];
+    printf("Filter type (Savings/Current) [any]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    if (bvdu_stricmp(buf, "Savings") == 0) q.type = 1;
+    else if (bvdu_stricmp(buf, "Current") == 0) q.type = 2;
+    printf("Frozen (y/n) [any]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    q.frozen = (buf[0] == 'y' || buf[0] == 'Y') ? 1 : (buf[0] == 'n' || buf[0] == 'N') ? 0 : -1;
+    printf("Inactive (y/n) [any]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    q.inactive = (buf[0] == 'y' || buf[0] == 'Y') ? 1 : (buf[0] == 'n' || buf[0] == 'N') ? 0 : -1;
+    printf("Min balance [none]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    if (buf[0]) { q.has_min = 1; q.min_bal = atof(buf); }
+    printf("Max balance [none]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    if (buf[0]) { q.has_max = 1; q.max_bal = atof(buf); }
+    printf("UPI prefix [any]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    strtolower_inplace(buf);
+    strncpy(q.upi_prefix, buf, sizeof q.upi_prefix - 1);
+    printf("Sort by 1.AccNo 2.Name 3.Balance 4.UPI [1]: ");
+    if (!safe_read_line(buf, sizeof buf)) return;
+    q.sort_key = atoi(buf);
+    if (q.sort_key < SORT_ACC_NO || q.sort_key > SORT_UPI) q.sort_key = SORT_ACC_NO;
+    printf("Page size [%d]: ", LIST_PAGE_DEFAULT);
+    if (!safe_read_line(buf, sizeof buf)) return;
+    q.page_size = atoi(buf);
+    if (q.page_size <= 0) q.page_size = LIST_PAGE_DEFAULT;
+
+    static uint64_t match[ACC_BM_WORDS];
+    account_query_bitmap(&q, match);
+    int total = bm_popcount(match);
+
+    list_out.out = stdout;
+    Account cursor;
+    AccountInfo cursor_info;
+    int has_cursor = 0, more = 0, shown = 0;
+    for (;;) {
+        ob_printf(&list_out, "AccNo | Name | Type | Balance | Loan | Active | Frozen | UPI\n");
+        shown += account_query_page(&q, match, &cursor, &cursor_info, &has_cursor, &more, &list_out);
+        ob_printf(&list_out, "-- %d of %d matching account(s) --\n", shown, total);
+        ob_flush(&list_out);
+        if (!more) break;
+        printf("Enter for next page, q to stop: ");
+        if (!safe_read_line(buf, sizeof buf) || buf[0] == 'q' || buf[0] == 'Q') break;
+    }
+}
+
+/* ---------------- Admin functions ---------------- */
+
+static void admin_menu(void) {
+    printf("Admin PIN: ");
+    int pin = safe_read_int();
+    if (pin != ADMIN_PIN) { printf("Invalid admin PIN.\n"); return; }
+    audit_log("ADMIN_LOGIN");
+    for (;;) {
+        printf("\n--- Admin Dashboard ---\n");
+        printf("1.View accounts\n2.Set price\n3.Randomize prices (admin)\n4.Set Savings interest rate (accrues daily)\n5.View audit log file path\n6.Set FX rates\n7.Unfreeze account\n8.Tick market once\n9.Ingest price feed\n10.Asset trade blotter\n11.Run settlement\n12.Set settlement cycle (T+N)\n13.Re-price trade fees (current schedule)\n14.Recovery checkpoint\n15.Recover to point in time\n16.Bank totals\n17.Mark/unmark hot account (striped credits)\n18.Archive dormant accounts\n19.Rehydrate archived account\n0.Logout\nChoice: ");
+        int ch = safe_read_int();
+        if (ch == 1) {
+            admin_list_accounts();
+        } else if (ch == 2) {
+            printf("Enter Asset ID to set price: ");
+            char buf[128]; if (!safe_read_line(buf, sizeof buf)) break;
+            int idx = find_price_index(buf);
+            if (idx < 0) { printf("Asset not found.\n"); continue; }
+            if (is_basket[idx]) { printf("Basket price is derived from its constituents.\n"); continue; }
+            printf("Enter new price (native): ");
+            double p = safe_read_double(); if (p <= 0) { printf("Invalid.\n"); continue; }
+            double old = prices[idx].price; char ts[25]; get_timestamp(ts, sizeof ts); set_asset_price(idx, p, ts); save_prices();
+            char audit[128]; snprintf(audit, sizeof audit, "ADMIN_SET_PRICE|%s|%.4f->%.4f", prices[idx].asset_id, old, p); audit_log(audit);
+            printf("Price updated.\n");
+        } else if (ch == 3) {
+            admin_randomize_all_prices();
+            printf("Prices randomized by admin.\n");
+        } else if (ch == 4) {
+            printf("Annual interest percent for Savings [current %.2f]: ", savings_rate_pct);
+            double rate = safe_read_double();
+            if (rate < 0 || rate > 100) { printf("Invalid rate.\n"); continue; }
+            set_savings_rate(rate);
+            char audit[64]; snprintf(audit, sizeof audit, "ADMIN_SET_INTEREST|%.4f", rate); audit_log(audit);
+            printf("Savings interest set to %.2f%% p.a.; accrues daily, posted on the 1st of each month.\n", rate);
+        } else if (ch == 5) {
+            printf("Audit log file: %s\nNotifications file: %s\n", F_ADMIN_AUDIT, F_NOTIFICATIONS);
+        } else if (ch == 6) {
+            printf("Enter INR per USD (e.g., 83.5): ");
+            double usd = safe_read_double();
+            printf("Enter INR per EUR (e.g., 88.2): ");
+            double eur = safe_read_double();
+            if (usd <= 0 || eur <= 0) { printf("Invalid rates.\n"); continue; }
+            fx.inr_per_usd = usd; fx.inr_per_eur = eur; get_timestamp(fx.last_update, sizeof fx.last_update); save_fx(); refresh_all_price_inr(); recompute_all_basket_navs(); save_prices();
+            char audit[128]; snprintf(audit, sizeof audit, "ADMIN_SET_FX|INR_USD=%.6f|INR_EUR=%.6f", usd, eur); audit_log(audit);
+            printf("FX updated.\n");
+        } else if (ch == 7) {
+            printf("Enter acc_no to unfreeze: ");
+            int a = safe_read_int();
+            int idx = find_account_index(a);
+            if (idx < 0) { printf("Account not found.\n"); continue; }
+            accounts[idx].frozen = 0; accounts[idx].failed_attempts = 0; save_accounts();
+            char audit[128]; snprintf(audit, sizeof audit, "ADMIN_UNFREEZE|%d", a); audit_log(audit);
+            printf("Account %d unfrozen.\n", a);
+        } else if (ch == 8) {
+            tick_market_once();
+            printf("Market tick executed.\n");
+        } else if (ch == 9) {
+            printf("Feed source (file, FIFO or unix:/path/to/socket): ");
+            char buf[256]; if (!safe_read_line(buf, sizeof buf)) break;
+            if (!buf[0]) { printf("Invalid.\n"); continue; }
+            run_price_feed(buf);
+        } else if (ch == 10) {
+            printf("Asset ID: ");
+            char buf[64]; if (!safe_read_line(buf, sizeof buf)) break;
+            asset_blotter(buf, 100);
+        } else if (ch == 11) {
+            int moves;
+            int n = run_settlement(&moves);
+            if (n < 0) printf("Settlement failed.\n");
+            else printf("Settled %d trade(s) into %d netted movement(s).\n", n, moves);
+        } else if (ch == 12) {
+            printf("Settlement days N (0 = instant) [current T+%d]: ", settle_days);
+            int n = safe_read_int();
+            if (n < 0 || n > 30) { printf("Invalid.\n"); continue; }
+            settle_days = n;
+            if (n == 0) { int moves; run_settlement(&moves); } /* flush pending before going instant */
+            save_settlement();
+            char audit[64]; snprintf(audit, sizeof audit, "ADMIN_SET_SETTLEMENT|T+%d", n); audit_log(audit);
+            printf("Settlement cycle set to T+%d.\n", n);
+        } else if (ch == 13) {
+            double old_fees, new_fees;
+            double t0 = now_seconds();
+            int n = reprice_trade_fees(&old_fees, &new_fees);
+            if (n < 0) { printf("Re-pricing failed.\n"); continue; }
+            printf("Re-priced %d trade(s) in %.3f ms: charged %.2f INR, current schedule %.2f INR (%+.2f).\n",
+                n, (now_seconds() - t0) * 1e3, old_fees, new_fees, new_fees - old_fees);
+        } else if (ch == 14) {
+            if (pitr_checkpoint() == 0) printf("Checkpoint written.\n");
+        } else if (ch == 15) {
+            printf("Recover to (YYYY-MM-DD HH:MM:SS): ");
+            char buf[64]; if (!safe_read_line(buf, sizeof buf)) break;
+            if (pitr_recover(buf) >= 0) {
+                char audit[96]; snprintf(audit, sizeof audit, "ADMIN_PITR_RECOVER|%s", buf); audit_log(audit);
+            }
+        } else if (ch == 16) {
+            print_bank_totals();
+            uint64_t since = totals_mutations;
+            int drift = totals_verify();
+            if (drift) printf("Verification corrected %d figure(s); see audit log.\n", drift);
+            else printf("Verified against a full scan (%llu change(s) since last check).\n", (unsigned long long)since);
+        } else if (ch == 17) {
+            printf("Enter acc_no: ");
+            int a = safe_read_int();
+            int idx = find_account_index(a);
+            if (idx < 0) { printf("Account not found.\n"); continue; }
+            int hot = !hot_slot[idx];
+            if (set_hot_account(idx, hot) < 0) { printf("Hot account limit (%d) reached.\n", MAX_HOT_ACCOUNTS); continue; }
+            save_hot_accounts();
+            if (!hot) save_accounts();
+            char audit[64]; snprintf(audit, sizeof audit, "ADMIN_SET_HOT|%d|%d", a, hot); audit_log(audit);
+            printf("Account %d is %s.\n", a, hot ? "now hot: credits are striped" : "no longer hot");
+        } else if (ch == 18) {
+            printf("Archive accounts inactive or without login for how many years (0 = inactive only) [2]: ");
+            char buf[32]; if (!safe_read_line(buf, sizeof buf)) break;
+            archive_dormant(buf[0] ? atoi(buf) : 2);
+        } else if (ch == 19) {
+            printf("Enter acc_no: ");
+            int a = safe_read_int();
+            char msg[96];
+            if (cold_rehydrate(a, msg, sizeof msg) != 0) printf("%s\n", msg);
+            else printf("Account %d restored from cold storage.\n", a);
+        } else if (ch == 0) {
+            audit_log("ADMIN_LOGOUT"); break;
+        } else printf("Invalid.\n");
+    }
+}
+
+/* ---------------- Menus ---------------- */
+
+/* Customer sessions are state machines rather than blocking prompt loops:
+   a Session remembers which prompt it is waiting on, session_feed() consumes
+   one line of input, does the work, prints the next prompt and returns. The
+   terminal drives one session from stdin; the text endpoint of --serve
+   drives thousands from a single event loop, each idle session costing its
+   Session and socket buffers rather than a thread stack. */
+
+enum {
+    SS_LOGIN_ACC, SS_LOGIN_PIN,
+    SS_DASH, SS_DEPOSIT, SS_WITHDRAW, SS_XFER_TO, SS_XFER_AMT, SS_UPI_TO, SS_UPI_AMT, SS_BULK,
+    SS_TRADE, SS_BUY_ID, SS_BUY_QTY, SS_SELL_ID, SS_SELL_QTY, SS_WATCH, SS_WATCH_ID,
+    SS_DONE
+};
+
+typedef struct {
+    uint8_t state;      /* SS_*: the prompt this session is waiting on */
+    int acc_idx;        /* logged-in account, -1 before login */
+    int peer;           /* step in progress: destination account, asset or watchlist choice */
+    int nlegs;          /* bulk payment being entered: legs[0] is the payer */
+    double total;
+    PayLeg *legs;
+} Session;
+
+static void session_prompt(Session *s, FILE *out) {
+    int idx = s->acc_idx;
+    switch (s->state) {
+    case SS_LOGIN_ACC: fprintf(out, "Enter account number: "); break;
+    case SS_LOGIN_PIN: fprintf(out, "Enter PIN: "); break;
+    case SS_DASH: {
+        double port = compute_portfolio_value_inr(accounts[idx].acc_no);
+        double pl = compute_unrealized_pl_inr(accounts[idx].acc_no);
+        fprintf(out, "\n--- Customer Dashboard: %s (%d) ---\n", account_info[idx].name, accounts[idx].acc_no);
+        fprintf(out, "Cash: %.2f INR | Portfolio: %.2f INR | Unrealized P/L: %+.2f INR\n", accounts[idx].balance, port, pl);
+        fprintf(out, "1.Balance Enquiry\n2.Deposit\n3.Withdraw\n4.Transfer\n5.Mini Statement\n6.Trading App\n7.UPI Transfer\n8.Account Details\n9.Bulk Payment\n0.Logout\nChoice: ");
+        break;
+    }
+    case SS_DEPOSIT: fprintf(out, "Enter amount to deposit (INR): "); break;
+    case SS_WITHDRAW: fprintf(out, "Enter amount to withdraw (INR): "); break;
+    case SS_XFER_TO: fprintf(out, "Enter destination account number: "); break;
+    case SS_XFER_AMT: fprintf(out, "Enter amount to transfer (INR): "); break;
+    case SS_UPI_TO: fprintf(out, "Enter destination UPI (e.g., alice@bvdu): "); break;
+    case SS_UPI_AMT: fprintf(out, "Enter amount (INR): "); break;
+    case SS_BULK: break; /* one payee per line, no prompt */
+    case SS_TRADE:
+        fprintf(out, "\n=== BVDU Trading App ===\n1.List Market Prices\n2.Buy Asset\n3.Sell Asset\n4.View Portfolio\n5.Watchlist\n6.Trade Blotter\n0.Exit\nChoice: ");
+        break;
+    case SS_BUY_ID: fprintf(out, "Enter Asset ID to buy (e.g., AAPL): "); break;
+    case SS_BUY_QTY: fprintf(out, "Enter quantity to buy: "); break;
+    case SS_SELL_ID: fprintf(out, "Enter Asset ID to sell: "); break;
+    case SS_SELL_QTY: fprintf(out, "Quantity to sell: "); break;
+    case SS_WATCH: fprintf(out, "\n--- Watchlist ---\n1.Subscribe asset\n2.Unsubscribe asset\n3.Show changed quotes\n0.Back\nChoice: "); break;
+    case SS_WATCH_ID: fprintf(out, "Asset ID: "); break;
+    }
+}
+
+static void session_end(Session *s) {
+    free(s->legs);
+    s->legs = NULL;
+    s->state = SS_DONE;
+}
+
+/* the dashboard's bulk payment, once the empty line (or the leg limit) ends it */
+static void session_bulk_pay(Session *s, FILE *out) {
+    static char notes[MAX_BATCH_LEGS][80];
+    int n = s->nlegs, from = s->acc_idx;
+    for (int i = 1; i < n; ++i) snprintf(notes[i], sizeof notes[i], "Batch from %d", accounts[from].acc_no);
+    s->legs[0].idx = from; s->legs[0].amount = -s->total;
+    snprintf(notes[0], sizeof notes[0], "Batch to %d payee(s)", n - 1);
+    char err[128];
+    if (batch_validate(s->legs, n, err, sizeof err) != 0) fprintf(out, "Batch rejected: %s. Nothing was paid.\n", err);
+    else {
+        batch_apply(s->legs, n, "BATCH_OUT", "BATCH_IN", notes);
+        fprintf(out, "Paid %.2f INR to %d payee(s). New balance: %.2f INR\n", s->total, n - 1, accounts[from].balance);
+    }
+    free(s->legs);
+    s->legs = NULL;
+}
+
+/* consume one line of input (newline already stripped), then prompt again */
+static void session_feed(Session *s, char *line, FILE *out) {
+    char res[IDEM_RESULT_MAX];
+    int me = s->acc_idx, ch = atoi(line);
+    if (me >= 0 && (!accounts[me].active || accounts[me].frozen) && s->state != SS_DONE) {
+        /* frozen or closed by an operator while the session was open */
+        fprintf(out, "Account not active or frozen. Logging out...\n");
+        session_end(s);
+        return;
+    }
+    switch (s->state) {
+    case SS_LOGIN_ACC:
+        s->peer = login_account(atoi(line), res, sizeof res);
+        if (s->peer < 0) fprintf(out, "%s\n", res);
+        else s->state = SS_LOGIN_PIN;
+        break;
+    case SS_LOGIN_PIN:
+        s->acc_idx = login_check_pin(s->peer, atoi(line), res, sizeof res);
+        if (s->acc_idx < 0) { fprintf(out, "%s\n", res); s->state = SS_LOGIN_ACC; }
+        else s->state = SS_DASH;
+        break;
+    case SS_DASH:
+        if (ch == 1) {
+            fprintf(out, "Cash balance: %.2f INR\nLoan outstanding: %.2f\n", accounts[me].balance, accounts[me].loan);
+            if (earns_interest(&accounts[me]))
+                fprintf(out, "Interest accrued: %.2f INR\n", accounts[me].accrued + interest_pending(&accounts[me], today_day()));
+        }
+        else if (ch == 2) s->state = SS_DEPOSIT;
+        else if (ch == 3) s->state = SS_WITHDRAW;
+        else if (ch == 4) s->state = SS_XFER_TO;
+        else if (ch == 5) print_mini_statement_for_account(out, accounts[me].acc_no);
+        else if (ch == 6) { ensure_default_prices(); s->state = SS_TRADE; }
+        else if (ch == 7) s->state = SS_UPI_TO;
+        else if (ch == 8) show_account_details(out, me);
+        else if (ch == 9) {
+            s->legs = malloc(MAX_BATCH_LEGS * sizeof *s->legs);
+            if (!s->legs) { fprintf(out, "Bulk payment unavailable, try later.\n"); break; }
+            s->nlegs = 1; s->total = 0.0;
+            fprintf(out, "Enter payees as 'acc_no amount', one per line (empty line to finish, max %d):\n", MAX_BATCH_LEGS - 1);
+            s->state = SS_BULK;
+        }
+        else if (ch == 0) { fprintf(out, "Logging out...\n"); session_end(s); return; }
+        else fprintf(out, "Invalid.\n");
+        break;
+    case SS_DEPOSIT:
+    case SS_WITHDRAW: {
+        double amt = atof(line);
+        if (!(amt >= 0.01)) fprintf(out, "Invalid amount.\n");
+        else { cash_movement(me, s->state == SS_DEPOSIT ? amt : -amt, NULL, res, sizeof res); fprintf(out, "%s\n", res); }
+        s->state = SS_DASH;
+        break;
+    }
+    case SS_XFER_TO: {
+        int to = find_active_account_index(atoi(line));
+        s->state = SS_DASH;
+        if (to < 0) fprintf(out, "Destination not found or not active.\n");
+        else if (accounts[to].frozen) fprintf(out, "Destination frozen. Cannot receive funds.\n");
+        else if (to == me) fprintf(out, "Cannot transfer to same account.\n");
+        else { s->peer = to; s->state = SS_XFER_AMT; }
+        break;
+    }
+    case SS_UPI_TO: {
+        strtolower_inplace(line);
+        int to = find_account_by_upi(line);
+        s->state = SS_DASH;
+        if (to < 0) fprintf(out, "UPI not found. Transfers allowed only to registered BVDU UPIs.\n");
+        else if (!accounts[to].active) fprintf(out, "Destination not active.\n");
+        else if (accounts[to].frozen) fprintf(out, "Destination frozen.\n");
+        else if (to == me) fprintf(out, "Cannot send to own UPI.\n");
+        else { s->peer = to; s->state = SS_UPI_AMT; }
+        break;
+    }
+    case SS_XFER_AMT:
+    case SS_UPI_AMT:
+        transfer_funds(me, s->peer, atof(line), s->state == SS_UPI_AMT, NULL, res, sizeof res);
+        fprintf(out, "%s\n", res);
+        s->state = SS_DASH;
+        break;
+    case SS_BULK:
+        if (line[0]) {
+            int acc; double amt;
+            if (sscanf(line, "%d %lf", &acc, &amt) != 2 || !(amt >= 0.01)) { fprintf(out, "Skipped '%s': expected 'acc_no amount'.\n", line); break; }
+            int to = find_active_account_index(acc);
+            if (to < 0 || to == me) { fprintf(out, "Skipped %d: not a valid payee.\n", acc); break; }
+            s->legs[s->nlegs].idx = to; s->legs[s->nlegs].amount = amt;
+            s->total += amt;
+            if (++s->nlegs < MAX_BATCH_LEGS) break;
+        }
+        session_bulk_pay(s, out);
+        s->state = SS_DASH;
+        break;
+    case SS_TRADE:
+        if (ch == 1) list_market_prices(out);
+        else if (ch == 2) s->state = SS_BUY_ID;
+        else if (ch == 3) s->state = SS_SELL_ID;
+        else if (ch == 4) view_portfolio(out, me);
+        else if (ch == 5) {
+            if (subscriber_for_account(accounts[me].acc_no, 1)) s->state = SS_WATCH;
+            else fprintf(out, "Watchlist service busy, try later.\n");
+        }
+        else if (ch == 6) account_blotter(out, accounts[me].acc_no, 50);
+        else if (ch == 0) s->state = SS_DASH;
+        else fprintf(out, "Invalid.\n");
+        break;
+    case SS_BUY_ID: {
+        int pidx = find_price_index(line); /* IDs are case-sensitive as stored */
+        PriceRec *pr = pidx >= 0 ? &prices[pidx] : NULL;
+        s->state = SS_TRADE;
+        if (!pr) fprintf(out, "Asset not found.\n");
+        else if (!market_is_open(pr))
+            fprintf(out, "Market for %s (%s) is currently closed (open %02d:00 to %02d:00).\n", pr->asset_id, pr->market, pr->open_hour, pr->close_hour);
+        else {
+            fprintf(out, "Current price of %s (%s) = %.4f (native)\n", pr->asset_name, pr->asset_id, pr->price);
+            s->peer = pidx; s->state = SS_BUY_QTY;
+        }
+        break;
+    }
+    case SS_SELL_ID: {
+        int pidx = find_price_index(line);
+        int hidx = pidx >= 0 ? find_holding_index(accounts[me].acc_no, pidx) : -1;
+        s->state = SS_TRADE;
+        if (pidx < 0) fprintf(out, "Asset unknown.\n");
+        else if (hidx < 0) fprintf(out, "You do not own this asset.\n");
+        else {
+            fprintf(out, "You own %.6f units. Current price (native) = %.4f\n", holdings[hidx].qty, prices[pidx].price);
+            s->peer = pidx; s->state = SS_SELL_QTY;
+        }
+        break;
+    }
+    case SS_BUY_QTY:
+    case SS_SELL_QTY:
+        if (s->state == SS_BUY_QTY) trade_buy(me, s->peer, atof(line), NULL, res, sizeof res);
+        else trade_sell(me, s->peer, atof(line), NULL, res, sizeof res);
+        fprintf(out, "%s\n", res);
+        s->state = SS_TRADE;
+        break;
+    case SS_WATCH: {
+        Subscriber *sub = subscriber_for_account(accounts[me].acc_no, 1);
+        if (ch == 1 || ch == 2) { s->peer = ch; s->state = SS_WATCH_ID; }
+        else if (ch == 3 && sub) {
+            tick_market_once(); /* simulate live market like list_market_prices */
+            watch_out.out = out;
+            if (subscriber_poll(sub, &watch_out) == 0) ob_printf(&watch_out, "No quote changes since last view.\n");
+            ob_flush(&watch_out);
+        }
+        else if (ch == 0) s->state = SS_TRADE;
+        else fprintf(out, "Invalid.\n");
+        break;
+    }
+    case SS_WATCH_ID: {
+        Subscriber *sub = subscriber_for_account(accounts[me].acc_no, 1);
+        int pidx = find_price_index(line);
+        s->state = SS_WATCH;
+        if (pidx < 0) fprintf(out, "Asset not found.\n");
+        else if (sub) {
+            if (s->peer == 1) subscribe_asset(sub, pidx); else unsubscribe_asset(sub, pidx);
+            fprintf(out, "%s %s.\n", s->peer == 1 ? "Subscribed to" : "Unsubscribed from", prices[pidx].asset_id);
+        }
+        break;
+    }
+    default:
+        return;
+    }
+    session_prompt(s, out);
+}
+
+/* terminal driver: one session fed from stdin until logout or end of input */
+static void customer_dashboard(int idx) {
+    if (idx < 0) return;
+    Session s = { SS_DASH, idx, -1, 0, 0.0, NULL };
+    char buf[128];
+    session_prompt(&s, stdout);
+    while (s.state != SS_DONE) {
+        if (!safe_read_line(buf, sizeof buf)) { session_end(&s); break; }
+        session_feed(&s, buf, stdout);
+    }
+}
+
+/* ---------------- Initialization: create default files if missing ---------------- */
+
+static void ensure_default_files(void) {
+    /* accounts: if not present, create sample team accounts */
+    FILE *f;
+    f = kv.holds_book ? NULL : fopen(F_ACCOUNTS, "r"); if (!f && !kv.holds_book) {
+        /* create sample accounts */
+        Account a;
+        AccountInfo ai;
+        memset(&a, 0, sizeof a);
+        memset(&ai, 0, sizeof ai);
+        a.last_accrual = today_day();
+        acc_count = 0;
+        /* sample team members */
+        a.acc_no = 1001; strncpy(ai.name, "adarsh", sizeof ai.name-1); ai.name[sizeof ai.name-1]='\0'; strncpy(ai.acc_type, "Savings", sizeof ai.acc_type-1); a.pin = 1234; a.balance = 10000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(ai.upi,"adarsh@bvdu", sizeof ai.upi-1); get_timestamp(ai.last_login, sizeof ai.last_login); a.type=(unsigned char)acc_type_index(ai.acc_type); account_info[acc_count]=ai; accounts[acc_count++]=a;
+        a.acc_no = 1002; strncpy(ai.name, "achyut", sizeof ai.name-1); ai.name[sizeof ai.name-1]='\0'; strncpy(ai.acc_type, "Savings", sizeof ai.acc_type-1); a.pin = 2345; a.balance = 8000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(ai.upi,"achyut@bvdu", sizeof ai.upi-1); get_timestamp(ai.last_login, sizeof ai.last_login); a.type=(unsigned char)acc_type_index(ai.acc_type); account_info[acc_count]=ai; accounts[acc_count++]=a;
+        a.acc_no = 1003; strncpy(ai.name, "ayush", sizeof ai.name-1); ai.name[sizeof ai.name-1]='\0'; strncpy(ai.acc_type, "Current", sizeof ai.acc_type-1); a.pin = 3456; a.balance = 5000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(ai.upi,"ayush@bvdu", sizeof ai.upi-1); get_timestamp(ai.last_login, sizeof ai.last_login); a.type=(unsigned char)acc_type_index(ai.acc_type); account_info[acc_count]=ai; accounts[acc_count++]=a;
+        a.acc_no = 1004; strncpy(ai.name, "aabir", sizeof ai.name-1); ai.name[sizeof ai.name-1]='\0'; strncpy(ai.acc_type, "Savings", sizeof ai.acc_type-1); a.pin = 4567; a.balance = 12000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(ai.upi,"aabir@bvdu", sizeof ai.upi-1); get_timestamp(ai.last_login, sizeof ai.last_login); a.type=(unsigned char)acc_type_index(ai.acc_type); account_info[acc_count]=ai; accounts[acc_count++]=a;
+        save_accounts();
+        audit_log("DEFAULT_ACCOUNTS_CREATED");
+    } else if (f) fclose(f);
+
+    /* transactions */
+    f = fopen(F_TRANSACTIONS, "r"); if (!f) { fclose(f); FILE *t = fopen(F_TRANSACTIONS, "w"); if (t) fclose(t); }
+    else fclose(f);
+
+    /* holdings - if absent create empty */
+    f = fopen(F_HOLDINGS, "r"); if (!f) { fclose(f); FILE *t = fopen(F_HOLDINGS, "w"); if (t) fclose(t); }
+    else fclose(f);
+
+    /* prices */
+    f = fopen(F_PRICES, "r");
+    if (!f) {
+        fclose(f);
+        /* ensure_default_prices will create default prices and save */
+        ensure_default_prices();
+    } else fclose(f);
+
+    /* fx */
+    f = fopen(F_FX, "r");
+    if (!f) {
+        fclose(f);
+        get_timestamp(fx.last_update, sizeof fx.last_update);
+        save_fx();
+    } else fclose(f);
+
+    /* admin audit and notifications */
+    f = fopen(F_ADMIN_AUDIT, "a"); if (f) fclose(f);
+    f = fopen(F_NOTIFICATIONS, "a"); if (f) fclose(f);
+}
+
+/* ---------------- Binary request server (--serve unix:/path) ---------------- */
+
+/* Wire format; integers and doubles in host order (little-endian on every
+   target this builds for):
+     request   u32 len | u8 op | u8 key_len | u16 0 | u32 tag | key | body
+     response  u32 len | u8 op | u8 status  | u16 0 | u32 tag | body
+   len counts the bytes after itself. The tag is echoed back, so a client may
+   keep many requests in flight on one connection; responses come back in
+   request order. A BATCH body is a run of complete request frames and its
+   response body the matching run of responses. key_len > 0 makes a money op
+   idempotent (see "Idempotency keys").
+   Request bodies:
+     LOGIN      i32 acc_no, i32 pin
+     DEPOSIT    f64 amount          WITHDRAW   f64 amount
+     TRANSFER   i32 to_acc, f64 amount
+     UPI        f64 amount, u8 n, UPI id
+     BUY, SELL  f64 qty, u8 n, asset id
+     BALANCE, STATEMENT, PORTFOLIO  empty
+   Response bodies:
+     LOGIN and money ops  f64 cash balance, u16 n, result text
+     BALANCE    f64 cash, f64 loan
+     STATEMENT  u16 rows, each u16 n + transactions.txt row
+     PORTFOLIO  u16 rows, each u8 n + asset id, f64 qty, f64 avg_price,
+                f64 price, f64 value_inr
+   Every request read in one poll round is applied as one commit group and
+   answered only after commit_end() has written it. Responses are encoded
+   straight into the connection's output buffer and sent with one call.
+   --serve text:/path serves the customer dashboard instead, one line-based
+   session per connection (see "Session engine"), from the same loop. */
+
+enum { OP_LOGIN = 1, OP_BALANCE, OP_DEPOSIT, OP_WITHDRAW, OP_TRANSFER, OP_UPI, OP_BUY, OP_SELL,
+       OP_STATEMENT, OP_PORTFOLIO, OP_BATCH = 15 };
+enum { ST_OK = 0, ST_REFUSED, ST_BAD_REQUEST, ST_NOT_LOGGED_IN, ST_UNKNOWN_OP };
+
+#define PROTO_HDR 12
+#define PROTO_MAX_FRAME (1u << 20)
+#define SERVE_MAX_CONNS 65536
+#define SERVE_IDLE_BUF 4096   /* larger input buffers are released once drained */
+
+typedef struct {
+    unsigned char *p;
+    size_t len, cap;
+} ProtoBuf;
+
+typedef struct {
+    int fd;
+    int acc_idx;        /* session account, -1 until LOGIN succeeds */
+    int slot;           /* position in the server's connection table */
+    uint8_t closing;    /* 1: close once the output is sent, 2: close now */
+    uint8_t want_out;   /* registered for writability */
+    Session *sess;      /* text connections only */
+    ProtoBuf in, out;   /* in holds only a partial frame or line */
+    size_t out_sent;
+} ProtoConn;
+
+typedef struct {
+    const unsigned char *p, *end;
+    int bad;
+} ProtoCursor;
+
+static _Atomic int serve_stop;
+
+static unsigned char *pb_reserve(ProtoBuf *b, size_t n) {
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap : 256;
+        while (cap < b->len + n) cap *= 2;
+        unsigned char *np = realloc(b->p, cap);
+        if (!np) { perror("pb_reserve"); exit(1); }
+        b->p = np; b->cap = cap;
+    }
+    unsigned char *at = b->p + b->len;
+    b->len += n;
+    return at;
+}
+
+static void pb_put(ProtoBuf *b, const void *v, size_t n) { memcpy(pb_reserve(b, n), v, n); }
+static void pb_u8(ProtoBuf *b, uint8_t v) { pb_put(b, &v, 1); }
+static void pb_u16(ProtoBuf *b, uint16_t v) { pb_put(b, &v, 2); }
+static void pb_f64(ProtoBuf *b, double v) { pb_put(b, &v, 8); }
+
+static void pb_text(ProtoBuf *b, const char *s) {
+    size_t n = strlen(s);
+    if (n > 65535) n = 65535;
+    pb_u16(b, (uint16_t)n);
+    pb_put(b, s, n);
+}
+
+/* start a response frame; returns its offset for proto_end() */
+static size_t proto_begin(ProtoBuf *b, uint8_t op, uint8_t status, uint32_t tag) {
+    size_t at = b->len;
+    unsigned char *h = pb_reserve(b, PROTO_HDR);
+    h[4] = op; h[5] = status; h[6] = h[7] = 0;
+    memcpy(h + 8, &tag, 4);
+    return at;
+}
+
+static void proto_end(ProtoBuf *b, size_t at) {
+    uint32_t len = (uint32_t)(b->len - at - 4);
+    memcpy(b->p + at, &len, 4);
+}
+
+static void pc_get(ProtoCursor *c, void *v, size_t n) {
+    if ((size_t)(c->end - c->p) < n) { c->bad = 1; memset(v, 0, n); return; }
+    memcpy(v, c->p, n);
+    c->p += n;
+}
+
+/* u8-length string into a NUL-terminated buffer */
+static void pc_str(ProtoCursor *c, char *out, size_t cap) {
+    uint8_t n = 0;
+    pc_get(c, &n, 1);
+    if (c->bad || n >= cap || (size_t)(c->end - c->p) < n) { c->bad = 1; out[0] = '\0'; return; }
+    memcpy(out, c->p, n);
+    out[n] = '\0';
+    c->p += n;
+}
+
+/* f64 amount or quantity; NaN, infinities and anything under min make the frame bad */
+static void pc_amount(ProtoCursor *c, double *v, double min) {
+    pc_get(c, v, 8);
+    if (!isfinite(*v) || !(*v >= min)) c->bad = 1;
+}
+
+/* one request frame (starting at its length field) -> one response in c->out */
+static void proto_handle(ProtoConn *conn, const unsigned char *f, size_t flen, int nested) {
+    ProtoBuf *b = &conn->out;
+    uint8_t op = f[4], klen = f[5];
+    uint32_t tag;
+    memcpy(&tag, f + 8, 4);
+    ProtoCursor c = { f + PROTO_HDR, f + flen, 0 };
+    char key[IDEM_KEY_MAX];
+    const char *kp = NULL;
+    if (klen) {
+        if (klen >= IDEM_KEY_MAX || (size_t)(c.end - c.p) < klen) c.bad = 1;
+        else { memcpy(key, c.p, klen); key[klen] = '\0'; c.p += klen; kp = idem_key_valid(key) ? key : NULL; c.bad = !kp; }
+    }
+    if (c.bad) { proto_end(b, proto_begin(b, op, ST_BAD_REQUEST, tag)); return; }
+
+    if (op == OP_BATCH) {
+        if (nested) { proto_end(b, proto_begin(b, op, ST_BAD_REQUEST, tag)); return; }
+        size_t at = proto_begin(b, op, ST_OK, tag);
+        while (c.end - c.p >= PROTO_HDR) {
+            uint32_t len;
+            memcpy(&len, c.p, 4);
+            if (len < PROTO_HDR - 4 || len > (size_t)(c.end - c.p) - 4) break;
+            proto_handle(conn, c.p, (size_t)len + 4, 1);
+            c.p += (size_t)len + 4;
+        }
+        if (c.p != c.end) b->p[at + 5] = ST_BAD_REQUEST; /* trailing garbage: earlier ops still ran */
+        proto_end(b, at);
+        return;
+    }
+
+    char out[IDEM_RESULT_MAX];
+    if (op == OP_LOGIN) {
+        int32_t acc_no, pin;
+        pc_get(&c, &acc_no, 4); pc_get(&c, &pin, 4);
+        if (c.bad) { proto_end(b, proto_begin(b, op, ST_BAD_REQUEST, tag)); return; }
+        int idx = login_account(acc_no, out, sizeof out);
+        if (idx >= 0) idx = login_check_pin(idx, pin, out, sizeof out);
+        if (idx >= 0) { conn->acc_idx = idx; snprintf(out, sizeof out, "Welcome %s.", account_info[idx].name); }
+        size_t at = proto_begin(b, op, idx >= 0 ? ST_OK : ST_REFUSED, tag);
+        pb_f64(b, idx >= 0 ? accounts[idx].balance : 0.0);
+        pb_text(b, out);
+        proto_end(b, at);
+        return;
+    }
+    int me = conn->acc_idx;
+    if (op < OP_BALANCE || op > OP_PORTFOLIO) { proto_end(b, proto_begin(b, op, ST_UNKNOWN_OP, tag)); return; }
+    if (me < 0 || !accounts[me].active || accounts[me].frozen) { proto_end(b, proto_begin(b, op, ST_NOT_LOGGED_IN, tag)); return; }
+
+    if (op == OP_BALANCE) {
+        size_t at = proto_begin(b, op, ST_OK, tag);
+        pb_f64(b, accounts[me].balance);
+        pb_f64(b, accounts[me].loan);
+        proto_end(b, at);
+        return;
+    }
+    if (op == OP_STATEMENT) {
+        char *lines[MINI_STAT_LIMIT];
+        size_t at = proto_begin(b, op, ST_OK, tag);
+        int n = 0;
+        if (last_transactions(accounts[me].acc_no, lines) == 0)
+            for (int i = 0; i < MINI_STAT_LIMIT; ++i) n += lines[i] != NULL;
+        else memset(lines, 0, sizeof lines);
+        pb_u16(b, (uint16_t)n);
+        for (int i = 0; i < MINI_STAT_LIMIT; ++i) if (lines[i]) { trim_newline(lines[i]); pb_text(b, lines[i]); free(lines[i]); }
+        proto_end(b, at);
+        return;
+    }
+    if (op == OP_PORTFOLIO) {
+        size_t at = proto_begin(b, op, ST_OK, tag);
+        size_t count_at = b->len;
+        uint16_t n = 0;
+        pb_u16(b, 0);
+        for (int i = 0; i < hold_count && n < 65535; ++i) {
+            const Holding *h = &holdings[i];
+            if (h->acc_no != accounts[me].acc_no) continue;
+            const PriceRec *pr = &prices[h->asset];
+            uint8_t idlen = (uint8_t)strlen(pr->asset_id);
+            pb_u8(b, idlen);
+            pb_put(b, pr->asset_id, idlen);
+            pb_f64(b, h->qty);
+            pb_f64(b, h->avg_price);
+            pb_f64(b, pr->price);
+            pb_f64(b, h->qty * price_in_inr(pr));
+            n++;
+        }
+        memcpy(b->p + count_at, &n, 2);
+        proto_end(b, at);
+        return;
+    }
+
+    int rc = -1;
+    double amount;
+    if (op == OP_DEPOSIT || op == OP_WITHDRAW) {
+        pc_amount(&c, &amount, 0.01);
+        if (!c.bad) rc = cash_movement(me, op == OP_DEPOSIT ? amount : -amount, kp, out, sizeof out);
+    } else if (op == OP_TRANSFER) {
+        int32_t to_acc;
+        pc_get(&c, &to_acc, 4);
+        pc_amount(&c, &amount, 0.01);
+        if (!c.bad) {
+            int to = find_account_index(to_acc);
+            if (to < 0) snprintf(out, sizeof out, "Destination not found or not active.");
+            else rc = transfer_funds(me, to, amount, 0, kp, out, sizeof out);
+        }
+    } else {
+        char id[64];
+        pc_amount(&c, &amount, op == OP_UPI ? 0.01 : 0.000001);
+        pc_str(&c, id, sizeof id);
+        if (!c.bad && op == OP_UPI) {
+            strtolower_inplace(id);
+            int to = find_account_by_upi(id);
+            if (to < 0) snprintf(out, sizeof out, "UPI not found. Transfers allowed only to registered BVDU UPIs.");
+            else rc = transfer_funds(me, to, amount, 1, kp, out, sizeof out);
+        } else if (!c.bad) {
+            int pidx = find_price_index(id);
+            if (pidx < 0) snprintf(out, sizeof out, "Asset not found.");
+            else rc = op == OP_BUY ? trade_buy(me, pidx, amount, kp, out, sizeof out) : trade_sell(me, pidx, amount, kp, out, sizeof out);
+        }
+    }
+    if (c.bad) { proto_end(b, proto_begin(b, op, ST_BAD_REQUEST, tag)); return; }
+    size_t at = proto_begin(b, op, rc == 0 ? ST_OK : ST_REFUSED, tag);
+    pb_f64(b, accounts[me].balance);
+    pb_text(b, out);
+    proto_end(b, at);
+}
+
+/* run every complete frame in p[0..n); returns the bytes consumed */
+static size_t proto_run(ProtoConn *conn, unsigned char *p, size_t n) {
+    size_t off = 0;
+    while (n - off >= 4) {
+        uint32_t len;
+        memcpy(&len, p + off, 4);
+        if (len < PROTO_HDR - 4 || len > PROTO_MAX_FRAME) { conn->closing = 2; return n; }
+        if (n - off < (size_t)len + 4) break;
+        proto_handle(conn, p + off, (size_t)len + 4, 0);
+        off += (size_t)len + 4;
+    }
+    return off;
+}
+
+/* feed every complete line in p[0..n) to the connection's session */
+static size_t text_run(ProtoConn *conn, unsigned char *p, size_t n) {
+    static FILE *ms;
+    static char *ms_buf;
+    static size_t ms_len;
+    if (!ms && !(ms = open_memstream(&ms_buf, &ms_len))) { perror("open_memstream"); exit(1); }
+    size_t off = 0;
+    unsigned char *nl;
+    while (conn->sess->state != SS_DONE && (nl = memchr(p + off, '\n', n - off))) {
+        *nl = '\0';
+        char *line = (char *)p + off;
+        off = (size_t)(nl - p) + 1;
+        trim_newline(line);
+        rewind(ms);
+        session_feed(conn->sess, line, ms);
+        fflush(ms);
+        pb_put(&conn->out, ms_buf, ms_len);
+    }
+    if (conn->sess->state == SS_DONE) { conn->closing = 1; return n; }
+    if (n - off > 1024) { conn->closing = 2; return n; } /* no line is that long */
+    return off;
+}
+
+/* new bytes from the socket: complete requests are handled straight from the
+   shared read buffer, only a trailing partial one is kept on the connection */
+static void proto_input(ProtoConn *conn, unsigned char *p, size_t n) {
+    size_t (*run)(ProtoConn *, unsigned char *, size_t) = conn->sess ? text_run : proto_run;
+    if (conn->in.len) {
+        pb_put(&conn->in, p, n);
+        p = conn->in.p; n = conn->in.len;
+    }
+    size_t used = run(conn, p, n);
+    if (conn->closing == 2) return;
+    if (p == conn->in.p) {
+        memmove(conn->in.p, conn->in.p + used, n - used);
+        conn->in.len = n - used;
+    } else pb_put(&conn->in, p + used, n - used);
+    if (conn->in.len == 0 && conn->in.cap > SERVE_IDLE_BUF) { free(conn->in.p); conn->in.p = NULL; conn->in.cap = 0; }
+}
+
+static int serve_listen(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path, sizeof sa.sun_path - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&sa, sizeof sa) != 0 || listen(fd, SOMAXCONN) != 0) { close(fd); return -1; }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+/* Readiness: epoll on Linux, so a round costs the connections that are
+   active rather than all that are open; poll() elsewhere. */
+#ifdef __linux__
+static int serve_ep = -1;
+
+static void serve_watch(ProtoConn *c, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (c->want_out ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(serve_ep, op, c->fd, &ev);
+}
+#endif
+
+static ProtoConn *serve_accept(int lfd, ProtoConn ***conns, int *n, int *cap, int text) {
+    int fd = accept(lfd, NULL, NULL);
+    if (fd < 0) return NULL;
+    if (*n == SERVE_MAX_CONNS) { close(fd); return NULL; }
+    if (*n == *cap) {
+        int ncap = *cap ? *cap * 2 : 64;
+        ProtoConn **nc = realloc(*conns, (size_t)ncap * sizeof *nc);
+        if (!nc) { close(fd); return NULL; }
+        *conns = nc; *cap = ncap;
+    }
+    ProtoConn *c = calloc(1, sizeof *c);
+    if (!c || (text && !(c->sess = malloc(sizeof *c->sess)))) { free(c); close(fd); return NULL; }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    c->fd = fd; c->acc_idx = -1; c->slot = *n;
+    (*conns)[(*n)++] = c;
+    if (text) {
+        *c->sess = (Session){ SS_LOGIN_ACC, -1, -1, 0, 0.0, NULL };
+        static const char hello[] = "=== BVDU Bank ===\nEnter account number: ";
+        pb_put(&c->out, hello, sizeof hello - 1);
+    }
+#ifdef __linux__
+    serve_watch(c, EPOLL_CTL_ADD);
+#endif
+    return c;
+}
+
+static void serve_close(ProtoConn *c, ProtoConn **conns, int *n) {
+    close(c->fd);   /* also drops it from the epoll set */
+    conns[c->slot] = conns[--*n];
+    conns[c->slot]->slot = c->slot;
+    if (c->sess) { session_end(c->sess); free(c->sess); }
+    free(c->in.p); free(c->out.p); free(c);
+}
+
+/* Single-threaded event loop: the book is only ever touched from here. A
+   round reads whatever is ready, applies it as one commit group, then
+   answers. Idle connections hold no read buffer; text is set for --serve text:. */
+static void serve_loop_mode(int lfd, int text) {
+    static unsigned char rbuf[65536];
+    ProtoConn **conns = NULL, **ready = NULL;
+    int n = 0, cap = 0, ready_cap = 0;
+#ifdef __linux__
+    static struct epoll_event evs[1024];
+    serve_ep = epoll_create1(0);
+    if (serve_ep < 0) { perror("epoll_create1"); return; }
+    struct epoll_event lev = { EPOLLIN, { .ptr = NULL } };
+    epoll_ctl(serve_ep, EPOLL_CTL_ADD, lfd, &lev);
+#else
+    struct pollfd *pfd = NULL;
+#endif
+    while (!atomic_load(&serve_stop)) {
+        int nready = 0, accept_ready = 0;
+        if (ready_cap < n + 1024) {
+            ready_cap = n + 1024;
+            ProtoConn **nr = realloc(ready, (size_t)ready_cap * sizeof *nr);
+            if (!nr) { perror("serve_loop"); break; }
+            ready = nr;
+        }
+        book_wait_begin();
+#ifdef __linux__
+        int ne = epoll_wait(serve_ep, evs, 1024, 200);
+        book_wait_end();
+        if (ne < 0) { if (errno == EINTR) continue; perror("epoll_wait"); break; }
+        for (int i = 0; i < ne; ++i) {
+            if (!evs[i].data.ptr) accept_ready = 1;
+            else ready[nready++] = evs[i].data.ptr;
+        }
+#else
+        struct pollfd *np = realloc(pfd, (size_t)(n + 1) * sizeof *np);
+        if (!np) { perror("serve_loop"); break; }
+        pfd = np;
+        pfd[0].fd = lfd; pfd[0].events = POLLIN; pfd[0].revents = 0;
+        for (int i = 0; i < n; ++i) {
+            pfd[i + 1].fd = conns[i]->fd;
+            pfd[i + 1].events = POLLIN | (conns[i]->want_out ? POLLOUT : 0);
+            pfd[i + 1].revents = 0;
+        }
+        int polled = poll(pfd, (nfds_t)n + 1, 200);
+        book_wait_end();
+        if (polled < 0) { if (errno == EINTR) continue; perror("poll"); break; }
+        accept_ready = pfd[0].revents & POLLIN;
+        for (int i = 0; i < n; ++i) if (pfd[i + 1].revents) ready[nready++] = conns[i];
+#endif
+        commit_begin();
+        for (int i = 0; i < nready; ++i) {
+            ProtoConn *c = ready[i];
+            while (!c->closing) {
+                ssize_t r = read(c->fd, rbuf, sizeof rbuf);
+                if (r > 0) { proto_input(c, rbuf, (size_t)r); if ((size_t)r < sizeof rbuf) break; continue; }
+                if (r < 0 && errno == EINTR) continue;
+                if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) c->closing = 2;
+                break;
+            }
+        }
+        commit_end();   /* durable before anything is acknowledged */
+        /* new connections only have a greeting to send, so they join after the commit */
+        while (accept_ready && nready < ready_cap) {
+            ProtoConn *c = serve_accept(lfd, &conns, &n, &cap, text);
+            if (!c) break;
+            ready[nready++] = c;
+        }
+        for (int i = 0; i < nready; ++i) {
+            ProtoConn *c = ready[i];
+            while (c->closing != 2 && c->out.len > c->out_sent) {
+                ssize_t w = send(c->fd, c->out.p + c->out_sent, c->out.len - c->out_sent, MSG_NOSIGNAL);
+                if (w <= 0) { if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c->closing = 2; break; }
+                c->out_sent += (size_t)w;
+            }
+            int pending = c->out.len > c->out_sent;
+            if (!pending) {
+                c->out.len = c->out_sent = 0;
+                free(c->out.p); c->out.p = NULL; c->out.cap = 0;   /* idle connections hold no buffers */
+            }
+            if (c->closing == 2 || (c->closing && !pending)) { serve_close(c, conns, &n); continue; }
+            if (pending != c->want_out) {
+                c->want_out = (uint8_t)pending;
+#ifdef __linux__
+                serve_watch(c, EPOLL_CTL_MOD);
+#endif
+            }
+        }
+    }
+    while (n > 0) serve_close(conns[n - 1], conns, &n);
+    free(conns); free(ready);
+#ifdef __linux__
+    close(serve_ep);
+    serve_ep = -1;
+#else
+    free(pfd);
+#endif
+}
+
+static void serve_loop(int lfd) { serve_loop_mode(lfd, 0); }
+
+/* ---------------- Shared-memory endpoint (--serve shm:/name) ---------------- */
+
+/* For services on the same host: a file in /dev/shm mapped by the bank and
+   by up to SHM_CLIENTS callers. Each caller claims a slot holding two
+   single-producer/single-consumer rings of fixed 64-byte messages, requests
+   (caller -> bank) and responses (bank -> caller). A ring index is only ever
+   written by one side, so pushing or popping is a plain store with release
+   ordering, no lock and no system call.
+   Waiting: a busy-poll caller spins on its response ring; a futex caller
+   sleeps on it and the bank wakes it after publishing. The bank spins while
+   work keeps arriving, then sleeps on a doorbell word that callers bump
+   after each push; it never sleeps while a busy-poll caller is attached.
+   Requests carry acc_no and PIN; a wrong PIN counts towards the lockout
+   like a failed login (the file is 0600 as well).
+   As with the socket server, everything drained in one sweep is one commit
+   group and responses are published after commit_end(). */
+
+#define SHM_CLIENTS 16
+#define SHM_RING 256              /* messages per direction, power of two */
+#define SHM_MAGIC 0x42564455u     /* "BVDU" */
+#define SHM_SPIN 4096             /* idle sweeps before the bank sleeps */
+
+typedef struct {
+    uint32_t tag;
+    uint8_t op;                   /* OP_BALANCE, OP_DEPOSIT, OP_WITHDRAW, OP_TRANSFER */
+    uint8_t status;               /* ST_* in responses */
+    uint16_t reserved;
+    int32_t acc_no, pin;
+    int32_t to_acc;
+    int32_t reserved2;
+    double amount;
+    double balance;               /* response: cash after the request */
+    char key[24];                 /* idempotency key, "" for none */
+} ShmMsg;
+
+typedef struct {
+    _Alignas(64) _Atomic uint32_t head;      /* producer: next slot to fill */
+    _Alignas(64) _Atomic uint32_t tail;      /* consumer: next slot to read */
+    _Alignas(64) _Atomic uint32_t waiting;   /* consumer asleep on head */
+    ShmMsg msg[SHM_RING];
+} ShmRing;
+
+typedef struct {
+    _Atomic uint32_t state;                  /* 0 free, 1 attached */
+    _Atomic int32_t pid;
+    uint32_t futex_mode;                     /* caller sleeps instead of spinning */
+    ShmRing req, resp;
+} ShmClient;
+
+typedef struct {
+    uint32_t magic, clients, ring, msg_size;
+    _Alignas(64) _Atomic uint32_t doorbell;  /* bumped after every request push */
+    _Atomic uint32_t bank_sleeping;
+    ShmClient client[SHM_CLIENTS];
+} ShmRegion;
+
+static void shm_wait(_Atomic uint32_t *word, uint32_t seen) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, seen, NULL, NULL, 0);
+#else
+    (void)word; (void)seen;
+    sched_yield();
+#endif
+}
+
+static void shm_wake(_Atomic uint32_t *word) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+/* publish everything written up to `head` and wake a sleeping consumer */
+static void shm_publish(ShmRing *r, uint32_t head) {
+    atomic_store(&r->head, head);
+    if (atomic_load(&r->waiting)) { atomic_store(&r->waiting, 0); shm_wake(&r->head); }
+}
+
+static ShmRegion *shm_map(const char *path, int create) {
+    int fd = open(path, O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0600);
+    if (fd < 0) return NULL;
+    if (create && ftruncate(fd, sizeof(ShmRegion)) != 0) { close(fd); return NULL; }
+    void *m = mmap(NULL, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return NULL;
+    ShmRegion *rg = m;
+    if (create) {
+        rg->clients = SHM_CLIENTS; rg->ring = SHM_RING; rg->msg_size = sizeof(ShmMsg);
+        atomic_thread_fence(memory_order_release);
+        rg->magic = SHM_MAGIC;
+    } else if (rg->magic != SHM_MAGIC || rg->msg_size != sizeof(ShmMsg)) {
+        munmap(m, sizeof(ShmRegion));
+        return NULL;
+    }
+    return rg;
+}
+
+/* caller side: claim a slot (reclaiming ones left by dead processes) */
+static int shm_attach(ShmRegion *rg, int futex_mode) {
+    for (int i = 0; i < SHM_CLIENTS; ++i) {
+        ShmClient *c = &rg->client[i];
+        uint32_t st = atomic_load(&c->state);
+        int32_t pid = atomic_load(&c->pid);
+        if (st && !(pid > 0 && kill(pid, 0) != 0 && errno == ESRCH)) continue;
+        if (!atomic_compare_exchange_strong(&c->state, &st, 1)) continue;
+        atomic_store(&c->req.head, atomic_load(&c->req.tail));   /* drop a dead caller's leftovers */
+        atomic_store(&c->resp.tail, atomic_load(&c->resp.head));
+        c->futex_mode = (uint32_t)futex_mode;
+        atomic_store(&c->pid, (int32_t)getpid());
+        return i;
+    }
+    return -1;
+}
+
+static void shm_detach(ShmRegion *rg, int slot) {
+    atomic_store(&rg->client[slot].pid, 0);
+    atomic_store(&rg->client[slot].state, 0);
+}
+
+/* caller side: one request, one response (m is overwritten by the reply) */
+static void shm_call(ShmRegion *rg, int slot, ShmMsg *m) {
+    ShmClient *c = &rg->client[slot];
+    uint32_t h = atomic_load_explicit(&c->req.head, memory_order_relaxed);
+    while (h - atomic_load_explicit(&c->req.tail, memory_order_acquire) >= SHM_RING) sched_yield();
+    c->req.msg[h & (SHM_RING - 1)] = *m;
+    atomic_store_explicit(&c->req.head, h + 1, memory_order_release);
+    atomic_fetch_add(&rg->doorbell, 1);
+    if (atomic_load(&rg->bank_sleeping)) shm_wake(&rg->doorbell);
+
+    uint32_t t = atomic_load_explicit(&c->resp.tail, memory_order_relaxed);
+    for (unsigned spins = 0; atomic_load_explicit(&c->resp.head, memory_order_acquire) == t; ++spins) {
+        if (c->futex_mode) {
+            atomic_store(&c->resp.waiting, 1);
+            if (atomic_load(&c->resp.head) == t) shm_wait(&c->resp.head, t);
+        } else if (spins % 1024 == 1023) sched_yield();   /* stays usable on a single core */
+    }
+    *m = c->resp.msg[t & (SHM_RING - 1)];
+    atomic_store_explicit(&c->resp.tail, t + 1, memory_order_release);
+}
+
+static void shm_handle(ShmMsg *m) {
+    char out[IDEM_RESULT_MAX];
+    const char *key = m->key[0] && memchr(m->key, '\0', sizeof m->key) && idem_key_valid(m->key) ? m->key : NULL;
+    int idx = find_account_index(m->acc_no);
+    if (idx < 0 || !accounts[idx].active || accounts[idx].frozen) { m->status = ST_NOT_LOGGED_IN; return; }
+    /* every message carries the PIN, so a miss counts toward the freeze like a login */
+    if ((accounts[idx].pin != m->pin || accounts[idx].failed_attempts) && login_check_pin(idx, m->pin, out, sizeof out) < 0) { m->status = ST_NOT_LOGGED_IN; return; }
+    if (m->op != OP_BALANCE && (!isfinite(m->amount) || !(m->amount >= 0.01))) { m->status = ST_BAD_REQUEST; return; }
+    int rc = 0;
+    if (m->op == OP_BALANCE) ;
+    else if (m->op == OP_DEPOSIT || m->op == OP_WITHDRAW) rc = cash_movement(idx, m->op == OP_DEPOSIT ? m->amount : -m->amount, key, out, sizeof out);
+    else if (m->op == OP_TRANSFER) {
+        int to = find_account_index(m->to_acc);
+        rc = to < 0 ? -1 : transfer_funds(idx, to, m->amount, 0, key, out, sizeof out);
+    } else { m->status = ST_UNKNOWN_OP; return; }
+    m->status = rc == 0 ? ST_OK : ST_REFUSED;
+    m->balance = accounts[idx].balance;
+}
+
+/* bank side */
+static void shm_serve_loop(ShmRegion *rg) {
+    uint32_t pending[SHM_CLIENTS];   /* response head not yet published */
+    unsigned idle = 0;
+    while (!atomic_load(&serve_stop)) {
+        int work = 0, spinners = 0;
+        book_wait_end();
+        commit_begin();
+        for (int i = 0; i < SHM_CLIENTS; ++i) {
+            ShmClient *c = &rg->client[i];
+            pending[i] = atomic_load_explicit(&c->resp.head, memory_order_relaxed);
+            if (!atomic_load_explicit(&c->state, memory_order_acquire)) continue;
+            spinners += !c->futex_mode;
+            uint32_t t = atomic_load_explicit(&c->req.tail, memory_order_relaxed);
+            uint32_t h = atomic_load_explicit(&c->req.head, memory_order_acquire);
+            uint32_t room = SHM_RING - (pending[i] - atomic_load_explicit(&c->resp.tail, memory_order_acquire));
+            for (; t != h && room; ++t, --room, ++work) {
+                ShmMsg m = c->req.msg[t & (SHM_RING - 1)];
+                shm_handle(&m);
+                c->resp.msg[pending[i]++ & (SHM_RING - 1)] = m;
+            }
+            atomic_store_explicit(&c->req.tail, t, memory_order_release);
+        }
+        commit_end();   /* durable before anything is acknowledged */
+        for (int i = 0; i < SHM_CLIENTS; ++i)
+            if (pending[i] != atomic_load_explicit(&rg->client[i].resp.head, memory_order_relaxed)) shm_publish(&rg->client[i].resp, pending[i]);
+        book_wait_begin();   /* other front ends get the book between sweeps */
+        if (work || spinners) { idle = 0; if (!work) sched_yield(); continue; }
+        if (++idle < SHM_SPIN) continue;
+        /* nothing for a while: sleep until a caller rings */
+        uint32_t bell = atomic_load(&rg->doorbell);
+        atomic_store(&rg->bank_sleeping, 1);
+        int any = 0;
+        for (int i = 0; i < SHM_CLIENTS && !any; ++i)
+            any = atomic_load(&rg->client[i].req.head) != atomic_load(&rg->client[i].req.tail);
+        if (!any && !atomic_load(&serve_stop)) shm_wait(&rg->doorbell, bell);
+        atomic_store(&rg->bank_sleeping, 0);
+        idle = 0;
+    }
+}
+
+/* Ctrl-C / kill: finish the current sweep, then remove the endpoint */
+static void serve_signal(int sig) {
+    (void)sig;
+    atomic_store(&serve_stop, 1);
+}
+
+static int run_server(const char *addr) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = serve_signal;   /* no SA_RESTART: poll() and futex waits must return */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    if (strncmp(addr, "shm:", 4) == 0) {
+        char path[128];
+        snprintf(path, sizeof path, "/dev/shm/%s", addr[4] == '/' ? addr + 5 : addr + 4);
+        ShmRegion *rg = shm_map(path, 1);
+        if (!rg) { perror(path); return 1; }
+        printf("Serving shared-memory endpoint %s (%d client slots)\n", path, SHM_CLIENTS);
+        fflush(stdout);
+        shm_serve_loop(rg);
+        munmap(rg, sizeof *rg);
+        unlink(path);
+        return 0;
+    }
+    int text = strncmp(addr, "text:", 5) == 0;
+    const char *path = text || strncmp(addr, "unix:", 5) == 0 ? addr + 5 : addr;
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;  /* one descriptor per session */
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    int lfd = serve_listen(path);
+    if (lfd < 0) { perror(path); return 1; }
+    printf("Serving %s on unix:%s\n", text ? "text sessions" : "binary protocol", path);
+    fflush(stdout);
+    serve_loop_mode(lfd, text);
+    close(lfd);
+    unlink(path);
+    return 0;
+}
+
+/* ---------------- Thread-per-core transfer engine (--transfers) ---------------- */
+
+/* Large transfer runs split the book across cores instead of locking it.
+   Core c owns every account with acc_no % ncores == c. It keeps those
+   balances (in paise) in memory it allocates itself after pinning to its
+   CPU, so first-touch placement puts them on that CPU's NUMA node, and it
+   writes the ledger rows of its accounts into its own segment. A transfer
+   goes to the core owning the payer, which debits it; when the payee lives
+   on another core the credit follows as a message. Each (sender, receiver)
+   pair has its own single-producer/single-consumer ring, so nothing on the
+   hot path is shared between cores. After the run the balances go back
+   into accounts[], the book is saved once and the segments are appended. */
+
+#define CORE_MAX 64
+#define CORE_RING 256             /* messages per ring, power of two */
+#define CORE_BURST 64             /* messages taken from one ring per visit */
+
+enum { CM_TRANSFER = 1, CM_CREDIT };
+
+typedef struct {
+    int32_t kind;
+    int32_t from, to;             /* accounts[] slots */
+    int64_t paise;
+} CoreMsg;
+
+typedef struct {
+    _Alignas(64) _Atomic uint32_t head;
+    _Alignas(64) _Atomic uint32_t tail;
+    _Alignas(64) CoreMsg msg[CORE_RING];
+} CoreRing;
+
+typedef struct {
+    _Alignas(64) _Atomic long finished;   /* transfers credited or refused here */
+    int id, ncores, nslots;
+    int64_t *paise;               /* owned balances by local index */
+    int64_t *seed;                /* paise[] as loaded, for the write-back delta */
+    uint8_t *touched;
+    CoreRing *in;                 /* in[j]: from core j; in[ncores]: from the dispatcher */
+    _Atomic int ready;
+    CoreMsg *backlog;             /* credits waiting for room in a full ring */
+    int nbacklog, backlog_cap;
+    ProtoBuf ledger;
+    long applied, refused;
+} Core;
+
+typedef struct {
+    int from, to;                 /* accounts[] slots */
+    int64_t paise;
+} CoreReq;
+
+static Core *cores[CORE_MAX];
+static int core_local[MAX_ACCOUNTS];   /* slot -> index in its owner's arrays */
+static _Atomic int core_stop;
+static char core_ts[25];
+
+static int core_owner(int slot, int ncores) { return (int)((unsigned)accounts[slot].acc_no % (unsigned)ncores); }
+
+static int core_push(CoreRing *r, const CoreMsg *m) {
+    uint32_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (h - atomic_load_explicit(&r->tail, memory_order_acquire) == CORE_RING) return 0;
+    r->msg[h & (CORE_RING - 1)] = *m;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+    return 1;
+}
+
+static void core_pin(int cpu) {
+#ifdef __linux__
+    unsigned long mask[CORE_MAX / (8 * sizeof(unsigned long)) + 1] = {0};
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) return;
+    cpu %= (int)online;
+    mask[cpu / (8 * (int)sizeof(unsigned long))] = 1UL << (cpu % (8 * (int)sizeof(unsigned long)));
+    syscall(SYS_sched_setaffinity, 0, sizeof mask, mask); /* best effort */
+#else
+    (void)cpu;
+#endif
+}
+
+static void core_ledger(Core *c, int slot, const char *type, int64_t paise, const char *fmt, int peer) {
+    Transaction t;
+    t.acc_no = accounts[slot].acc_no;
+    snprintf(t.timestamp, sizeof t.timestamp, "%s", core_ts);
+    snprintf(t.type, sizeof t.type, "%s", type);
+    t.amount = (double)paise / 100.0;
+    t.balance_after = (double)c->paise[core_local[slot]] / 100.0;
+    snprintf(t.note, sizeof t.note, fmt, peer);
+    char *at = (char *)pb_reserve(&c->ledger, MAX_LINE);
+    c->ledger.len -= MAX_LINE - (size_t)format_transaction(at, MAX_LINE, &t);
 }
 
-/* ---------------- Admin functions ---------------- */
+static void core_credit(Core *c, const CoreMsg *m) {
+    int l = core_local[m->to];
+    c->paise[l] += m->paise;
+    c->touched[l] = 1;
+    core_ledger(c, m->to, "TRANSFER_IN", m->paise, "Transfer from %d", accounts[m->from].acc_no);
+    atomic_store_explicit(&c->finished, atomic_load_explicit(&c->finished, memory_order_relaxed) + 1, memory_order_release);
+}
 
-static void admin_menu(void) {
-    printf("Admin PIN: ");
-    int pin = safe_read_int();
-    if (pin != ADMIN_PIN) { printf("Invalid admin PIN.\n"); return; }
-    audit_log("ADMIN_LOGIN");
-    for (;;) {
-        printf("\n--- Admin Dashboard ---\n");
-        printf("1.View accounts\n2.Set price\n3.Randomize prices (admin)\n4.Apply interest to Savings\n5.View audit log file path\n6.Set FX rates\n7.Unfreeze account\n8.Tick market once\n0.Logout\nChoice: ");
-        int ch = safe_read_int();
-        if (ch == 1) {
-            printf("AccNo | Name | Type | Balance | Loan | Active | Frozen | UPI\n");
-            for (int i = 0; i < acc_count; ++i) {
-                Account *a = &accounts[i];
-                printf("%d | %s | %s | %.2f | %.2f | %d | %d | %s\n",
-                    a->acc_no, a->name, a->acc_type, a->balance, a->loan, a->active, a->frozen, a->upi);
-            }
-        } else if (ch == 2) {
-            printf("Enter Asset ID to set price: ");
-            char buf[128]; if (!fgets(buf, sizeof buf, stdin)) break; trim_newline(buf);
-            int idx = find_price_index(buf);
-            if (idx < 0) { printf("Asset not found.\n"); continue; }
-            printf("Enter new price (native): ");
-            double p = safe_read_double(); if (p <= 0) { printf("Invalid.\n"); continue; }
-            double old = prices[idx].price; prices[idx].price = p; get_timestamp(prices[idx].last_update, sizeof prices[idx].last_update); save_prices();
-            char audit[128]; snprintf(audit, sizeof audit, "ADMIN_SET_PRICE|%s|%.4f->%.4f", prices[idx].asset_id, old, p); audit_log(audit);
-            printf("Price updated.\n");
-        } else if (ch == 3) {
-            admin_randomize_all_prices();
-            printf("Prices randomized by admin.\n");
-        } else if (ch == 4) {
-            printf("Enter annual interest percent for Savings: ");
-            double rate = safe_read_double();
-            if (rate <= 0) { printf("Invalid rate.\n"); continue; }
-            for (int i = 0; i < acc_count; ++i) {
-                if (!accounts[i].active) continue;
-                if (bvdu_stricmp(accounts[i].acc_type, "Savings") == 0) {
-                    double interest = accounts[i].balance * (rate / 100.0);
-                    accounts[i].balance += interest;
-                    char note[128]; snprintf(note, sizeof note, "Interest applied %.2f%%", rate);
-                    log_transaction(accounts[i].acc_no, "INTEREST", interest, accounts[i].balance, note);
-                }
+static void core_transfer(Core *c, const CoreMsg *m) {
+    int l = core_local[m->from];
+    /* the core's account_available(): striped credits that landed since load count */
+    int64_t striped = hot_drain(m->from);
+    if (striped) { c->paise[l] += striped; c->touched[l] = 1; }
+    if (c->paise[l] < m->paise) {
+        c->refused++;
+        atomic_store_explicit(&c->finished, atomic_load_explicit(&c->finished, memory_order_relaxed) + 1, memory_order_release);
+        return;
+    }
+    c->paise[l] -= m->paise;
+    c->touched[l] = 1;
+    c->applied++;
+    core_ledger(c, m->from, "TRANSFER_OUT", -m->paise, "Transfer to %d", accounts[m->to].acc_no);
+    CoreMsg credit = *m;
+    credit.kind = CM_CREDIT;
+    int owner = core_owner(m->to, c->ncores);
+    if (owner == c->id) { core_credit(c, &credit); return; }
+    if (c->nbacklog == 0 && core_push(&cores[owner]->in[c->id], &credit)) return;
+    if (c->nbacklog == c->backlog_cap) {
+        int cap = c->backlog_cap ? c->backlog_cap * 2 : 256;
+        CoreMsg *nb = realloc(c->backlog, (size_t)cap * sizeof *nb);
+        if (!nb) { perror("core_transfer"); exit(1); }
+        c->backlog = nb; c->backlog_cap = cap;
+    }
+    c->backlog[c->nbacklog++] = credit;
+}
+
+static void *core_worker(void *arg) {
+    Core *c = arg;
+    int n = c->ncores;
+    core_pin(c->id);
+    /* allocated and first written here, on this core's node */
+    c->paise = malloc((size_t)(c->nslots ? c->nslots : 1) * sizeof *c->paise);
+    c->seed = malloc((size_t)(c->nslots ? c->nslots : 1) * sizeof *c->seed);
+    c->touched = calloc((size_t)(c->nslots ? c->nslots : 1), 1);
+    c->in = aligned_alloc(64, (size_t)(n + 1) * sizeof *c->in);
+    if (!c->paise || !c->seed || !c->touched || !c->in) { perror("core_worker"); exit(1); }
+    memset(c->in, 0, (size_t)(n + 1) * sizeof *c->in);
+    for (int i = 0; i < acc_count; ++i)
+        if (core_owner(i, n) == c->id)
+            c->seed[core_local[i]] = c->paise[core_local[i]] = (int64_t)(accounts[i].balance * 100.0 + (accounts[i].balance < 0 ? -0.5 : 0.5));
+    atomic_store_explicit(&c->ready, 1, memory_order_release);
+
+    while (!atomic_load_explicit(&core_stop, memory_order_acquire)) {
+        int busy = 0;
+        /* retry parked credits in order, so one payee's rows stay ordered */
+        int kept = 0;
+        for (int i = 0; i < c->nbacklog; ++i) {
+            const CoreMsg *m = &c->backlog[i];
+            if (kept || !core_push(&cores[core_owner(m->to, n)]->in[c->id], m)) c->backlog[kept++] = *m;
+        }
+        busy |= kept != c->nbacklog;
+        c->nbacklog = kept;
+        for (int j = 0; j <= n; ++j) {
+            CoreRing *r = &c->in[j];
+            uint32_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            uint32_t h = atomic_load_explicit(&r->head, memory_order_acquire);
+            if (h - t > CORE_BURST) h = t + CORE_BURST;
+            for (; t != h; ++t) {
+                const CoreMsg *m = &r->msg[t & (CORE_RING - 1)];
+                if (m->kind == CM_TRANSFER) core_transfer(c, m); else core_credit(c, m);
+                busy = 1;
             }
+            atomic_store_explicit(&r->tail, t, memory_order_release);
+        }
+        if (!busy) sched_yield();
+    }
+    return NULL;
+}
+
+/* Run every request next() yields on ncores cores. Each touched balance is
+   written back as one account_credit() of its net change, so interest is
+   accrued on the old balance and the bank totals follow; with persist the book is saved and the ledger
+   segments appended. Returns 0, or -1 when the cores could not be started
+   (nothing has moved then). */
+static int core_run(int ncores, int (*next)(void *, CoreReq *), void *src, int persist, long *applied, long *refused) {
+    if (ncores < 1) ncores = 1;
+    if (ncores > CORE_MAX) ncores = CORE_MAX;
+    hot_fold_all();
+    get_timestamp(core_ts, sizeof core_ts);
+    memset(cores, 0, sizeof cores);
+    for (int t = 0; t < ncores; ++t) {
+        cores[t] = aligned_alloc(64, sizeof(Core));
+        if (!cores[t]) { while (t--) free(cores[t]); return -1; }
+        memset(cores[t], 0, sizeof(Core));
+        cores[t]->id = t; cores[t]->ncores = ncores;
+    }
+    for (int i = 0; i < acc_count; ++i) core_local[i] = cores[core_owner(i, ncores)]->nslots++;
+
+    atomic_store(&core_stop, 0);
+    pthread_t tids[CORE_MAX];
+    int started = 0;
+    while (started < ncores && pthread_create(&tids[started], NULL, core_worker, cores[started]) == 0) started++;
+    for (int t = 0; t < started; ++t)
+        while (!atomic_load_explicit(&cores[t]->ready, memory_order_acquire)) sched_yield();
+
+    long dispatched = 0;
+    if (started == ncores) {
+        CoreReq rq;
+        while (next(src, &rq)) {
+            CoreMsg m = { CM_TRANSFER, rq.from, rq.to, rq.paise };
+            CoreRing *r = &cores[core_owner(rq.from, ncores)]->in[ncores];
+            while (!core_push(r, &m)) sched_yield();
+            dispatched++;
+        }
+        /* a transfer finishes on its payer's core when refused, otherwise on
+           its payee's core once credited: done when every one has finished */
+        for (;;) {
+            long fin = 0;
+            for (int t = 0; t < ncores; ++t) fin += atomic_load_explicit(&cores[t]->finished, memory_order_acquire);
+            if (fin == dispatched) break;
+            sched_yield();
+        }
+    }
+    atomic_store(&core_stop, 1);
+    for (int t = 0; t < started; ++t) pthread_join(tids[t], NULL);
+
+    *applied = *refused = 0;
+    if (started == ncores) {
+        for (int i = 0; i < acc_count; ++i) {
+            const Core *c = cores[core_owner(i, ncores)];
+            int l = core_local[i];
+            if (c->touched[l] && c->paise[l] != c->seed[l]) account_credit(i, (double)(c->paise[l] - c->seed[l]) / 100.0);
+        }
+        for (int t = 0; t < ncores; ++t) { *applied += cores[t]->applied; *refused += cores[t]->refused; }
+        if (persist) {
             save_accounts();
-            audit_log("ADMIN_APPLY_INTEREST");
-            printf("Interest applied to savings.\n");
-        } else if (ch == 5) {
-            printf("Audit log file: %s\nNotifications file: %s\n", F_ADMIN_AUDIT, F_NOTIFICATIONS);
-        } else if (ch == 6) {
-            printf("Enter INR per USD (e.g., 83.5): ");
-            double usd = safe_read_double();
-            printf("Enter INR per EUR (e.g., 88.2): ");
-            double eur = safe_read_double();
-            if (usd <= 0 || eur <= 0) { printf("Invalid rates.\n"); continue; }
-            fx.inr_per_usd = usd; fx.inr_per_eur = eur; get_timestamp(fx.last_update, sizeof fx.last_update); save_fx();
-            char audit[128]; snprintf(audit, sizeof audit, "ADMIN_SET_FX|INR_USD=%.6f|INR_EUR=%.6f", usd, eur); audit_log(audit);
-            printf("FX updated.\n");
-        } else if (ch == 7) {
-            printf("Enter acc_no to unfreeze: ");
-            int a = safe_read_int();
-            int idx = find_account_index(a);
-            if (idx < 0) { printf("Account not found.\n"); continue; }
-            accounts[idx].frozen = 0; accounts[idx].failed_attempts = 0; save_accounts();
-            char audit[128]; snprintf(audit, sizeof audit, "ADMIN_UNFREEZE|%d", a); audit_log(audit);
-            printf("Account %d unfrozen.\n", a);
-        } else if (ch == 8) {
-            tick_market_once();
-            printf("Market tick executed.\n");
-        } else if (ch == 0) {
-            audit_log("ADMIN_LOGOUT"); break;
-        } else printf("Invalid.\n");
+            for (int t = 0; t < ncores; ++t)
+                if (cores[t]->ledger.len && io_append(F_TRANSACTIONS, cores[t]->ledger.p, cores[t]->ledger.len, 0) != 0) perror("core_run");
+        }
     }
+    for (int t = 0; t < ncores; ++t) {
+        Core *c = cores[t];
+        free(c->paise); free(c->seed); free(c->touched); free(c->in); free(c->backlog); free(c->ledger.p); free(c);
+        cores[t] = NULL;
+    }
+    return started == ncores ? 0 : -1;
 }
 
-/* ---------------- Menus ---------------- */
+typedef struct {
+    FILE *f;
+    long line, skipped;
+} TransferFile;
 
-static void trading_app_menu(int acc_idx) {
-    if (acc_idx < 0) {
-        printf("Please login as a customer to use the Trading App.\n");
-        return;
+#define CORE_MAX_INR 1e15          /* largest transfer; its paise fit int64_t with room to spare */
+
+/* next valid "from_acc|to_acc|amount" line; malformed ones are counted */
+static int transfer_file_next(void *arg, CoreReq *rq) {
+    TransferFile *tf = arg;
+    char line[MAX_LINE];
+    while (fgets(line, sizeof line, tf->f)) {
+        tf->line++;
+        trim_newline(line);
+        if (!line[0] || line[0] == '#') continue;
+        int from_acc, to_acc; double amt;
+        if (sscanf(line, "%d|%d|%lf", &from_acc, &to_acc, &amt) != 3 || !isfinite(amt) || !(amt >= 0.01) || amt > CORE_MAX_INR) {
+            tf->skipped++;
+            continue;
+        }
+        rq->from = find_active_account_index(from_acc);
+        rq->to = find_active_account_index(to_acc);
+        if (rq->from < 0 || rq->to < 0 || rq->from == rq->to || accounts[rq->from].frozen || accounts[rq->to].frozen) { tf->skipped++; continue; }
+        rq->paise = (int64_t)(amt * 100.0 + 0.5);
+        return 1;
     }
-    ensure_default_prices();
-    for (;;) {
-        printf("\n=== BVDU Trading App ===\n1.List Market Prices\n2.Buy Asset\n3.Sell Asset\n4.View Portfolio\n0.Exit\nChoice: ");
-        int ch = safe_read_int();
-        if (ch == 1) list_market_prices();
-        else if (ch == 2) buy_asset_loggedin(acc_idx);
-        else if (ch == 3) sell_asset_loggedin(acc_idx);
-        else if (ch == 4) view_portfolio(acc_idx);
-        else if (ch == 0) break;
-        else printf("Invalid.\n");
+    return 0;
+}
+
+/* --transfers <file> [cores]: apply independent transfers, one per line */
+static int run_transfers(const char *path, int ncores) {
+    TransferFile tf = { fopen(path, "r"), 0, 0 };
+    if (!tf.f) { printf("Cannot read %s.\n", path); return 1; }
+    if (ncores < 1) ncores = settle_thread_count();
+    long applied, refused;
+    double t0 = now_seconds();
+    int rc = core_run(ncores, transfer_file_next, &tf, 1, &applied, &refused);
+    double secs = now_seconds() - t0;
+    fclose(tf.f);
+    if (rc != 0) { printf("Could not start %d core(s). Nothing was moved.\n", ncores); return 1; }
+    char audit[128];
+    snprintf(audit, sizeof audit, "TRANSFERS|%s|cores=%d|applied=%ld|refused=%ld|skipped=%ld", path, ncores, applied, refused, tf.skipped);
+    audit_log(audit);
+    printf("Applied %ld transfer(s) on %d core(s) in %.3f s; %ld refused for funds, %ld line(s) skipped.\n",
+        applied, ncores, secs, refused, tf.skipped);
+    return 0;
+}
+
+/* ---------------- Benchmarks (./bvdu_bank --bench <name>) ---------------- */
+
+/* publication cost must not depend on the number of subscribers */
+static void bench_pubsub(void) {
+    const int ticks = 1000000;
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    for (int round = 0; round < 2; ++round) {
+        int nsubs = round ? MAX_SUBSCRIBERS : 0;
+        for (int k = 0; k < nsubs; ++k) {
+            Subscriber *s = subscriber_for_account(100000 + k, 1);
+            for (int i = 0; i < price_count; ++i) subscribe_asset(s, i);
+        }
+        double t0 = now_seconds();
+        for (int k = 0; k < ticks; ++k) {
+            int i = k % price_count;
+            set_asset_price(i, prices[i].price * (k & 1 ? 1.001 : 0.999), ts);
+        }
+        double pub = now_seconds() - t0;
+        t0 = now_seconds();
+        int delivered = 0;
+        for (int k = 0; k < nsubs; ++k) delivered += subscriber_poll(&subscribers[k], NULL);
+        double poll = now_seconds() - t0;
+        printf("subscribers=%-5d publish: %.1f ns/tick  poll-all: %.3f ms (%d quotes delivered)\n",
+            nsubs, pub / ticks * 1e9, poll * 1e3, delivered);
     }
 }
 
-/* Customer dashboard uses logged-in index and avoids re-auth for transfer/upi */
-static void customer_dashboard(int idx) {
-    if (idx < 0) return;
-    for (;;) {
-        double port = compute_portfolio_value_inr(accounts[idx].acc_no);
-        double pl = compute_unrealized_pl_inr(accounts[idx].acc_no);
-        printf("\n--- Customer Dashboard: %s (%d) ---\n", accounts[idx].name, accounts[idx].acc_no);
-        printf("Cash: %.2f INR | Portfolio: %.2f INR | Unrealized P/L: %+.2f INR\n", accounts[idx].balance, port, pl);
-        printf("1.Balance Enquiry\n2.Deposit\n3.Withdraw\n4.Transfer\n5.Mini Statement\n6.Trading App\n7.UPI Transfer\n8.Account Details\n0.Logout\nChoice: ");
-        int ch = safe_read_int();
-        if (ch == 1) { printf("Cash balance: %.2f INR\nLoan outstanding: %.2f\n", accounts[idx].balance, accounts[idx].loan); }
-        else if (ch == 2) deposit_money();
-        else if (ch == 3) withdraw_money();
-        else if (ch == 4) transfer_from_loggedin(idx);
-        else if (ch == 5) print_mini_statement_for_account(accounts[idx].acc_no);
-        else if (ch == 6) trading_app_menu(idx);
-        else if (ch == 7) upi_transfer_from_loggedin(idx);
-        else if (ch == 8) show_account_details(idx);
-        else if (ch == 0) { printf("Logging out...\n"); break; }
-        else printf("Invalid.\n");
+/* per-trade fee lookup vs the batch re-pricing kernel */
+static void bench_fees(void) {
+    const int n = 1000000;
+    double *cols = malloc((size_t)n * 7 * sizeof *cols);
+    if (!cols || price_count == 0) { free(cols); printf("bench_fees: setup failed\n"); return; }
+    double *value = cols, *bps = cols + n, *mn = cols + 2*(size_t)n, *mx = cols + 3*(size_t)n;
+    double *levy = cols + 4*(size_t)n, *spread = cols + 5*(size_t)n, *out = cols + 6*(size_t)n;
+    double sink = 0.0;
+    double t0 = now_seconds();
+    for (int i = 0; i < n; ++i) {
+        double v = 1000.0 + (i % 5000) * 37.0;
+        sink += compute_fees(i % price_count, (i & 1) ? 'S' : 'B', v, (double)(i % 2000000)).total;
+    }
+    double scalar = now_seconds() - t0;
+    for (int i = 0; i < n; ++i) {
+        const FeeCell *cell = &fee_table[price_market[i % price_count]][price_class[i % price_count]][i & 1];
+        value[i] = 1000.0 + (i % 5000) * 37.0;
+        bps[i] = cell->bps[0]; mn[i] = cell->min_fee[0]; mx[i] = cell->max_fee[0];
+        levy[i] = cell->levy_bps; spread[i] = cell->spread_bps; out[i] = 0.0;
     }
+    t0 = now_seconds();
+    fee_kernel(n, value, bps, mn, mx, levy, spread, out);
+    double batch = now_seconds() - t0;
+    for (int i = 0; i < n; ++i) sink += out[i];
+    printf("compute_fees: %.1f ns/trade  fee_kernel: %.2f ns/trade  (checksum %.0f)\n",
+        scalar / n * 1e9, batch / n * 1e9, sink);
+    free(cols);
 }
 
-/* ---------------- Initialization: create default files if missing ---------------- */
+/* incremental basket NAV vs recomputing every basket from its constituents */
+static void bench_basket(void) {
+    const int n_assets = 500, n_baskets = 2000, per_basket = 20, ticks = 1000000;
+    char ts[25];
+    get_timestamp(ts, sizeof ts);
+    int first = price_count;
+    for (int a = 0; a < n_assets && price_count < MAX_PRICES; ++a) {
+        PriceRec *p = &prices[price_count++];
+        memset(p, 0, sizeof *p);
+        snprintf(p->asset_id, sizeof p->asset_id, "SYN%d", a);
+        strcpy(p->market, a % 3 == 0 ? "US" : "IN");
+        p->price = 100.0 + a;
+    }
+    rebuild_price_index();
+    refresh_all_price_inr();
+    int made = 0;
+    for (int b = 0; b < n_baskets; ++b) {
+        char id[16], spec[MAX_LINE * 2];
+        size_t off = 0;
+        snprintf(id, sizeof id, "BSK%d", b);
+        for (int k = 0; k < per_basket; ++k)
+            off += (size_t)snprintf(spec + off, sizeof spec - off, "%sSYN%d:%.2f", k ? "," : "", rand() % n_assets, 0.5 + (rand() % 100) / 50.0);
+        if (add_basket(id, id, "IN", 0, 24, spec) >= 0) made++;
+    }
+    rebuild_basket_links();
+    recompute_all_basket_navs();
+    int universe = price_count - first - made;
+    double t0 = now_seconds();
+    for (int k = 0; k < ticks; ++k) {
+        int i = first + rand() % universe;
+        set_asset_price(i, prices[i].price * (1.0 + rand_minus1_1() * 0.001), ts);
+    }
+    double inc = now_seconds() - t0;
+    double drift = 0.0;
+    double saved[MAX_PRICES];
+    for (int i = 0; i < price_count; ++i) saved[i] = prices[i].price;
+    const int full_ticks = 200;
+    t0 = now_seconds();
+    for (int k = 0; k < full_ticks; ++k) recompute_all_basket_navs();
+    double full = now_seconds() - t0;
+    for (int i = 0; i < price_count; ++i)
+        if (is_basket[i] && prices[i].price > 0) {
+            double d = fabs(saved[i] - prices[i].price) / prices[i].price;
+            if (d > drift) drift = d;
+        }
+    printf("%d baskets x %d constituents over %d assets (%d links)\n", made, per_basket, universe, basket_entry_count);
+    printf("incremental: %.1f ns/tick  full recompute: %.1f us/tick  max drift after %d ticks: %.2e\n",
+        inc / ticks * 1e9, full / full_ticks * 1e6, ticks, drift);
+}
 
-static void ensure_default_files(void) {
-    /* accounts: if not present, create sample team accounts */
-    FILE *f;
-    f = fopen(F_ACCOUNTS, "r"); if (!f) {
-        fclose(f);
-        /* create sample accounts */
-        Account a;
-        acc_count = 0;
-        /* sample team members */
-        a.acc_no = 1001; strncpy(a.name, "adarsh", sizeof a.name-1); a.name[sizeof a.name-1]='\0'; strncpy(a.acc_type, "Savings", sizeof a.acc_type-1); a.pin = 1234; a.balance = 10000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(a.upi,"adarsh@bvdu", sizeof a.upi-1); get_timestamp(a.last_login, sizeof a.last_login); accounts[acc_count++]=a;
-        a.acc_no = 1002; strncpy(a.name, "achyut", sizeof a.name-1); a.name[sizeof a.name-1]='\0'; strncpy(a.acc_type, "Savings", sizeof a.acc_type-1); a.pin = 2345; a.balance = 8000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(a.upi,"achyut@bvdu", sizeof a.upi-1); get_timestamp(a.last_login, sizeof a.last_login); accounts[acc_count++]=a;
-        a.acc_no = 1003; strncpy(a.name, "ayush", sizeof a.name-1); a.name[sizeof a.name-1]='\0'; strncpy(a.acc_type, "Current", sizeof a.acc_type-1); a.pin = 3456; a.balance = 5000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(a.upi,"ayush@bvdu", sizeof a.upi-1); get_timestamp(a.last_login, sizeof a.last_login); accounts[acc_count++]=a;
-        a.acc_no = 1004; strncpy(a.name, "aabir", sizeof a.name-1); a.name[sizeof a.name-1]='\0'; strncpy(a.acc_type, "Savings", sizeof a.acc_type-1); a.pin = 4567; a.balance = 12000.0; a.loan = 0; a.active=1; a.frozen=0; a.failed_attempts=0; strncpy(a.upi,"aabir@bvdu", sizeof a.upi-1); get_timestamp(a.last_login, sizeof a.last_login); accounts[acc_count++]=a;
-        save_accounts();
-        audit_log("DEFAULT_ACCOUNTS_CREATED");
-    } else fclose(f);
+/* ledger appends plus periodic account snapshots, as the menu loop issues them */
+static double bench_io_run(int requests, int batch, int snap_every, double *drain) {
+    const char *log = "bench_io.log", *snap_path = "bench_io.snap";
+    remove(log); remove(snap_path);
+    char line[MAX_LINE];
+    double t0 = now_seconds();
+    for (int r = 0; r < requests; ++r) {
+        int n = snprintf(line, sizeof line, "%d|2026-01-01 10:00:00|DEPOSIT|%.2f|%.2f|bench\n", 1000 + r % 500, 100.0 + r, 5000.0 + r);
+        io_append(log, line, (size_t)n, 0);
+        if (r % snap_every == snap_every - 1) {
+            Snapshot snap;
+            FILE *f = snapshot_begin(&snap, "bench_io.tmp", snap_path, 0);
+            if (f) {
+                for (int i = 0; i < 2000; ++i)
+                    fprintf(f, "%d|Account %d|SAVINGS|1234|%.2f|0.00|1|0|0|acc%d@bvdu|never\n", 1000 + i, i, 1000.0 + r + i, i);
+                snapshot_commit(&snap);
+            }
+        }
+        if (r % batch == batch - 1) io_flush(); /* the menu would now block on input */
+    }
+    double req = now_seconds() - t0;
+    t0 = now_seconds();
+    io_drain();
+    *drain = now_seconds() - t0;
+    remove(log); remove(snap_path);
+    return req;
+}
 
-    /* transactions */
-    f = fopen(F_TRANSACTIONS, "r"); if (!f) { fclose(f); FILE *t = fopen(F_TRANSACTIONS, "w"); if (t) fclose(t); }
-    else fclose(f);
+static void bench_io(void) {
+    const int requests = 200000, batch = 16, snap_every = 1000;
+    double drain, req = bench_io_run(requests, batch, snap_every, &drain);
+    printf("%d requests, flush every %d, snapshot every %d\n", requests, batch, snap_every);
+    printf("stdio:    request path %.2f us/req  drain %.1f ms\n", req / requests * 1e6, drain * 1e3);
+    if (!io_backend_init("uring")) return;
+    req = bench_io_run(requests, batch, snap_every, &drain);
+    printf("io_uring: request path %.2f us/req  drain %.1f ms\n", req / requests * 1e6, drain * 1e3);
+}
 
-    /* holdings - if absent create empty */
-    f = fopen(F_HOLDINGS, "r"); if (!f) { fclose(f); FILE *t = fopen(F_HOLDINGS, "w"); if (t) fclose(t); }
-    else fclose(f);
+/* the Account layout before the hot/cold split, for comparison */
+typedef struct {
+    int acc_no;
+    char name[50];
+    char acc_type[20];
+    int pin;
+    double balance;
+    double loan;
+    int active;
+    int frozen;
+    int failed_attempts;
+    char upi[64];
+    char last_login[25];
+    double accrued;
+    int64_t last_accrual;
+} WideAccount;
 
-    /* prices */
-    f = fopen(F_PRICES, "r");
-    if (!f) {
-        fclose(f);
-        /* ensure_default_prices will create default prices and save */
-        ensure_default_prices();
-    } else fclose(f);
+static void bench_accounts(void) {
+    const int n = 1000000, reps = 10;
+    WideAccount *wide = calloc((size_t)n, sizeof *wide);
+    Account *hot = calloc((size_t)n, sizeof *hot);
+    if (!wide || !hot) { printf("out of memory\n"); free(wide); free(hot); return; }
+    for (int i = 0; i < n; ++i) {
+        const char *type = i % 3 ? "Savings" : "Current";
+        wide[i].acc_no = hot[i].acc_no = 1001 + i;
+        wide[i].balance = hot[i].balance = 1000.0 + i % 9973;
+        wide[i].loan = hot[i].loan = i % 7 ? 0.0 : 500.0;
+        wide[i].active = hot[i].active = i % 50 != 0;
+        strcpy(wide[i].acc_type, type);
+        hot[i].type = (unsigned char)acc_type_index(type);
+        snprintf(wide[i].name, sizeof wide[i].name, "cust%d", i);
+        snprintf(wide[i].upi, sizeof wide[i].upi, "cust%d@bvdu", i);
+    }
+    /* totals scan: deposits by type and loan book, as totals_scan() does */
+    double sink = 0.0;
+    double t0 = now_seconds();
+    for (int r = 0; r < reps; ++r) {
+        double by[ACC_TYPE_COUNT] = {0}, loans = 0.0;
+        for (int i = 0; i < n; ++i) {
+            if (!wide[i].active) continue;
+            by[acc_type_index(wide[i].acc_type)] += wide[i].balance;
+            loans += wide[i].loan;
+        }
+        sink += by[0] + by[1] + loans;
+    }
+    double wide_scan = now_seconds() - t0;
+    t0 = now_seconds();
+    for (int r = 0; r < reps; ++r) {
+        double by[ACC_TYPE_COUNT] = {0}, loans = 0.0;
+        for (int i = 0; i < n; ++i) {
+            if (!hot[i].active) continue;
+            by[hot[i].type] += hot[i].balance;
+            loans += hot[i].loan;
+        }
+        sink -= by[0] + by[1] + loans;
+    }
+    double hot_scan = now_seconds() - t0;
+    /* lookups by account number, as find_account_index() does */
+    const int lookups = 200;
+    int found = 0;
+    t0 = now_seconds();
+    for (int k = 0; k < lookups; ++k) {
+        int want = 1001 + (int)(((unsigned)k * 2654435761u) % (unsigned)n);
+        for (int i = 0; i < n; ++i) if (wide[i].acc_no == want) { found++; break; }
+    }
+    double wide_find = now_seconds() - t0;
+    t0 = now_seconds();
+    for (int k = 0; k < lookups; ++k) {
+        int want = 1001 + (int)(((unsigned)k * 2654435761u) % (unsigned)n);
+        for (int i = 0; i < n; ++i) if (hot[i].acc_no == want) { found--; break; }
+    }
+    double hot_find = now_seconds() - t0;
+    printf("%d accounts: record %zu bytes before the split, %zu hot + %zu cold after\n",
+        n, sizeof(WideAccount), sizeof(Account), sizeof(AccountInfo));
+    printf("totals scan: %.2f ns/account -> %.2f ns/account (%.1fx)\n",
+        wide_scan / reps / n * 1e9, hot_scan / reps / n * 1e9, wide_scan / hot_scan);
+    printf("acc_no lookup: %.2f ms -> %.2f ms (%.1fx)%s\n",
+        wide_find / lookups * 1e3, hot_find / lookups * 1e3, wide_find / hot_find,
+        (fabs(sink) > 1e-3 || found) ? " [mismatch]" : "");
+    free(wide);
+    free(hot);
+}
 
-    /* fx */
-    f = fopen(F_FX, "r");
-    if (!f) {
-        fclose(f);
-        get_timestamp(fx.last_update, sizeof fx.last_update);
-        save_fx();
-    } else fclose(f);
+static int cmp_double(const void *x, const void *y) {
+    double a = *(const double *)x, b = *(const double *)y;
+    return (a > b) - (a < b);
+}
 
-    /* admin audit and notifications */
-    f = fopen(F_ADMIN_AUDIT, "a"); if (f) fclose(f);
-    f = fopen(F_NOTIFICATIONS, "a"); if (f) fclose(f);
+/* paged store: build cost and lookup latency with a pool far smaller than the file */
+static void bench_btree(void) {
+    const char *path = "bench_accounts.db";
+    const int n = 1000000, probes = 200000, frames = 1024;
+    remove(path);
+    if (acctstore_open(path, frames) != 0) return;
+    double *lat = malloc((size_t)probes * sizeof *lat);
+    if (!lat) { acctstore_close(); return; }
+    Account a;
+    AccountInfo ai;
+    memset(&a, 0, sizeof a);
+    memset(&ai, 0, sizeof ai);
+    strcpy(ai.acc_type, "Savings");
+    a.active = 1;
+    double t0 = now_seconds();
+    for (int i = 0; i < n; ++i) {
+        a.acc_no = 1001 + i;
+        a.balance = 1000.0 + i % 9973;
+        snprintf(ai.name, sizeof ai.name, "cust%d", i);
+        snprintf(ai.upi, sizeof ai.upi, "u%08x@bvdu", (unsigned)i * 2654435761u);  /* random key order */
+        acctstore_put(&a, &ai, 0);
+    }
+    acctstore_flush();
+    double build = now_seconds() - t0;
+    struct stat st;
+    double file_mb = stat(path, &st) == 0 ? st.st_size / 1048576.0 : 0.0;
+    printf("%d accounts: built in %.2fs (%.2f us/insert), file %.0f MB, pool %.0f MB, height %u + %u\n",
+        n, build, build / n * 1e6, file_mb, frames * (double)BT_PAGE / 1048576.0,
+        acct_store.meta.height[BT_ACC], acct_store.meta.height[BT_UPI]);
+    for (int pass = 0; pass < 2; ++pass) {
+        uint64_t h0 = acct_store.hits, m0 = acct_store.misses;
+        int found = 0;
+        for (int k = 0; k < probes; ++k) {
+            int i = (int)(((unsigned)k * 40503u + 7u) % (unsigned)n);
+            double s0 = now_seconds();
+            if (pass == 0) found += acctstore_get(1001 + i, &a, &ai, NULL);
+            else {
+                char upi[32];
+                snprintf(upi, sizeof upi, "U%08X@BVDU", (unsigned)i * 2654435761u);
+                found += acctstore_find_upi(upi) == 1001 + i;
+            }
+            lat[k] = now_seconds() - s0;
+        }
+        qsort(lat, (size_t)probes, sizeof *lat, cmp_double);
+        uint64_t hits = acct_store.hits - h0, misses = acct_store.misses - m0;
+        printf("%-13s p50 %.2f us  p99 %.2f us  max %.2f us  pool hit %.1f%%%s\n",
+            pass ? "upi lookup:" : "acc_no get:", lat[probes / 2] * 1e6, lat[probes * 99 / 100] * 1e6,
+            lat[probes - 1] * 1e6, 100.0 * hits / (double)(hits + misses ? hits + misses : 1),
+            found == probes ? "" : " [missing keys]");
+    }
+    free(lat);
+    acctstore_close();
+    remove(path);
+}
+
+/* write amplification and point-lookup latency of the KV engine */
+static void bench_lsm(void) {
+    const char *dir = "bench_kv";
+    const int puts = 1000000, keyspace = 400000, probes = 100000;
+    if (kv.open || kv_open(dir) != 0) { printf("bench_lsm: cannot open %s\n", dir); return; }
+    double *lat = malloc((size_t)probes * sizeof *lat);
+    if (!lat) { kv_close(); return; }
+    char key[32], val[128];
+    memset(val, 'v', sizeof val);
+    double t0 = now_seconds();
+    for (int i = 0; i < puts; ++i) {
+        unsigned k = ((unsigned)i * 2654435761u) % (unsigned)keyspace;
+        snprintf(key, sizeof key, "acct%08u", k);
+        int n = snprintf(val, sizeof val, "%u|%d|", k, i);
+        val[n] = 'v';
+        kv_put(CF_ACCOUNTS, key, val, 100);
+    }
+    kv_sync();
+    double ingest = now_seconds() - t0;
+    kv_wait_merges();
+    double settled = now_seconds() - t0;
+    double mb = 1048576.0;
+    printf("%d puts over %d keys: %.2f us/put, merges settled after %.2fs\n", puts, keyspace, ingest / puts * 1e6, settled);
+    printf("user %.1f MB, WAL %.1f MB, flush %.1f MB, merge %.1f MB (%llu merges): write amplification %.2fx\n",
+        kv.user_bytes / mb, kv.wal_bytes / mb, kv.flush_bytes / mb, kv.merge_bytes / mb, (unsigned long long)kv.merges,
+        (kv.wal_bytes + kv.flush_bytes + kv.merge_bytes) / (double)kv.user_bytes);
+    printf("runs:");
+    for (int i = 0; i < kv.cf[CF_ACCOUNTS].nruns; ++i) printf(" t%d", kv.cf[CF_ACCOUNTS].runs[i]->tier);
+    printf("\n");
+    for (int pass = 0; pass < 2; ++pass) {
+        int found = 0;
+        for (int k = 0; k < probes; ++k) {
+            unsigned id = ((unsigned)k * 40503u) % (unsigned)keyspace;
+            snprintf(key, sizeof key, pass ? "miss%08u" : "acct%08u", id);
+            double s0 = now_seconds();
+            char *v = kv_get(CF_ACCOUNTS, key, NULL);
+            lat[k] = now_seconds() - s0;
+            found += v != NULL;
+            free(v);
+        }
+        qsort(lat, (size_t)probes, sizeof *lat, cmp_double);
+        printf("%-13s p50 %.2f us  p99 %.2f us  (%d/%d found)\n", pass ? "absent key:" : "present key:",
+            lat[probes / 2] * 1e6, lat[probes * 99 / 100] * 1e6, found, probes);
+    }
+    free(lat);
+    /* drop the bench store */
+    kv_flush_memtables();
+    kv_wait_merges();
+    char path[256];
+    for (int c = 0; c < CF_COUNT; ++c)
+        for (int i = 0; i < kv.cf[c].nruns; ++i) { kv_run_path(path, sizeof path, kv.cf[c].runs[i]->seq); remove(path); }
+    kv_close();
+    const char *rest[] = {"wal.log", "MANIFEST"};
+    for (int i = 0; i < 2; ++i) { snprintf(path, sizeof path, "%s/%s", dir, rest[i]); remove(path); }
+    rmdir(dir);
+}
+
+/* --bench hot: many threads crediting one receiver */
+#define HOT_BENCH_CREDITS 2000000
+
+static pthread_mutex_t hot_bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static double hot_bench_balance;
+static HotAccount hot_bench_acct;
+
+static void *hot_bench_locked(void *arg) {
+    int n = *(int *)arg;
+    for (int i = 0; i < n; ++i) {
+        pthread_mutex_lock(&hot_bench_lock);
+        hot_bench_balance += 1.0;
+        pthread_mutex_unlock(&hot_bench_lock);
+    }
+    return NULL;
+}
+
+static void *hot_bench_striped(void *arg) {
+    int n = *(int *)arg;
+    for (int i = 0; i < n; ++i) hot_credit(&hot_bench_acct, 1.0);
+    return NULL;
+}
+
+static void bench_hot(void) {
+    const int counts[] = {1, 2, 4, 8};
+    printf("%d credits to one account, split across threads (%ld CPU(s) online)\n",
+        HOT_BENCH_CREDITS, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("threads  locked balance  striped       speedup\n");
+    for (int c = 0; c < 4; ++c) {
+        int t = counts[c], per = HOT_BENCH_CREDITS / t;
+        pthread_t tids[8];
+        double secs[2];
+        int ok = 1;
+        for (int mode = 0; mode < 2; ++mode) {
+            hot_bench_balance = 0.0;
+            memset(&hot_bench_acct, 0, sizeof hot_bench_acct);
+            double t0 = now_seconds();
+            for (int i = 0; i < t; ++i) pthread_create(&tids[i], NULL, mode ? hot_bench_striped : hot_bench_locked, &per);
+            for (int i = 0; i < t; ++i) pthread_join(tids[i], NULL);
+            secs[mode] = now_seconds() - t0;
+            int64_t sum = 0;
+            for (int k = 0; k < HOT_STRIPES; ++k) sum += atomic_load(&hot_bench_acct.stripe[k].paise);
+            if (mode ? sum != (int64_t)per * t * 100 : hot_bench_balance != (double)per * t) ok = 0;
+        }
+        if (!ok) printf("  (credit count mismatch)\n");
+        printf("%7d  %8.1f M/s    %8.1f M/s  %6.1fx\n", t,
+            per * t / secs[0] / 1e6, per * t / secs[1] / 1e6, secs[0] / secs[1]);
+    }
+}
+
+/* --bench proto: one client connection against the server thread, in a
+   scratch directory holding two accounts; half the ops are transfers */
+#define PROTO_BENCH_OPS 200000
+
+static void *bench_proto_server(void *arg) {
+    serve_loop(*(int *)arg);
+    return NULL;
+}
+
+static void bench_proto_op(ProtoBuf *b, long i) {
+    size_t at = proto_begin(b, i % 2 ? OP_BALANCE : OP_TRANSFER, 0, (uint32_t)i);
+    if (!(i % 2)) {
+        int32_t to = 1002;
+        double amt = 1.0;
+        pb_put(b, &to, 4);
+        pb_f64(b, amt);
+    }
+    proto_end(b, at);
+}
+
+/* read responses until `frames` have arrived; returns the ops answered OK */
+static long bench_proto_collect(int fd, ProtoBuf *in, long frames) {
+    long ok = 0;
+    while (frames > 0) {
+        unsigned char *at = pb_reserve(in, 65536);
+        ssize_t r = read(fd, at, 65536);
+        in->len -= 65536 - (r > 0 ? (size_t)r : 0);
+        if (r <= 0) break;
+        size_t off = 0;
+        while (frames > 0 && in->len - off >= 4) {
+            uint32_t len;
+            memcpy(&len, in->p + off, 4);
+            if (in->len - off < (size_t)len + 4) break;
+            const unsigned char *f = in->p + off;
+            if (f[4] != OP_BATCH) ok += f[5] == ST_OK;
+            else for (size_t k = PROTO_HDR; k + PROTO_HDR <= (size_t)len + 4; ) {
+                uint32_t sub;
+                memcpy(&sub, f + k, 4);
+                ok += f[k + 5] == ST_OK;
+                k += (size_t)sub + 4;
+            }
+            off += (size_t)len + 4;
+            frames--;
+        }
+        memmove(in->p, in->p + off, in->len - off);
+        in->len -= off;
+    }
+    return ok;
+}
+
+/* swap the loaded book for two Current accounts (1001 with 1e9 INR, 1002
+   empty, PIN 1111) inside a fresh directory, so server benchmarks write
+   nothing next to the real data files */
+static int bench_scratch_begin(char *cwd, size_t cwdlen, char *dir) {
+    book_detach();   /* benchmarks fill the book with their own accounts */
+    if (!getcwd(cwd, cwdlen) || !mkdtemp(dir) || chdir(dir) != 0) return -1;
+    acc_count = 2; hold_count = 0; hot_count = 0;
+    memset(hot_slot, 0, sizeof hot_slot);
+    for (int i = 0; i < 2; ++i) {
+        memset(&accounts[i], 0, sizeof accounts[i]);
+        memset(&account_info[i], 0, sizeof account_info[i]);
+        accounts[i].acc_no = 1001 + i;
+        accounts[i].pin = 1111;
+        accounts[i].balance = i ? 0.0 : 1e9;
+        accounts[i].active = 1;
+        accounts[i].type = (unsigned char)acc_type_index("Current");
+        accounts[i].last_accrual = today_day();
+        snprintf(account_info[i].name, sizeof account_info[i].name, "bench%d", i);
+        snprintf(account_info[i].acc_type, sizeof account_info[i].acc_type, "Current");
+        snprintf(account_info[i].upi, sizeof account_info[i].upi, "bench%d@bvdu", i);
+    }
+    acc_index_dirty = 1;
+    totals_rebuild();
+    return 0;
+}
+
+static void bench_scratch_end(const char *cwd, const char *dir) {
+    const char *files[] = { F_ACCOUNTS, F_HOLDINGS, F_JOURNAL, F_TRANSACTIONS, F_NOTIFICATIONS, F_ADMIN_AUDIT, F_TRADES, "bench.sock" };
+    for (size_t k = 0; k < sizeof files / sizeof *files; ++k) remove(files[k]);
+    if (chdir(cwd) != 0 || rmdir(dir) != 0) printf("benchmark: could not remove %s\n", dir);
+}
+
+static void bench_proto(void) {
+    char cwd[1024], dir[] = "/tmp/bvdu_proto_XXXXXX";
+    if (bench_scratch_begin(cwd, sizeof cwd, dir) != 0) { printf("bench_proto: no scratch directory\n"); return; }
+    int lfd = serve_listen("bench.sock"), fd = -1;
+    pthread_t tid;
+    int started = lfd >= 0 && pthread_create(&tid, NULL, bench_proto_server, &lfd) == 0;
+    ProtoBuf out = {0}, in = {0};
+    if (!started) { printf("bench_proto: cannot start server\n"); goto done; }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, "bench.sock");
+    if (fd < 0 || connect(fd, (struct sockaddr *)&sa, sizeof sa) != 0) { printf("bench_proto: cannot connect\n"); goto done; }
+    size_t at = proto_begin(&out, OP_LOGIN, 0, 0);
+    int32_t login[2] = {1001, 1111};
+    pb_put(&out, login, sizeof login);
+    proto_end(&out, at);
+    if (write(fd, out.p, out.len) != (ssize_t)out.len || bench_proto_collect(fd, &in, 1) != 1) { printf("bench_proto: login failed\n"); goto done; }
+
+    printf("%d ops (transfer / balance alternating) on one connection\n", PROTO_BENCH_OPS);
+    printf("mode                      ops/s      ok\n");
+    const struct { const char *name; int window, batch; } modes[] = {
+        {"one at a time", 1, 0}, {"pipelined x512", 512, 0}, {"batch frames 8 x 512", 8, 512},
+    };
+    long transfers = 0;
+    for (int m = 0; m < 3; ++m) {
+        long ops = m == 0 ? PROTO_BENCH_OPS / 10 : PROTO_BENCH_OPS, ok = 0, i = 0;
+        double t0 = now_seconds();
+        while (i < ops) {
+            out.len = 0;
+            long frames = 0;
+            for (int w = 0; w < modes[m].window && i < ops; ++w, ++frames) {
+                if (!modes[m].batch) { bench_proto_op(&out, i++); continue; }
+                size_t bat = proto_begin(&out, OP_BATCH, 0, (uint32_t)i);
+                for (int k = 0; k < modes[m].batch && i < ops; ++k) bench_proto_op(&out, i++);
+                proto_end(&out, bat);
+            }
+            if (write(fd, out.p, out.len) != (ssize_t)out.len) break;
+            ok += bench_proto_collect(fd, &in, frames);
+        }
+        double dt = now_seconds() - t0;
+        transfers += (i + 1) / 2;
+        printf("%-22s %10.0f  %6ld/%ld\n", modes[m].name, ops / dt, ok, ops);
+    }
+    printf("balances: %.2f + %.2f (moved %.2f, expected %ld.00)\n",
+        accounts[0].balance, accounts[1].balance, accounts[1].balance, transfers);
+done:
+    if (fd >= 0) close(fd);
+    atomic_store(&serve_stop, 1);
+    if (started) pthread_join(tid, NULL);
+    if (lfd >= 0) close(lfd);
+    free(out.p); free(in.p);
+    bench_scratch_end(cwd, dir);
+}
+
+/* --bench shm: round trips through the shared-memory endpoint */
+static void *bench_shm_server(void *arg) {
+    shm_serve_loop(arg);
+    return NULL;
+}
+
+static void bench_shm(void) {
+    const int calls = 100000, transfers = 20000;
+    char cwd[1024], dir[] = "/tmp/bvdu_shm_XXXXXX", path[64];
+    if (bench_scratch_begin(cwd, sizeof cwd, dir) != 0) { printf("bench_shm: no scratch directory\n"); return; }
+    snprintf(path, sizeof path, "/dev/shm/bvdu_bench_%d", (int)getpid());
+    ShmRegion *rg = shm_map(path, 1);
+    double *lat = malloc((size_t)calls * sizeof *lat);
+    pthread_t tid;
+    if (!rg || !lat || pthread_create(&tid, NULL, bench_shm_server, rg) != 0) {
+        printf("bench_shm: cannot set up %s\n", path);
+        if (rg) { munmap(rg, sizeof *rg); unlink(path); }
+        free(lat); bench_scratch_end(cwd, dir);
+        return;
+    }
+    printf("round trip (us)          p50      p99     calls/s   (%ld CPU(s) online)\n", sysconf(_SC_NPROCESSORS_ONLN));
+    double moved = 0.0;
+    for (int mode = 0; mode < 4; ++mode) {
+        int futex = mode & 1, xfer = mode >= 2, n = xfer ? transfers : calls;
+        int slot = shm_attach(rg, futex);
+        ShmMsg m;
+        double t0 = now_seconds();
+        for (int i = 0; i < n; ++i) {
+            memset(&m, 0, sizeof m);
+            m.op = xfer ? OP_TRANSFER : OP_BALANCE;
+            m.acc_no = 1001; m.pin = 1111; m.to_acc = 1002; m.amount = 1.0;
+            double t = now_seconds();
+            shm_call(rg, slot, &m);
+            lat[i] = now_seconds() - t;
+            if (m.status != ST_OK) { printf("bench_shm: status %d\n", m.status); break; }
+            if (xfer) moved += 1.0;
+        }
+        double dt = now_seconds() - t0;
+        shm_detach(rg, slot);
+        qsort(lat, (size_t)n, sizeof *lat, cmp_double);
+        printf("%-8s %-13s %8.2f %8.2f %11.0f\n", xfer ? "transfer" : "balance", futex ? "futex wake" : "busy-poll",
+            lat[n / 2] * 1e6, lat[n * 99 / 100] * 1e6, n / dt);
+    }
+    printf("moved %.2f INR, 1002 now holds %.2f\n", moved, accounts[1].balance);
+    atomic_store(&serve_stop, 1);
+    atomic_fetch_add(&rg->doorbell, 1);
+    shm_wake(&rg->doorbell);
+    pthread_join(tid, NULL);
+    munmap(rg, sizeof *rg);
+    unlink(path);
+    free(lat);
+    bench_scratch_end(cwd, dir);
+}
+
+/* --bench cores: random transfers among a full book, 1..N cores */
+#define CORE_BENCH_OPS (1 << 21)
+
+typedef struct {
+    const CoreReq *reqs;
+    long n, next;
+} CoreBenchSrc;
+
+static int core_bench_next(void *arg, CoreReq *rq) {
+    CoreBenchSrc *s = arg;
+    if (s->next == s->n) return 0;
+    *rq = s->reqs[s->next++];
+    return 1;
+}
+
+static void bench_cores(void) {
+    char cwd[1024], dir[] = "/tmp/bvdu_cores_XXXXXX";
+    if (bench_scratch_begin(cwd, sizeof cwd, dir) != 0) { printf("bench_cores: no scratch directory\n"); return; }
+    CoreReq *reqs = malloc(CORE_BENCH_OPS * sizeof *reqs);
+    if (!reqs) { printf("bench_cores: out of memory\n"); bench_scratch_end(cwd, dir); return; }
+    acc_count = MAX_ACCOUNTS;
+    for (int i = 0; i < acc_count; ++i) {
+        accounts[i] = accounts[0];
+        accounts[i].acc_no = 1001 + i;
+        accounts[i].balance = 1e7;
+    }
+    acc_index_dirty = 1;
+    uint64_t x = 0x9e3779b97f4a7c15ull;
+    for (long i = 0; i < CORE_BENCH_OPS; ++i) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        reqs[i].from = (int)(x % (uint64_t)acc_count);
+        reqs[i].to = (int)((x >> 32) % (uint64_t)(acc_count - 1));
+        if (reqs[i].to >= reqs[i].from) reqs[i].to++;
+        reqs[i].paise = 100;
+    }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int top = online > 1 ? (int)online : 2;
+    if (top > CORE_MAX) top = CORE_MAX;
+    printf("%d transfers among %d accounts (%ld CPU(s) online)\n", CORE_BENCH_OPS, acc_count, online);
+    printf("cores  transfers/s  speedup\n");
+    double base = 0.0;
+    for (int n = 1; n <= top; n = n * 2 > top && n < top ? top : n * 2) {
+        for (int i = 0; i < acc_count; ++i) accounts[i].balance = 1e7;
+        CoreBenchSrc src = { reqs, CORE_BENCH_OPS, 0 };
+        long applied, refused;
+        double t0 = now_seconds();
+        int rc = core_run(n, core_bench_next, &src, 0, &applied, &refused);
+        double rate = CORE_BENCH_OPS / (now_seconds() - t0);
+        double sum = 0.0;
+        for (int i = 0; i < acc_count; ++i) sum += accounts[i].balance;
+        if (n == 1) base = rate;
+        printf("%5d  %11.0f  %6.2fx%s%s\n", n, rate, rate / base, n > online ? "  (more cores than CPUs)" : "",
+            rc != 0 || applied != CORE_BENCH_OPS || sum != 1e7 * acc_count ? "  (MISMATCH)" : "");
+    }
+    free(reqs);
+    bench_scratch_end(cwd, dir);
+}
+
+/* --bench onboard: parallel account building (numbers + UPI reservations) */
+#define ONBOARD_BENCH_ACCOUNTS (1 << 17)
+
+static void bench_onboard(void) {
+    char cwd[1024], dir[] = "/tmp/bvdu_onboard_XXXXXX";
+    if (bench_scratch_begin(cwd, sizeof cwd, dir) != 0) { printf("bench_onboard: no scratch directory\n"); return; }
+    int n = ONBOARD_BENCH_ACCOUNTS;
+    char **lines = malloc((size_t)n * sizeof *lines);
+    char (*err)[128] = malloc((size_t)n * sizeof *err);
+    if (!lines || !err) { printf("bench_onboard: out of memory\n"); free(lines); free(err); bench_scratch_end(cwd, dir); return; }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int top = online > 1 ? (int)online : 2;
+    if (top > ONBOARD_MAX_THREADS) top = ONBOARD_MAX_THREADS;
+    printf("%d accounts built per run (%ld CPU(s) online)\n", n, online);
+    printf("threads  accounts/s  speedup\n");
+    double base = 0.0;
+    for (int t = 1; t <= top; t = t * 2 > top && t < top ? top : t * 2) {
+        for (int i = 0; i < n; ++i) {
+            char line[96];
+            snprintf(line, sizeof line, "user%d|Savings|1234|100|u%d", i, i);
+            lines[i] = strdup(line);
+        }
+        upi_set_init((size_t)n + (size_t)acc_count);
+        for (int i = 0; i < acc_count; ++i) upi_reserve(account_info[i].upi);
+        OnboardShard shards[ONBOARD_MAX_THREADS];
+        double t0 = now_seconds();
+        int made = onboard_build(lines, n, t, n, shards, err);
+        double rate = n / (now_seconds() - t0);
+        /* every number and UPI id handed out exactly once */
+        int dup = made != n;
+        int lo = INT32_MAX, hi = 0;
+        for (int k = 0; k < t; ++k)
+            for (int i = 0; i < shards[k].made; ++i) {
+                if (shards[k].acc[i].acc_no < lo) lo = shards[k].acc[i].acc_no;
+                if (shards[k].acc[i].acc_no > hi) hi = shards[k].acc[i].acc_no;
+            }
+        uint8_t *seen = calloc((size_t)(hi >= lo ? hi - lo + 1 : 1), 1);
+        for (int k = 0; k < t; ++k) {
+            for (int i = 0; seen && i < shards[k].made; ++i) dup |= seen[shards[k].acc[i].acc_no - lo]++;
+            free(shards[k].acc); free(shards[k].info);
+        }
+        free(seen);
+        dup |= upi_reserve("u0@bvdu");   /* must already be taken */
+        if (t == 1) base = rate;
+        printf("%7d  %10.0f  %6.2fx%s%s\n", t, rate, rate / base, t > online ? "  (more threads than CPUs)" : "", dup ? "  (DUPLICATE OR MISSING)" : "");
+        for (int i = 0; i < n; ++i) free(lines[i]);
+    }
+    free(lines); free(err);
+    upi_set_stale = 1;
+    remove(F_ACCOUNT_SEQ);
+    bench_scratch_end(cwd, dir);
+}
+
+/* --bench archive: checkpoint cost before and after the dormant accounts
+   leave the book, and the cost of bringing one back */
+#define ARCHIVE_BENCH_SAVES 20
+#define ARCHIVE_BENCH_ROWS 8
+
+static double bench_save_accounts(void) {
+    double t0 = now_seconds();
+    for (int r = 0; r < ARCHIVE_BENCH_SAVES; ++r) save_accounts();
+    return (now_seconds() - t0) / ARCHIVE_BENCH_SAVES;
+}
+
+static void bench_archive(void) {
+    char cwd[1024], dir[] = "/tmp/bvdu_archive_XXXXXX";
+    if (bench_scratch_begin(cwd, sizeof cwd, dir) != 0) { printf("bench_archive: no scratch directory\n"); return; }
+    OutBuf *ledger = malloc(sizeof *ledger);
+    if (!ledger) { printf("bench_archive: out of memory\n"); bench_scratch_end(cwd, dir); return; }
+    ledger->append_path = F_TRANSACTIONS;
+    ledger->len = 0;
+    char now[25];
+    get_timestamp(now, sizeof now);
+    acc_count = MAX_ACCOUNTS;
+    for (int i = 0; i < acc_count; ++i) {   /* one in ten logged in recently */
+        accounts[i] = accounts[0];
+        accounts[i].acc_no = 1001 + i;
+        accounts[i].balance = 100.0 * ARCHIVE_BENCH_ROWS;
+        snprintf(account_info[i].name, sizeof account_info[i].name, "bench%d", i);
+        snprintf(account_info[i].acc_type, sizeof account_info[i].acc_type, "Current");
+        snprintf(account_info[i].upi, sizeof account_info[i].upi, "bench%d@bvdu", i);
+        snprintf(account_info[i].last_login, sizeof account_info[i].last_login, "%s", i % 10 ? "2015-06-01 10:00:00" : now);
+        for (int r = 1; r <= ARCHIVE_BENCH_ROWS; ++r)
+            ob_printf(ledger, "%d|%s|DEPOSIT|100.00|%.2f|Deposit\n", accounts[i].acc_no, now, 100.0 * r);
+    }
+    ob_flush(ledger);
+    free(ledger);
+    acc_index_dirty = 1;
+    totals_rebuild();
+    int total = acc_count;
+    long ledger_before = io_file_size(F_TRANSACTIONS);
+    double before = bench_save_accounts();
+    archive_dormant(2);
+    double after = bench_save_accounts();
+    long ledger_after = io_file_size(F_TRANSACTIONS);
+    char msg[96];
+    double t0 = now_seconds();
+    int bad = cold_rehydrate(1002, msg, sizeof msg) != 0 || find_account_index(1002) < 0;
+    double one = now_seconds() - t0;
+    bad |= io_file_size(F_TRANSACTIONS) != ledger_after + (ledger_before / total);
+    printf("%d accounts, %d left in the book\n", total, acc_count - 1);
+    printf("save_accounts: %.3f ms -> %.3f ms; transactions.txt %ld -> %ld bytes; %s %ld bytes\n",
+        before * 1e3, after * 1e3, ledger_before, ledger_after, F_COLD_STORE, io_file_size(F_COLD_STORE));
+    printf("rehydrate one account: %.3f ms%s\n", one * 1e3, bad ? "  (MISMATCH)" : "");
+    FILE *cat = fopen(F_PITR_CATALOG, "r");
+    char line[64], path[64];
+    while (cat && fgets(line, sizeof line, cat)) {
+        snprintf(path, sizeof path, "pitr_%lld.accounts", atoll(line)); remove(path);
+        snprintf(path, sizeof path, "pitr_%lld.holdings", atoll(line)); remove(path);
+    }
+    if (cat) fclose(cat);
+    remove(F_PITR_CATALOG);
+    remove(F_COLD_STORE);
+    bench_scratch_end(cwd, dir);
+}
+
+static int run_benchmark(const char *name) {
+    if (strcmp(name, "pubsub") == 0) bench_pubsub();
+    else if (strcmp(name, "fees") == 0) bench_fees();
+    else if (strcmp(name, "basket") == 0) bench_basket();
+    else if (strcmp(name, "io") == 0) bench_io();
+    else if (strcmp(name, "accounts") == 0) bench_accounts();
+    else if (strcmp(name, "btree") == 0) bench_btree();
+    else if (strcmp(name, "lsm") == 0) bench_lsm();
+    else if (strcmp(name, "hot") == 0) bench_hot();
+    else if (strcmp(name, "proto") == 0) bench_proto();
+    else if (strcmp(name, "shm") == 0) bench_shm();
+    else if (strcmp(name, "cores") == 0) bench_cores();
+    else if (strcmp(name, "onboard") == 0) bench_onboard();
+    else if (strcmp(name, "archive") == 0) bench_archive();
+    else { printf("Unknown benchmark '%s'. Available: pubsub, fees, basket, io, accounts, btree, lsm, hot, proto, shm, cores, onboard, archive\n", name); return 1; }
+    return 0;
 }
 
 /* ---------------- Main menu and entry ---------------- */
 
-int main(void) {
+int main(int argc, char **argv) {
     srand((unsigned)time(NULL));
+    io_backend_init(getenv("BVDU_IO"));
+    kv_attach(getenv("BVDU_KV"));
     load_fx();
     load_prices();
-    load_holdings();
     load_accounts();
+    book_attach(getenv("BVDU_SHARED"));   /* from here on the book is held except while waiting for input */
+    load_hot_accounts();
+    load_idempotency();
     ensure_default_files();
+    load_baskets();
+    load_holdings();   /* after every listing exists, so only truly unknown ids are interned */
+    load_trades();
+    load_settlement();
+    load_interest();
+    load_fees();
+    compile_asset_fee_keys();
+    totals_rebuild();
+    post_monthly_interest();
+
+    /* non-interactive tools */
+    if (argc >= 3 && strcmp(argv[1], "--price-feed") == 0) {
+        book_detach();   /* a feed blocks on its input for as long as it runs */
+        run_price_feed(argv[2]);
+        return 0;
+    }
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0) {
+        kv_close();   /* benchmarks save scratch books, never into the store */
+        return run_benchmark(argv[2]);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--metrics") == 0) { write_metrics(stdout); return 0; }
+    if (argc >= 3 && strcmp(argv[1], "--recover") == 0) return pitr_recover(argv[2]) < 0;
+    if (argc >= 2 && strcmp(argv[1], "--checkpoint") == 0) return pitr_checkpoint() != 0;
+    if (argc >= 3 && strcmp(argv[1], "--store-import") == 0) return acctstore_import(argv[2]);
+    if (argc >= 4 && strcmp(argv[1], "--store-get") == 0) return acctstore_lookup(argv[2], argv[3]);
+    if (argc >= 5 && strcmp(argv[1], "--kv-get") == 0) return kv_lookup(argv[2], argv[3], argv[4]);
+    acctstore_attach(getenv("BVDU_ACCOUNT_STORE"));
+    kv_adopt_book();
+    pitr_ensure_checkpoint();
+    if (argc >= 2 && strcmp(argv[1], "--settle") == 0) {
+        int moves;
+        int n = run_settlement(&moves);
+        if (n < 0) { printf("Settlement failed.\n"); return 1; }
+        printf("Settled %d trade(s) into %d netted movement(s).\n", n, moves);
+        return 0;
+    }
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0) return run_server(argv[2]);
+    if (argc >= 2 && strcmp(argv[1], "--archive") == 0) return archive_dormant(argc >= 3 ? atoi(argv[2]) : 2);
+    if (argc >= 3 && strcmp(argv[1], "--rehydrate") == 0) return run_rehydrate(atoi(argv[2]));
+    if (argc >= 3 && strcmp(argv[1], "--onboard") == 0) return run_onboard(argv[2], argc >= 4 ? atoi(argv[3]) : 0);
+    if (argc >= 3 && strcmp(argv[1], "--transfers") == 0) return run_transfers(argv[2], argc >= 4 ? atoi(argv[3]) : 0);
+    if (argc >= 3 && strcmp(argv[1], "--pay-batch") == 0) return run_pay_batch(argv[2], argc >= 4 ? argv[3] : NULL);
+    if (argc >= 3 && strcmp(argv[1], "--export-trades") == 0) {
+        int n = export_trades_csv(argv[2]);
+        if (n < 0) { printf("Cannot write %s.\n", argv[2]); return 1; }
+        printf("Exported %d trade(s) to %s.\n", n, argv[2]);
+        return 0;
+    }
 
     printf("=== BVDU Bank — Banking & Trading Management System ===\n");
     for (;;) {
+        post_monthly_interest(); /* no-op unless the month has turned */
         printf("\nMain Menu:\n1.Customer Login\n2.Create Account\n3.List Market Prices\n4.Admin\n0.Exit\nChoice: ");
         int ch = safe_read_int();
         if (ch == 1) {
             int idx = authenticate_prompt();
             if (idx >= 0) customer_dashboard(idx);
         } else if (ch == 2) create_account_interactive();
-        else if (ch == 3) list_market_prices();
+        else if (ch == 3) list_market_prices(stdout);
         else if (ch == 4) admin_menu();
         else if (ch == 0) { printf("Bye — saving data...\n"); save_accounts(); save_holdings(); save_prices(); save_fx(); break; }
         else printf("Invalid.\n");